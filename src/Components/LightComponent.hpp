@@ -54,5 +54,17 @@ void LightComponent<TLight>::ReceiveEvent(const IEntityEvent& ev)
     if (ev.Is<EntityMovedEvent>())
     {
         this->position = this->owner->ScreenCenter() + offsetFromCenter;
+
+        if (this->GetScene()->isServer)
+        {
+            return;
+        }
+
+        auto renderer = this->GetScene()->GetEngine()->GetRenderer();
+
+        if (renderer != nullptr)
+        {
+            renderer->GetLightManager()->UpdateLight(this);
+        }
     }
 }
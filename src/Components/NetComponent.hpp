@@ -80,10 +80,13 @@ DEFINE_COMMAND(DoNothingCommand)
 
 struct PlayerCommandHandler
 {
+    // Registered by the engine so that there is always a command to send, e.g. from the load test's synthetic clients
+    static constexpr int DoNothingCommandId = 255;
+
     PlayerCommandHandler(BlockAllocator* blockAllocator)
         : blockAllocator(blockAllocator)
     {
-
+        RegisterCommandType<DoNothingCommand>(DoNothingCommandId);
     }
 
     struct ScheduledCommand
@@ -94,7 +97,7 @@ struct PlayerCommandHandler
 
     PlayerCommandHandler()
     {
-        RegisterCommandType<DoNothingCommand>(0);
+        RegisterCommandType<DoNothingCommand>(DoNothingCommandId);
     }
 
     template<typename TCommand>
@@ -148,10 +151,13 @@ void PlayerCommandHandler::RegisterCommandType(int id, std::function<void(const
         return command;
     };
 
-    handlerByMetadata[&TCommand::typeMetadata] = [=](const auto& command)
+    if (onReceived != nullptr)
     {
-        onReceived(static_cast<const TCommand&>(command));
-    };
+        handlerByMetadata[&TCommand::typeMetadata] = [=](const auto& command)
+        {
+            onReceived(static_cast<const TCommand&>(command));
+        };
+    }
 
     commandIdByMetadata[&TCommand::typeMetadata] = id;
 }
@@ -167,10 +173,16 @@ DEFINE_COMPONENT(NetComponent)
     void OnAdded() override;
     void OnRemoved() override;
 
+    static constexpr int NoOwner = -2;
+
     int netId = -2;
-    int ownerClientId = -2;
+    int ownerClientId = NoOwner;
     bool isMarkedForDestructionOnClient = false;
 
     float destroyTime = INFINITY;
     bool markedForDestruction = false;
+
+    // Used by the server's relevancy filter, if any
+    bool alwaysRelevant = false;
+    float relevancyPriority = 1;
 };
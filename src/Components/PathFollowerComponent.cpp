@@ -76,7 +76,8 @@ void PathFollowerComponent::FollowFlowField()
             return;
         }
 
-        if (currentPath.flowField->grid[pathFindingPosition].hasLineOfSightToGoal
+        if (currentPath.flowField != nullptr
+            && currentPath.flowField->grid[pathFindingPosition].hasLineOfSightToGoal
             && CanBeeline(owner->Center(), scene->isometricSettings.TileToWorld(currentPath.target)))
         {
             intermediateTarget = currentPath.target;
@@ -180,23 +181,33 @@ void PathFollowerComponent::ReceiveEvent(const IEntityEvent& ev)
     if (auto flowFieldReady = ev.Is<FlowFieldReadyEvent>())
     {
         auto flowField = flowFieldReady->result;
-        auto cell = flowField->startCell;
+        auto cell = flowFieldReady->startCell;
         currentPath.path.clear();
         currentPath.nextPathIndex = -1;
         currentPath.flowField = flowField;
 
-        Vector2 dir;
-        do
+        if (flowField == nullptr)
         {
-            dir = flowField->grid[cell].dir;
+            for (auto pathCell : flowFieldReady->path)
+            {
+                currentPath.path.push_back(pathCell + Vector2(0.5));
+            }
+        }
+        else
+        {
+            Vector2 dir;
+            do
+            {
+                dir = flowField->grid[cell].dir;
 
-            if (dir == Vector2(0)) break;
+                if (dir == Vector2(0)) break;
 
-            cell = cell + dir;
-            currentPath.path.push_back(cell + Vector2(0.5));
-        } while (true);
+                cell = cell + dir;
+                currentPath.path.push_back(cell + Vector2(0.5));
+            } while (true);
+        }
 
-        currentPath.target = flowField->end;
+        currentPath.target = flowFieldReady->end;
         acceleration = { 0, 0 };
     }
 }
@@ -13,6 +13,8 @@ RigidBodyComponent::RigidBodyComponent(b2BodyType type)
 
 void RigidBodyComponent::OnAdded()
 {
+    owner->rigidBody = this;
+
     b2BodyDef bodyDef;
     bodyDef.type = type;
     CreateBody(bodyDef);
@@ -22,6 +24,9 @@ void RigidBodyComponent::SetVelocity(const Vector2& velocity)
 {
     auto scaled = velocity * Scene::PixelsToBox2DRatio;
     body->SetLinearVelocity(b2Vec2(scaled.x, scaled.y));
+
+    // Wakes the body
+    GetScene()->GetCollisionManager().MarkBodyForSync(body);
 }
 
 Vector2 RigidBodyComponent::GetVelocity() const
@@ -34,6 +39,7 @@ void RigidBodyComponent::ApplyForce(const Vector2& force)
 {
     auto box2dForce = b2Vec2(force.x * Scene::PixelsToBox2DRatio.x, force.y * Scene::PixelsToBox2DRatio.y);
     body->ApplyForceToCenter(box2dForce, true);
+    GetScene()->GetCollisionManager().MarkBodyForSync(body);
 }
 
 void RigidBodyComponent::ApplyForce(const Vector2& force, const Vector2& position)
@@ -41,6 +47,18 @@ void RigidBodyComponent::ApplyForce(const Vector2& force, const Vector2& positio
     auto box2dForce = b2Vec2(force.x * Scene::PixelsToBox2DRatio.x, force.y * Scene::PixelsToBox2DRatio.y);
     auto box2dPosition = b2Vec2(position.x * Scene::PixelsToBox2DRatio.x, position.y * Scene::PixelsToBox2DRatio.y);
     body->ApplyForce(box2dForce, body->GetWorldPoint(box2dPosition), true);
+    GetScene()->GetCollisionManager().MarkBodyForSync(body);
+}
+
+void RigidBodyComponent::SetAwake(bool isAwake)
+{
+    body->SetAwake(isAwake);
+    NotifyBodyChanged();
+}
+
+void RigidBodyComponent::NotifyBodyChanged()
+{
+    GetScene()->GetCollisionManager().MarkBodyForSync(body);
 }
 
 void ScaleToBox2D(b2Vec2& v)
@@ -53,10 +71,21 @@ void RigidBodyComponent::OnOwnerMoved()
     body->SetTransform(
         Scene::PixelToBox2D(owner->Center()),
         owner->Rotation());
+
+    // SetTransform() doesn't wake the body, and the owner may have been teleported
+    GetScene()->GetCollisionManager().MarkBodyForSync(body);
 }
 
 void RigidBodyComponent::OnRemoved()
 {
+    if (owner->rigidBody == this)
+    {
+        RigidBodyComponent* otherRigidBody = nullptr;
+        owner->TryGetComponent(otherRigidBody);
+        owner->rigidBody = otherRigidBody != this ? otherRigidBody : nullptr;
+    }
+
+    GetScene()->GetCollisionManager().ForgetBody(body);
     GetScene()->GetWorld()->DestroyBody(body);
 }
 
@@ -64,6 +93,7 @@ b2Body* RigidBodyComponent::CreateBody(b2BodyDef& bodyDef, bool createAtCurrentP
 {
     if (body != nullptr)
     {
+        GetScene()->GetCollisionManager().ForgetBody(body);
         GetScene()->GetWorld()->DestroyBody(body);
     }
 
@@ -79,6 +109,7 @@ b2Body* RigidBodyComponent::CreateBody(b2BodyDef& bodyDef, bool createAtCurrentP
     bodyDef.userData.pointer = reinterpret_cast<uintptr_t>(this);
 
     body = GetScene()->GetWorld()->CreateBody(&bodyDef);
+    GetScene()->GetCollisionManager().AddBody(body);
 
     return body;
 }
@@ -90,7 +121,9 @@ void RigidBodyComponent::ResetBody()
     if (body != nullptr)
     {
         oldType = body->GetType();
+        GetScene()->GetCollisionManager().ForgetBody(body);
         GetScene()->GetWorld()->DestroyBody(body);
+        body = nullptr;
     }
 
     b2BodyDef bodyDef;
@@ -22,6 +22,17 @@ DEFINE_COMPONENT(RigidBodyComponent)
     void ApplyForce(const Vector2& force);
     void ApplyForce(const Vector2& force, const Vector2 & position);
 
+    /// <summary>
+    /// Wakes the body, or puts it to sleep until something touches it.
+    /// </summary>
+    void SetAwake(bool isAwake);
+
+    /// <summary>
+    /// Must be called after changing body directly in a way that can wake or move it, such as b2Body::SetAwake(),
+    /// SetLinearVelocity() or SetTransform(). Otherwise the owner doesn't follow the body until something else wakes it.
+    /// </summary>
+    void NotifyBodyChanged();
+
     static RigidBodyComponent* FromB2Body(b2Body* body);
 
     b2Fixture* CreateBoxCollider(Vector2 size, bool isTrigger = false, Vector2 offset = Vector2(0, 0));
@@ -32,4 +43,8 @@ DEFINE_COMPONENT(RigidBodyComponent)
 
     b2Body* body = nullptr;
     b2BodyType type;
+
+    // Kept by CollisionManager. The index is -1 when the body isn't waiting to be synced, and -2 after it's forgotten.
+    int syncListIndex = -1;
+    unsigned int creationOrder = 0;
 };
@@ -2,6 +2,7 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
 
 #include "Engine.hpp"
@@ -18,7 +19,10 @@
 #include "Tools/PlotManager.hpp"
 #include "Tools/MetricsManager.hpp"
 #include "Sound/SoundManager.hpp"
+#include "System/WorkerPool.hpp"
+#include "Tools/Profiler.hpp"
 #include "UI/UI.hpp"
+#include "Net/LoadTest.hpp"
 #include "Net/ServerGame.hpp"
 
 using namespace std::chrono;
@@ -84,6 +88,13 @@ Engine::Engine(const EngineConfig& config)
 
     _neuralNetworkManager = std::make_unique<NeuralNetworkManager>();
 
+    int workerThreadCount = config.workerThreadCount >= 0
+        ? config.workerThreadCount
+        : std::max((int)std::thread::hardware_concurrency() - 1, 0);
+
+    Log("Starting %d worker threads\n", workerThreadCount);
+    _workerPool = std::make_unique<WorkerPool>(workerThreadCount);
+
     UiCanvas::Initialize(_soundManager.get());
 }
 
@@ -107,6 +118,7 @@ Engine::~Engine()
 
         TaskScheduler::GetInstance()->Stop();
         ThreadPool::GetInstance()->Stop();
+        _workerPool->Stop();
     }
     catch(const std::exception& e)
     {
@@ -151,6 +163,9 @@ void AccurateSleepFor(float seconds)
 
 void Engine::RunFrame()
 {
+    // Between frames, so no zone is open on any thread
+    Profiler::GetInstance()->EndFrame();
+
     std::function<void()> func;
     while (g_workQueue.TryDequeue(func))
     {
@@ -188,9 +203,30 @@ void Engine::RunFrame()
     float now = GetTimeSeconds();
     float timeUntilUpdate = nextGameToRun->nextUpdateTime - now;
 
-    AccurateSleepFor(timeUntilUpdate);
+    {
+        PROFILE_ZONE("Sleep");
+        AccurateSleepFor(timeUntilUpdate);
+    }
+
+    auto frameStart = high_resolution_clock::now();
     nextGameToRun->RunFrame(GetTimeSeconds());
     nextGameToRun->nextUpdateTime = nextGameToRun->nextUpdateTime + 1.0f / nextGameToRun->targetTickRate;
+
+    if (_loadTest != nullptr && nextGameToRun == _serverGame.get())
+    {
+        _loadTest->Update(duration<float>(high_resolution_clock::now() - frameStart).count());
+
+        if (_loadTest->IsFinished())
+        {
+            _loadTest = nullptr;
+        }
+    }
+
+    auto scene = nextGameToRun->GetScene();
+    if (scene != nullptr)
+    {
+        scene->GetFrameArena().Reset();
+    }
 }
 
 void Engine::PauseGame()
@@ -217,8 +253,47 @@ void ConnectCommand(ConsoleCommandBinder& binder)
 
 ConsoleCmd connectCmd("connect", ConnectCommand);
 
+static void LogFrameArenaStats(Console* console, const char* gameName, BaseGameInstance* game)
+{
+    Scene* scene = game != nullptr ? game->GetScene() : nullptr;
+    if (scene == nullptr)
+    {
+        return;
+    }
+
+    auto& arena = scene->GetFrameArena();
+    console->Log(
+        "%s: %d bytes last frame, %d peak, %d capacity, grown %d times\n",
+        gameName,
+        (int)arena.LastFrameBytes(),
+        (int)arena.HighWaterMark(),
+        (int)arena.Capacity(),
+        arena.TotalOverflowFrames());
+}
+
+void FrameArenaStatsCommand(ConsoleCommandBinder& binder)
+{
+    binder.Help("Shows how much per-frame scratch memory each scene uses");
+
+    auto engine = binder.GetEngine();
+    LogFrameArenaStats(binder.GetConsole(), "server", engine->GetServerGame());
+    LogFrameArenaStats(binder.GetConsole(), "client", engine->GetClientGame());
+}
+
+ConsoleCmd frameArenaStatsCmd("frame-arena-stats", FrameArenaStatsCommand);
+
+static void CheckMaxServerClients(int maxServerClients)
+{
+    if (maxServerClients < 1 || maxServerClients > ServerGame::MaxClientIds)
+    {
+        FatalError("maxServerClients is %d, it has to be between 1 and %d", maxServerClients, ServerGame::MaxClientIds);
+    }
+}
+
 void Engine::StartServer(int port, const char* mapName)
 {
+    CheckMaxServerClients(_config.maxServerClients);
+
     SLNet::SocketDescriptor sd(port, nullptr);
     auto peerInterface = SLNet::RakPeerInterface::GetInstance();
 
@@ -227,23 +302,47 @@ void Engine::StartServer(int port, const char* mapName)
         peerInterface->Shutdown(500);
     }
 
-    auto result = peerInterface->Startup(ServerGame::MaxClients, &sd, 1);
+    auto result = peerInterface->Startup(_config.maxServerClients, &sd, 1);
 
     if (result != SLNet::RAKNET_STARTED)
     {
         FatalError("Failed to startup server");
     }
 
-    peerInterface->SetMaximumIncomingConnections(ServerGame::MaxClients);
+    peerInterface->SetMaximumIncomingConnections(_config.maxServerClients);
 
     Log("Listening on %d...\n", port);
 
-    _serverGame = std::make_shared<ServerGame>(this, peerInterface, SLNet::AddressOrGUID(SLNet::SystemAddress("0.0.0.2", 1)));
+    _serverGame = std::make_shared<ServerGame>(this, peerInterface, SLNet::AddressOrGUID(SLNet::SystemAddress("0.0.0.2", 1)), _config.maxServerClients);
     _clientGame = nullptr;
 
     _serverGame->sceneManager.TrySwitchScene(mapName);
 }
 
+void Engine::StartLoopbackServer(const char* mapName)
+{
+    CheckMaxServerClients(_config.maxServerClients);
+
+    auto peerInterface = SLNet::RakPeerInterface::GetInstance();
+
+    if (peerInterface->IsActive())
+    {
+        peerInterface->Shutdown(500);
+    }
+
+    _serverGame = std::make_shared<ServerGame>(this, peerInterface, SLNet::AddressOrGUID(SLNet::SystemAddress("0.0.0.2", 1)), _config.maxServerClients);
+    _clientGame = nullptr;
+
+    _serverGame->sceneManager.TrySwitchScene(mapName);
+}
+
+void Engine::StartLoadTest(const LoadTestSettings& settings)
+{
+    // The old test has to let go of its server before a new one is started
+    _loadTest = nullptr;
+    _loadTest = std::make_unique<LoadTest>(this, settings);
+}
+
 void Engine::ConnectToServer(const char* address, int port)
 {
     SLNet::SocketDescriptor sd;
@@ -18,8 +18,11 @@ class MetricsManager;
 class Renderer;
 class SceneManager;
 class SoundManager;
+class WorkerPool;
 struct ServerGame;
 struct ClientGame;
+class LoadTest;
+struct LoadTestSettings;
 
 void ExecuteOnGameThread(const std::function<void()>& function);
 
@@ -32,6 +35,12 @@ struct EngineConfig
     }
 
     int blockAllocatorSizeBytes = 32 * 1024 * 1024;
+
+    // Number of worker threads used for concurrent entity updates. -1 uses one less than the number of hardware threads
+    int workerThreadCount = -1;
+
+    // Connections beyond this are turned away with PacketType::ServerFull. At most ServerGame::MaxClientIds.
+    int maxServerClients = 8;
     std::optional<std::string> consoleVarsFile = "vars.cfg";
     std::string initialConsoleCmd;
 };
@@ -53,6 +62,7 @@ public:
     ServerGame* GetServerGame() { return _serverGame.get(); }
     ClientGame* GetClientGame() { return _clientGame.get(); }
     NeuralNetworkManager* GetNeuralNetworkManager() { return _neuralNetworkManager.get();  }
+    WorkerPool* GetWorkerPool() { return _workerPool.get(); }
 
     bool ActiveGame() { return _activeGame; }
     void QuitGame() { _activeGame = false; }
@@ -83,6 +93,13 @@ public:
     void StartLocalServer(int port, const char* mapName);
     void StartSinglePlayerGame(const char* mapName);
 
+    /// <summary>
+    /// Starts a server that doesn't open any sockets. Only in-process clients connected through NetworkInterface's
+    /// loopback can join it.
+    /// </summary>
+    void StartLoopbackServer(const char* mapName);
+    void StartLoadTest(const LoadTestSettings& settings);
+
 private:
     Engine() = default;
 
@@ -97,9 +114,11 @@ private:
     std::unique_ptr<BlockAllocator> _defaultBlockAllocator;
     std::unique_ptr<SoundManager> _soundManager;
     std::unique_ptr<NeuralNetworkManager> _neuralNetworkManager;
+    std::unique_ptr<WorkerPool> _workerPool;
 
     std::shared_ptr<ServerGame> _serverGame;
     std::shared_ptr<ClientGame> _clientGame;
+    std::unique_ptr<LoadTest> _loadTest;
 
     IGame* _game = nullptr;
     bool _activeGame = true;
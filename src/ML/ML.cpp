@@ -59,14 +59,11 @@ gsl::span<uint64_t> ReadGridSensorRectangles(
 
     Rectangle gridPixelBounds(topLeft, gridSizePixels);
 
-    const int maxRectangles = 8192;
-    static ColliderHandle colliderPool[maxRectangles];
-    static uint64_t outputStorage[maxRectangles];
-
-    auto overlappingColliders = scene->FindOverlappingColliders(gridPixelBounds, colliderPool);
+    auto overlappingColliders = scene->FindOverlappingColliders(gridPixelBounds);
+    auto outputStorage = scene->GetFrameArena().AllocateArray<uint64_t>(overlappingColliders.size());
 
     int outputSize = 0;
-    for(int i = 0; i < Min((int)overlappingColliders.size(), maxRectangles); ++i)
+    for(int i = 0; i < (int)overlappingColliders.size(); ++i)
     {
         auto& collider = overlappingColliders[i];
 
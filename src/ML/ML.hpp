@@ -168,6 +168,9 @@ private:
     std::unordered_map<std::string, std::shared_ptr<StrifeML::INetworkContext>> _networksByName;
 };
 
+/// <summary>
+/// The rectangles are allocated from the scene's frame arena, so they're only valid until the end of the frame.
+/// </summary>
 gsl::span<uint64_t> ReadGridSensorRectangles(
     Scene* scene,
     Vector2 center,
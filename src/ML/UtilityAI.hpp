@@ -39,13 +39,18 @@ struct UtilityAI
         considerations.push_back(consideration);
     }
 
-    void Evaluate(const TState& state, std::vector<float>& outUtility) const
+    void EvaluateConsiderations(const TState& state, UtilityConsiderationSet& outSet) const
     {
-        UtilityConsiderationSet set;
         for (auto& consideration : considerations)
         {
-            set[consideration.name] = consideration.evaluate(state);
+            outSet[consideration.name] = consideration.evaluate(state);
         }
+    }
+
+    void Evaluate(const TState& state, std::vector<float>& outUtility) const
+    {
+        UtilityConsiderationSet set;
+        EvaluateConsiderations(state, set);
 
         for (int i = 0; i < actions.size(); ++i)
         {
@@ -55,13 +60,20 @@ struct UtilityAI
 
     int PickBestAction(const TState& state) const
     {
-        std::vector<float> utility;
-        Evaluate(state, utility);
+        UtilityConsiderationSet set;
+        EvaluateConsiderations(state, set);
 
+        // Only the best action is needed, so the utilities aren't collected
         int maxIndex = 0;
-        for (int i = 1; i < utility.size(); ++i)
+        float maxUtility = 0;
+        for (int i = 0; i < actions.size(); ++i)
         {
-            if (utility[i] > utility[maxIndex]) maxIndex = i;
+            float utility = actions[i].evaluate(set);
+            if (i == 0 || utility > maxUtility)
+            {
+                maxIndex = i;
+                maxUtility = utility;
+            }
         }
 
         return maxIndex;
@@ -1,39 +1,121 @@
 #include "BlockAllocator.hpp"
 
-#include <set>
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <unordered_map>
 
-static int totalLargeRequested = 0;
+#include "Tools/Console.hpp"
 
-void* BlockAllocator::Allocate(int size)
+static constexpr int BlockSizeGranularity = 64;
+
+static constexpr std::array<int, BlockAllocator::MaxBlockSize / BlockSizeGranularity + 1> MakeBlockIdTable()
+{
+    std::array<int, BlockAllocator::MaxBlockSize / BlockSizeGranularity + 1> table { };
+
+    int blockId = 0;
+    int blockSize = BlockSizeGranularity;
+
+    for (int i = 0; i < (int)table.size(); ++i)
+    {
+        // Entry i holds sizes up to i * granularity
+        while (i * BlockSizeGranularity > blockSize)
+        {
+            ++blockId;
+            blockSize *= 2;
+        }
+
+        table[i] = blockId;
+    }
+
+    return table;
+}
+
+static constexpr auto g_blockIdBySize = MakeBlockIdTable();
+
+// Allocators are identified by id rather than address so that a thread never mistakes a new allocator for one that
+// was destroyed at the same address
+struct BlockAllocatorRegistry
+{
+    std::mutex mutex;
+    std::unordered_map<uint64_t, BlockAllocator*> allocatorsById;
+    uint64_t nextId = 0;
+};
+
+static BlockAllocatorRegistry& GetRegistry()
+{
+    static BlockAllocatorRegistry registry;
+    return registry;
+}
+
+struct ThreadCacheEntry
+{
+    uint64_t allocatorId;
+    void* cache;
+};
+
+BlockAllocator::BlockAllocator(int bufSize)
+    : _stackAllocator(bufSize)
+{
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    _id = registry.nextId++;
+    registry.allocatorsById[_id] = this;
+}
+
+BlockAllocator::~BlockAllocator()
+{
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    registry.allocatorsById.erase(_id);
+}
+
+void* BlockAllocator::Allocate(int size, bool zeroMemory)
 {
     int blockId = GetBlockId(size);
 
     if (blockId == TooBig)
     {
-        totalLargeRequested += size;
-
         auto data = new char[size];
         if (data == nullptr)
         {
-            FatalError("Failed to allocate large block of size %d bytes in BlockAllocator (total %d)", size, totalLargeRequested);
+            FatalError("Failed to allocate large block of size %d bytes in BlockAllocator (total %lld)", size, (long long)LargeLiveBytes());
+        }
+
+        int64_t liveBytes = _largeLiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        int64_t peakBytes = _largePeakBytes.load(std::memory_order_relaxed);
+        while (liveBytes > peakBytes && !_largePeakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed))
+        {
+        }
+
+        if (zeroMemory)
+        {
+            memset(data, 0, size);
         }
 
         return data;
     }
 
-    void* block;
-    if (_blocks[blockId].HasFreeItem())
+    auto cache = GetThreadCache();
+
+    if (!cache->blocks[blockId].HasFreeItem())
     {
-        block = _blocks[blockId].Borrow();
+        Refill(cache, blockId);
     }
-    else
+
+    void* block = cache->blocks[blockId].Borrow();
+    --cache->cachedBlocks[blockId];
+
+    cache->liveBlocks[blockId].store(cache->liveBlocks[blockId].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    cache->requestedBytes[blockId].store(cache->requestedBytes[blockId].load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+
+    if (zeroMemory)
     {
-        block = _stackAllocator.AllocateOrFatalError(_blockSizes[blockId]);
+        memset(block, 0, _blockSizes[blockId]);
     }
 
-    memset(block, 0, _blockSizes[blockId]);
-
     return block;
 }
 
@@ -44,11 +126,47 @@ void BlockAllocator::Free(void* data, int size)
     if (blockId == TooBig)
     {
         delete[](char*)(data);
-        totalLargeRequested -= size;
+        _largeLiveBytes.fetch_sub(size, std::memory_order_relaxed);
+        return;
+    }
+
+    auto cache = GetThreadCache();
+
+    cache->blocks[blockId].Return((Block*)data);
+    ++cache->cachedBlocks[blockId];
+
+    cache->liveBlocks[blockId].store(cache->liveBlocks[blockId].load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    cache->requestedBytes[blockId].store(cache->requestedBytes[blockId].load(std::memory_order_relaxed) - size, std::memory_order_relaxed);
+
+    if (cache->cachedBlocks[blockId] > MaxCachedBlocks(blockId))
+    {
+        Flush(cache, blockId, cache->cachedBlocks[blockId] / 2);
     }
-    else
+}
+
+void BlockAllocator::GetStats(std::vector<BlockSizeClassStats>& outStats) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (int i = 0; i < TotalBlockSizes; ++i)
     {
-        _blocks[blockId].Return((Block*)data);
+        int64_t liveBlocks = 0;
+        int64_t requestedBytes = 0;
+
+        for (auto& cache : _threadCaches)
+        {
+            liveBlocks += cache->liveBlocks[i].load(std::memory_order_relaxed);
+            requestedBytes += cache->requestedBytes[i].load(std::memory_order_relaxed);
+        }
+
+        BlockSizeClassStats stats;
+        stats.blockSize = _blockSizes[i];
+        stats.liveBytes = liveBlocks * _blockSizes[i];
+        stats.requestedBytes = requestedBytes;
+        stats.peakBytes = _peakOutstandingBlocks[i] * _blockSizes[i];
+        stats.reservedBytes = _reservedBlocks[i] * _blockSizes[i];
+
+        outStats.push_back(stats);
     }
 }
 
@@ -66,13 +184,176 @@ void BlockAllocator::SetDefaultAllocator(BlockAllocator* allocator)
 
 int BlockAllocator::GetBlockId(int size)
 {
+    if (size > MaxBlockSize)
+    {
+        return TooBig;
+    }
+
+    return g_blockIdBySize[(size + BlockSizeGranularity - 1) / BlockSizeGranularity];
+}
+
+struct ThreadCacheList
+{
+    ~ThreadCacheList();
+
+    std::vector<ThreadCacheEntry> entries;
+};
+
+static thread_local ThreadCacheList t_threadCaches;
+
+ThreadCacheList::~ThreadCacheList()
+{
+    for (auto& entry : entries)
+    {
+        BlockAllocator::ReleaseThreadCache(entry.allocatorId, entry.cache);
+    }
+}
+
+BlockAllocator::ThreadCache* BlockAllocator::GetThreadCache()
+{
+    for (auto& entry : t_threadCaches.entries)
+    {
+        if (entry.allocatorId == _id)
+        {
+            return static_cast<ThreadCache*>(entry.cache);
+        }
+    }
+
+    auto cache = ClaimThreadCache();
+    t_threadCaches.entries.push_back({ _id, cache });
+
+    return cache;
+}
+
+BlockAllocator::ThreadCache* BlockAllocator::ClaimThreadCache()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Caches of threads that have exited are reused, which also keeps their share of the stats
+    for (auto& cache : _threadCaches)
+    {
+        if (!cache->inUse)
+        {
+            cache->inUse = true;
+            return cache.get();
+        }
+    }
+
+    _threadCaches.push_back(std::make_unique<ThreadCache>());
+    _threadCaches.back()->inUse = true;
+
+    return _threadCaches.back().get();
+}
+
+void BlockAllocator::ReleaseThreadCache(uint64_t allocatorId, void* cacheHandle)
+{
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> registryLock(registry.mutex);
+
+    auto it = registry.allocatorsById.find(allocatorId);
+    if (it == registry.allocatorsById.end())
+    {
+        return;
+    }
+
+    auto allocator = it->second;
+    auto cache = static_cast<ThreadCache*>(cacheHandle);
+
     for (int i = 0; i < TotalBlockSizes; ++i)
     {
-        if (size < _blockSizes[i])
+        allocator->Flush(cache, i, cache->cachedBlocks[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(allocator->_mutex);
+    cache->inUse = false;
+}
+
+void BlockAllocator::Refill(ThreadCache* cache, int blockId)
+{
+    int count = std::max(MaxCachedBlocks(blockId) / 2, 1);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Block* block;
+        if (_blocks[blockId].HasFreeItem())
+        {
+            block = _blocks[blockId].Borrow();
+        }
+        else
         {
-            return i;
+            block = (Block*)_stackAllocator.AllocateOrFatalError(_blockSizes[blockId]);
+            ++_reservedBlocks[blockId];
         }
+
+        cache->blocks[blockId].Return(block);
+    }
+
+    cache->cachedBlocks[blockId] += count;
+    _outstandingBlocks[blockId] += count;
+    _peakOutstandingBlocks[blockId] = std::max(_peakOutstandingBlocks[blockId], _outstandingBlocks[blockId]);
+}
+
+void BlockAllocator::Flush(ThreadCache* cache, int blockId, int count)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (int i = 0; i < count; ++i)
+    {
+        _blocks[blockId].Return(cache->blocks[blockId].Borrow());
+    }
+
+    cache->cachedBlocks[blockId] -= count;
+    _outstandingBlocks[blockId] -= count;
+}
+
+static void AllocatorStatsCmd(ConsoleCommandBinder& binder)
+{
+    binder.Help("Shows memory usage per size class of the default block allocator");
+
+    auto allocator = BlockAllocator::GetDefaultAllocator();
+    if (allocator == nullptr)
+    {
+        binder.GetConsole()->Log("No default block allocator\n");
+        return;
+    }
+
+    std::vector<BlockSizeClassStats> stats;
+    allocator->GetStats(stats);
+
+    binder.GetConsole()->Log("%6s %12s %12s %12s %12s %8s %8s\n", "block", "live", "requested", "peak", "reserved", "waste%", "free%");
+
+    for (auto& sizeClass : stats)
+    {
+        // Internal fragmentation: rounding requests up to the block size. External: reserved blocks nobody is using.
+        float wastedPercent = sizeClass.liveBytes > 0
+            ? 100.0f * (sizeClass.liveBytes - sizeClass.requestedBytes) / sizeClass.liveBytes
+            : 0;
+        float freePercent = sizeClass.reservedBytes > 0
+            ? 100.0f * (sizeClass.reservedBytes - sizeClass.liveBytes) / sizeClass.reservedBytes
+            : 0;
+
+        binder.GetConsole()->Log(
+            "%6d %12lld %12lld %12lld %12lld %7.1f%% %7.1f%%\n",
+            sizeClass.blockSize,
+            (long long)sizeClass.liveBytes,
+            (long long)sizeClass.requestedBytes,
+            (long long)sizeClass.peakBytes,
+            (long long)sizeClass.reservedBytes,
+            wastedPercent,
+            freePercent);
     }
 
-    return TooBig;
+    binder.GetConsole()->Log(
+        "large: %lld live, %lld peak\n",
+        (long long)allocator->LargeLiveBytes(),
+        (long long)allocator->LargePeakBytes());
 }
+
+ConsoleCmd _allocatorStatsCmd("allocator-stats", AllocatorStatsCmd);
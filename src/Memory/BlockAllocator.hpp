@@ -1,19 +1,49 @@
 #pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "FreeList.hpp"
 #include "StackAllocator.hpp"
 
+/// <summary>
+/// Per size class memory usage, summed over every thread.
+/// </summary>
+struct BlockSizeClassStats
+{
+    int blockSize;
+    int64_t liveBytes;          // Blocks currently allocated, rounded up to the block size
+    int64_t requestedBytes;     // What was actually asked for by the live allocations
+    int64_t peakBytes;          // High water mark of blocks handed out to threads, including their caches
+    int64_t reservedBytes;      // Carved out of the backing buffer so far. Never shrinks.
+};
+
+/// <summary>
+/// Thread-safe allocator for small, fixed size blocks. Each thread keeps its own free list per size class, so the
+/// shared lock is only taken to move a batch of blocks between a thread and the central free lists. Allocations that
+/// are larger than the largest size class go to new[].
+/// </summary>
 class BlockAllocator
 {
 public:
-    BlockAllocator(int bufSize)
-        : _stackAllocator(bufSize)
-    {
-        
-    }
+    static constexpr int MaxBlockSize = 4096;
+
+    BlockAllocator(int bufSize);
+    ~BlockAllocator();
 
-    void* Allocate(int size);
+    /// <summary>
+    /// Blocks are zeroed by default. Callers that construct every field themselves can skip it.
+    /// </summary>
+    void* Allocate(int size, bool zeroMemory = true);
     void Free(void* data, int size);
 
+    void GetStats(std::vector<BlockSizeClassStats>& outStats) const;
+    int64_t LargeLiveBytes() const { return _largeLiveBytes.load(std::memory_order_relaxed); }
+    int64_t LargePeakBytes() const { return _largePeakBytes.load(std::memory_order_relaxed); }
+
     static BlockAllocator* GetDefaultAllocator();
     static void SetDefaultAllocator(BlockAllocator* allocator);
 
@@ -31,16 +61,50 @@ private:
 
     static constexpr int TotalBlockSizes = sizeof(_blockSizes) / sizeof(int);
 
+    // Each thread caches up to this many bytes per size class before giving half of them back
+    static constexpr int ThreadCacheBytesPerSizeClass = 32 * 1024;
+
     struct Block
     {
         void* next;
     };
 
+    struct ThreadCache
+    {
+        FreeList<Block> blocks[TotalBlockSizes];
+        int cachedBlocks[TotalBlockSizes] = { };
+        bool inUse = false;
+
+        // Only written by the owning thread. Frees can happen on a different thread than the allocation, so these
+        // can go negative; only the sum over all caches is meaningful.
+        std::atomic<int64_t> liveBlocks[TotalBlockSizes] = { };
+        std::atomic<int64_t> requestedBytes[TotalBlockSizes] = { };
+    };
+
     static constexpr int TooBig = -1;
     static int GetBlockId(int size);
+    static int MaxCachedBlocks(int blockId) { return ThreadCacheBytesPerSizeClass / _blockSizes[blockId]; }
 
+    ThreadCache* GetThreadCache();
+    ThreadCache* ClaimThreadCache();
+    static void ReleaseThreadCache(uint64_t allocatorId, void* cache);
+    friend struct ThreadCacheList;
+
+    void Refill(ThreadCache* cache, int blockId);
+    void Flush(ThreadCache* cache, int blockId, int count);
+
+    uint64_t _id;
+
+    mutable std::mutex _mutex;
     FreeList<Block> _blocks[TotalBlockSizes];
+    int64_t _outstandingBlocks[TotalBlockSizes] = { };
+    int64_t _peakOutstandingBlocks[TotalBlockSizes] = { };
+    int64_t _reservedBlocks[TotalBlockSizes] = { };
     StackAllocator _stackAllocator;
+    std::vector<std::unique_ptr<ThreadCache>> _threadCaches;
+
+    std::atomic<int64_t> _largeLiveBytes { 0 };
+    std::atomic<int64_t> _largePeakBytes { 0 };
 
     static BlockAllocator* _defaultAllocator;
 };
@@ -0,0 +1,121 @@
+#include "FrameArena.hpp"
+#include "System/Logger.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Easy to spot in a debugger when something reads frame memory after the reset
+static constexpr unsigned char FreedMemoryPattern = 0xDD;
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+FrameArena::FrameArena(int capacity)
+{
+    AllocateBuffer(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+    for (auto allocation : _overflowAllocations)
+    {
+        free(allocation);
+    }
+
+    free(_rawBuffer);
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    if (alignment > MaxAlignment)
+    {
+        FatalError("FrameArena can't align to more than %d bytes (requested %d)", MaxAlignment, (int)alignment);
+    }
+
+    size_t offset = _used.load(std::memory_order_relaxed);
+    size_t alignedOffset;
+
+    do
+    {
+        alignedOffset = AlignUp(offset, alignment);
+
+        if (alignedOffset + size > _capacity)
+        {
+            return AllocateOverflow(size, alignment);
+        }
+    } while (!_used.compare_exchange_weak(offset, alignedOffset + size, std::memory_order_relaxed));
+
+    return _buffer + alignedOffset;
+}
+
+void FrameArena::Reset()
+{
+    size_t used = BytesUsed();
+    bool overflowed = !_overflowAllocations.empty();
+
+#ifndef NDEBUG
+    memset(_buffer, FreedMemoryPattern, _used.load(std::memory_order_relaxed));
+#endif
+
+    for (auto allocation : _overflowAllocations)
+    {
+        free(allocation);
+    }
+
+    _overflowAllocations.clear();
+    _overflowBytes = 0;
+    _used.store(0, std::memory_order_relaxed);
+
+    _lastFrameBytes = used;
+    _highWaterMark = std::max(_highWaterMark, used);
+    ++_generation;
+
+    if (overflowed)
+    {
+        // Grow with some headroom so that a frame that's a little busier doesn't overflow again
+        ++_totalOverflowFrames;
+        free(_rawBuffer);
+        AllocateBuffer(AlignUp(used + used / 2, MaxAlignment));
+    }
+}
+
+size_t FrameArena::BytesUsed() const
+{
+    return _used.load(std::memory_order_relaxed) + _overflowBytes;
+}
+
+void* FrameArena::AllocateOverflow(size_t size, size_t alignment)
+{
+    auto raw = (unsigned char*)malloc(size + alignment);
+    if (raw == nullptr)
+    {
+        FatalError("Failed to allocate %d bytes of frame memory", (int)size);
+    }
+
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    _overflowAllocations.push_back(raw);
+    _overflowBytes += size;
+
+    return raw + AlignUp((uintptr_t)raw, alignment) - (uintptr_t)raw;
+}
+
+void FrameArena::AllocateBuffer(size_t capacity)
+{
+    _rawBuffer = (unsigned char*)malloc(capacity + MaxAlignment);
+    if (_rawBuffer == nullptr)
+    {
+        FatalError("Failed to allocate %d bytes for frame arena", (int)capacity);
+    }
+
+    _buffer = _rawBuffer + AlignUp((uintptr_t)_rawBuffer, MaxAlignment) - (uintptr_t)_rawBuffer;
+    _capacity = capacity;
+}
+
+void ReportFrameArenaUseAfterReset()
+{
+    FatalError("Frame memory was used after the frame arena was reset");
+}
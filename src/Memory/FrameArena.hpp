@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Linear allocator for memory that only has to live until the end of the frame. Allocating is a pointer bump that is
+/// safe to do from several threads at once, and freeing is a no-op: everything is released by Reset(). If a frame needs
+/// more than the arena holds, the extra allocations fall back to the heap and the arena grows on the next reset, so
+/// once the frame size has settled no heap allocations are made.
+///
+/// Debug builds poison everything on reset and catch containers that are still used after the frame they were
+/// created in (see FrameArenaAllocator).
+/// </summary>
+class FrameArena
+{
+public:
+    static constexpr int DefaultCapacity = 256 * 1024;
+    static constexpr int MaxAlignment = 64;
+
+    FrameArena(int capacity = DefaultCapacity);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    /// <summary>
+    /// The elements aren't constructed, so this is meant for trivial types.
+    /// </summary>
+    template<typename T>
+    T* AllocateArray(int count)
+    {
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /// <summary>
+    /// Releases everything allocated since the last reset. Must not be called while anything is still allocating.
+    /// </summary>
+    void Reset();
+
+    /// <summary>
+    /// Incremented on every reset. Allocations made under an older generation are no longer valid.
+    /// </summary>
+    unsigned int Generation() const { return _generation; }
+
+    size_t BytesUsed() const;
+    size_t LastFrameBytes() const { return _lastFrameBytes; }
+    size_t HighWaterMark() const { return _highWaterMark; }
+    size_t Capacity() const { return _capacity; }
+    int TotalOverflowFrames() const { return _totalOverflowFrames; }
+
+private:
+    void* AllocateOverflow(size_t size, size_t alignment);
+    void AllocateBuffer(size_t capacity);
+
+    unsigned char* _rawBuffer = nullptr;
+    unsigned char* _buffer = nullptr;
+    size_t _capacity = 0;
+    std::atomic<size_t> _used { 0 };
+
+    std::mutex _overflowMutex;
+    std::vector<void*> _overflowAllocations;
+    size_t _overflowBytes = 0;
+
+    unsigned int _generation = 0;
+    size_t _lastFrameBytes = 0;
+    size_t _highWaterMark = 0;
+    int _totalOverflowFrames = 0;
+};
+
+void ReportFrameArenaUseAfterReset();
+
+/// <summary>
+/// Lets standard containers allocate from a FrameArena, e.g. FrameVector&lt;int&gt; values(scene->GetFrameArena()).
+/// Deallocating does nothing, so a container must not outlive the frame it was created in.
+/// </summary>
+template<typename T>
+class FrameArenaAllocator
+{
+public:
+    using value_type = T;
+
+    FrameArenaAllocator(FrameArena& arena)
+        : _arena(&arena),
+          _generation(arena.Generation())
+    {
+
+    }
+
+    template<typename U>
+    FrameArenaAllocator(const FrameArenaAllocator<U>& other)
+        : _arena(other._arena),
+          _generation(other._generation)
+    {
+
+    }
+
+    T* allocate(size_t count)
+    {
+        CheckGeneration();
+        return static_cast<T*>(_arena->Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void deallocate(T* data, size_t count)
+    {
+        CheckGeneration();
+    }
+
+    template<typename U>
+    bool operator==(const FrameArenaAllocator<U>& rhs) const { return _arena == rhs._arena; }
+
+    template<typename U>
+    bool operator!=(const FrameArenaAllocator<U>& rhs) const { return _arena != rhs._arena; }
+
+private:
+    template<typename U>
+    friend class FrameArenaAllocator;
+
+    void CheckGeneration() const
+    {
+#ifndef NDEBUG
+        if (_arena->Generation() != _generation)
+        {
+            ReportFrameArenaUseAfterReset();
+        }
+#endif
+    }
+
+    FrameArena* _arena;
+    unsigned int _generation;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
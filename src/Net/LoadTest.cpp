@@ -0,0 +1,349 @@
+#include "LoadTest.hpp"
+
+#include <algorithm>
+
+#include "Engine.hpp"
+#include "Net/ReplicationManager.hpp"
+#include "Scene/Scene.hpp"
+#include "Tools/Console.hpp"
+
+SyntheticClient::SyntheticClient(SLNet::RakPeerInterface* raknetInterface, BlockAllocator* blockAllocator, SLNet::AddressOrGUID address_)
+    : address(address_),
+      networkInterface(raknetInterface),
+      commandHandler(blockAllocator)
+{
+    networkInterface.isLoopbackOnly = true;
+}
+
+void SyntheticClient::AddCommand(PlayerCommand& command, int fixedUpdateCount)
+{
+    commandHandler.fixedUpdateCount = fixedUpdateCount;
+    commandHandler.AddCommand(command);
+
+    unacknowledgedCommands.push_back({ command.id, Clock::now() });
+}
+
+static float Percentile(const std::vector<float>& sortedValues, float percentile)
+{
+    if (sortedValues.empty())
+    {
+        return 0;
+    }
+
+    int index = std::min((int)(percentile / 100 * sortedValues.size()), (int)sortedValues.size() - 1);
+    return sortedValues[index];
+}
+
+static float MillisecondsSince(SyntheticClient::Clock::time_point time)
+{
+    return std::chrono::duration<float, std::milli>(SyntheticClient::Clock::now() - time).count();
+}
+
+LoadTest::LoadTest(Engine* engine, const LoadTestSettings& settings)
+    : _engine(engine),
+      _settings(settings)
+{
+    engine->StartLoopbackServer(settings.mapName.c_str());
+    _server = engine->GetServerGame();
+
+    if (_settings.commandScript == nullptr)
+    {
+        int commandIntervalTicks = std::max(_settings.commandIntervalTicks, 1);
+
+        _settings.commandScript = [=](SyntheticClient& client, int tick)
+        {
+            if (tick % commandIntervalTicks == 0)
+            {
+                DoNothingCommand command;
+                client.AddCommand(command, commandIntervalTicks);
+            }
+        };
+    }
+
+    auto raknetInterface = _server->networkInterface.raknetInterface;
+    auto serverAddress = _server->localAddress;
+
+    _server->networkInterface.loopbackPacketLoss = _settings.packetLoss;
+
+    for (int i = 0; i < settings.totalClients; ++i)
+    {
+        // Made up addresses, like the ones of the local client and server
+        SLNet::AddressOrGUID address(SLNet::SystemAddress("0.0.1.0", 1 + i));
+        auto client = std::make_unique<SyntheticClient>(raknetInterface, engine->GetDefaultBlockAllocator(), address);
+
+        _server->networkInterface.AddLoopbackPeer(address, { &client->networkInterface, address.systemAddress });
+        client->networkInterface.AddLoopbackPeer(serverAddress, { &_server->networkInterface, serverAddress.systemAddress });
+
+        unsigned char data[1] = { (unsigned char)PacketType::NewConnection };
+        client->networkInterface.SendReliable(serverAddress, data);
+
+        _clients.push_back(std::move(client));
+    }
+
+    _startTime = SyntheticClient::Clock::now();
+
+    Log("Load test: %d synthetic clients on %s for %.1f seconds\n",
+        settings.totalClients,
+        settings.mapName.c_str(),
+        settings.durationSeconds);
+}
+
+LoadTest::~LoadTest()
+{
+    DisconnectClients();
+}
+
+void LoadTest::Update(float serverFrameSeconds)
+{
+    if (_isFinished)
+    {
+        return;
+    }
+
+    if (_engine->GetServerGame() != _server)
+    {
+        Log("Load test stopped: the server was replaced\n");
+        DisconnectClients();
+        _isFinished = true;
+        return;
+    }
+
+    // The first frames load the map and accept the connections
+    if (_tick > 0)
+    {
+        _tickTimesMs.push_back(serverFrameSeconds * 1000);
+    }
+
+    bool sendUpdateRequests = _tick % std::max(_settings.updateRequestIntervalTicks, 1) == 0;
+
+    for (auto& client : _clients)
+    {
+        ReceivePackets(*client);
+
+        if (!client->IsConnected())
+        {
+            continue;
+        }
+
+        _settings.commandScript(*client, _tick);
+
+        if (sendUpdateRequests)
+        {
+            SLNet::BitStream message;
+            ReplicationManager::WriteUpdateRequest(
+                client->commandHandler,
+                client->lastReceivedSnapshotId,
+                client->lastServerReceivedCommandId,
+                message);
+
+            client->bytesSent += message.GetNumberOfBytesUsed();
+            client->networkInterface.SendReliable(_server->localAddress, message);
+        }
+    }
+
+    ++_tick;
+
+    if (MillisecondsSince(_startTime) >= _settings.durationSeconds * 1000)
+    {
+        ReportResults();
+        DisconnectClients();
+        _isFinished = true;
+
+        if (_settings.quitWhenDone)
+        {
+            _engine->QuitGame();
+        }
+    }
+}
+
+const LoadTestResults& LoadTest::Run()
+{
+    while (!_isFinished)
+    {
+        auto frameStart = SyntheticClient::Clock::now();
+        _engine->RunFrame();
+        Update(std::chrono::duration<float>(SyntheticClient::Clock::now() - frameStart).count());
+    }
+
+    return _results;
+}
+
+void LoadTest::ReceivePackets(SyntheticClient& client)
+{
+    SLNet::Packet* packet;
+    while (client.networkInterface.TryGetPacket(packet))
+    {
+        client.bytesReceived += packet->length;
+
+        SLNet::BitStream stream(packet->data, packet->length, false);
+        stream.IgnoreBytes(1);
+
+        switch ((PacketType)packet->data[0])
+        {
+        case PacketType::NewConnectionResponse:
+            stream.Read(client.clientId);
+            break;
+
+        case PacketType::ServerFull:
+            client.wasRejected = true;
+            break;
+
+        case PacketType::UpdateResponse:
+        {
+            UpdateResponseAck ack;
+            if (!ReplicationManager::ReadUpdateResponseAck(stream, ack))
+            {
+                break;
+            }
+
+            if (ack.snapshotFrom == 0) ++client.fullUpdatesReceived;
+            else ++client.deltaUpdatesReceived;
+
+            // Same as a real client, which drops updates that arrive out of order
+            if (ack.snapshotTo > client.lastReceivedSnapshotId)
+            {
+                client.lastReceivedSnapshotId = ack.snapshotTo;
+            }
+
+            client.lastServerReceivedCommandId = std::max(client.lastServerReceivedCommandId, ack.lastServerReceivedCommandId);
+
+            auto& unacknowledged = client.unacknowledgedCommands;
+            while (!unacknowledged.empty() && unacknowledged.front().commandId <= client.lastServerReceivedCommandId)
+            {
+                _commandAckLatenciesMs.push_back(MillisecondsSince(unacknowledged.front().sentTime));
+                unacknowledged.pop_front();
+            }
+
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
+
+void LoadTest::ReportResults()
+{
+    float elapsedSeconds = MillisecondsSince(_startTime) / 1000;
+
+    int64_t totalBytesSent = 0;
+    int64_t totalBytesReceived = 0;
+    int64_t maxBytesReceived = 0;
+
+    auto replicationManager = _server->GetScene() != nullptr ? _server->GetScene()->replicationManager : nullptr;
+    uint32 currentSnapshotId = replicationManager != nullptr ? replicationManager->GetCurrentSnapshotId() : 0;
+
+    _results = LoadTestResults();
+    _results.ticks = _tick;
+
+    for (auto& client : _clients)
+    {
+        if (client->wasRejected) ++_results.rejectedClients;
+        if (!client->IsConnected()) continue;
+
+        ++_results.connectedClients;
+        totalBytesSent += client->bytesSent;
+        totalBytesReceived += client->bytesReceived;
+        maxBytesReceived = std::max(maxBytesReceived, client->bytesReceived);
+        _results.unacknowledgedCommands += client->unacknowledgedCommands.size();
+        _results.fullUpdatesReceived += client->fullUpdatesReceived;
+        _results.deltaUpdatesReceived += client->deltaUpdatesReceived;
+
+        if (currentSnapshotId > client->lastReceivedSnapshotId)
+        {
+            _results.maxSnapshotsBehind = std::max(_results.maxSnapshotsBehind, currentSnapshotId - client->lastReceivedSnapshotId);
+        }
+    }
+
+    std::sort(_tickTimesMs.begin(), _tickTimesMs.end());
+    std::sort(_commandAckLatenciesMs.begin(), _commandAckLatenciesMs.end());
+
+    float perClientSeconds = std::max(_results.connectedClients, 1) * elapsedSeconds;
+
+    _results.tickTimeP99Ms = Percentile(_tickTimesMs, 99);
+    _results.downBytesPerSecondPerClient = totalBytesReceived / perClientSeconds;
+    _results.upBytesPerSecondPerClient = totalBytesSent / perClientSeconds;
+    _results.acknowledgedCommands = (int)_commandAckLatenciesMs.size();
+    _results.commandAckLatencyP99Ms = Percentile(_commandAckLatenciesMs, 99);
+
+    Log("Load test results: %d ticks in %.1f seconds\n", _tick, elapsedSeconds);
+    Log("  clients: %d connected, %d rejected, %d total\n", _results.connectedClients, _results.rejectedClients, (int)_clients.size());
+    Log("  tick time (ms): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+        Percentile(_tickTimesMs, 50),
+        Percentile(_tickTimesMs, 90),
+        _results.tickTimeP99Ms,
+        _tickTimesMs.empty() ? 0.0f : _tickTimesMs.back());
+    Log("  bytes/s per client: %.0f down (max %.0f), %.0f up\n",
+        _results.downBytesPerSecondPerClient,
+        maxBytesReceived / std::max(elapsedSeconds, 1e-3f),
+        _results.upBytesPerSecondPerClient);
+    Log("  world updates: %d full, %d delta, %.0f%% packet loss, furthest client %u snapshots behind\n",
+        _results.fullUpdatesReceived,
+        _results.deltaUpdatesReceived,
+        _settings.packetLoss * 100,
+        _results.maxSnapshotsBehind);
+    Log("  command ack latency (ms): p50 %.1f, p90 %.1f, p99 %.1f, max %.1f (%d acknowledged, %lld pending)\n",
+        Percentile(_commandAckLatenciesMs, 50),
+        Percentile(_commandAckLatenciesMs, 90),
+        _results.commandAckLatencyP99Ms,
+        _commandAckLatenciesMs.empty() ? 0.0f : _commandAckLatenciesMs.back(),
+        _results.acknowledgedCommands,
+        (long long)_results.unacknowledgedCommands);
+}
+
+void LoadTest::DisconnectClients()
+{
+    // If the server was replaced, its loopback peers went away with it
+    bool serverIsRunning = _engine->GetServerGame() == _server;
+
+    if (serverIsRunning)
+    {
+        _server->networkInterface.loopbackPacketLoss = 0;
+    }
+
+    for (auto& client : _clients)
+    {
+        if (serverIsRunning)
+        {
+            if (client->IsConnected())
+            {
+                unsigned char data[1] = { (unsigned char)PacketType::Disconnected };
+                client->networkInterface.SendReliable(_server->localAddress, data);
+            }
+
+            _server->networkInterface.RemoveLoopbackPeer(client->address);
+        }
+
+        // Release whatever the server sent that was never read
+        SLNet::Packet* packet;
+        while (client->networkInterface.TryGetPacket(packet))
+        {
+        }
+    }
+
+    _clients.clear();
+}
+
+static void LoadTestCommand(ConsoleCommandBinder& binder)
+{
+    LoadTestSettings settings;
+
+    binder.Bind(settings.mapName, "map-name");
+    binder.TryBind(settings.totalClients, "clients");
+    binder.TryBind(settings.durationSeconds, "seconds");
+    binder.TryBind(settings.packetLoss, "packet-loss");
+    binder.TryBind(settings.quitWhenDone, "quit-when-done");
+    binder.Help("Runs a server without sockets against synthetic clients and logs tick times, bandwidth and command "
+                "latency. Run with the server variable set for a headless test.");
+
+    auto engine = binder.GetEngine();
+
+    // Deferred so that the game and its resources are set up when this is passed as the initial command
+    ExecuteOnGameThread([=]
+    {
+        engine->StartLoadTest(settings);
+    });
+}
+
+ConsoleCmd loadTestCmd("load-test", LoadTestCommand);
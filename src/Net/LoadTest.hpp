@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Components/NetComponent.hpp"
+#include "Net/ServerGame.hpp"
+
+class Engine;
+
+/// <summary>
+/// A client that only speaks the network protocol: it connects, sends update requests with scripted commands and
+/// acknowledges the world updates it receives, but doesn't have a scene. Many of them can run in one process.
+/// </summary>
+struct SyntheticClient
+{
+    using Clock = std::chrono::steady_clock;
+
+    SyntheticClient(SLNet::RakPeerInterface* raknetInterface, BlockAllocator* blockAllocator, SLNet::AddressOrGUID address_);
+
+    bool IsConnected() const { return clientId != -1; }
+
+    /// <summary>
+    /// Queues a command to be sent with the next update requests until the server acknowledges it. Commands other
+    /// than DoNothingCommand need to be registered with commandHandler first, using the same id as the game.
+    /// </summary>
+    void AddCommand(PlayerCommand& command, int fixedUpdateCount);
+
+    SLNet::AddressOrGUID address;
+    NetworkInterface networkInterface;
+    PlayerCommandHandler commandHandler;
+
+    int clientId = -1;
+    bool wasRejected = false;
+    uint32 lastReceivedSnapshotId = 0;
+    unsigned int lastServerReceivedCommandId = 0;
+
+    int64_t bytesSent = 0;
+    int64_t bytesReceived = 0;
+    int fullUpdatesReceived = 0;
+    int deltaUpdatesReceived = 0;
+
+    struct SentCommand
+    {
+        unsigned int commandId;
+        Clock::time_point sentTime;
+    };
+
+    std::deque<SentCommand> unacknowledgedCommands;
+};
+
+struct LoadTestSettings
+{
+    std::string mapName;
+    int totalClients = 32;
+    float durationSeconds = 30;
+
+    // Client updates go out at half the server tick rate, like real clients at 30Hz against a 60Hz server
+    int updateRequestIntervalTicks = 2;
+    int commandIntervalTicks = 4;
+
+    // Fraction of the server's unreliable packets that are dropped on the way to the clients
+    float packetLoss = 0;
+
+    bool quitWhenDone = false;
+
+    // Called for each connected client every server tick. By default a DoNothingCommand is sent every
+    // commandIntervalTicks ticks.
+    std::function<void(SyntheticClient& client, int tick)> commandScript;
+};
+
+struct LoadTestResults
+{
+    int ticks = 0;
+    int connectedClients = 0;
+    int rejectedClients = 0;
+
+    float tickTimeP99Ms = 0;
+    float downBytesPerSecondPerClient = 0;
+    float upBytesPerSecondPerClient = 0;
+
+    int acknowledgedCommands = 0;
+    int64_t unacknowledgedCommands = 0;
+    float commandAckLatencyP99Ms = 0;
+
+    int fullUpdatesReceived = 0;
+    int deltaUpdatesReceived = 0;
+    uint32 maxSnapshotsBehind = 0;      // How far the client furthest behind was from the server's snapshot at the end
+};
+
+/// <summary>
+/// Runs a server without sockets against synthetic clients connected over NetworkInterface's loopback, and reports
+/// server tick times, bandwidth per client and how long it takes the server to acknowledge a command.
+/// </summary>
+class LoadTest
+{
+public:
+    LoadTest(Engine* engine, const LoadTestSettings& settings);
+    ~LoadTest();
+
+    /// <summary>
+    /// Called after each server frame with the time the frame took.
+    /// </summary>
+    void Update(float serverFrameSeconds);
+
+    /// <summary>
+    /// Runs server frames until the test is finished, for headless programs that drive the engine themselves instead
+    /// of running the game loop.
+    /// </summary>
+    const LoadTestResults& Run();
+
+    bool IsFinished() const { return _isFinished; }
+
+    /// <summary>
+    /// Filled in when the test finishes. Stays empty if it was stopped because the server was replaced.
+    /// </summary>
+    const LoadTestResults& Results() const { return _results; }
+
+private:
+    void ReceivePackets(SyntheticClient& client);
+    void ReportResults();
+    void DisconnectClients();
+
+    Engine* _engine;
+    ServerGame* _server;
+    LoadTestSettings _settings;
+
+    std::vector<std::unique_ptr<SyntheticClient>> _clients;
+
+    int _tick = 0;
+    SyntheticClient::Clock::time_point _startTime;
+    bool _isFinished = false;
+
+    std::vector<float> _tickTimesMs;
+    std::vector<float> _commandAckLatenciesMs;
+    LoadTestResults _results;
+};
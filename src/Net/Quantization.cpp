@@ -0,0 +1,228 @@
+#include "Quantization.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "System/Logger.hpp"
+
+static constexpr double TwoPi = 6.283185307179586;
+
+static uint32_t MaxCode(int bits)
+{
+    return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+}
+
+Quantization Quantization::FixedPoint(float min, float max, int bits)
+{
+    if (bits < 1 || bits > 32 || !(min < max))
+    {
+        FatalError("Invalid fixed point quantization: [%f, %f] in %d bits", min, max, bits);
+    }
+
+    Quantization quantization;
+    quantization.mode = QuantizationMode::FixedPoint;
+    quantization.min = min;
+    quantization.max = max;
+    quantization.bits = bits;
+
+    return quantization;
+}
+
+Quantization Quantization::Angle(int bits)
+{
+    if (bits < 1 || bits > 31)
+    {
+        FatalError("Invalid angle quantization: %d bits", bits);
+    }
+
+    Quantization quantization;
+    quantization.mode = QuantizationMode::Angle;
+    quantization.bits = bits;
+
+    return quantization;
+}
+
+Quantization Quantization::HalfFloat()
+{
+    Quantization quantization;
+    quantization.mode = QuantizationMode::HalfFloat;
+    quantization.bits = 16;
+
+    return quantization;
+}
+
+bool Quantization::IsInRange(float value) const
+{
+    switch (mode)
+    {
+    case QuantizationMode::FixedPoint: return value >= min && value <= max;
+    case QuantizationMode::Angle: return std::isfinite(value);
+    case QuantizationMode::HalfFloat: return !std::isfinite(value) || std::abs(value) <= 65504;
+    default: return true;
+    }
+}
+
+uint32_t Quantization::Encode(float value) const
+{
+    switch (mode)
+    {
+    case QuantizationMode::FixedPoint:
+    {
+        double t = ((double)value - min) / ((double)max - min);
+        if (!(t > 0)) return 0;     // Also catches NaN
+        if (t >= 1) return MaxCode(bits);
+
+        return (uint32_t)std::llround(t * MaxCode(bits));
+    }
+
+    case QuantizationMode::Angle:
+    {
+        if (!std::isfinite(value)) return 0;
+
+        double turns = value / TwoPi;
+        turns -= std::floor(turns);
+
+        return (uint32_t)std::llround(turns * (1u << bits)) & MaxCode(bits);
+    }
+
+    case QuantizationMode::HalfFloat:
+        return FloatToHalf(value);
+
+    default:
+    {
+        uint32_t raw;
+        memcpy(&raw, &value, sizeof(raw));
+        return raw;
+    }
+    }
+}
+
+float Quantization::Decode(uint32_t encoded) const
+{
+    switch (mode)
+    {
+    case QuantizationMode::FixedPoint:
+        return (float)(min + ((double)max - min) * encoded / MaxCode(bits));
+
+    case QuantizationMode::Angle:
+        return (float)(TwoPi * encoded / (1u << bits));
+
+    case QuantizationMode::HalfFloat:
+        return HalfToFloat((uint16_t)encoded);
+
+    default:
+    {
+        float value;
+        memcpy(&value, &encoded, sizeof(value));
+        return value;
+    }
+    }
+}
+
+float Quantization::MaxError() const
+{
+    switch (mode)
+    {
+    case QuantizationMode::FixedPoint: return (float)(((double)max - min) / MaxCode(bits) / 2);
+    case QuantizationMode::Angle: return (float)(TwoPi / (1u << bits) / 2);
+    case QuantizationMode::HalfFloat: return 1.0f / 2048;     // Half of the 10 bit mantissa's last place
+    default: return 0;
+    }
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF);
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF)
+    {
+        // Infinity stays infinity, NaN stays NaN
+        return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    }
+
+    int halfExponent = exponent - 127 + 15;
+
+    if (halfExponent >= 0x1F)
+    {
+        return sign | 0x7C00;
+    }
+
+    if (halfExponent <= 0)
+    {
+        if (halfExponent < -10)
+        {
+            return sign;
+        }
+
+        // Subnormal: shift the mantissa, including its implicit leading one, into place
+        mantissa |= 0x800000;
+        int shift = 14 - halfExponent;
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1) != 0))
+        {
+            ++halfMantissa;
+        }
+
+        return sign | halfMantissa;
+    }
+
+    uint32_t half = sign | ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+
+    // Round to nearest even. Carrying into the exponent is correct, including rounding up to infinity.
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0))
+    {
+        ++half;
+    }
+
+    return half;
+}
+
+float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    int exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+
+    if (exponent == 0x1F)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // Subnormal half, which is a normal float
+            exponent = 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+
+            mantissa &= 0x3FF;
+            bits = sign | ((uint32_t)(exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+    }
+    else
+    {
+        bits = sign | ((uint32_t)(exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
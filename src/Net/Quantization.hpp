@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Math/Vector2.hpp"
+
+enum class QuantizationMode
+{
+    None,
+    FixedPoint,
+    Angle,
+    HalfFloat
+};
+
+/// <summary>
+/// Describes how a float, or each component of a Vector2, is packed into fewer bits when it's sent over the network.
+/// </summary>
+struct Quantization
+{
+    /// <summary>
+    /// Evenly spaced values between min and max, inclusive. Values outside the range are clamped.
+    /// </summary>
+    static Quantization FixedPoint(float min, float max, int bits);
+
+    /// <summary>
+    /// Angles in radians. They're wrapped, so the received value is always in [0, 2pi).
+    /// </summary>
+    static Quantization Angle(int bits);
+
+    /// <summary>
+    /// IEEE 754 half precision: 16 bits with about three significant digits, for values like velocities that don't
+    /// have useful bounds.
+    /// </summary>
+    static Quantization HalfFloat();
+
+    bool IsEnabled() const { return mode != QuantizationMode::None; }
+
+    /// <summary>
+    /// False if Encode() can't represent the value: it's outside of a fixed point range and gets clamped, it's too
+    /// large for a half float and becomes infinity, or it's NaN where that isn't kept.
+    /// </summary>
+    bool IsInRange(float value) const;
+
+    uint32_t Encode(float value) const;
+    float Decode(uint32_t encoded) const;
+
+    /// <summary>
+    /// The largest difference between a value and its decoded value. For half floats this is relative to the value.
+    /// </summary>
+    float MaxError() const;
+
+    bool EncodesToSameValue(float lhs, float rhs) const { return Encode(lhs) == Encode(rhs); }
+    bool EncodesToSameValue(Vector2 lhs, Vector2 rhs) const
+    {
+        return EncodesToSameValue(lhs.x, rhs.x) && EncodesToSameValue(lhs.y, rhs.y);
+    }
+
+    QuantizationMode mode = QuantizationMode::None;
+    float min = 0;
+    float max = 0;
+    int bits = 32;      // Per component
+};
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
@@ -0,0 +1,130 @@
+#include "RelevancyFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialRelevancyFilter::SpatialRelevancyFilter(float relevancyRadius, int maxEntitiesPerClient)
+    : _relevancyRadius(relevancyRadius),
+      _cellSize(relevancyRadius > 0 ? relevancyRadius : 1),
+      _maxEntitiesPerClient(maxEntitiesPerClient)
+{
+
+}
+
+int64_t SpatialRelevancyFilter::GetCellKey(int cellX, int cellY) const
+{
+    return ((int64_t)cellY << 32) | (uint32_t)cellX;
+}
+
+void SpatialRelevancyFilter::Update(gsl::span<const RelevancyCandidate> candidates)
+{
+    _candidates.assign(candidates.begin(), candidates.end());
+    _candidatesByCell.clear();
+    _alwaysRelevant.clear();
+    _owned.clear();
+
+    for (int i = 0; i < (int)_candidates.size(); ++i)
+    {
+        auto& candidate = _candidates[i];
+
+        if (candidate.alwaysRelevant)
+        {
+            _alwaysRelevant.push_back(i);
+            continue;
+        }
+
+        if (candidate.ownerClientId >= 0)
+        {
+            _owned.push_back(i);
+        }
+
+        int cellX = (int)floor(candidate.position.x / _cellSize);
+        int cellY = (int)floor(candidate.position.y / _cellSize);
+        _candidatesByCell.emplace_back(GetCellKey(cellX, cellY), i);
+    }
+
+    std::sort(_candidatesByCell.begin(), _candidatesByCell.end());
+}
+
+void SpatialRelevancyFilter::GetRelevantEntities(int clientId, const std::optional<Vector2>& viewpoint, std::vector<int>& outNetIds)
+{
+    for (auto index : _alwaysRelevant)
+    {
+        outNetIds.push_back(_candidates[index].netId);
+    }
+
+    // Never despawn a client's own entities
+    for (auto index : _owned)
+    {
+        if (_candidates[index].ownerClientId == clientId)
+        {
+            outNetIds.push_back(_candidates[index].netId);
+        }
+    }
+
+    _scoredCandidates.clear();
+
+    if (!viewpoint.has_value())
+    {
+        for (auto& cellEntry : _candidatesByCell)
+        {
+            _scoredCandidates.emplace_back(_candidates[cellEntry.second].priority, cellEntry.second);
+        }
+    }
+    else
+    {
+        Vector2 center = viewpoint.value();
+        float radiusSquared = _relevancyRadius * _relevancyRadius;
+
+        int minCellX = (int)floor((center.x - _relevancyRadius) / _cellSize);
+        int maxCellX = (int)floor((center.x + _relevancyRadius) / _cellSize);
+        int minCellY = (int)floor((center.y - _relevancyRadius) / _cellSize);
+        int maxCellY = (int)floor((center.y + _relevancyRadius) / _cellSize);
+
+        for (int cellY = minCellY; cellY <= maxCellY; ++cellY)
+        {
+            for (int cellX = minCellX; cellX <= maxCellX; ++cellX)
+            {
+                auto key = GetCellKey(cellX, cellY);
+                auto it = std::lower_bound(
+                    _candidatesByCell.begin(),
+                    _candidatesByCell.end(),
+                    std::make_pair(key, 0));
+
+                for (; it != _candidatesByCell.end() && it->first == key; ++it)
+                {
+                    auto& candidate = _candidates[it->second];
+                    float distanceSquared = (candidate.position - center).LengthSquared();
+
+                    if (distanceSquared <= radiusSquared)
+                    {
+                        float score = candidate.priority / (1 + sqrt(distanceSquared));
+                        _scoredCandidates.emplace_back(score, it->second);
+                    }
+                }
+            }
+        }
+    }
+
+    if (_maxEntitiesPerClient >= 0 && (int)_scoredCandidates.size() > _maxEntitiesPerClient)
+    {
+        // Highest score first, ties broken by candidate index so every server makes the same choice
+        std::nth_element(
+            _scoredCandidates.begin(),
+            _scoredCandidates.begin() + _maxEntitiesPerClient,
+            _scoredCandidates.end(),
+            [](auto& lhs, auto& rhs)
+            {
+                return lhs.first != rhs.first
+                       ? lhs.first > rhs.first
+                       : lhs.second < rhs.second;
+            });
+
+        _scoredCandidates.resize(_maxEntitiesPerClient);
+    }
+
+    for (auto& scoredCandidate : _scoredCandidates)
+    {
+        outNetIds.push_back(_candidates[scoredCandidate.second].netId);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <gsl/span>
+
+#include "Math/Vector2.hpp"
+
+/// <summary>
+/// A replicated entity as seen by a relevancy filter. Built by the ReplicationManager each snapshot.
+/// </summary>
+struct RelevancyCandidate
+{
+    int netId;
+    int ownerClientId;
+    Vector2 position;
+    float priority;
+    bool alwaysRelevant;
+};
+
+/// <summary>
+/// Decides which replicated entities each client receives. Entities that stop being relevant are despawned on the
+/// client and spawned again with their full state when they become relevant again.
+/// </summary>
+class IRelevancyFilter
+{
+public:
+    virtual ~IRelevancyFilter() = default;
+
+    /// <summary>
+    /// Called by the server once per snapshot, before any client is queried.
+    /// </summary>
+    virtual void Update(gsl::span<const RelevancyCandidate> candidates) = 0;
+
+    /// <summary>
+    /// Appends the net ids of the candidates that are relevant to the given client. The output doesn't need to be
+    /// sorted and may contain duplicates.
+    /// </summary>
+    virtual void GetRelevantEntities(int clientId, const std::optional<Vector2>& viewpoint, std::vector<int>& outNetIds) = 0;
+};
+
+/// <summary>
+/// Entities are relevant if they are within a radius of the client's viewpoint, always relevant, or owned by the
+/// client. Clients without a viewpoint see everything. When more entities are relevant than the per-client budget,
+/// the ones with the highest priority / distance are kept.
+/// </summary>
+class SpatialRelevancyFilter : public IRelevancyFilter
+{
+public:
+    SpatialRelevancyFilter(float relevancyRadius, int maxEntitiesPerClient = -1);
+
+    void Update(gsl::span<const RelevancyCandidate> candidates) override;
+    void GetRelevantEntities(int clientId, const std::optional<Vector2>& viewpoint, std::vector<int>& outNetIds) override;
+
+private:
+    int64_t GetCellKey(int cellX, int cellY) const;
+
+    float _relevancyRadius;
+    float _cellSize;
+    int _maxEntitiesPerClient;
+
+    std::vector<RelevancyCandidate> _candidates;
+
+    // Candidate indices sorted by cell so that each cell is a contiguous range
+    std::vector<std::pair<int64_t, int>> _candidatesByCell;
+    std::vector<int> _alwaysRelevant;
+    std::vector<int> _owned;
+
+    std::vector<std::pair<float, int>> _scoredCandidates;
+};
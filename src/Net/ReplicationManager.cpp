@@ -1,10 +1,15 @@
 #include "ReplicationManager.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <slikenet/BitStream.h>
 
 #include "Net/ServerGame.hpp"
 #include "Scene/Scene.hpp"
 #include "Engine.hpp"
+#include "System/WorkerPool.hpp"
+#include "Tools/Console.hpp"
+#include "Tools/Profiler.hpp"
 
 
 #ifdef _WIN32
@@ -41,12 +46,26 @@ struct SpawnEntityMessage
             .Add(netId)
             .Add(type.key)
             .Add(position)
-            .Add(dimensions)
-            .Add(ownerClientId);
+            .Add(dimensions);
+
+        // Most entities have no owner, so they only cost the flag
+        bool hasOwner = ownerClientId >= 0;
+        stream.Add(hasOwner);
+
+        if (hasOwner)
+        {
+            uint16 clientId = (uint16)ownerClientId;
+            stream.Add(clientId);
+            ownerClientId = clientId;
+        }
+        else
+        {
+            ownerClientId = NetComponent::NoOwner;
+        }
     }
 
     int netId;
-    uint8 ownerClientId;
+    int ownerClientId;
     StringId type;
     Vector2 position;
     Vector2 dimensions;
@@ -123,6 +142,19 @@ PlayerCommand* ClientState::GetCommandById(int id)
     return nullptr;
 }
 
+WorldState* ClientState::GetRelevantWorldState(uint32 snapshotId)
+{
+    for (auto& state : relevantWorldStates)
+    {
+        if (state.snapshotId == snapshotId)
+        {
+            return &state;
+        }
+    }
+
+    return nullptr;
+}
+
 void ReplicationManager::Client_ReceiveUpdateResponse(SLNet::BitStream& stream)
 {
     ReadWriteBitStream rw(stream, true);
@@ -190,54 +222,94 @@ void ReplicationManager::Client_SendUpdateRequest(float deltaTime, ClientGame* g
             }
         }
 
-        const int maxPacketSize = 1300;
+        SLNet::BitStream message;
+        WriteUpdateRequest(playerCommandHandler, client.lastReceivedSnapshotId, client.lastServerReceivedCommandId, message);
 
-        ClientUpdateRequestMessage request;
-        request.lastReceivedSnapshotId = client.lastReceivedSnapshotId;
+        game->networkInterface.SendReliable(game->serverAddress, message);
+    }
+}
 
-        SLNet::BitStream message;
-        message.Write(PacketType::UpdateRequest);
-        ReadWriteBitStream stream(message, false);
+void ReplicationManager::WriteUpdateRequest(
+    PlayerCommandHandler& commandHandler,
+    uint32 lastReceivedSnapshotId,
+    unsigned int lastServerReceivedCommandId,
+    SLNet::BitStream& message)
+{
+    const int maxPacketSize = 1300;
 
-        PlayerCommandHandler::ScheduledCommand* commands[decltype(playerCommandHandler.localCommands)::Capacity()];
-        int totalCommands = 0;
+    ClientUpdateRequestMessage request;
+    request.lastReceivedSnapshotId = lastReceivedSnapshotId;
 
-        for (auto& command : playerCommandHandler.localCommands)
+    message.Write(PacketType::UpdateRequest);
+    ReadWriteBitStream stream(message, false);
+
+    PlayerCommandHandler::ScheduledCommand* commands[decltype(commandHandler.localCommands)::Capacity()];
+    int totalCommands = 0;
+
+    for (auto& command : commandHandler.localCommands)
+    {
+        if (command.commandId > lastServerReceivedCommandId)
         {
-            if (command.commandId > client.lastServerReceivedCommandId)
-            {
-                commands[totalCommands++] = &command;
-            }
+            commands[totalCommands++] = &command;
         }
+    }
+
+    if (totalCommands == 0)
+    {
+        request.firstCommandId = 0;
+    }
+    else
+    {
+        request.firstCommandId = commands[0]->commandId;
+    }
+
+    request.ReadWrite(stream);
 
-        if (totalCommands == 0)
+    for (int i = 0; i < totalCommands; ++i)
+    {
+        commands[i]->stream.ResetReadPointer();
+        bool hasRoomForCommand =
+            message.GetNumberOfBitsUsed() + commands[i]->stream.GetNumberOfUnreadBits() <= maxPacketSize * 8;
+        if (hasRoomForCommand)
         {
-            request.firstCommandId = 0;
+            message.Write(commands[i]->stream);
         }
         else
         {
-            request.firstCommandId = commands[0]->commandId;
+            break;
         }
+    }
+}
 
-        request.ReadWrite(stream);
+bool ReplicationManager::ReadUpdateResponseAck(SLNet::BitStream& stream, UpdateResponseAck& outAck)
+{
+    ReadWriteBitStream rw(stream, true);
 
-        for (int i = 0; i < totalCommands; ++i)
-        {
-            commands[i]->stream.ResetReadPointer();
-            bool hasRoomForCommand =
-                message.GetNumberOfBitsUsed() + commands[i]->stream.GetNumberOfUnreadBits() <= maxPacketSize * 8;
-            if (hasRoomForCommand)
-            {
-                message.Write(commands[i]->stream);
-            }
-            else
-            {
-                break;
-            }
-        }
+    UpdateResponseMessage responseMessage;
+    responseMessage.ReadWrite(rw);
 
-        game->networkInterface.SendReliable(game->serverAddress, message);
+    uint8 messageType;
+    if (!stream.Read(messageType) || (MessageType)messageType != MessageType::EntitySnapshot)
+    {
+        return false;
+    }
+
+    bool hasSpawnMessage;
+    while (stream.Read(hasSpawnMessage) && hasSpawnMessage)
+    {
+        SpawnEntityMessage spawnMessage;
+        spawnMessage.ReadWrite(rw);
     }
+
+    EntitySnapshotMessage snapshotMessage;
+    snapshotMessage.ReadWrite(rw);
+
+    outAck.snapshotFrom = responseMessage.snapshotFrom;
+    outAck.snapshotTo = responseMessage.snapshotTo;
+    outAck.lastServerReceivedCommandId = snapshotMessage.lastServerSequence;
+    outAck.lastServerExecutedCommandId = snapshotMessage.lastServerExecuted;
+
+    return true;
 }
 
 int BitsNeeded(int value)
@@ -297,6 +369,10 @@ void ReadVarGroup(VarGroup* group, uint32 fromSnapshotId, uint32 toSnapshotId, f
             {
                 group->vars[i]->ReadValueDeltaedFromSequence(fromSnapshotId, toSnapshotId, time, stream);
             }
+            else
+            {
+                group->vars[i]->KeepValueFromSnapshot(fromSnapshotId, toSnapshotId, time);
+            }
         }
         else
         {
@@ -306,6 +382,14 @@ void ReadVarGroup(VarGroup* group, uint32 fromSnapshotId, uint32 toSnapshotId, f
     }
 }
 
+void KeepVarGroup(VarGroup* group, uint32 fromSnapshotId, uint32 toSnapshotId, float time)
+{
+    for (int i = 0; i < group->varCount; ++i)
+    {
+        group->vars[i]->KeepValueFromSnapshot(fromSnapshotId, toSnapshotId, time);
+    }
+}
+
 void PartitionVars(ISyncVar* head, VarGroup* frequent, VarGroup* infrequent)
 {
     for (auto var = head; var != nullptr; var = var->next)
@@ -381,6 +465,8 @@ void ReadVars(ISyncVar* head, uint32 fromSnapshotId, uint32 toSnapshotId, float
 
     if (!anyChanged)
     {
+        KeepVarGroup(&frequent, fromSnapshotId, toSnapshotId, time);
+        KeepVarGroup(&infrequent, fromSnapshotId, toSnapshotId, time);
         return;
     }
     else
@@ -408,12 +494,24 @@ void ReadVars(ISyncVar* head, uint32 fromSnapshotId, uint32 toSnapshotId, float
             {
                 ReadVarGroup(&infrequent, fromSnapshotId, toSnapshotId, time, stream);
             }
+            else
+            {
+                KeepVarGroup(&infrequent, fromSnapshotId, toSnapshotId, time);
+            }
         }
     }
 }
 
 static WorldState g_emptyWorldState;
 
+static ConsoleVar<int> g_maxSnapshotsWithoutAck("net-max-snapshots-without-ack", 10);
+
+int ReplicationManager::MaxSnapshotsWithoutAck()
+{
+    // The baseline has to still be in the client's relevant state history
+    return Clamp(g_maxSnapshotsWithoutAck.Value(), 1, decltype(ClientState::relevantWorldStates)::Capacity() - 1);
+}
+
 void ReplicationManager::Server_ProcessUpdateRequest(SLNet::BitStream& message, int clientId)
 {
     auto& client = _clientStateByClientId[clientId];
@@ -433,6 +531,12 @@ void ReplicationManager::Server_ProcessUpdateRequest(SLNet::BitStream& message,
             while (message.GetNumberOfUnreadBits() >= 8)
             {
                 auto command = playerCommandHandler.DeserializeCommand(readMessage);
+                if (command == nullptr)
+                {
+                    // Can't tell where the unknown command ends, so the rest of the message can't be read
+                    break;
+                }
+
                 command->id = currentCommandId++;
 
                 // Only add commands we haven't already received
@@ -458,101 +562,136 @@ void ReplicationManager::Server_ProcessUpdateRequest(SLNet::BitStream& message,
 }
 
 bool ReplicationManager::Server_SendWorldUpdate(int clientId, SLNet::BitStream& response)
+{
+    PendingWorldUpdate update;
+    PrepareWorldUpdate(clientId, update);
+
+    return EncodeWorldUpdate(update, response);
+}
+
+void ReplicationManager::Server_WriteWorldUpdates(gsl::span<ClientWorldUpdate> updates)
+{
+    if (_pendingWorldUpdates.size() < updates.size())
+    {
+        _pendingWorldUpdates.resize(updates.size());
+    }
+
+    // Relevancy filters aren't thread-safe, so this part stays on the game thread
+    for (int i = 0; i < (int)updates.size(); ++i)
+    {
+        PrepareWorldUpdate(updates[i].clientId, _pendingWorldUpdates[i]);
+    }
+
+    auto encode = [&](int i)
+    {
+        updates[i].stream->Reset();
+        updates[i].hasUpdate = EncodeWorldUpdate(_pendingWorldUpdates[i], *updates[i].stream);
+        updates[i].isFullState = _pendingWorldUpdates[i].sendFullState;
+    };
+
+    auto workerPool = scene->GetEngine()->GetWorkerPool();
+    if (workerPool != nullptr && updates.size() > 1)
+    {
+        PROFILE_ZONE("EncodeWorldUpdates");
+        workerPool->ParallelFor((int)updates.size(), encode);
+    }
+    else
+    {
+        for (int i = 0; i < (int)updates.size(); ++i)
+        {
+            encode(i);
+        }
+    }
+}
+
+void ReplicationManager::PrepareWorldUpdate(int clientId, PendingWorldUpdate& outUpdate)
 {
     auto& client = _clientStateByClientId[clientId];
+    outUpdate.client = &client;
+    outUpdate.isUpToDate = client.lastReceivedSnapshotId == _currentSnapshotId;
+    outUpdate.sendFullState = false;
+
+    if (outUpdate.isUpToDate)
+    {
+        return;
+    }
+
+    // Deltas are sent unreliably, so they're from the last snapshot the client acknowledged. If it hasn't
+    // acknowledged one in a while, the baseline is probably too old to be useful (or gone), so send everything.
+    outUpdate.baselineId = client.lastReceivedSnapshotId;
+    outUpdate.sendFullState = client.GetRelevantWorldState(outUpdate.baselineId) == nullptr
+        || _currentSnapshotId - outUpdate.baselineId > (uint32)MaxSnapshotsWithoutAck();
+
+    if (outUpdate.sendFullState)
+    {
+        // A full state that's in flight will arrive, and deltas can be sent from it once it's acknowledged. Sending
+        // another one every tick until then would only pile up bytes on a connection that's already behind.
+        if (client.fullStateSnapshotId > client.lastReceivedSnapshotId)
+        {
+            outUpdate.isUpToDate = true;
+            outUpdate.sendFullState = false;
+            return;
+        }
+
+        client.fullStateSnapshotId = _currentSnapshotId;
+        outUpdate.baselineId = 0;
+    }
+
+    auto currentState = GetWorldSnapshot(_currentSnapshotId);
+    if (currentState == nullptr) FatalError("Missing current snapshot");
+
+    outUpdate.relevantState.snapshotId = _currentSnapshotId;
+    outUpdate.relevantState.entities.clear();
+    GetRelevantEntities(clientId, client, *currentState, outUpdate.relevantState.entities);
+}
+
+bool ReplicationManager::EncodeWorldUpdate(PendingWorldUpdate& update, SLNet::BitStream& response)
+{
+    auto& client = *update.client;
+    auto baselineId = update.baselineId;
+    auto& relevantState = update.relevantState;
+
     ReadWriteBitStream responseStream(response, false);
 
     response.Write(PacketType::UpdateResponse);
 
-    if (client.lastReceivedSnapshotId == _currentSnapshotId)
+    if (update.isUpToDate)
     {
         return false;
     }
 
     UpdateResponseMessage responseMessage;
-    responseMessage.snapshotFrom = client.lastReceivedSnapshotId;
+    responseMessage.snapshotFrom = baselineId;
     responseMessage.snapshotTo = _currentSnapshotId;
     responseMessage.ReadWrite(responseStream);
 
     response.Write(MessageType::EntitySnapshot);
 
-    auto currentState = GetWorldSnapshot(_currentSnapshotId);
-    if (currentState == nullptr) FatalError("Missing current snapshot");
+    WorldDiff diff;
 
     {
-        auto& clientState = _clientStateByClientId[clientId];
-
-        auto lastClientState = GetWorldSnapshot(clientState.lastReceivedSnapshotId);
-
-        WorldDiff diff;
-        if (lastClientState == nullptr)
+        if (update.sendFullState)
         {
-            NetLog("Have to send from %d -> %d\n", clientState.lastReceivedSnapshotId, _currentSnapshotId);
-            lastClientState = &g_emptyWorldState;
+            NetLog("Have to send full state %d -> %d\n", client.lastReceivedSnapshotId, _currentSnapshotId);
 
-            diff.addedEntities = currentState->entities;
+            // The client destroys whatever it has that isn't spawned by a full update
+            diff.addedEntities = relevantState.entities;
         }
         else
         {
-            bool includeDiff = false;
-            for (auto& snapshot : _worldSnapshots)
-            {
-                if (snapshot.snapshotId == clientState.lastReceivedSnapshotId)
-                {
-                    includeDiff = true;
-                }
-
-                if (includeDiff)
-                {
-                    diff.Merge(snapshot.diffFromLastSnapshot);
-                }
-
-                if (snapshot.snapshotId == _currentSnapshotId)
-                {
-                    break;
-                }
-            }
-        }
-
-        NetLog("Entities believed to be on client: %d\n", (int)lastClientState->entities.size());
-
-        NetLog("On client: ");
-        for (int i = 0; i < lastClientState->entities.size(); ++i)
-        {
-            NetLog("%d \n", lastClientState->entities[i]);
+            GetSentEntitiesDiff(client, baselineId, relevantState, diff);
         }
 
-        NetLog("\n");
-
-        NetLog("On server: ");
-        for (int i = 0; i < currentState->entities.size(); ++i)
-        {
-            NetLog("%d \n", currentState->entities[i]);
-        }
-
-        NetLog("\n");
-
+        NetLog("Entities relevant to client: %d\n", (int)relevantState.entities.size());
         NetLog("Entities added: %d\n", (int)diff.addedEntities.size());
         NetLog("Entities destroyed: %d\n", (int)diff.destroyedEntities.size());
 
-        // Send new entities that don't exist on the client
+        // Send entities that don't exist on the client, either because they're new or just became relevant
         for (auto addedEntity : diff.addedEntities)
         {
-            if (_componentsByNetId.count(addedEntity) == 0 || _componentsByNetId[addedEntity]->owner->isDestroyed)
-            {
-                // Never need to send created events if the entity was destroyed in this packet
-                continue;
-            }
-
-            auto net = _componentsByNetId[addedEntity];
-
+            auto net = GetNetComponentById(addedEntity);
             auto entity = net->owner;
 
-            if (entity->isDestroyed)
-            {
-                FatalError("Entity was destroyed");
-            }
-
             SpawnEntityMessage spawnMessage;
             spawnMessage.position = entity->Center();
             spawnMessage.netId = net->netId;
@@ -571,11 +710,11 @@ bool ReplicationManager::Server_SendWorldUpdate(int clientId, SLNet::BitStream&
         responseMessage.lastServerSequence = client.lastServerReceivedCommandId;
         responseMessage.lastServerExecuted = client.lastServerExecutedCommandId;
         responseMessage.sentTime = scene->absoluteTime;
-        responseMessage.totalEntities = currentState->entities.size();
+        responseMessage.totalEntities = relevantState.entities.size();
 
         responseMessage.ReadWrite(responseStream);
 
-        // Send destroy messages for entities that the client doesn't know were destroyed
+        // Send destroy messages for entities that were destroyed or stopped being relevant
         for (auto destroyedEntity : diff.destroyedEntities)
         {
             DestroyEntityMessage destroyMessage;
@@ -588,22 +727,128 @@ bool ReplicationManager::Server_SendWorldUpdate(int clientId, SLNet::BitStream&
         response.Write(false);
     }
 
-    // Send the current state of the world
+    // Send the current state of the relevant entities, in the same net id order the client reads them in
     {
-        NetLog("Total entities on server: %d\n", (int)_componentsByNetId.size());
-
-        for (auto& c : _componentsByNetId)
+        for (auto netId : relevantState.entities)
         {
-            auto fromSnapshotId = client.lastReceivedSnapshotId;
+            // Entities that were just spawned on the client need their full state, even if they were relevant before
+            bool wasAdded = std::binary_search(diff.addedEntities.begin(), diff.addedEntities.end(), netId);
+            auto fromSnapshotId = wasAdded ? 0 : baselineId;
             auto toSnapshotId = _currentSnapshotId;
 
-            WriteVars(c.second->owner->syncVarHead, fromSnapshotId, toSnapshotId, response);
+            WriteVars(GetNetComponentById(netId)->owner->syncVarHead, fromSnapshotId, toSnapshotId, response);
         }
     }
 
+    if (client.relevantWorldStates.IsFull())
+    {
+        client.relevantWorldStates.Dequeue();
+    }
+
+    client.relevantWorldStates.Enqueue(std::move(relevantState));
+
+    auto& stats = update.sendFullState ? _fullSnapshotStats : _deltaSnapshotStats;
+    stats.totalSent.fetch_add(1, std::memory_order_relaxed);
+    stats.totalBytes.fetch_add(response.GetNumberOfBytesUsed(), std::memory_order_relaxed);
+
     return true;
 }
 
+void ReplicationManager::GetSentEntitiesDiff(ClientState& client, uint32 baselineId, const WorldState& relevantState, WorldDiff& outDiff)
+{
+    // The client applied the baseline and possibly some of the updates sent after it, but we don't know which. So
+    // entities that are missing from any of them might not exist on the client, and entities in any of them might.
+    std::vector<int> onAllSentStates;
+    std::vector<int> onAnySentStates;
+    std::vector<int> scratch;
+    bool isFirst = true;
+
+    for (auto& state : client.relevantWorldStates)
+    {
+        if (state.snapshotId < baselineId)
+        {
+            continue;
+        }
+
+        if (isFirst)
+        {
+            onAllSentStates = state.entities;
+            onAnySentStates = state.entities;
+            isFirst = false;
+            continue;
+        }
+
+        scratch.clear();
+        std::set_intersection(
+            onAllSentStates.begin(), onAllSentStates.end(),
+            state.entities.begin(), state.entities.end(),
+            std::back_inserter(scratch));
+        onAllSentStates.swap(scratch);
+
+        scratch.clear();
+        std::set_union(
+            onAnySentStates.begin(), onAnySentStates.end(),
+            state.entities.begin(), state.entities.end(),
+            std::back_inserter(scratch));
+        onAnySentStates.swap(scratch);
+    }
+
+    // Spawning an entity that already exists and destroying one that doesn't are both ignored by the client
+    std::set_difference(
+        relevantState.entities.begin(), relevantState.entities.end(),
+        onAllSentStates.begin(), onAllSentStates.end(),
+        std::back_inserter(outDiff.addedEntities));
+
+    std::set_difference(
+        onAnySentStates.begin(), onAnySentStates.end(),
+        relevantState.entities.begin(), relevantState.entities.end(),
+        std::back_inserter(outDiff.destroyedEntities));
+}
+
+void ReplicationManager::GetRelevantEntities(int clientId, const ClientState& client, const WorldState& currentState, std::vector<int>& outNetIds)
+{
+    if (_relevancyFilter == nullptr)
+    {
+        outNetIds = currentState.entities;
+    }
+    else
+    {
+        _relevancyFilter->GetRelevantEntities(clientId, client.viewpoint, outNetIds);
+        std::sort(outNetIds.begin(), outNetIds.end());
+        outNetIds.erase(std::unique(outNetIds.begin(), outNetIds.end()), outNetIds.end());
+    }
+
+    // Entities can be destroyed after the snapshot is taken, in which case the client is told they were destroyed
+    outNetIds.erase(
+        std::remove_if(outNetIds.begin(), outNetIds.end(), [=](int netId)
+        {
+            auto it = _componentsByNetId.find(netId);
+            return it == _componentsByNetId.end() || it->second->owner->isDestroyed;
+        }),
+        outNetIds.end());
+}
+
+void ReplicationManager::UpdateRelevancyFilter(const WorldState& state)
+{
+    _relevancyCandidates.clear();
+
+    for (auto netId : state.entities)
+    {
+        auto net = _componentsByNetId[netId];
+
+        RelevancyCandidate candidate;
+        candidate.netId = netId;
+        candidate.ownerClientId = net->ownerClientId;
+        candidate.position = net->owner->Center();
+        candidate.priority = net->relevancyPriority;
+        candidate.alwaysRelevant = net->alwaysRelevant;
+
+        _relevancyCandidates.push_back(candidate);
+    }
+
+    _relevancyFilter->Update(_relevancyCandidates);
+}
+
 WorldState ReplicationManager::GetCurrentWorldState()
 {
     WorldState state;
@@ -625,11 +870,26 @@ void ReplicationManager::ReceiveEvent(const IEntityEvent& ev)
 
 void ReplicationManager::ProcessSpawnEntity(SpawnEntityMessage& message)
 {
-    if (_componentsByNetId.count(message.netId) != 0)
+    auto existing = _componentsByNetId.find(message.netId);
+    if (existing != _componentsByNetId.end())
     {
-        NetLog("Spawn duplicate entity: %d\n", message.netId);
-        // Duplicate entity
-        return;
+        auto net = existing->second;
+
+        if (net->markedForDestruction && !net->owner->isDestroyed)
+        {
+            // Despawned because it stopped being relevant, but came back before the despawn took effect
+            NetLog("Respawn entity: %d\n", message.netId);
+            net->markedForDestruction = false;
+            net->isMarkedForDestructionOnClient = false;
+            net->destroyTime = INFINITY;
+            return;
+        }
+        else if (!net->owner->isDestroyed)
+        {
+            NetLog("Spawn duplicate entity: %d\n", message.netId);
+            // Duplicate entity
+            return;
+        }
     }
 
     NetLog("Spawn entity with netId %d\n", message.netId);
@@ -675,6 +935,10 @@ void ReplicationManager::ProcessDestroyEntity(DestroyEntityMessage& message, flo
 
 void ReplicationManager::ProcessEntitySnapshotMessage(ReadWriteBitStream& stream, uint32 snapshotFromId)
 {
+    // A full update spawns every entity that is relevant, so anything else the client has is gone
+    bool isFullState = snapshotFromId == 0;
+    std::vector<int> spawnedEntities;
+
     // Read new entities
     SpawnEntityMessage spawnEntityMessage;
     do
@@ -684,6 +948,11 @@ void ReplicationManager::ProcessEntitySnapshotMessage(ReadWriteBitStream& stream
 
         spawnEntityMessage.ReadWrite(stream);
         ProcessSpawnEntity(spawnEntityMessage);
+
+        if (isFullState)
+        {
+            spawnedEntities.push_back(spawnEntityMessage.netId);
+        }
     } while (true);
 
     EntitySnapshotMessage message;
@@ -701,6 +970,21 @@ void ReplicationManager::ProcessEntitySnapshotMessage(ReadWriteBitStream& stream
         ProcessDestroyEntity(destroyEntityMessage, time);
     } while (true);
 
+    if (isFullState)
+    {
+        std::sort(spawnedEntities.begin(), spawnedEntities.end());
+
+        for (auto& c : _componentsByNetId)
+        {
+            if (!c.second->markedForDestruction
+                && !std::binary_search(spawnedEntities.begin(), spawnedEntities.end(), c.first))
+            {
+                destroyEntityMessage.netId = c.first;
+                ProcessDestroyEntity(destroyEntityMessage, time);
+            }
+        }
+    }
+
 //    if(message.totalEntities != components.size())
 //    {
 //        fflush(stdout);
@@ -746,9 +1030,9 @@ void ReplicationManager::Server_ClientDisconnected(int clientId)
         {
             c->owner->Destroy();
         }
-
-        _clientStateByClientId.erase(clientId);
     }
+
+    _clientStateByClientId.erase(clientId);
 }
 
 void ReplicationManager::TakeSnapshot()
@@ -778,6 +1062,11 @@ void ReplicationManager::TakeSnapshot()
     auto state = GetCurrentWorldState();
     WorldState::Diff(_worldSnapshots.Last(), state, state.diffFromLastSnapshot);
 
+    if (_isServer && _relevancyFilter != nullptr)
+    {
+        UpdateRelevancyFilter(state);
+    }
+
     _worldSnapshots.Enqueue(std::move(state));
 }
 
@@ -821,3 +1110,51 @@ void WorldState::Diff(const WorldState& before, const WorldState& after, WorldDi
         outDiff.addedEntities.push_back(after.entities[afterIndex++]);
     }
 }
+
+static void LogSnapshotStats(Console* console, const char* name, int64_t totalSent, int64_t totalBytes)
+{
+    console->Log(
+        "%s: %lld sent, %lld bytes, %.1f bytes each\n",
+        name,
+        (long long)totalSent,
+        (long long)totalBytes,
+        totalSent > 0 ? (double)totalBytes / totalSent : 0.0);
+}
+
+static void SnapshotStatsCmd(ConsoleCommandBinder& binder)
+{
+    binder.Help("Shows how many world updates the server sent as full state and as deltas");
+
+    auto serverGame = binder.GetEngine()->GetServerGame();
+    if (serverGame == nullptr || serverGame->GetScene() == nullptr)
+    {
+        binder.GetConsole()->Log("No server running\n");
+        return;
+    }
+
+    auto replicationManager = serverGame->GetScene()->replicationManager;
+    auto& full = replicationManager->GetFullSnapshotStats();
+    auto& delta = replicationManager->GetDeltaSnapshotStats();
+
+    int64_t fullSent = full.totalSent.load(std::memory_order_relaxed);
+    int64_t fullBytes = full.totalBytes.load(std::memory_order_relaxed);
+    int64_t deltaSent = delta.totalSent.load(std::memory_order_relaxed);
+    int64_t deltaBytes = delta.totalBytes.load(std::memory_order_relaxed);
+
+    LogSnapshotStats(binder.GetConsole(), "full", fullSent, fullBytes);
+    LogSnapshotStats(binder.GetConsole(), "delta", deltaSent, deltaBytes);
+
+    if (fullSent > 0 && deltaSent > 0)
+    {
+        // Compared to sending every update as full state
+        double fullBytesEach = (double)fullBytes / fullSent;
+        double savedBytes = fullBytesEach * deltaSent - deltaBytes;
+
+        binder.GetConsole()->Log(
+            "deltas saved about %.0f bytes (%.1f%%)\n",
+            savedBytes,
+            100.0 * savedBytes / (fullBytesEach * (fullSent + deltaSent)));
+    }
+}
+
+ConsoleCmd _snapshotStatsCmd("net-snapshot-stats", SnapshotStatsCmd);
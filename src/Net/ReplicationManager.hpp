@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <optional>
 #include <unordered_map>
 #include <unordered_set>
@@ -7,10 +9,12 @@
 
 
 #include "Components/NetComponent.hpp"
+#include "Net/RelevancyFilter.hpp"
 #include "Scene/Entity.hpp"
 #include "Scene/Scene.hpp"
 
 struct ClientGame;
+struct ClientWorldUpdate;
 struct NetworkInterface;
 
 class NetworkManager;
@@ -79,6 +83,7 @@ DEFINE_EVENT(JoinedServerEvent)
 struct ClientState
 {
     PlayerCommand* GetCommandById(int id);
+    WorldState* GetRelevantWorldState(uint32 snapshotId);
 
     unsigned int lastServerReceivedCommandId = 0;
     unsigned int lastReceivedSnapshotId = 0;
@@ -87,6 +92,28 @@ struct ClientState
 
     FixedSizeCircularQueue<PlayerCommand*, 128> commands;
     std::string clientName;
+
+    // Server only: the entities that were relevant to the client in each recently sent snapshot
+    FixedSizeCircularQueue<WorldState, 32> relevantWorldStates;
+    std::optional<Vector2> viewpoint;
+
+    // Server only: the last full state, which is sent reliably. Until the client acknowledges it, it isn't sent another.
+    unsigned int fullStateSnapshotId = 0;
+};
+
+// What a client learns from the header of a world update, without applying it
+struct UpdateResponseAck
+{
+    uint32 snapshotFrom;
+    uint32 snapshotTo;
+    unsigned int lastServerReceivedCommandId;
+    unsigned int lastServerExecutedCommandId;
+};
+
+struct SnapshotSendStats
+{
+    std::atomic<int64_t> totalSent { 0 };
+    std::atomic<int64_t> totalBytes { 0 };
 };
 
 class ReplicationManager : public ISceneService
@@ -112,7 +139,13 @@ public:
             //FatalError("Tried to remove net component from %s on client\n", typeid(*component->owner).name());
         }
 
-        _componentsByNetId.erase(component->netId);
+        // A despawned entity may already have been replaced by a respawned one with the same id
+        auto it = _componentsByNetId.find(component->netId);
+        if (it != _componentsByNetId.end() && it->second == component)
+        {
+            _componentsByNetId.erase(it);
+        }
+
         components.erase(component);
     }
 
@@ -144,11 +177,64 @@ public:
     void Client_ReceiveUpdateResponse(SLNet::BitStream& stream);
     void Client_SendUpdateRequest(float deltaTime, ClientGame* game);
 
+    /// <summary>
+    /// Writes an update request that acknowledges a snapshot and carries the commands the server hasn't received yet.
+    /// </summary>
+    static void WriteUpdateRequest(
+        PlayerCommandHandler& commandHandler,
+        uint32 lastReceivedSnapshotId,
+        unsigned int lastServerReceivedCommandId,
+        SLNet::BitStream& message);
+
+    /// <summary>
+    /// Reads the snapshot ids and command acknowledgements of an update response, for clients that don't apply the
+    /// update to a scene. The packet type must already have been read.
+    /// </summary>
+    static bool ReadUpdateResponseAck(SLNet::BitStream& stream, UpdateResponseAck& outAck);
+
     void Server_ProcessUpdateRequest(SLNet::BitStream& message, int clientId);
     bool Server_SendWorldUpdate(int clientId, SLNet::BitStream& response);
 
+    /// <summary>
+    /// Writes the world update of each client into its own stream, producing the same bytes as Server_SendWorldUpdate().
+    /// The updates are encoded on worker threads, which only read entity and sync var state, so nothing may modify
+    /// entities or take a snapshot until this returns.
+    /// </summary>
+    void Server_WriteWorldUpdates(gsl::span<ClientWorldUpdate> updates);
+
     void Server_ClientDisconnected(int clientId);
 
+    /// <summary>
+    /// Limits which entities are sent to each client. Without a filter every client receives every entity.
+    /// </summary>
+    void SetRelevancyFilter(std::unique_ptr<IRelevancyFilter> filter)
+    {
+        _relevancyFilter = std::move(filter);
+    }
+
+    /// <summary>
+    /// Sets the position that the relevancy filter measures distances from for a client, usually its camera or
+    /// player position. Ignored for clients the server doesn't know, such as ones that just disconnected.
+    /// </summary>
+    void SetClientViewpoint(int clientId, std::optional<Vector2> viewpoint)
+    {
+        auto client = _clientStateByClientId.find(clientId);
+        if (client != _clientStateByClientId.end())
+        {
+            client->second.viewpoint = viewpoint;
+        }
+    }
+
+    /// <summary>
+    /// World updates are sent unreliably as deltas from the last snapshot the client acknowledged. Once this many
+    /// snapshots have been sent without an acknowledgement, the client gets the full state instead, which is sent
+    /// reliably.
+    /// </summary>
+    static int MaxSnapshotsWithoutAck();
+
+    const SnapshotSendStats& GetFullSnapshotStats() const { return _fullSnapshotStats; }
+    const SnapshotSendStats& GetDeltaSnapshotStats() const { return _deltaSnapshotStats; }
+
     void TakeSnapshot();
 
     WorldState GetCurrentWorldState();
@@ -169,7 +255,25 @@ private:
     void ProcessDestroyEntity(class DestroyEntityMessage& message, float destroyTime);
     void ProcessEntitySnapshotMessage(ReadWriteBitStream& stream, uint32 snapshotFromId);
 
+    // What a client's update will contain, decided on the game thread before the update is encoded
+    struct PendingWorldUpdate
+    {
+        ClientState* client = nullptr;
+        bool isUpToDate = false;
+        bool sendFullState = false;
+        uint32 baselineId = 0;
+        WorldState relevantState;
+    };
+
+    void PrepareWorldUpdate(int clientId, PendingWorldUpdate& outUpdate);
+
+    // Called concurrently for different clients
+    bool EncodeWorldUpdate(PendingWorldUpdate& update, SLNet::BitStream& response);
+
     WorldState* GetWorldSnapshot(uint32 snapshotId);
+    void UpdateRelevancyFilter(const WorldState& state);
+    void GetRelevantEntities(int clientId, const ClientState& client, const WorldState& currentState, std::vector<int>& outNetIds);
+    void GetSentEntitiesDiff(ClientState& client, uint32 baselineId, const WorldState& relevantState, WorldDiff& outDiff);
 
     std::map<int, NetComponent*> _componentsByNetId;
     std::unordered_map<int, ClientState> _clientStateByClientId;
@@ -181,4 +285,11 @@ private:
 
     uint32 _currentSnapshotId = 0;
     FixedSizeCircularQueue<WorldState, 32> _worldSnapshots;
+
+    std::unique_ptr<IRelevancyFilter> _relevancyFilter;
+    std::vector<RelevancyCandidate> _relevancyCandidates;
+
+    SnapshotSendStats _fullSnapshotStats;
+    SnapshotSendStats _deltaSnapshotStats;
+    std::vector<PendingWorldUpdate> _pendingWorldUpdates;
 };
\ No newline at end of file
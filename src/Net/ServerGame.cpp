@@ -13,6 +13,7 @@
 #include "Tools/Console.hpp"
 #include "Tools/MetricsManager.hpp"
 #include "Tools/PlotManager.hpp"
+#include "Tools/Profiler.hpp"
 #include "Scene/IGame.hpp"
 
 ConsoleVar<bool> g_stressTest("stress-test", false, false);
@@ -22,6 +23,8 @@ ConsoleVar<float> g_timeScale("time-scale", 1);
 
 void BaseGameInstance::RunFrame(float currentTime)
 {
+    PROFILE_ZONE("RunFrame");
+
     auto input = engine->GetInput();
     auto sdlManager = engine->GetSdlManager();
 
@@ -62,10 +65,17 @@ void BaseGameInstance::RunFrame(float currentTime)
         //_soundManager->SetListenerPosition(soundListener->Center(), soundListener->GetVelocity());
     }
 
-    UpdateNetwork();
+    {
+        PROFILE_ZONE("UpdateNetwork");
+        UpdateNetwork();
+    }
 
     scene->UpdateEntities(renderDeltaTime);
-    PostUpdateEntities();
+
+    {
+        PROFILE_ZONE("PostUpdateEntities");
+        PostUpdateEntities();
+    }
 
     bool allowConsole = !isHeadless && g_developerMode.Value();
     auto console = engine->GetConsole();
@@ -127,6 +137,8 @@ void BaseGameInstance::RunFrame(float currentTime)
 
 void BaseGameInstance::Render(Scene* scene, float deltaTime, float renderDeltaTime)
 {
+    PROFILE_ZONE("Render");
+
     auto input = engine->GetInput();
     auto sdlManager = engine->GetSdlManager();
     auto renderer = engine->GetRenderer();
@@ -218,6 +230,23 @@ void ServerGame::HandleNewConnection(SLNet::Packet* packet)
 {
     SLNet::BitStream response;
     int clientId = AddClient(packet->systemAddress);
+
+    if (clientId == -1)
+    {
+        Log("Rejected connection: server is full (%d clients)\n", MaxClients());
+
+        response.Write(PacketType::ServerFull);
+        networkInterface.SendReliable(packet->systemAddress, response);
+
+        if (!networkInterface.IsLoopback(packet->systemAddress))
+        {
+            // Let the rejection go out before dropping the connection
+            networkInterface.raknetInterface->CloseConnection(packet->systemAddress, true);
+        }
+
+        return;
+    }
+
     sceneManager.GetScene()->SendEvent(PlayerConnectedEvent(clientId));
 
     response.Write(PacketType::NewConnectionResponse);
@@ -317,6 +346,8 @@ void ServerGame::DisconnectClient(int clientId)
     GetScene()->replicationManager->Server_ClientDisconnected(clientId);
 
     clients[clientId].status = ClientConnectionStatus::NotConnected;
+    _clientIdByAddress.erase(clients[clientId].address);
+    _freeClientIds.push_back(clientId);
 }
 
 static ConsoleVar<std::string> g_name("name", "", true);
@@ -363,6 +394,11 @@ void ClientGame::UpdateNetwork()
             Log("Connection failed: servere not accepting incoming connections\n");
             break;
         }
+        case PacketType::ServerFull:
+        {
+            Log("Connection failed: server is full\n");
+            break;
+        }
         case PacketType::UpdateResponse:
         {
             SLNet::BitStream stream(packet->data, packet->length, false);
@@ -464,56 +500,93 @@ ConsoleCmd pingCmd("ping", PingCommand);
 
 int ServerGame::AddClient(const SLNet::AddressOrGUID& address)
 {
-    for (int i = 0; i < MaxClients; ++i)
+    auto existing = _clientIdByAddress.find(address);
+    if (existing != _clientIdByAddress.end())
     {
-        if (clients[i].status != ClientConnectionStatus::Connected)
-        {
-            clients[i].status = ClientConnectionStatus::Connected;
-            clients[i].clientId = i;
-            clients[i].address = address;
+        return existing->second;
+    }
 
-            return i;
-        }
+    if (_freeClientIds.empty())
+    {
+        return -1;
     }
 
-    // TODO MW
-    FatalError("Server full");
+    int clientId = _freeClientIds.back();
+    _freeClientIds.pop_back();
+
+    clients[clientId].status = ClientConnectionStatus::Connected;
+    clients[clientId].clientId = clientId;
+    clients[clientId].address = address;
+    _clientIdByAddress[address] = clientId;
+
+    return clientId;
 }
 
 int ServerGame::GetClientId(const SLNet::AddressOrGUID& address)
 {
-    for (auto& client : clients)
-    {
-        if (client.status == ClientConnectionStatus::Connected && client.address == address)
-        {
-            return client.clientId;
-        }
-    }
-
-    return -1;
+    auto it = _clientIdByAddress.find(address);
+    return it != _clientIdByAddress.end()
+        ? it->second
+        : -1;
 }
 
 void ServerGame::PostUpdateEntities()
 {
     auto replicationManager = GetScene()->replicationManager;
-    replicationManager->TakeSnapshot();
 
-    SLNet::BitStream worldUpdateStream;
+    {
+        PROFILE_ZONE("TakeSnapshot");
+        replicationManager->TakeSnapshot();
+    }
+
+    PROFILE_ZONE("SendWorldUpdates");
+
+    _worldUpdates.clear();
     for (auto& client : clients)
     {
         if (client.status != ClientConnectionStatus::Connected) continue;
 
-        worldUpdateStream.Reset();
-        if (replicationManager->Server_SendWorldUpdate(client.clientId, worldUpdateStream))
+        ClientWorldUpdate update;
+        update.clientId = client.clientId;
+        update.stream = &_worldUpdateStreams[client.clientId];
+        _worldUpdates.push_back(update);
+    }
+
+    replicationManager->Server_WriteWorldUpdates(_worldUpdates);
+
+    for (auto& update : _worldUpdates)
+    {
+        if (!update.hasUpdate)
+        {
+            continue;
+        }
+
+        // A delta is from a snapshot the client acknowledged, so a lost one is replaced by the next. A lost full state
+        // would leave the client with nothing to delta from and the server sending the whole world again.
+        if (update.isFullState)
+        {
+            networkInterface.SendReliable(clients[update.clientId].address, *update.stream);
+        }
+        else
         {
-            networkInterface.SendReliable(client.address, worldUpdateStream);
+            networkInterface.SendUnreliable(clients[update.clientId].address, *update.stream);
         }
     }
 }
 
-ServerGame::ServerGame(Engine* engine, SLNet::RakPeerInterface* raknetInterface, SLNet::AddressOrGUID localAddress_)
-    : BaseGameInstance(engine, raknetInterface, localAddress_, true)
+ServerGame::ServerGame(Engine* engine, SLNet::RakPeerInterface* raknetInterface, SLNet::AddressOrGUID localAddress_, int maxClients)
+    : BaseGameInstance(engine, raknetInterface, localAddress_, true),
+      clients(maxClients),
+      _worldUpdateStreams(std::make_unique<SLNet::BitStream[]>(maxClients))
 {
+    // Taken from the back, so the first clients to connect get the lowest ids
+    for (int i = maxClients - 1; i >= 0; --i)
+    {
+        _freeClientIds.push_back(i);
+    }
+
+    _worldUpdates.reserve(maxClients);
+
     isHeadless = true;
     targetTickRate = 60;//30;
 
@@ -523,11 +596,11 @@ ServerGame::ServerGame(Engine* engine, SLNet::RakPeerInterface* raknetInterface,
 
 void ServerGame::ForEachClient(const std::function<void(ServerGameClient&)>& handler)
 {
-    for (int i = 0; i < MaxClients; ++i)
+    for (auto& client : clients)
     {
-        if (clients[i].status == ClientConnectionStatus::Connected)
+        if (client.status == ClientConnectionStatus::Connected)
         {
-            handler(clients[i]);
+            handler(client);
         }
     }
 }
@@ -540,7 +613,7 @@ void ServerGame::BroadcastRpc(const IRemoteProcedureCall& rpc)
 
 void ServerGame::ExecuteRpc(int clientId, const IRemoteProcedureCall& rpc)
 {
-    if (clientId < 0 || clientId >= MaxClients || clients[clientId].status != ClientConnectionStatus::Connected)
+    if (clientId < 0 || clientId >= MaxClients() || clients[clientId].status != ClientConnectionStatus::Connected)
     {
         return;
     }
@@ -550,16 +623,7 @@ void ServerGame::ExecuteRpc(int clientId, const IRemoteProcedureCall& rpc)
 
 int ServerGame::TotalConnectedClients()
 {
-    int count = 0;
-    for (int i = 0; i < MaxClients; ++i)
-    {
-        if (clients[i].status == ClientConnectionStatus::Connected)
-        {
-            ++count;
-        }
-    }
-
-    return count;
+    return _clientIdByAddress.size();
 }
 
 ReadWriteBitStream& ReadWriteBitStream::Add(Vector2& out)
@@ -613,6 +677,66 @@ ReadWriteBitStream& ReadWriteBitStream::Add(std::vector<unsigned char>& v)
     return *this;
 }
 
+ReadWriteBitStream& ReadWriteBitStream::AddBits(uint32_t& value, int totalBits)
+{
+    // Bits are written starting with the least significant byte
+    unsigned char bytes[4];
+
+    if (isReading)
+    {
+        memset(bytes, 0, sizeof(bytes));
+        stream.ReadBits(bytes, totalBits);
+        value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+    else
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            bytes[i] = (value >> (i * 8)) & 0xFF;
+        }
+
+        stream.WriteBits(bytes, totalBits);
+    }
+
+    return *this;
+}
+
+static std::atomic<int> g_totalOutOfRangeQuantizedValues { 0 };
+
+ReadWriteBitStream& ReadWriteBitStream::AddQuantized(float& value, const Quantization& quantization)
+{
+    if (isReading)
+    {
+        uint32_t encoded;
+        AddBits(encoded, quantization.bits);
+        value = quantization.Decode(encoded);
+    }
+    else
+    {
+        uint32_t encoded = quantization.Encode(value);
+
+        // The client gets a different value than the server has, so the range is wrong for this game. Logged now and
+        // then, since it's likely to happen every tick. World updates are encoded concurrently.
+        if (!quantization.IsInRange(value)
+            && g_totalOutOfRangeQuantizedValues.fetch_add(1, std::memory_order_relaxed) % 1000 == 0)
+        {
+            Log(LogType::Error, "Quantized value %f is out of range and was sent as %f (%d times so far)\n",
+                value,
+                quantization.Decode(encoded),
+                g_totalOutOfRangeQuantizedValues.load(std::memory_order_relaxed));
+        }
+
+        AddBits(encoded, quantization.bits);
+    }
+
+    return *this;
+}
+
+ReadWriteBitStream& ReadWriteBitStream::AddQuantized(Vector2& value, const Quantization& quantization)
+{
+    return AddQuantized(value.x, quantization).AddQuantized(value.y, quantization);
+}
+
 void RpcManager::Execute(SLNet::AddressOrGUID address, const IRemoteProcedureCall& rpc)
 {
     SLNet::BitStream stream;
@@ -4,12 +4,14 @@
 #include <list>
 #include <memory>
 #include <queue>
+#include <random>
 #include <gsl/span>
 #include <unordered_map>
 #include <slikenet/BitStream.h>
 #include <slikenet/MessageIdentifiers.h>
 #include <slikenet/peerinterface.h>
 #include "Math/Vector2.hpp"
+#include "Net/Quantization.hpp"
 
 #include "Scene/SceneManager.hpp"
 #include "Memory/StringId.hpp"
@@ -66,6 +68,17 @@ struct ReadWriteBitStream
     ReadWriteBitStream& Add(std::string& str);
     ReadWriteBitStream& Add(std::vector<unsigned char>& v);
 
+    /// <summary>
+    /// Writes only the low totalBits bits of the value.
+    /// </summary>
+    ReadWriteBitStream& AddBits(uint32_t& value, int totalBits);
+
+    /// <summary>
+    /// When reading, the result is the decoded value, not necessarily the value that was written.
+    /// </summary>
+    ReadWriteBitStream& AddQuantized(float& value, const Quantization& quantization);
+    ReadWriteBitStream& AddQuantized(Vector2& value, const Quantization& quantization);
+
     SLNet::BitStream& stream;
     bool isReading;
 };
@@ -110,8 +123,23 @@ struct RemoteProcedureCall : IRemoteProcedureCall
     template<> inline constexpr const char* GetRpcName<structName_>() { return #structName_; } \
     struct structName_ : RemoteProcedureCall<structName_>
 
+struct AddressOrGuidHash
+{
+    size_t operator()(const SLNet::AddressOrGUID& address) const
+    {
+        return SLNet::AddressOrGUID::ToInteger(address);
+    }
+};
+
 struct NetworkInterface
 {
+    // A peer in the same process that packets are handed to directly instead of going through RakNet
+    struct LoopbackPeer
+    {
+        NetworkInterface* peerInterface;
+        SLNet::SystemAddress addressOnPeer;     // The sender's address as the peer sees it
+    };
+
     NetworkInterface(SLNet::RakPeerInterface* raknetInterface_)
         : raknetInterface(raknetInterface_)
     {
@@ -120,15 +148,12 @@ struct NetworkInterface
 
     void SendUnreliable(const SLNet::AddressOrGUID& address, gsl::span<unsigned char> data)
     {
-        if (address == localAddress && localInterface != nullptr)
+        if (loopbackPacketLoss > 0 && IsLoopback(address) && _lossDistribution(_lossRandom) < loopbackPacketLoss)
         {
-            auto packet = raknetInterface->AllocatePacket(data.size_bytes());
-            packet->systemAddress = localInterface->localAddress.systemAddress;
-
-            memcpy(packet->data, data.data(), data.size_bytes());
-            localInterface->AddLocalPacket(packet);
+            return;
         }
-        else
+
+        if (!TrySendLoopback(address, data))
         {
             raknetInterface->Send(
                 (char*)data.data(),
@@ -143,15 +168,7 @@ struct NetworkInterface
 
     void SendReliable(const SLNet::AddressOrGUID& address, gsl::span<unsigned char> data)
     {
-        if (address == localAddress && localInterface != nullptr)
-        {
-            auto packet = raknetInterface->AllocatePacket(data.size_bytes());
-            packet->systemAddress = localInterface->localAddress.systemAddress;
-
-            memcpy(packet->data, data.data(), data.size_bytes());
-            localInterface->AddLocalPacket(packet);
-        }
-        else
+        if (!TrySendLoopback(address, data))
         {
             raknetInterface->Send(
                 (char*)data.data(),
@@ -188,7 +205,9 @@ struct NetworkInterface
         }
         else
         {
-            lastPacket = raknetInterface->Receive();
+            lastPacket = isLoopbackOnly
+                ? nullptr
+                : raknetInterface->Receive();
         }
 
         outPacket = lastPacket;
@@ -201,6 +220,22 @@ struct NetworkInterface
         localAddress = localAddress_;
     }
 
+    void AddLoopbackPeer(const SLNet::AddressOrGUID& address, const LoopbackPeer& peer)
+    {
+        loopbackPeers[address] = peer;
+    }
+
+    void RemoveLoopbackPeer(const SLNet::AddressOrGUID& address)
+    {
+        loopbackPeers.erase(address);
+    }
+
+    bool IsLoopback(const SLNet::AddressOrGUID& address) const
+    {
+        return (address == localAddress && localInterface != nullptr)
+            || loopbackPeers.count(address) != 0;
+    }
+
     void AddLocalPacket(SLNet::Packet* packet)
     {
         localPackets.push(packet);
@@ -209,8 +244,47 @@ struct NetworkInterface
     SLNet::RakPeerInterface* raknetInterface;
     NetworkInterface* localInterface = nullptr;
     SLNet::AddressOrGUID localAddress;
+    std::unordered_map<SLNet::AddressOrGUID, LoopbackPeer, AddressOrGuidHash> loopbackPeers;
     std::queue<SLNet::Packet*> localPackets;
     SLNet::Packet* lastPacket = nullptr;
+
+    // Only receives packets from loopback peers, so it never takes packets meant for a game that shares the RakNet peer
+    bool isLoopbackOnly = false;
+
+    // Fraction of unreliable packets to loopback peers that are dropped, to test against a lossy connection
+    float loopbackPacketLoss = 0;
+
+private:
+    bool TrySendLoopback(const SLNet::AddressOrGUID& address, gsl::span<unsigned char> data)
+    {
+        LoopbackPeer peer;
+
+        if (address == localAddress && localInterface != nullptr)
+        {
+            peer.peerInterface = localInterface;
+            peer.addressOnPeer = localInterface->localAddress.systemAddress;
+        }
+        else
+        {
+            if (loopbackPeers.empty()) return false;
+
+            auto it = loopbackPeers.find(address);
+            if (it == loopbackPeers.end()) return false;
+
+            peer = it->second;
+        }
+
+        auto packet = raknetInterface->AllocatePacket(data.size_bytes());
+        packet->systemAddress = peer.addressOnPeer;
+
+        memcpy(packet->data, data.data(), data.size_bytes());
+        peer.peerInterface->AddLocalPacket(packet);
+
+        return true;
+    }
+
+    std::minstd_rand _lossRandom;
+    std::uniform_real_distribution<float> _lossDistribution { 0, 1 };
 };
 
 class RpcManager
@@ -245,6 +319,14 @@ struct ServerGameClient
     int clientId;
 };
 
+struct ClientWorldUpdate
+{
+    int clientId;
+    SLNet::BitStream* stream;
+    bool hasUpdate = false;     // False if the client is up to date and nothing needs to be sent
+    bool isFullState = false;   // Not deltaed from anything the client has, so it has to be sent reliably
+};
+
 class FileTransferService;
 
 struct BaseGameInstance
@@ -281,23 +363,37 @@ struct BaseGameInstance
 
 struct ServerGame : BaseGameInstance
 {
-    static constexpr int MaxClients = 8;
+    // Client ids are sent in 16 bits, see SpawnEntityMessage
+    static constexpr int MaxClientIds = 65536;
 
-    ServerGame(Engine* engine, SLNet::RakPeerInterface* raknetInterface, SLNet::AddressOrGUID localAddress_);
+    ServerGame(Engine* engine, SLNet::RakPeerInterface* raknetInterface, SLNet::AddressOrGUID localAddress_, int maxClients);
 
     void HandleNewConnection(SLNet::Packet* packet);
     void UpdateNetwork() override;
     void PostUpdateEntities() override;
+
+    /// <summary>
+    /// Returns -1 if the server is full.
+    /// </summary>
     int AddClient(const SLNet::AddressOrGUID& address);
     int GetClientId(const SLNet::AddressOrGUID& address);
     void ForEachClient(const std::function<void(ServerGameClient&)>& handler);
     void BroadcastRpc(const IRemoteProcedureCall& rpc);
     void ExecuteRpc(int clientId, const IRemoteProcedureCall& rpc);
     int TotalConnectedClients();
+    int MaxClients() const { return (int)clients.size(); }
 
-    ServerGameClient clients[MaxClients];
+    // Indexed by client id
+    std::vector<ServerGameClient> clients;
 
     void DisconnectClient(int clientId);
+
+private:
+    std::unordered_map<SLNet::AddressOrGUID, int, AddressOrGuidHash> _clientIdByAddress;
+    std::vector<int> _freeClientIds;
+
+    std::vector<ClientWorldUpdate> _worldUpdates;
+    std::unique_ptr<SLNet::BitStream[]> _worldUpdateStreams;
 };
 
 struct ClientGame : BaseGameInstance
@@ -1,9 +1,85 @@
 
 #include <slikenet/BitStream.h>
+#include <cmath>
 
 #include "SyncVar.hpp"
 
+#include "Net/ServerGame.hpp"
 #include "Scene/Scene.hpp"
+#include "Tools/ConsoleVar.hpp"
+
+static ConsoleVar<bool> g_syncVarQuantization("net-quantization", true);
+
+int SyncVarHistoryPool::CalculateHistoryLength(float tickRate, float historySeconds)
+{
+    int minLength = Max(MinHistoryLength, (int)ceil(tickRate * historySeconds));
+
+    int length = 1;
+    while (length < minLength)
+    {
+        length *= 2;
+    }
+
+    return length;
+}
+
+void SyncVarHistoryPool::SetHistoryLength(int length)
+{
+    if (_totalAllocatedBlocks != 0)
+    {
+        FatalError("Can't change the sync var history length after histories have been allocated");
+    }
+
+    if (length <= 0 || (length & (length - 1)) != 0)
+    {
+        FatalError("Sync var history length must be a power of two (got %d)", length);
+    }
+
+    _historyLength = length;
+}
+
+SyncVarHistoryPool::SizeClass& SyncVarHistoryPool::GetSizeClass(int size)
+{
+    for (auto& sizeClass : _sizeClasses)
+    {
+        if (sizeClass.size == size)
+        {
+            return sizeClass;
+        }
+    }
+
+    _sizeClasses.push_back({ size });
+    return _sizeClasses.back();
+}
+
+void* SyncVarHistoryPool::Allocate(int size)
+{
+    auto& sizeClass = GetSizeClass(size);
+
+    if (sizeClass.freeBlocks.empty())
+    {
+        auto chunk = std::make_unique<unsigned char[]>(size * BlocksPerChunk);
+
+        for (int i = BlocksPerChunk - 1; i >= 0; --i)
+        {
+            sizeClass.freeBlocks.push_back(chunk.get() + i * size);
+        }
+
+        _chunks.push_back(std::move(chunk));
+    }
+
+    auto block = sizeClass.freeBlocks.back();
+    sizeClass.freeBlocks.pop_back();
+    ++_totalAllocatedBlocks;
+
+    return block;
+}
+
+void SyncVarHistoryPool::Free(void* data, int size)
+{
+    GetSizeClass(size).freeBlocks.push_back(data);
+    --_totalAllocatedBlocks;
+}
 
 ISyncVar::ISyncVar(SyncVarUpdateFrequency frequency_)
     : frequency(frequency_)
@@ -14,10 +90,24 @@ ISyncVar::ISyncVar(SyncVarUpdateFrequency frequency_)
         FatalError("Syncvars can only be added to an entity");
     }
 
+    _owner = entity;
     next = entity->syncVarHead;
     entity->syncVarHead = this;
 }
 
+void* ISyncVar::AllocateHistory(int snapshotSize, int& outHistoryLength)
+{
+    auto& pool = _owner->scene->GetSyncVarHistoryPool();
+    outHistoryLength = pool.HistoryLength();
+
+    return pool.Allocate(snapshotSize * outHistoryLength);
+}
+
+void ISyncVar::FreeHistory(void* history, int snapshotSize, int historyLength)
+{
+    _owner->scene->GetSyncVarHistoryPool().Free(history, snapshotSize * historyLength);
+}
+
 void WriteBitsToStream(const unsigned char* data, int size, SLNet::BitStream& stream)
 {
     stream.WriteBits(data, size * 8);
@@ -28,6 +118,31 @@ void ReadBitsFromStream(unsigned char* data, int size, SLNet::BitStream& stream)
     stream.ReadBits(data, size * 8);
 }
 
+bool IsSyncVarQuantizationEnabled()
+{
+    return g_syncVarQuantization.Value();
+}
+
+void WriteQuantizedSyncVar(float value, const Quantization& quantization, SLNet::BitStream& stream)
+{
+    ReadWriteBitStream(stream, false).AddQuantized(value, quantization);
+}
+
+void WriteQuantizedSyncVar(Vector2 value, const Quantization& quantization, SLNet::BitStream& stream)
+{
+    ReadWriteBitStream(stream, false).AddQuantized(value, quantization);
+}
+
+void ReadQuantizedSyncVar(float& outValue, const Quantization& quantization, SLNet::BitStream& stream)
+{
+    ReadWriteBitStream(stream, true).AddQuantized(outValue, quantization);
+}
+
+void ReadQuantizedSyncVar(Vector2& outValue, const Quantization& quantization, SLNet::BitStream& stream)
+{
+    ReadWriteBitStream(stream, true).AddQuantized(outValue, quantization);
+}
+
 template<>
 void ReadSyncVarDelta<Vector2>(const Vector2& before, Vector2& result, SyncVarDeltaMode mode, SLNet::BitStream& stream)
 {
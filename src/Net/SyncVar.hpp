@@ -1,13 +1,20 @@
 #pragma once
 
+#include <memory>
+#include <new>
+#include <vector>
+
 #include "Math/Vector2.hpp"
 #include "Memory/CircularQueue.hpp"
+#include "Net/Quantization.hpp"
 
 namespace SLNet
 {
     class BitStream;
 }
 
+struct Entity;
+
 enum class SyncVarUpdateFrequency
 {
     Frequent,
@@ -50,12 +57,66 @@ inline bool TryLerp(const Vector2& start, const Vector2& end, float t, Vector2&
 void WriteBitsToStream(const unsigned char* data, int size, SLNet::BitStream& stream);
 void ReadBitsFromStream(unsigned char* data, int size, SLNet::BitStream& stream);
 
+template<typename T>
+constexpr bool IsQuantizableSyncVarType = std::is_same_v<T, float> || std::is_same_v<T, Vector2>;
+
+void WriteQuantizedSyncVar(float value, const Quantization& quantization, SLNet::BitStream& stream);
+void WriteQuantizedSyncVar(Vector2 value, const Quantization& quantization, SLNet::BitStream& stream);
+void ReadQuantizedSyncVar(float& outValue, const Quantization& quantization, SLNet::BitStream& stream);
+void ReadQuantizedSyncVar(Vector2& outValue, const Quantization& quantization, SLNet::BitStream& stream);
+
+/// <summary>
+/// False when the net-quantization console var is off, which sends quantized vars at full precision instead. The
+/// server and the client have to agree on it, so it's only for comparing bandwidth with a loopback server.
+/// </summary>
+bool IsSyncVarQuantizationEnabled();
+
 template<typename T>
 void WriteSyncVarDelta(const T& before, const T& after, bool forceFullUpdate, SyncVarDeltaMode mode, SLNet::BitStream& stream);
 
 template<typename T>
 void ReadSyncVarDelta(const T& before, T& result, SyncVarDeltaMode mode, SLNet::BitStream& stream);
 
+/// <summary>
+/// Scene-wide storage for sync var snapshot histories. A history is only allocated the first time a var is
+/// snapshotted, so entities that aren't replicated don't pay for one, and every history holds the same number of
+/// snapshots.
+/// </summary>
+class SyncVarHistoryPool
+{
+public:
+    // The server keeps this many world snapshots, so deltas are never based on anything older
+    static constexpr int MinHistoryLength = 32;
+
+    /// <summary>
+    /// Returns the number of snapshots needed to cover the given duration at the given tick rate, rounded up to a
+    /// power of two.
+    /// </summary>
+    static int CalculateHistoryLength(float tickRate, float historySeconds);
+
+    void SetHistoryLength(int length);
+    int HistoryLength() const { return _historyLength; }
+
+    void* Allocate(int size);
+    void Free(void* data, int size);
+
+private:
+    static constexpr int BlocksPerChunk = 16;
+
+    struct SizeClass
+    {
+        int size;
+        std::vector<void*> freeBlocks;
+    };
+
+    SizeClass& GetSizeClass(int size);
+
+    std::vector<SizeClass> _sizeClasses;
+    std::vector<std::unique_ptr<unsigned char[]>> _chunks;
+    int _historyLength = MinHistoryLength;
+    int _totalAllocatedBlocks = 0;
+};
+
 struct ISyncVar
 {
     ISyncVar(SyncVarUpdateFrequency frequency_ = SyncVarUpdateFrequency::Frequent);
@@ -67,6 +128,13 @@ struct ISyncVar
     virtual bool CurrentValueChangedFromSequence(uint32_t snapshotId) = 0;
     virtual void WriteValueDeltaedFromSnapshot(uint32_t fromSnapshotId, uint32_t toSnapshotId, SLNet::BitStream& stream) = 0;
     virtual void ReadValueDeltaedFromSequence(uint32_t fromSnapshotId, uint32_t toSnapshotId, float time, SLNet::BitStream& stream) = 0;
+
+    /// <summary>
+    /// Called on the client for vars that weren't sent because they didn't change since the snapshot the update is
+    /// based on. Records that value for the new snapshot, so the var ends up with the same value as on the server even
+    /// if a later snapshot had changed it in between.
+    /// </summary>
+    virtual void KeepValueFromSnapshot(uint32_t fromSnapshotId, uint32_t toSnapshotId, float time) = 0;
     virtual void SetCurrentValueToValueAtTime(float time) = 0;
     virtual void AddCurrentValueToSnapshots(uint32_t currentSnapshotId, float currentTime) = 0;
 
@@ -74,6 +142,12 @@ struct ISyncVar
 
     ISyncVar* next = nullptr;
     SyncVarUpdateFrequency frequency;
+
+protected:
+    void* AllocateHistory(int snapshotSize, int& outHistoryLength);
+    void FreeHistory(void* history, int snapshotSize, int historyLength);
+
+    Entity* _owner;
 };
 
 template<typename T, typename Enable = void>
@@ -112,6 +186,32 @@ struct SyncVar final : ISyncVar
 
     }
 
+    /// <summary>
+    /// Sends the value with fewer bits, see Quantization. Only floats and Vector2s can be quantized. Changes that are
+    /// too small to change the encoded value aren't sent at all.
+    /// </summary>
+    SyncVar(const T& value, SyncVarInterpolation interpolation_, SyncVarUpdateFrequency frequency, const Quantization& quantization_)
+        : ISyncVar(frequency),
+        currentValue(value),
+        interpolation(interpolation_),
+        quantization(quantization_)
+    {
+        static_assert(IsQuantizableSyncVarType<T>, "Only float and Vector2 sync vars can be quantized");
+    }
+
+    ~SyncVar() override
+    {
+        if (_history != nullptr)
+        {
+            for (int i = 0; i < _historyCapacity; ++i)
+            {
+                _history[i].~Snapshot();
+            }
+
+            FreeHistory(_history, sizeof(Snapshot), _historyCapacity);
+        }
+    }
+
     bool CurrentValueChangedFromSequence(uint32_t snapshotId) override
     {
         T value;
@@ -121,6 +221,14 @@ struct SyncVar final : ISyncVar
             return true;
         }
 
+        if constexpr (IsQuantizableSyncVarType<T>)
+        {
+            if (UsesQuantization())
+            {
+                return !quantization.EncodesToSameValue(value, currentValue);
+            }
+        }
+
         return value != currentValue;
     }
 
@@ -142,6 +250,15 @@ struct SyncVar final : ISyncVar
             newValue = currentValue;
         }
 
+        if constexpr (IsQuantizableSyncVarType<T>)
+        {
+            if (UsesQuantization())
+            {
+                WriteQuantizedSyncVar(newValue, quantization, stream);
+                return;
+            }
+        }
+
         if constexpr (DirectlySerializableAsBytes<T>::value)
         {
             WriteBitsToStream(reinterpret_cast<const unsigned char*>(&newValue), sizeof(T), stream);
@@ -166,6 +283,16 @@ struct SyncVar final : ISyncVar
             newValue = currentValue;
         }
 
+        if constexpr (IsQuantizableSyncVarType<T>)
+        {
+            if (UsesQuantization())
+            {
+                ReadQuantizedSyncVar(newValue, quantization, stream);
+                AddValue(newValue, time, toSnapshotId);
+                return;
+            }
+        }
+
         if constexpr (DirectlySerializableAsBytes<T>::value)
         {
             ReadBitsFromStream(reinterpret_cast<unsigned char*>(&newValue), sizeof(T), stream);
@@ -178,6 +305,19 @@ struct SyncVar final : ISyncVar
         AddValue(newValue, time, toSnapshotId);
     }
 
+    void KeepValueFromSnapshot(uint32_t fromSnapshotId, uint32_t toSnapshotId, float time) override
+    {
+        T value;
+        if (!TryGetValueAtSnapshot(fromSnapshotId, value))
+        {
+            value = _historyCount > 0
+                ? SnapshotAt(_historyCount - 1).value
+                : currentValue;
+        }
+
+        AddValue(value, time, toSnapshotId);
+    }
+
     void SetCurrentValueToValueAtTime(float time) override
     {
         auto newValue = GetValueAtTime(time);
@@ -230,91 +370,148 @@ struct SyncVar final : ISyncVar
 
     void AddValue(const T& value, float time, uint32_t snapshotId)
     {
-        if (!snapshots.IsEmpty())
+        if (_historyCount > 0 && time <= SnapshotAt(_historyCount - 1).time)
         {
-            auto& lastSnapshot = *(--snapshots.end());
-            float lastTime = lastSnapshot.time;
+            return;
+        }
 
-            if(time <= lastTime)
-                return;
+        if (_history == nullptr)
+        {
+            AllocateSnapshots();
         }
 
-        if (snapshots.IsFull())
+        if (_historyCount == _historyCapacity)
         {
-            snapshots.Dequeue();
+            _historyStart = (_historyStart + 1) & (_historyCapacity - 1);
+            --_historyCount;
         }
 
-        snapshots.Enqueue({ value, time, snapshotId });
+        SnapshotAt(_historyCount++) = Snapshot(value, time, snapshotId);
     }
 
     bool TryGetValueAtSnapshot(uint32_t snapshotId, T& outValue)
     {
-        for (auto& snapshot : snapshots)
+        int index = FindSnapshotIndex(snapshotId);
+        if (index == -1)
         {
-            if (snapshotId == snapshot.snapshotId)
-            {
-                outValue = snapshot.value;
-                return true;
-            }
+            return false;
         }
 
-        return false;
+        outValue = SnapshotAt(index).value;
+        return true;
     }
 
     T GetValueAtTime(float time)
     {
-        auto it = snapshots.begin();
-
-        auto& last = *(--snapshots.end());
-
-        if (snapshots.IsEmpty())
+        if (_historyCount == 0)
         {
             return currentValue;
         }
 
-        if (time < snapshots.Peek().time)
+        if (time < SnapshotAt(0).time)
         {
-            return snapshots.Peek().value;
+            return SnapshotAt(0).value;
         }
 
-        do
+        // Find the first snapshot after the oldest one that is at or after the given time
+        int low = 1;
+        int high = _historyCount;
+        while (low < high)
         {
-            auto next = it;
-            ++next;
-
-            if (next == snapshots.end())
+            int mid = (low + high) / 2;
+            if (SnapshotAt(mid).time >= time)
+            {
+                high = mid;
+            }
+            else
             {
-                return (*it).value;
+                low = mid + 1;
             }
+        }
+
+        if (low == _historyCount)
+        {
+            return SnapshotAt(_historyCount - 1).value;
+        }
 
-            auto& currentSnapshot = *it;
-            auto& nextSnapshot = *next;
+        auto& currentSnapshot = SnapshotAt(low - 1);
+        auto& nextSnapshot = SnapshotAt(low);
 
-            if (nextSnapshot.time >= time)
+        if (interpolation == SyncVarInterpolation::Linear)
+        {
+            T result;
+            float t = (time - currentSnapshot.time) / (nextSnapshot.time - currentSnapshot.time);
+            if (TryLerp(currentSnapshot.value, nextSnapshot.value, t, result))
             {
-                if (interpolation == SyncVarInterpolation::Linear)
-                {
-                    T result;
-                    float t = (time - currentSnapshot.time) / (nextSnapshot.time - currentSnapshot.time);
-                    if (TryLerp(currentSnapshot.value, nextSnapshot.value, t, result))
-                    {
-                        return result;
-                    }
-                }
-
-                return currentSnapshot.value;
+                return result;
             }
+        }
 
-            it = next;
-        } while (true);
+        return currentSnapshot.value;
     }
 
     T currentValue;
 
-    FixedSizeCircularQueue<Snapshot, 256> snapshots;
     SyncVarInterpolation interpolation;
     SyncVarDeltaMode deltaMode = SyncVarDeltaMode::Full;
+    Quantization quantization;
 
 private:
+    bool UsesQuantization() const
+    {
+        return quantization.IsEnabled() && IsSyncVarQuantizationEnabled();
+    }
+
+    Snapshot& SnapshotAt(int index)
+    {
+        return _history[(_historyStart + index) & (_historyCapacity - 1)];
+    }
+
+    void AllocateSnapshots()
+    {
+        _history = static_cast<Snapshot*>(AllocateHistory(sizeof(Snapshot), _historyCapacity));
+
+        for (int i = 0; i < _historyCapacity; ++i)
+        {
+            new(&_history[i]) Snapshot();
+        }
+    }
+
+    int FindSnapshotIndex(uint32_t snapshotId)
+    {
+        if (_historyCount == 0)
+        {
+            return -1;
+        }
+
+        // Snapshot ids are usually consecutive, in which case the index can be calculated directly
+        uint32_t offset = snapshotId - SnapshotAt(0).snapshotId;
+        if (offset < (uint32_t)_historyCount && SnapshotAt(offset).snapshotId == snapshotId)
+        {
+            return offset;
+        }
+
+        // Otherwise binary search, since ids increase along with time
+        int low = 0;
+        int high = _historyCount - 1;
+        while (low <= high)
+        {
+            int mid = (low + high) / 2;
+            auto midId = SnapshotAt(mid).snapshotId;
+
+            if (midId == snapshotId) return mid;
+            else if (midId < snapshotId) low = mid + 1;
+            else high = mid - 1;
+        }
+
+        return -1;
+    }
+
     bool _wasChanged = false;
+
+    // Ring buffer borrowed from the scene's SyncVarHistoryPool, allocated on first use
+    Snapshot* _history = nullptr;
+    int _historyCapacity = 0;
+    int _historyStart = 0;
+    int _historyCount = 0;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "FlowFieldCache.hpp"
+
+#include "PathFinding.hpp"
+
+std::shared_ptr<FlowField> FlowFieldCache::TryGet(int endCellIndex, uint32_t obstacleVersion)
+{
+    auto it = _entryByCell.find(endCellIndex);
+    if (it == _entryByCell.end())
+    {
+        ++_stats.misses;
+        return nullptr;
+    }
+
+    auto entry = it->second;
+    if (entry->obstacleVersion != obstacleVersion)
+    {
+        // The obstacles changed since the field was calculated, so it may lead through walls
+        ++_stats.invalidations;
+        ++_stats.misses;
+        Remove(entry);
+        return nullptr;
+    }
+
+    ++_stats.hits;
+    _entries.splice(_entries.begin(), _entries, entry);
+
+    return entry->field;
+}
+
+void FlowFieldCache::Add(int endCellIndex, uint32_t obstacleVersion, std::shared_ptr<FlowField> field)
+{
+    auto sizeBytes = FieldSizeBytes(*field);
+    if (sizeBytes > _budgetBytes)
+    {
+        return;
+    }
+
+    auto it = _entryByCell.find(endCellIndex);
+    if (it != _entryByCell.end())
+    {
+        Remove(it->second);
+    }
+
+    _entries.push_front({ endCellIndex, obstacleVersion, std::move(field), sizeBytes });
+    _entryByCell[endCellIndex] = _entries.begin();
+    _bytesHeld += sizeBytes;
+
+    EvictToBudget();
+}
+
+void FlowFieldCache::SetBudgetBytes(size_t budgetBytes)
+{
+    _budgetBytes = budgetBytes;
+    EvictToBudget();
+}
+
+void FlowFieldCache::Clear()
+{
+    _entries.clear();
+    _entryByCell.clear();
+    _bytesHeld = 0;
+}
+
+size_t FlowFieldCache::FieldSizeBytes(const FlowField& field)
+{
+    return sizeof(FlowField)
+        + (size_t)field.grid.Rows() * field.grid.Cols() * sizeof(FlowCell)
+        + field.dynamicCells.capacity() * sizeof(FlowFieldDynamicCell);
+}
+
+void FlowFieldCache::Remove(EntryList::iterator entry)
+{
+    _bytesHeld -= entry->sizeBytes;
+    _entryByCell.erase(entry->endCellIndex);
+    _entries.erase(entry);
+}
+
+void FlowFieldCache::EvictToBudget()
+{
+    while (_bytesHeld > _budgetBytes && !_entries.empty())
+    {
+        ++_stats.evictions;
+        Remove(std::prev(_entries.end()));
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <robin_hood.h>
+
+struct FlowField;
+
+struct FlowFieldCacheStats
+{
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t invalidations = 0;
+    int64_t evictions = 0;
+};
+
+/// <summary>
+/// Least recently used flow fields, keyed by target cell and the version of the obstacle grid they were calculated
+/// from. A field from an older version is never returned. Fields that were handed out stay alive while they're in use,
+/// even after they're evicted.
+/// </summary>
+class FlowFieldCache
+{
+public:
+    /// <summary>
+    /// Returns null if there's no field for the cell from this version of the obstacle grid
+    /// </summary>
+    std::shared_ptr<FlowField> TryGet(int endCellIndex, uint32_t obstacleVersion);
+
+    void Add(int endCellIndex, uint32_t obstacleVersion, std::shared_ptr<FlowField> field);
+
+    void SetBudgetBytes(size_t budgetBytes);
+    void Clear();
+
+    size_t BytesHeld() const { return _bytesHeld; }
+    int TotalFields() const { return (int)_entries.size(); }
+    const FlowFieldCacheStats& GetStats() const { return _stats; }
+
+    static size_t FieldSizeBytes(const FlowField& field);
+
+private:
+    struct Entry
+    {
+        int endCellIndex;
+        uint32_t obstacleVersion;
+        std::shared_ptr<FlowField> field;
+        size_t sizeBytes;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void Remove(EntryList::iterator entry);
+    void EvictToBudget();
+
+    // Most recently used first
+    EntryList _entries;
+    robin_hood::unordered_flat_map<int, EntryList::iterator> _entryByCell;
+
+    size_t _budgetBytes = 0;
+    size_t _bytesHeld = 0;
+    FlowFieldCacheStats _stats;
+};
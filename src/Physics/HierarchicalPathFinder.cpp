@@ -0,0 +1,702 @@
+#include "HierarchicalPathFinder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+#include "PathFinding.hpp"
+
+static constexpr int StartKey = -2;
+static constexpr int EndKey = -1;
+
+HierarchicalPathFinder::HierarchicalPathFinder(int rows, int cols)
+    : _rows(rows),
+      _cols(cols),
+      _clusterRows((rows + ClusterSize - 1) / ClusterSize),
+      _clusterCols((cols + ClusterSize - 1) / ClusterSize)
+{
+    _clusters.resize(_clusterRows * _clusterCols);
+
+    for (int i = 0; i < (int)_clusters.size(); ++i)
+    {
+        _dirtyClusters.push_back(i);
+    }
+}
+
+void HierarchicalPathFinder::MarkCellsChanged(Vector2 min, Vector2 max)
+{
+    int minClusterX = std::max((int)min.x, 0) / ClusterSize;
+    int minClusterY = std::max((int)min.y, 0) / ClusterSize;
+    int maxClusterX = std::min(((int)max.x - 1) / ClusterSize, _clusterCols - 1);
+    int maxClusterY = std::min(((int)max.y - 1) / ClusterSize, _clusterRows - 1);
+
+    for (int y = minClusterY; y <= maxClusterY; ++y)
+    {
+        for (int x = minClusterX; x <= maxClusterX; ++x)
+        {
+            int clusterIndex = y * _clusterCols + x;
+            if (!_clusters[clusterIndex].isDirty)
+            {
+                _clusters[clusterIndex].isDirty = true;
+                _dirtyClusters.push_back(clusterIndex);
+            }
+        }
+    }
+}
+
+void HierarchicalPathFinder::Update(const VariableSizedGrid<ObstacleCell>& obstacles)
+{
+    if (_dirtyClusters.empty())
+    {
+        return;
+    }
+
+    // The portals on the border of a changed cluster are also nodes of its neighbors
+    _clustersToRebuild.clear();
+    for (auto clusterIndex : _dirtyClusters)
+    {
+        int x = clusterIndex % _clusterCols;
+        int y = clusterIndex / _clusterCols;
+
+        _clustersToRebuild.push_back(clusterIndex);
+        if (x > 0) _clustersToRebuild.push_back(clusterIndex - 1);
+        if (x + 1 < _clusterCols) _clustersToRebuild.push_back(clusterIndex + 1);
+        if (y > 0) _clustersToRebuild.push_back(clusterIndex - _clusterCols);
+        if (y + 1 < _clusterRows) _clustersToRebuild.push_back(clusterIndex + _clusterCols);
+    }
+
+    std::sort(_clustersToRebuild.begin(), _clustersToRebuild.end());
+    _clustersToRebuild.erase(std::unique(_clustersToRebuild.begin(), _clustersToRebuild.end()), _clustersToRebuild.end());
+
+    for (auto clusterIndex : _clustersToRebuild)
+    {
+        BuildNodes(obstacles, clusterIndex);
+    }
+
+    for (auto clusterIndex : _clustersToRebuild)
+    {
+        BuildDistances(obstacles, clusterIndex);
+        _clusters[clusterIndex].isDirty = false;
+    }
+
+    _dirtyClusters.clear();
+}
+
+bool HierarchicalPathFinder::FindPath(
+    const VariableSizedGrid<ObstacleCell>& obstacles,
+    Vector2 start,
+    Vector2 end,
+    Scratch& scratch,
+    std::vector<Vector2>& outPath) const
+{
+    if (start.x < 0 || start.x >= _cols || start.y < 0 || start.y >= _rows
+        || end.x < 0 || end.x >= _cols || end.y < 0 || end.y >= _rows)
+    {
+        return false;
+    }
+
+    int startCell = (int)start.y * _cols + (int)start.x;
+    int endCell = (int)end.y * _cols + (int)end.x;
+
+    if (startCell == endCell)
+    {
+        return true;
+    }
+
+    int startCluster = ClusterIndexOfCell(startCell);
+    int endCluster = ClusterIndexOfCell(endCell);
+
+    // Short hops within a cluster don't need the abstract graph
+    if (startCluster == endCluster)
+    {
+        SearchCluster(obstacles, startCluster, startCell, startCell, endCell, scratch);
+
+        if (DistanceInCluster(startCluster, endCell, scratch) >= 0)
+        {
+            return AppendClusterPath(startCluster, startCell, endCell, scratch, outPath);
+        }
+    }
+
+    // The start and end are connected to the portals of their clusters for this request only
+    scratch.startSeeds.clear();
+    scratch.endSeeds.clear();
+    scratch.seedNodeCosts.clear();
+    AddSeeds(obstacles, startCell, startCell, endCell, true, scratch.startSeeds);
+    AddSeeds(obstacles, endCell, startCell, endCell, false, scratch.endSeeds);
+
+    int directCost = -1;
+    int directStartSeed = -1;
+    int directEndSeed = -1;
+
+    for (auto* seeds : { &scratch.startSeeds, &scratch.endSeeds })
+    {
+        for (int i = 0; i < (int)seeds->size(); ++i)
+        {
+            auto& seed = (*seeds)[i];
+            auto& nodes = _clusters[seed.cluster].nodes;
+
+            // Moves are symmetric, so the distance from the end to a portal is also the distance back
+            SearchCluster(obstacles, seed.cluster, seed.cell, startCell, endCell, scratch);
+
+            seed.firstNodeCost = scratch.seedNodeCosts.size();
+            for (auto& node : nodes)
+            {
+                int distance = DistanceInCluster(seed.cluster, node.cell, scratch);
+                scratch.seedNodeCosts.push_back(distance >= 0 ? seed.cost + distance : -1);
+            }
+
+            if (seeds != &scratch.startSeeds)
+            {
+                continue;
+            }
+
+            for (int j = 0; j < (int)scratch.endSeeds.size(); ++j)
+            {
+                auto& endSeed = scratch.endSeeds[j];
+                int distance = endSeed.cluster == seed.cluster
+                    ? DistanceInCluster(seed.cluster, endSeed.cell, scratch)
+                    : -1;
+
+                if (distance >= 0 && (directCost == -1 || seed.cost + distance + endSeed.cost < directCost))
+                {
+                    directCost = seed.cost + distance + endSeed.cost;
+                    directStartSeed = i;
+                    directEndSeed = j;
+                }
+            }
+        }
+    }
+
+    int endX = (int)end.x;
+    int endY = (int)end.y;
+    auto heuristic = [=](int cell)
+    {
+        return std::abs(cell % _cols - endX) + std::abs(cell / _cols - endY);
+    };
+
+    auto& searchNodes = scratch.searchNodes;
+    auto& open = scratch.open;
+    searchNodes.clear();
+    open.clear();
+
+    auto visit = [&](int key, int parentKey, int g, int cluster, int nodeIndex, int h)
+    {
+        auto it = searchNodes.find(key);
+        if (it != searchNodes.end() && (it->second.closed || it->second.g <= g))
+        {
+            return;
+        }
+
+        searchNodes[key] = { g, parentKey, cluster, nodeIndex, false };
+        open.emplace_back(g + h, key);
+        std::push_heap(open.begin(), open.end(), std::greater<>());
+    };
+
+    searchNodes[StartKey] = { 0, StartKey, startCluster, -1, false };
+    open.emplace_back(0, StartKey);
+
+    if (directCost >= 0)
+    {
+        visit(EndKey, StartKey, directCost, endCluster, -1, 0);
+    }
+
+    bool foundPath = false;
+
+    while (!open.empty())
+    {
+        std::pop_heap(open.begin(), open.end(), std::greater<>());
+        int key = open.back().second;
+        open.pop_back();
+
+        auto current = searchNodes[key];
+        if (current.closed)
+        {
+            continue;
+        }
+
+        searchNodes[key].closed = true;
+
+        if (key == EndKey)
+        {
+            foundPath = true;
+            break;
+        }
+
+        if (key == StartKey)
+        {
+            for (auto& seed : scratch.startSeeds)
+            {
+                auto& nodes = _clusters[seed.cluster].nodes;
+                for (int i = 0; i < (int)nodes.size(); ++i)
+                {
+                    int cost = scratch.seedNodeCosts[seed.firstNodeCost + i];
+                    if (cost >= 0)
+                    {
+                        visit(nodes[i].cell, StartKey, cost, seed.cluster, i, heuristic(nodes[i].cell));
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        auto& cluster = _clusters[current.cluster];
+        auto& node = cluster.nodes[current.nodeIndex];
+        int totalNodes = cluster.nodes.size();
+
+        for (int i = 0; i < totalNodes; ++i)
+        {
+            int distance = cluster.distances[current.nodeIndex * totalNodes + i];
+            if (i != current.nodeIndex && distance >= 0)
+            {
+                visit(cluster.nodes[i].cell, key, current.g + distance, current.cluster, i, heuristic(cluster.nodes[i].cell));
+            }
+        }
+
+        for (auto exitCell : node.exits)
+        {
+            int exitCluster = ClusterIndexOfCell(exitCell);
+            auto& exitNodes = _clusters[exitCluster].nodes;
+
+            for (int i = 0; i < (int)exitNodes.size(); ++i)
+            {
+                if (exitNodes[i].cell == exitCell)
+                {
+                    visit(exitCell, key, current.g + 1, exitCluster, i, heuristic(exitCell));
+                    break;
+                }
+            }
+        }
+
+        for (auto& seed : scratch.endSeeds)
+        {
+            int cost = seed.cluster == current.cluster
+                ? scratch.seedNodeCosts[seed.firstNodeCost + current.nodeIndex]
+                : -1;
+
+            if (cost >= 0)
+            {
+                visit(EndKey, key, current.g + cost, seed.cluster, -1, 0);
+            }
+        }
+    }
+
+    if (!foundPath)
+    {
+        return false;
+    }
+
+    auto& abstractPath = scratch.abstractPath;
+    abstractPath.clear();
+    for (int key = EndKey; key != StartKey; key = searchNodes[key].parentKey)
+    {
+        abstractPath.push_back(key);
+    }
+
+    abstractPath.push_back(StartKey);
+    std::reverse(abstractPath.begin(), abstractPath.end());
+
+    // Picks the seed in the given cluster that is closest to a portal, or to the other end for a direct path
+    auto closestSeed = [&](const std::vector<Scratch::Seed>& seeds, int cluster, int nodeIndex)
+    {
+        int best = -1;
+        for (int i = 0; i < (int)seeds.size(); ++i)
+        {
+            int cost = seeds[i].cluster == cluster ? scratch.seedNodeCosts[seeds[i].firstNodeCost + nodeIndex] : -1;
+            if (cost >= 0 && (best == -1 || cost < scratch.seedNodeCosts[seeds[best].firstNodeCost + nodeIndex]))
+            {
+                best = i;
+            }
+        }
+
+        return best;
+    };
+
+    // Refine each step into cells. Steps between portals of different clusters are a single move.
+    for (int i = 0; i + 1 < (int)abstractPath.size(); ++i)
+    {
+        int fromKey = abstractPath[i];
+        int toKey = abstractPath[i + 1];
+        int from;
+        int to;
+        const Scratch::Seed* endSeed = nullptr;
+
+        if (fromKey == StartKey)
+        {
+            const Scratch::Seed* startSeed;
+            if (toKey == EndKey)
+            {
+                startSeed = &scratch.startSeeds[directStartSeed];
+                endSeed = &scratch.endSeeds[directEndSeed];
+                to = endSeed->cell;
+            }
+            else
+            {
+                auto& toNode = searchNodes[toKey];
+                startSeed = &scratch.startSeeds[closestSeed(scratch.startSeeds, toNode.cluster, toNode.nodeIndex)];
+                to = toKey;
+            }
+
+            // A start in an obstacle may have to step into the next cluster first
+            from = startSeed->cell;
+            if (from != startCell)
+            {
+                outPath.push_back(Vector2(from % _cols, from / _cols));
+            }
+        }
+        else
+        {
+            from = fromKey;
+
+            if (toKey == EndKey)
+            {
+                auto& fromNode = searchNodes[fromKey];
+                endSeed = &scratch.endSeeds[closestSeed(scratch.endSeeds, fromNode.cluster, fromNode.nodeIndex)];
+                to = endSeed->cell;
+            }
+            else
+            {
+                to = toKey;
+            }
+        }
+
+        int fromCluster = ClusterIndexOfCell(from);
+        if (fromCluster != ClusterIndexOfCell(to))
+        {
+            outPath.push_back(Vector2(to % _cols, to / _cols));
+        }
+        else
+        {
+            SearchCluster(obstacles, fromCluster, from, startCell, endCell, scratch);
+            if (!AppendClusterPath(fromCluster, from, to, scratch, outPath))
+            {
+                return false;
+            }
+        }
+
+        if (endSeed != nullptr && endSeed->cell != endCell)
+        {
+            outPath.push_back(end);
+        }
+    }
+
+    return true;
+}
+
+void HierarchicalPathFinder::AddSeeds(
+    const VariableSizedGrid<ObstacleCell>& obstacles,
+    int cell,
+    int startCell,
+    int endCell,
+    bool isStart,
+    std::vector<Scratch::Seed>& outSeeds) const
+{
+    outSeeds.push_back({ cell, ClusterIndexOfCell(cell), 0, 0 });
+
+    // An open cell on a cluster border is covered by the portals of that border, but a cell in an obstacle isn't
+    if (obstacles[Vector2(cell % _cols, cell / _cols)].count == 0)
+    {
+        return;
+    }
+
+    int x = cell % _cols;
+    int y = cell / _cols;
+    const int offsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+    for (auto& offset : offsets)
+    {
+        int neighborX = x + offset[0];
+        int neighborY = y + offset[1];
+
+        if (neighborX < 0 || neighborX >= _cols || neighborY < 0 || neighborY >= _rows)
+        {
+            continue;
+        }
+
+        int neighbor = neighborY * _cols + neighborX;
+        int neighborCluster = ClusterIndexOfCell(neighbor);
+
+        // Paths can't pass through an occupied cell, so a cell next to the end must be open to be stepped from
+        bool canMove = isStart
+            ? CanMove(obstacles, cell, neighbor, startCell, endCell)
+            : CanMove(obstacles, neighbor, cell, startCell, endCell)
+                && (obstacles[Vector2(neighborX, neighborY)].count == 0 || neighbor == startCell);
+
+        if (neighborCluster != outSeeds[0].cluster && canMove)
+        {
+            outSeeds.push_back({ neighbor, neighborCluster, 1, 0 });
+        }
+    }
+}
+
+size_t HierarchicalPathFinder::MemoryUsageBytes() const
+{
+    size_t total = sizeof(*this) + _clusters.capacity() * sizeof(Cluster);
+
+    for (auto& cluster : _clusters)
+    {
+        total += cluster.nodes.capacity() * sizeof(PortalNode) + cluster.distances.capacity() * sizeof(int);
+
+        for (auto& node : cluster.nodes)
+        {
+            total += node.exits.capacity() * sizeof(int);
+        }
+    }
+
+    return total;
+}
+
+int HierarchicalPathFinder::ClusterIndexOfCell(int cell) const
+{
+    return (cell / _cols / ClusterSize) * _clusterCols + (cell % _cols) / ClusterSize;
+}
+
+void HierarchicalPathFinder::GetClusterBounds(int clusterIndex, int& outMinX, int& outMinY, int& outMaxX, int& outMaxY) const
+{
+    outMinX = (clusterIndex % _clusterCols) * ClusterSize;
+    outMinY = (clusterIndex / _clusterCols) * ClusterSize;
+    outMaxX = std::min(outMinX + ClusterSize, _cols);
+    outMaxY = std::min(outMinY + ClusterSize, _rows);
+}
+
+void HierarchicalPathFinder::BuildNodes(const VariableSizedGrid<ObstacleCell>& obstacles, int clusterIndex)
+{
+    auto& cluster = _clusters[clusterIndex];
+    cluster.nodes.clear();
+
+    int minX, minY, maxX, maxY;
+    GetClusterBounds(clusterIndex, minX, minY, maxX, maxY);
+
+    struct Border
+    {
+        int dx, dy;
+    };
+
+    const Border borders[] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+    for (auto border : borders)
+    {
+        // Walk along the border in increasing x or y, so that the cluster on the other side picks the same portals
+        int x = border.dx > 0 ? maxX - 1 : minX;
+        int y = border.dy > 0 ? maxY - 1 : minY;
+        int stepX = border.dx != 0 ? 0 : 1;
+        int stepY = border.dy != 0 ? 0 : 1;
+        int length = border.dx != 0 ? maxY - minY : maxX - minX;
+
+        int outsideX = x + border.dx;
+        int outsideY = y + border.dy;
+        if (outsideX < 0 || outsideX >= _cols || outsideY < 0 || outsideY >= _rows)
+        {
+            continue;
+        }
+
+        int runStart = -1;
+
+        for (int i = 0; i <= length; ++i)
+        {
+            bool isOpen = false;
+            int insideCell = (y + stepY * i) * _cols + x + stepX * i;
+            int outsideCell = (outsideY + stepY * i) * _cols + outsideX + stepX * i;
+
+            if (i < length)
+            {
+                isOpen = CanMove(obstacles, insideCell, outsideCell, -1, -1)
+                    && CanMove(obstacles, outsideCell, insideCell, -1, -1);
+            }
+
+            // A run must be connected along both sides of the border, so that any crossing in it can be swapped for
+            // the run's portal
+            bool continuesRun = runStart != -1
+                && isOpen
+                && CanMove(obstacles, insideCell - stepY * _cols - stepX, insideCell, -1, -1)
+                && CanMove(obstacles, insideCell, insideCell - stepY * _cols - stepX, -1, -1)
+                && CanMove(obstacles, outsideCell - stepY * _cols - stepX, outsideCell, -1, -1)
+                && CanMove(obstacles, outsideCell, outsideCell - stepY * _cols - stepX, -1, -1);
+
+            if (runStart != -1 && !continuesRun)
+            {
+                int runEnd = i - 1;
+                auto addPortalAt = [&](int index)
+                {
+                    AddPortal(
+                        cluster,
+                        (y + stepY * index) * _cols + x + stepX * index,
+                        (outsideY + stepY * index) * _cols + outsideX + stepX * index);
+                };
+
+                if (runEnd - runStart + 1 <= MaxSinglePortalEntranceLength)
+                {
+                    addPortalAt((runStart + runEnd) / 2);
+                }
+                else
+                {
+                    // Wide openings get a portal at each end so that paths don't all funnel through the middle
+                    addPortalAt(runStart);
+                    addPortalAt(runEnd);
+                }
+
+                runStart = -1;
+            }
+
+            if (isOpen && runStart == -1)
+            {
+                runStart = i;
+            }
+        }
+    }
+}
+
+void HierarchicalPathFinder::BuildDistances(const VariableSizedGrid<ObstacleCell>& obstacles, int clusterIndex)
+{
+    auto& cluster = _clusters[clusterIndex];
+    int totalNodes = cluster.nodes.size();
+
+    cluster.distances.assign(totalNodes * totalNodes, -1);
+
+    for (int i = 0; i < totalNodes; ++i)
+    {
+        SearchCluster(obstacles, clusterIndex, cluster.nodes[i].cell, -1, -1, _updateScratch);
+
+        for (int j = 0; j < totalNodes; ++j)
+        {
+            cluster.distances[i * totalNodes + j] = DistanceInCluster(clusterIndex, cluster.nodes[j].cell, _updateScratch);
+        }
+    }
+}
+
+void HierarchicalPathFinder::AddPortal(Cluster& cluster, int insideCell, int outsideCell)
+{
+    // A corner cell can be a portal to two clusters
+    for (auto& node : cluster.nodes)
+    {
+        if (node.cell == insideCell)
+        {
+            node.exits.push_back(outsideCell);
+            return;
+        }
+    }
+
+    cluster.nodes.push_back({ insideCell, { outsideCell } });
+}
+
+void HierarchicalPathFinder::SearchCluster(
+    const VariableSizedGrid<ObstacleCell>& obstacles,
+    int clusterIndex,
+    int fromCell,
+    int exceptionA,
+    int exceptionB,
+    Scratch& scratch) const
+{
+    int minX, minY, maxX, maxY;
+    GetClusterBounds(clusterIndex, minX, minY, maxX, maxY);
+
+    scratch.distance.assign(ClusterSize * ClusterSize, -1);
+    scratch.parent.resize(ClusterSize * ClusterSize);
+    scratch.queue.clear();
+
+    auto localIndex = [=](int cell)
+    {
+        return (cell / _cols - minY) * ClusterSize + cell % _cols - minX;
+    };
+
+    scratch.distance[localIndex(fromCell)] = 0;
+    scratch.parent[localIndex(fromCell)] = fromCell;
+    scratch.queue.push_back(fromCell);
+
+    for (int i = 0; i < (int)scratch.queue.size(); ++i)
+    {
+        int cell = scratch.queue[i];
+        int x = cell % _cols;
+        int y = cell / _cols;
+        int distance = scratch.distance[localIndex(cell)];
+
+        const int offsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+        for (auto& offset : offsets)
+        {
+            int nextX = x + offset[0];
+            int nextY = y + offset[1];
+
+            if (nextX < minX || nextX >= maxX || nextY < minY || nextY >= maxY)
+            {
+                continue;
+            }
+
+            int nextCell = nextY * _cols + nextX;
+            int nextIndex = localIndex(nextCell);
+
+            if (scratch.distance[nextIndex] != -1 || !CanMove(obstacles, cell, nextCell, exceptionA, exceptionB))
+            {
+                continue;
+            }
+
+            scratch.distance[nextIndex] = distance + 1;
+            scratch.parent[nextIndex] = cell;
+            scratch.queue.push_back(nextCell);
+        }
+    }
+}
+
+int HierarchicalPathFinder::DistanceInCluster(int clusterIndex, int cell, const Scratch& scratch) const
+{
+    int minX, minY, maxX, maxY;
+    GetClusterBounds(clusterIndex, minX, minY, maxX, maxY);
+
+    return scratch.distance[(cell / _cols - minY) * ClusterSize + cell % _cols - minX];
+}
+
+bool HierarchicalPathFinder::AppendClusterPath(int clusterIndex, int fromCell, int toCell, Scratch& scratch, std::vector<Vector2>& outPath) const
+{
+    if (DistanceInCluster(clusterIndex, toCell, scratch) < 0)
+    {
+        return false;
+    }
+
+    int minX, minY, maxX, maxY;
+    GetClusterBounds(clusterIndex, minX, minY, maxX, maxY);
+
+    scratch.segment.clear();
+    for (int cell = toCell; cell != fromCell; cell = scratch.parent[(cell / _cols - minY) * ClusterSize + cell % _cols - minX])
+    {
+        scratch.segment.push_back(cell);
+    }
+
+    for (int i = (int)scratch.segment.size() - 1; i >= 0; --i)
+    {
+        int cell = scratch.segment[i];
+        outPath.push_back(Vector2(cell % _cols, cell / _cols));
+    }
+
+    return true;
+}
+
+bool HierarchicalPathFinder::CanMove(
+    const VariableSizedGrid<ObstacleCell>& obstacles,
+    int fromCell,
+    int toCell,
+    int exceptionA,
+    int exceptionB) const
+{
+    auto& from = obstacles[Vector2(fromCell % _cols, fromCell / _cols)];
+    auto& to = obstacles[Vector2(toCell % _cols, toCell / _cols)];
+
+    int dx = toCell % _cols - fromCell % _cols;
+    int dy = toCell / _cols - fromCell / _cols;
+
+    ObstacleEdgeFlags fromEdge = dx > 0 ? ObstacleEdgeFlags::EastBlocked
+        : dx < 0 ? ObstacleEdgeFlags::WestBlocked
+        : dy > 0 ? ObstacleEdgeFlags::SouthBlocked
+        : ObstacleEdgeFlags::NorthBlocked;
+
+    ObstacleEdgeFlags toEdge = dx > 0 ? ObstacleEdgeFlags::WestBlocked
+        : dx < 0 ? ObstacleEdgeFlags::EastBlocked
+        : dy > 0 ? ObstacleEdgeFlags::NorthBlocked
+        : ObstacleEdgeFlags::SouthBlocked;
+
+    if (from.flags.HasFlag(fromEdge) || to.flags.HasFlag(toEdge))
+    {
+        return false;
+    }
+
+    return to.count == 0 || toCell == exceptionA || toCell == exceptionB;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <robin_hood.h>
+
+#include "Math/Vector2.hpp"
+#include "Container/Grid.hpp"
+
+struct ObstacleCell;
+
+/// <summary>
+/// Hierarchical pathfinding (HPA*). The grid is divided into square clusters. The open cells where two clusters meet
+/// become portals in an abstract graph, which also stores the distances between the portals of each cluster. A request
+/// runs A* over the portals and then refines the result into cells one cluster at a time. The cost of a request
+/// therefore grows with the length of the path rather than with the size of the map.
+///
+/// Only static obstacles are taken into account, so unlike flow fields the paths don't avoid other path followers.
+/// </summary>
+class HierarchicalPathFinder
+{
+public:
+    static constexpr int ClusterSize = 16;
+
+    /// <summary>
+    /// Working memory for FindPath(). Reused between requests, and each thread needs its own.
+    /// </summary>
+    struct Scratch
+    {
+        // The start or end of a request, or a cell next to it in another cluster if it's inside an obstacle
+        struct Seed
+        {
+            int cell;
+            int cluster;
+            int cost;
+            int firstNodeCost;      // Index of the costs to the cluster's portals in seedNodeCosts
+        };
+
+        struct SearchNode
+        {
+            int g;
+            int parentKey;
+            int cluster;
+            int nodeIndex;
+            bool closed;
+        };
+
+        std::vector<int> distance;
+        std::vector<int> parent;
+        std::vector<int> queue;
+
+        robin_hood::unordered_flat_map<int, SearchNode> searchNodes;
+        std::vector<std::pair<int, int>> open;
+        std::vector<Seed> startSeeds;
+        std::vector<Seed> endSeeds;
+        std::vector<int> seedNodeCosts;
+        std::vector<int> abstractPath;
+        std::vector<int> segment;
+    };
+
+    HierarchicalPathFinder(int rows, int cols);
+
+    /// <summary>
+    /// Marks the clusters that overlap the cells in [min, max) as changed. They are rebuilt by the next Update().
+    /// </summary>
+    void MarkCellsChanged(Vector2 min, Vector2 max);
+
+    /// <summary>
+    /// Rebuilds the portals and distances of the changed clusters. Must not run at the same time as FindPath().
+    /// </summary>
+    void Update(const VariableSizedGrid<ObstacleCell>& obstacles);
+
+    /// <summary>
+    /// Appends the cells after start, up to and including end. Returns false if end can't be reached. Can be called
+    /// from several threads at once, each with its own scratch.
+    /// </summary>
+    bool FindPath(
+        const VariableSizedGrid<ObstacleCell>& obstacles,
+        Vector2 start,
+        Vector2 end,
+        Scratch& scratch,
+        std::vector<Vector2>& outPath) const;
+
+    size_t MemoryUsageBytes() const;
+
+private:
+    static constexpr int MaxSinglePortalEntranceLength = 6;
+
+    struct PortalNode
+    {
+        int cell;
+        std::vector<int> exits;     // Cells in neighboring clusters that can be stepped to from this one
+    };
+
+    struct Cluster
+    {
+        std::vector<PortalNode> nodes;
+        std::vector<int> distances;     // nodes x nodes, -1 if unreachable
+        bool isDirty = true;
+    };
+
+    int ClusterIndexOfCell(int cell) const;
+    void GetClusterBounds(int clusterIndex, int& outMinX, int& outMinY, int& outMaxX, int& outMaxY) const;
+
+    void BuildNodes(const VariableSizedGrid<ObstacleCell>& obstacles, int clusterIndex);
+    void BuildDistances(const VariableSizedGrid<ObstacleCell>& obstacles, int clusterIndex);
+    void AddPortal(Cluster& cluster, int insideCell, int outsideCell);
+
+    /// <summary>
+    /// Breadth-first search from a cell that doesn't leave its cluster. The two exception cells count as open even if
+    /// they're occupied, like the start and end of a request.
+    /// </summary>
+    void SearchCluster(
+        const VariableSizedGrid<ObstacleCell>& obstacles,
+        int clusterIndex,
+        int fromCell,
+        int exceptionA,
+        int exceptionB,
+        Scratch& scratch) const;
+
+    void AddSeeds(
+        const VariableSizedGrid<ObstacleCell>& obstacles,
+        int cell,
+        int startCell,
+        int endCell,
+        bool isStart,
+        std::vector<Scratch::Seed>& outSeeds) const;
+
+    int DistanceInCluster(int clusterIndex, int cell, const Scratch& scratch) const;
+    bool AppendClusterPath(int clusterIndex, int fromCell, int toCell, Scratch& scratch, std::vector<Vector2>& outPath) const;
+
+    bool CanMove(const VariableSizedGrid<ObstacleCell>& obstacles, int fromCell, int toCell, int exceptionA, int exceptionB) const;
+
+    int _rows;
+    int _cols;
+    int _clusterRows;
+    int _clusterCols;
+
+    std::vector<Cluster> _clusters;
+    std::vector<int> _dirtyClusters;
+    std::vector<int> _clustersToRebuild;
+    Scratch _updateScratch;
+};
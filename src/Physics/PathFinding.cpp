@@ -1,9 +1,49 @@
 #include "PathFinding.hpp"
+#include <algorithm>
+#include <functional>
+#include "Engine.hpp"
 #include "Renderer.hpp"
 #include "Components/PathFollowerComponent.hpp"
+#include "Net/ServerGame.hpp"
+#include "System/WorkerPool.hpp"
+#include "Tools/Console.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "Tools/Profiler.hpp"
+
+// Hierarchical paths only avoid static obstacles, so crowds moving to the same cell still use a flow field
+static ConsoleVar<bool> g_hierarchicalPaths("path-hierarchical", false);
+static ConsoleVar<int> g_pathCrowdSize("path-crowd-size", 8);
+static ConsoleVar<int> g_pathCacheBudgetMb("path-cache-budget-mb", 64);
+
+// Of the neighbors that are equally close to the target, a flow field points at the first one in this order. This
+// makes the directions independent of the order cells were visited in, so a repaired field matches a fresh one.
+static const Vector2 FlowDirections[] =
+{
+    Vector2(0, 1),
+    Vector2(0, -1),
+    Vector2(1, 0),
+    Vector2(-1, 0)
+};
+
+static int GetDirectionPriority(Vector2 dir)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        if (FlowDirections[i] == dir) return i;
+    }
+
+    return 4;
+}
+
+static bool IsInGrid(const VariableSizedGrid<FlowCell>& grid, Vector2 cell)
+{
+    return cell.x >= 0 && cell.x < grid.Cols() && cell.y >= 0 && cell.y < grid.Rows();
+}
 
 PathFinderService::PathFinderService(int rows, int cols)
-    : _obstacleGrid(rows, cols)
+    : _obstacleGrid(rows, cols),
+    _obstacleSnapshot(rows, cols),
+    _hierarchicalPathFinder(rows, cols)
 {
     _obstacleGrid.FillWithZero();
 }
@@ -32,6 +72,9 @@ void PathFinderService::AddObstacle(const Rectangle& bounds)
             ++_obstacleGrid[i][j].count;
         }
     }
+
+    _hierarchicalPathFinder.MarkCellsChanged(topLeft, bottomRight);
+    ++_obstacleVersion;
 }
 
 void PathFinderService::RequestFlowField(Vector2 start, Vector2 end, Entity* owner)
@@ -65,13 +108,18 @@ void PathFinderService::RequestFlowField(Vector2 start, Vector2 end, Entity* own
         request.end = request.endCell;
     }
 
-    _requestQueue.push(request);
+    // Only the most recent request from an entity is delivered
+    request.id = _nextRequestId++;
+    _latestRequestIdByOwner[owner] = request.id;
+
+    _requestQueue.push_back(request);
 }
 
 void PathFinderService::ReceiveEvent(const IEntityEvent& ev)
 {
     if(ev.Is<UpdateEvent>())
     {
+        PROFILE_ZONE("CalculatePaths");
         CalculatePaths();
     }
     else if(auto renderEvent = ev.Is<RenderEvent>())
@@ -82,83 +130,596 @@ void PathFinderService::ReceiveEvent(const IEntityEvent& ev)
 
 void PathFinderService::CalculatePaths()
 {
-    int calculationCount = 0;
+    if (_requestQueue.empty())
+    {
+        return;
+    }
+
+    auto workerPool = scene->GetEngine()->GetWorkerPool();
+    int totalThreads = workerPool != nullptr ? workerPool->TotalThreads() : 1;
+    int calculationsPerField = _obstacleGrid.Rows() * _obstacleGrid.Cols() * 4;
+    int maxJobs = Max(totalThreads, totalThreads * MaxGridCalculationsPerTick / Max(calculationsPerField, 1));
+
+    UpdateFollowerCells();
+
+    int totalJobs = GroupRequestsIntoJobs(maxJobs);
+    if (totalJobs == 0)
+    {
+        return;
+    }
+
+    if (g_hierarchicalPaths.Value())
+    {
+        PROFILE_ZONE("UpdateHierarchicalPathFinder");
+        _hierarchicalPathFinder.Update(_obstacleGrid);
+
+        for (int i = 0; i < totalJobs; ++i)
+        {
+            _jobs[i].useFlowField = (int)_jobs[i].requests.size() >= g_pathCrowdSize.Value();
+        }
+    }
 
-    while(calculationCount < MaxGridCalculationsPerTick)
+    _flowFieldCache.SetBudgetBytes((size_t)Max(g_pathCacheBudgetMb.Value(), 0) * 1024 * 1024);
+
+    bool anyFlowFields = false;
+    for (int i = 0; i < totalJobs; ++i)
     {
-        if(_requestQueue.empty())
+        auto& job = _jobs[i];
+        if (job.useFlowField)
         {
-            return;
+            TryUseCachedFlowField(job);
+            anyFlowFields = true;
         }
+    }
+
+    if (anyFlowFields)
+    {
+        BuildObstacleSnapshot();
+    }
 
-        auto& request = _requestQueue.front();
+    // The game thread is blocked until every job is done, so the obstacles can't change underneath the workers
+    auto calculateJob = [=](int jobId)
+    {
+        auto& job = _jobs[jobId];
 
+        if (job.isCached)
+        {
+            PROFILE_ZONE("RepairFlowField");
+            if (!RepairFlowField(job))
+            {
+                CalculateFlowField(job);
+            }
+        }
+        else if (job.useFlowField)
+        {
+            PROFILE_ZONE("CalculateFlowField");
+            CalculateFlowField(job);
+        }
+        else
+        {
+            PROFILE_ZONE("CalculateHierarchicalPaths");
+            CalculateHierarchicalPaths(job);
+        }
+    };
+
+    if (workerPool != nullptr)
+    {
+        workerPool->ParallelFor(totalJobs, calculateJob);
+    }
+    else
+    {
+        for (int i = 0; i < totalJobs; ++i)
+        {
+            calculateJob(i);
+        }
+    }
+
+    for (int i = 0; i < totalJobs; ++i)
+    {
+        auto& job = _jobs[i];
+
+        if (job.useFlowField)
+        {
+            _flowFieldCache.Add(GetCellIndex(job.endCell), _obstacleVersion, job.result);
+        }
+
+        for (int j = 0; j < (int)job.requests.size(); ++j)
+        {
+            auto& request = job.requests[j];
+            Entity* owner;
+            if (!request.owner.TryGetValue(owner))
+            {
+                continue;
+            }
+
+            auto latestRequest = _latestRequestIdByOwner.find(owner);
+            if (latestRequest == _latestRequestIdByOwner.end() || latestRequest->second != request.id)
+            {
+                continue;
+            }
+
+            _latestRequestIdByOwner.erase(latestRequest);
+
+            if (job.useFlowField)
+            {
+                owner->SendEvent(FlowFieldReadyEvent(job.result, request.startCell, request.end));
+            }
+            else
+            {
+                owner->SendEvent(FlowFieldReadyEvent(job.paths[j], request.startCell, request.end));
+            }
+        }
+
+        job.result = nullptr;
+    }
+}
+
+void PathFinderService::UpdateFollowerCells()
+{
+    _followerCellByOwner.clear();
+    _followerCells.clear();
+    for (auto pathFollower : pathFollowers)
+    {
+        auto cell = GetFollowerCell(pathFollower->owner);
+        _followerCellByOwner[pathFollower->owner] = cell;
+        _followerCells.push_back(GetCellIndex(cell));
+    }
+}
+
+void PathFinderService::BuildObstacleSnapshot()
+{
+    // Static obstacles rarely change, so the grid is only copied when they did. Otherwise only the path followers,
+    // which move every tick, are taken out of the snapshot and put back where they are now.
+    if (!_hasObstacleSnapshot || _snapshotObstacleVersion != _obstacleVersion)
+    {
+        for (int i = 0; i < _obstacleGrid.Rows(); ++i)
+        {
+            for (int j = 0; j < _obstacleGrid.Cols(); ++j)
+            {
+                _obstacleSnapshot[i][j] = _obstacleGrid[i][j];
+            }
+        }
+
+        _hasObstacleSnapshot = true;
+        _snapshotObstacleVersion = _obstacleVersion;
+    }
+    else
+    {
+        for (auto index : _snapshotFollowerCells)
+        {
+            --_obstacleSnapshot[GetCellFromIndex(index)].count;
+        }
+    }
+
+    // Other path followers are treated as obstacles
+    _snapshotFollowerCells.clear();
+    for (auto& followerCell : _followerCellByOwner)
+    {
+        ++_obstacleSnapshot[followerCell.second].count;
+        _snapshotFollowerCells.push_back(GetCellIndex(followerCell.second));
+    }
+}
+
+void PathFinderService::TryUseCachedFlowField(FlowFieldJob& job)
+{
+    auto field = _flowFieldCache.TryGet(GetCellIndex(job.endCell), _obstacleVersion);
+    if (field == nullptr)
+    {
+        return;
+    }
+
+    // The field was calculated for other requesters, with the path followers where they were at the time, so it's
+    // repaired before use. Followers may still be using it, so a field that needs repairs is copied first.
+    job.result = field;
+    job.isCached = true;
+}
+
+int PathFinderService::GroupRequestsIntoJobs(int maxJobs)
+{
+    int totalJobs = 0;
+    _deferredRequests.clear();
+
+    for (auto& request : _requestQueue)
+    {
         Entity* owner;
-        if(!request.owner.TryGetValue(owner))
+        if (!request.owner.TryGetValue(owner))
+        {
+            continue;
+        }
+
+        auto latestRequest = _latestRequestIdByOwner.find(owner);
+        if (latestRequest == _latestRequestIdByOwner.end() || latestRequest->second != request.id)
         {
-            _requestQueue.pop();
+            // Superseded by a newer request from the same entity
             continue;
         }
 
+        FlowFieldJob* job = nullptr;
+        for (int i = 0; i < totalJobs; ++i)
         {
-            for (auto pathFollower : pathFollowers)
+            if (_jobs[i].endCell == request.endCell)
             {
-                if (pathFollower->owner == owner) continue;
-                ++_obstacleGrid[scene->isometricSettings.ScreenToIntegerTile(pathFollower->owner->Center())].count;
+                job = &_jobs[i];
+                break;
             }
         }
 
-        if(request.status == PathRequestStatus::NotStarted)
+        if (job == nullptr)
+        {
+            if (totalJobs == maxJobs)
+            {
+                _deferredRequests.push_back(request);
+                continue;
+            }
+
+            if (totalJobs == (int)_jobs.size())
+            {
+                _jobs.emplace_back();
+            }
+
+            job = &_jobs[totalJobs++];
+            job->Reset(request.endCell);
+        }
+
+        job->requests.push_back(request);
+        job->requesterStartCells.insert(GetCellIndex(request.startCell));
+
+        auto followerCell = _followerCellByOwner.find(owner);
+        if (followerCell != _followerCellByOwner.end())
+        {
+            ++job->requesterOccupancy[GetCellIndex(followerCell->second)];
+        }
+    }
+
+    std::swap(_requestQueue, _deferredRequests);
+
+    return totalJobs;
+}
+
+void PathFinderService::CalculateFlowField(FlowFieldJob& job)
+{
+    job.result = std::make_shared<FlowField>(_obstacleSnapshot.Rows(), _obstacleSnapshot.Cols(), job.endCell);
+    job.result->pathFinder = this;
+
+    job.workQueue.clear();
+    job.workQueue.push_back(job.endCell);
+    job.result->grid[job.endCell].alreadyVisited = true;
+    job.result->grid[job.endCell].distance = 0;
+
+    for (int i = 0; i < (int)job.workQueue.size(); ++i)
+    {
+        auto cell = job.workQueue[i];
+
+        job.result->grid[cell].hasLineOfSightToGoal = HasLineOfSight(job, cell);
+
+        for (auto direction : FlowDirections)
         {
-            std::queue<Vector2> emptyQueue;
-            std::swap(emptyQueue, _workQueue);
+            EnqueueCellIfValid(job, cell + direction, cell);
+        }
+    }
+
+    RecordDynamicCells(job);
+}
 
-            _fieldInProgress = std::make_shared<FlowField>(_obstacleGrid.Rows(), _obstacleGrid.Cols(), request.startCell, request.endCell, request.end);
-            _fieldInProgress->pathFinder = this;
+bool PathFinderService::RepairFlowField(FlowFieldJob& job)
+{
+    int totalCells = job.result->grid.Rows() * job.result->grid.Cols();
+    int endIndex = GetCellIndex(job.endCell);
 
-            _workQueue.push(request.endCell);
-            _fieldInProgress->grid[request.endCell].alreadyVisited = true;
+    // Only cells with path followers or requesters, now or when the field was last updated, can have changed. The
+    // rest only have static obstacles, which haven't changed since then.
+    job.changedCells.clear();
+    job.seenCells.clear();
 
-            request.status = PathRequestStatus::InProgress;
+    auto checkCell = [&](int index, bool wasOpen, bool wasRequesterStart)
+    {
+        if (!job.seenCells.insert(index).second)
+        {
+            return;
         }
 
-        while(calculationCount < MaxGridCalculationsPerTick && !_workQueue.empty())
+        bool isRequesterStart = job.requesterStartCells.count(index) != 0;
+        if (IsOpen(job, GetCellFromIndex(index)) != wasOpen || isRequesterStart != wasRequesterStart)
         {
-            auto cell = _workQueue.front();
-            _workQueue.pop();
+            job.changedCells.push_back(index);
+        }
+    };
+
+    for (auto& dynamicCell : job.result->dynamicCells)
+    {
+        checkCell(dynamicCell.index, dynamicCell.isOpen, dynamicCell.isRequesterStart);
+    }
+
+    for (auto index : _followerCells)
+    {
+        checkCell(index, _obstacleGrid[GetCellFromIndex(index)].count == 0, false);
+    }
+
+    for (auto index : job.requesterStartCells)
+    {
+        checkCell(index, _obstacleGrid[GetCellFromIndex(index)].count == 0, false);
+    }
 
-            _fieldInProgress->grid[cell].hasLineOfSightToGoal = HasLineOfSight(_fieldInProgress.get(), cell, _fieldInProgress->endCell);
+    if (job.changedCells.empty())
+    {
+        return true;
+    }
+
+    // Copy on write: the cached field is shared with the followers it was handed to, and may be left half repaired if
+    // the repair gives up below
+    job.result = std::make_shared<FlowField>(*job.result);
+    auto& grid = job.result->grid;
+
+    // Every cell whose path to the target led through a changed cell has to find a new one. If that's a large part of
+    // the field, calculating it from scratch is cheaper. The target itself can always be entered, but a path follower
+    // on it still blocks the line of sight.
+    job.invalidatedCells.clear();
+    for (auto index : job.changedCells)
+    {
+        auto& flowCell = grid[GetCellFromIndex(index)];
+        if (flowCell.distance >= 0 && index != endIndex)
+        {
+            flowCell.distance = -1;
+            job.invalidatedCells.push_back(index);
+        }
+    }
 
-            const Vector2 directions[] =
+    for (int i = 0; i < (int)job.invalidatedCells.size(); ++i)
+    {
+        auto cell = GetCellFromIndex(job.invalidatedCells[i]);
+
+        for (auto direction : FlowDirections)
+        {
+            auto next = cell + direction;
+            if (!IsInGrid(grid, next))
             {
-                Vector2(0, 1),
-                Vector2(0, -1),
-                Vector2(1, 0),
-                Vector2(-1, 0)
-            };
+                continue;
+            }
+
+            auto& nextFlowCell = grid[next];
+            if (nextFlowCell.distance >= 0 && next + nextFlowCell.dir == cell)
+            {
+                nextFlowCell.distance = -1;
+                job.invalidatedCells.push_back(GetCellIndex(next));
+            }
+        }
+
+        if ((int)job.invalidatedCells.size() > totalCells / 4)
+        {
+            return false;
+        }
+    }
+
+    // Re-expand from the intact cells around the invalidated ones, and from cells that opened up. Distances that
+    // shrink because of an opened cell spread out from it.
+    auto& queue = job.repairQueue;
+    queue.clear();
+
+    auto pushIfReachable = [&](int index)
+    {
+        auto cell = GetCellFromIndex(index);
+        int bestDistance = -1;
+
+        for (auto direction : FlowDirections)
+        {
+            auto from = cell + direction;
+            if (!IsInGrid(grid, from))
+            {
+                continue;
+            }
+
+            int distance = grid[from].distance;
+            if (distance >= 0 && (bestDistance == -1 || distance + 1 < bestDistance) && CanEnter(job, from, cell))
+            {
+                bestDistance = distance + 1;
+            }
+        }
+
+        if (bestDistance != -1)
+        {
+            queue.emplace_back(bestDistance, index);
+            std::push_heap(queue.begin(), queue.end(), std::greater<>());
+        }
+    };
+
+    for (auto index : job.invalidatedCells)
+    {
+        pushIfReachable(index);
+    }
+
+    for (auto index : job.changedCells)
+    {
+        pushIfReachable(index);
+    }
+
+    job.repairedCells.clear();
+    while (!queue.empty())
+    {
+        std::pop_heap(queue.begin(), queue.end(), std::greater<>());
+        auto [distance, index] = queue.back();
+        queue.pop_back();
+
+        auto cell = GetCellFromIndex(index);
+        auto& flowCell = grid[cell];
+        if (flowCell.distance >= 0 && flowCell.distance <= distance)
+        {
+            continue;
+        }
 
-            for(auto direction : directions)
+        flowCell.distance = distance;
+        job.repairedCells.push_back(index);
+
+        if ((int)job.repairedCells.size() > totalCells / 4)
+        {
+            return false;
+        }
+
+        for (auto direction : FlowDirections)
+        {
+            auto next = cell + direction;
+            if (!IsInGrid(grid, next))
             {
-                EnqueueCellIfValid(cell + direction, cell);
-                ++calculationCount;
+                continue;
+            }
+
+            int nextDistance = grid[next].distance;
+            if ((nextDistance == -1 || distance + 1 < nextDistance) && CanEnter(job, cell, next))
+            {
+                queue.emplace_back(distance + 1, GetCellIndex(next));
+                std::push_heap(queue.begin(), queue.end(), std::greater<>());
             }
         }
+    }
 
-        if(_workQueue.empty())
+    // A cell's direction depends on its neighbors' distances. Line of sight depends on the cells between it and the
+    // target, so it's updated in order of distance from the target, starting at the changes.
+    auto endCell = job.endCell;
+    auto pushLineOfSight = [&](Vector2 cell)
+    {
+        if (IsInGrid(grid, cell))
         {
-            owner->SendEvent(FlowFieldReadyEvent(_fieldInProgress));
-            _fieldInProgress = nullptr;
-            _requestQueue.pop();
+            int manhattanDistance = (int)(Abs(cell.x - endCell.x) + Abs(cell.y - endCell.y));
+            queue.emplace_back(manhattanDistance, GetCellIndex(cell));
+            std::push_heap(queue.begin(), queue.end(), std::greater<>());
         }
+    };
 
+    for (auto* cells : { &job.invalidatedCells, &job.repairedCells })
+    {
+        for (auto index : *cells)
         {
-            for (auto pathFollower : pathFollowers)
+            auto cell = GetCellFromIndex(index);
+
+            for (int i = -1; i < 4; ++i)
             {
-                if (pathFollower->owner == owner) continue;
-                --_obstacleGrid[scene->isometricSettings.ScreenToIntegerTile(pathFollower->owner->Center())].count;
+                auto neighbor = i == -1 ? cell : cell + FlowDirections[i];
+                if (!IsInGrid(grid, neighbor))
+                {
+                    continue;
+                }
+
+                bool wasVisited = grid[neighbor].alreadyVisited;
+                UpdateFlowDirection(job, neighbor);
+
+                if (grid[neighbor].alreadyVisited != wasVisited)
+                {
+                    pushLineOfSight(neighbor);
+                }
+            }
+        }
+    }
+
+    for (auto index : job.changedCells)
+    {
+        auto cell = GetCellFromIndex(index);
+        pushLineOfSight(cell);
+
+        for (auto direction : FlowDirections)
+        {
+            pushLineOfSight(cell + direction);
+        }
+    }
+
+    while (!queue.empty())
+    {
+        std::pop_heap(queue.begin(), queue.end(), std::greater<>());
+        auto [manhattanDistance, index] = queue.back();
+        queue.pop_back();
+
+        auto cell = GetCellFromIndex(index);
+        auto& flowCell = grid[cell];
+        bool hasLineOfSight = flowCell.alreadyVisited && HasLineOfSight(job, cell);
+
+        if (hasLineOfSight == flowCell.hasLineOfSightToGoal)
+        {
+            continue;
+        }
+
+        flowCell.hasLineOfSightToGoal = hasLineOfSight;
+
+        // Only cells further from the target can look through this one
+        for (int y = -1; y <= 1; ++y)
+        {
+            for (int x = -1; x <= 1; ++x)
+            {
+                auto neighbor = cell + Vector2(x, y);
+                if (Abs(neighbor.x - endCell.x) + Abs(neighbor.y - endCell.y) > manhattanDistance)
+                {
+                    pushLineOfSight(neighbor);
+                }
             }
         }
     }
+
+    RecordDynamicCells(job);
+
+    return true;
+}
+
+void PathFinderService::UpdateFlowDirection(FlowFieldJob& job, Vector2 cell)
+{
+    auto& grid = job.result->grid;
+    auto& flowCell = grid[cell];
+
+    flowCell.alreadyVisited = flowCell.distance >= 0;
+    flowCell.dir = Vector2(0, 0);
+
+    for (auto direction : FlowDirections)
+    {
+        auto next = cell + direction;
+        if (flowCell.distance > 0
+            && IsInGrid(grid, next)
+            && grid[next].distance == flowCell.distance - 1
+            && CanEnter(job, next, cell))
+        {
+            flowCell.dir = direction;
+            break;
+        }
+    }
+}
+
+void PathFinderService::RecordDynamicCells(FlowFieldJob& job)
+{
+    auto& dynamicCells = job.result->dynamicCells;
+    dynamicCells.clear();
+    job.seenCells.clear();
+
+    auto addCell = [&](int index)
+    {
+        if (job.seenCells.insert(index).second)
+        {
+            bool isRequesterStart = job.requesterStartCells.count(index) != 0;
+            dynamicCells.push_back({ index, IsOpen(job, GetCellFromIndex(index)), isRequesterStart });
+        }
+    };
+
+    for (auto index : _followerCells)
+    {
+        addCell(index);
+    }
+
+    for (auto index : job.requesterStartCells)
+    {
+        addCell(index);
+    }
+}
+
+void PathFinderService::CalculateHierarchicalPaths(FlowFieldJob& job)
+{
+    job.paths.resize(job.requests.size());
+
+    for (int i = 0; i < (int)job.requests.size(); ++i)
+    {
+        auto& request = job.requests[i];
+        auto& path = job.paths[i];
+
+        // An unreachable target leaves the path empty, the same as a flow field that doesn't reach the requester
+        path.clear();
+        if (!_hierarchicalPathFinder.FindPath(_obstacleGrid, request.startCell, job.endCell, job.hierarchicalScratch, path))
+        {
+            path.clear();
+        }
+    }
 }
 
 void PathFinderService::Visualize(Renderer* renderer)
@@ -205,11 +766,62 @@ void PathFinderService::Visualize(Renderer* renderer)
     }
 }
 
+static void PathCacheStatsCommand(ConsoleCommandBinder& binder)
+{
+    binder.Help("Shows how often path requests reuse a cached flow field and how much memory the cache holds");
+
+    auto engine = binder.GetEngine();
+    BaseGameInstance* games[] = { engine->GetServerGame(), engine->GetClientGame() };
+    const char* gameNames[] = { "server", "client" };
+
+    for (int i = 0; i < 2; ++i)
+    {
+        Scene* scene = games[i] != nullptr ? games[i]->GetScene() : nullptr;
+        auto pathFinder = scene != nullptr ? scene->TryGetService<PathFinderService>() : nullptr;
+        if (pathFinder == nullptr)
+        {
+            continue;
+        }
+
+        auto& cache = pathFinder->GetFlowFieldCache();
+        auto& stats = cache.GetStats();
+        int64_t lookups = stats.hits + stats.misses;
+
+        binder.GetConsole()->Log(
+            "%s: %.1f%% hit rate (%lld of %lld), %d fields in %lld bytes, %lld invalidated, %lld evicted\n",
+            gameNames[i],
+            lookups > 0 ? 100.0 * stats.hits / lookups : 0.0,
+            (long long)stats.hits,
+            (long long)lookups,
+            cache.TotalFields(),
+            (long long)cache.BytesHeld(),
+            (long long)stats.invalidations,
+            (long long)stats.evictions);
+    }
+}
+
+ConsoleCmd pathCacheStatsCmd("path-cache-stats", PathCacheStatsCommand);
+
 Vector2 PathFinderService::PixelToCellCoordinate(Vector2 position) const
 {
     return position.Floor().AsVectorOfType<float>();
 }
 
+Vector2 PathFinderService::GetFollowerCell(Entity* owner) const
+{
+    return scene->isometricSettings.ScreenToIntegerTile(owner->Center());
+}
+
+int PathFinderService::GetCellIndex(Vector2 cell) const
+{
+    return (int)cell.y * _obstacleGrid.Cols() + (int)cell.x;
+}
+
+Vector2 PathFinderService::GetCellFromIndex(int index) const
+{
+    return Vector2(index % _obstacleGrid.Cols(), index / _obstacleGrid.Cols());
+}
+
 ObstacleEdgeFlags GetBlockedDirection(Vector2 from, Vector2 to)
 {
     auto diff = to - from;
@@ -221,22 +833,34 @@ ObstacleEdgeFlags GetBlockedDirection(Vector2 from, Vector2 to)
     return ObstacleEdgeFlags();
 }
 
-void PathFinderService::EnqueueCellIfValid(Vector2 cell, Vector2 from)
+void PathFinderService::EnqueueCellIfValid(FlowFieldJob& job, Vector2 cell, Vector2 from)
 {
-    bool isBlocked = IsBlocked(from, cell)
-        && cell != _fieldInProgress->startCell
-        && cell != _fieldInProgress->endCell;
+    if(cell.x < 0
+        || cell.x >= _obstacleSnapshot.Cols()
+        || cell.y < 0
+        || cell.y >= _obstacleSnapshot.Rows())
+    {
+        return;
+    }
 
-    if(cell.x >= 0
-        && cell.x < _obstacleGrid.Cols()
-        && cell.y >= 0
-        && cell.y < _obstacleGrid.Rows()
-        && !_fieldInProgress->grid[cell].alreadyVisited
-        && !isBlocked)
+    auto& flowCell = job.result->grid[cell];
+    int distance = job.result->grid[from].distance + 1;
+
+    if(!flowCell.alreadyVisited)
     {
-        _workQueue.push(cell);
-        _fieldInProgress->grid[cell].alreadyVisited = true;
-        _fieldInProgress->grid[cell].dir = from - cell;
+        if (CanEnter(job, from, cell))
+        {
+            job.workQueue.push_back(cell);
+            flowCell.alreadyVisited = true;
+            flowCell.dir = from - cell;
+            flowCell.distance = distance;
+        }
+    }
+    else if (flowCell.distance == distance
+        && GetDirectionPriority(from - cell) < GetDirectionPriority(flowCell.dir)
+        && CanEnter(job, from, cell))
+    {
+        flowCell.dir = from - cell;
     }
 }
 
@@ -264,30 +888,64 @@ void PathFinderService::RemoveObstacle(const Rectangle &bounds)
             --_obstacleGrid[i][j].count;
         }
     }
+
+    _hierarchicalPathFinder.MarkCellsChanged(topLeft, bottomRight);
+    ++_obstacleVersion;
 }
 
 void PathFinderService::AddEdge(Vector2 from, Vector2 to)
 {
     _obstacleGrid[from].flags.SetFlag(GetBlockedDirection(from, to));
     _obstacleGrid[to].flags.SetFlag(GetBlockedDirection(to, from));
+    _hierarchicalPathFinder.MarkCellsChanged(from.Min(to), from.Max(to) + Vector2(1, 1));
+    ++_obstacleVersion;
 }
 
 void PathFinderService::RemoveEdge(Vector2 from, Vector2 to)
 {
     _obstacleGrid[from].flags.ResetFlag(GetBlockedDirection(from, to));
     _obstacleGrid[to].flags.ResetFlag(GetBlockedDirection(to, from));
+    _hierarchicalPathFinder.MarkCellsChanged(from.Min(to), from.Max(to) + Vector2(1, 1));
+    ++_obstacleVersion;
+}
+
+bool PathFinderService::IsBlocked(FlowFieldJob& job, Vector2 from, Vector2 to)
+{
+    if (_obstacleSnapshot[from].flags.HasFlag(GetBlockedDirection(from, to))
+        || _obstacleSnapshot[to].flags.HasFlag(GetBlockedDirection(to, from)))
+    {
+        return true;
+    }
+
+    return !IsOpen(job, to);
+}
+
+bool PathFinderService::IsOpen(FlowFieldJob& job, Vector2 cell)
+{
+    int count = _obstacleSnapshot[cell].count;
+    if (count != 0 && !job.requesterOccupancy.empty())
+    {
+        auto occupancy = job.requesterOccupancy.find(GetCellIndex(cell));
+        if (occupancy != job.requesterOccupancy.end())
+        {
+            count -= occupancy->second;
+        }
+    }
+
+    return count == 0;
 }
 
-bool PathFinderService::IsBlocked(Vector2 from, Vector2 to)
+bool PathFinderService::CanEnter(FlowFieldJob& job, Vector2 from, Vector2 to)
 {
-    return _obstacleGrid[from].flags.HasFlag(GetBlockedDirection(from, to))
-        || _obstacleGrid[to].flags.HasFlag(GetBlockedDirection(to, from))
-        || _obstacleGrid[to].count != 0;
+    return !IsBlocked(job, from, to)
+        || job.requesterStartCells.count(GetCellIndex(to)) != 0
+        || to == job.endCell;
 }
 
-bool PathFinderService::HasLineOfSight(FlowField* field, Vector2 at, Vector2 endCell)
+bool PathFinderService::HasLineOfSight(FlowFieldJob& job, Vector2 at)
 {
-    endCell = endCell.Floor().AsVectorOfType<float>();
+    auto field = job.result.get();
+    auto endCell = job.endCell.Floor().AsVectorOfType<float>();
     if (at.x == 0 || at.x == field->grid.Cols() || at.y == 0 || at.y == field->grid.Rows())
     {
         return false;
@@ -309,7 +967,7 @@ bool PathFinderService::HasLineOfSight(FlowField* field, Vector2 at, Vector2 end
 
         if (distX >= distY)
         {
-            if (!IsBlocked(at, at + Vector2(stepX, 0)))
+            if (!IsBlocked(job, at, at + Vector2(stepX, 0)))
             {
                 hasLineOfSight |= field->grid[at + Vector2(stepX, 0)].hasLineOfSightToGoal;
             }
@@ -317,7 +975,7 @@ bool PathFinderService::HasLineOfSight(FlowField* field, Vector2 at, Vector2 end
 
         if (distY >= distX)
         {
-            if (!IsBlocked(at, at + Vector2(0, stepY)))
+            if (!IsBlocked(job, at, at + Vector2(0, stepY)))
             {
                 hasLineOfSight |= field->grid[at + Vector2(0, stepY)].hasLineOfSightToGoal;
             }
@@ -331,7 +989,7 @@ bool PathFinderService::HasLineOfSight(FlowField* field, Vector2 at, Vector2 end
             }
             else if (distX == distY)
             {
-                if (IsBlocked(at, at + Vector2(stepX, 0)) || IsBlocked(at, at + Vector2(0, stepY)))
+                if (IsBlocked(job, at, at + Vector2(stepX, 0)) || IsBlocked(job, at, at + Vector2(0, stepY)))
                 {
                     hasLineOfSight = false;
                 }
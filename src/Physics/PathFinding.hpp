@@ -1,11 +1,14 @@
 #pragma once
 #include <memory>
-#include <queue>
+#include <unordered_map>
 #include <vector>
+#include <robin_hood.h>
 
 #include "Math/Rectangle.hpp"
 #include "Math/Vector2.hpp"
 #include "Container/Grid.hpp"
+#include "Physics/FlowFieldCache.hpp"
+#include "Physics/HierarchicalPathFinder.hpp"
 #include "Scene/IEntityEvent.hpp"
 #include "Scene/Scene.hpp"
 
@@ -16,44 +19,65 @@ struct FlowCell
     bool alreadyVisited = false;
     bool hasLineOfSightToGoal = false;
     Vector2 dir;
+    int distance = -1;      // Steps to the target, -1 if it can't be reached
 };
 
+/// <summary>
+/// A cell whose openness depended on path followers or requesters when a flow field was last calculated
+/// </summary>
+struct FlowFieldDynamicCell
+{
+    int index;
+    bool isOpen;
+    bool isRequesterStart;
+};
+
+/// <summary>
+/// Directions towards a target cell. Shared by every entity that requested a path to that cell.
+/// </summary>
 struct FlowField
 {
-    FlowField(int rows, int cols, Vector2 startCell, Vector2 endCell, Vector2 end)
+    FlowField(int rows, int cols, Vector2 endCell)
         : grid(rows, cols),
-        startCell(startCell),
-        endCell(endCell),
-        end(end)
+        endCell(endCell)
     {
         
     }
 
     VariableSizedGrid<FlowCell> grid;
     PathFinderService* pathFinder;
-    Vector2 startCell;
     Vector2 endCell;
-    Vector2 end;
+
+    // Compared against the current path followers to find the cells to repair when the field is reused
+    std::vector<FlowFieldDynamicCell> dynamicCells;
 };
 
 /// <summary>
-/// Sent to an entity to inform it that its path request is complete
+/// Sent to an entity to inform it that its path request is complete. Paths found by the hierarchical path finder
+/// don't have a flow field, so result is null and path holds the cells after startCell instead.
 /// </summary>
 DEFINE_EVENT(FlowFieldReadyEvent)
 {
-    FlowFieldReadyEvent(std::shared_ptr<FlowField> result_)
-        : result(result_)
+    FlowFieldReadyEvent(std::shared_ptr<FlowField> result_, Vector2 startCell_, Vector2 end_)
+        : result(result_),
+        startCell(startCell_),
+        end(end_)
     {
         
     }
 
-    std::shared_ptr<FlowField> result;
-};
+    FlowFieldReadyEvent(const std::vector<Vector2>& path_, Vector2 startCell_, Vector2 end_)
+        : path(path_),
+        startCell(startCell_),
+        end(end_)
+    {
 
-enum class PathRequestStatus
-{
-    NotStarted,
-    InProgress
+    }
+
+    std::shared_ptr<FlowField> result;
+    std::vector<Vector2> path;
+    Vector2 startCell;
+    Vector2 end;
 };
 
 struct PathRequest
@@ -65,7 +89,7 @@ struct PathRequest
     Vector2 endCell;
 
     EntityReference<Entity> owner;
-    PathRequestStatus status = PathRequestStatus::NotStarted;
+    int id;
 };
 
 enum class ObstacleEdgeFlags
@@ -93,6 +117,48 @@ struct ObstacleCell
     int height = 0;
 };
 
+/// <summary>
+/// All pending requests for the same target cell, calculated as a single flow field on a worker thread
+/// </summary>
+struct FlowFieldJob
+{
+    void Reset(Vector2 endCell_)
+    {
+        endCell = endCell_;
+        requests.clear();
+        requesterStartCells.clear();
+        requesterOccupancy.clear();
+        result = nullptr;
+        useFlowField = true;
+        isCached = false;
+    }
+
+    Vector2 endCell;
+    std::vector<PathRequest> requests;
+    std::shared_ptr<FlowField> result;
+
+    // Set when result came from the flow field cache and only needs to be repaired around path followers that moved
+    bool isCached = false;
+
+    // In hierarchical mode, jobs with fewer requests than the crowd size get a path per request instead of a flow field
+    bool useFlowField = true;
+    std::vector<std::vector<Vector2>> paths;
+    HierarchicalPathFinder::Scratch hierarchicalScratch;
+
+    // Path followers don't block their own path, so the cells the requesters occupy are discounted
+    robin_hood::unordered_flat_set<int> requesterStartCells;
+    robin_hood::unordered_flat_map<int, int> requesterOccupancy;
+
+    std::vector<Vector2> workQueue;
+
+    // Used to repair cached flow fields
+    std::vector<int> changedCells;
+    std::vector<int> invalidatedCells;
+    std::vector<int> repairedCells;
+    std::vector<std::pair<int, int>> repairQueue;
+    robin_hood::unordered_flat_set<int> seenCells;
+};
+
 class PathFinderService : public ISceneService
 {
 public:
@@ -111,24 +177,56 @@ public:
         return _obstacleGrid[position];
     }
 
+    const FlowFieldCache& GetFlowFieldCache() const { return _flowFieldCache; }
+    void ClearFlowFieldCache() { _flowFieldCache.Clear(); }
+
     std::vector<PathFollowerComponent*> pathFollowers;
 
 private:
+    // Per thread
     static constexpr int MaxGridCalculationsPerTick = 32768 * 8;
 
     void ReceiveEvent(const IEntityEvent& ev) override;
     void CalculatePaths();
+    void UpdateFollowerCells();
+    void BuildObstacleSnapshot();
+    void TryUseCachedFlowField(FlowFieldJob& job);
+    int GroupRequestsIntoJobs(int maxJobs);
 
     Vector2 PixelToCellCoordinate(Vector2 position) const;
-    void EnqueueCellIfValid(Vector2 cell, Vector2 from);
-
-    bool HasLineOfSight(FlowField* field, Vector2 at, Vector2 endCell);
-
-    bool IsBlocked(Vector2 from, Vector2 to);
+    Vector2 GetFollowerCell(Entity* owner) const;
+    int GetCellIndex(Vector2 cell) const;
+
+    // These only read the obstacle snapshot and the job, so they can run on worker threads
+    void CalculateFlowField(FlowFieldJob& job);
+    bool RepairFlowField(FlowFieldJob& job);
+    void CalculateHierarchicalPaths(FlowFieldJob& job);
+    void EnqueueCellIfValid(FlowFieldJob& job, Vector2 cell, Vector2 from);
+    void UpdateFlowDirection(FlowFieldJob& job, Vector2 cell);
+    void RecordDynamicCells(FlowFieldJob& job);
+    bool HasLineOfSight(FlowFieldJob& job, Vector2 at);
+    bool IsBlocked(FlowFieldJob& job, Vector2 from, Vector2 to);
+    bool IsOpen(FlowFieldJob& job, Vector2 cell);
+    bool CanEnter(FlowFieldJob& job, Vector2 from, Vector2 to);
+    Vector2 GetCellFromIndex(int index) const;
 
     VariableSizedGrid<ObstacleCell> _obstacleGrid;
-    std::queue<PathRequest> _requestQueue;
-
-    std::queue<Vector2> _workQueue;
-    std::shared_ptr<FlowField> _fieldInProgress;
+    VariableSizedGrid<ObstacleCell> _obstacleSnapshot;
+    bool _hasObstacleSnapshot = false;
+    uint32_t _snapshotObstacleVersion = 0;
+    std::vector<int> _snapshotFollowerCells;
+    HierarchicalPathFinder _hierarchicalPathFinder;
+
+    // Incremented whenever a static obstacle or edge changes
+    uint32_t _obstacleVersion = 0;
+    FlowFieldCache _flowFieldCache;
+    std::unordered_map<Entity*, Vector2> _followerCellByOwner;
+    std::vector<int> _followerCells;
+
+    std::vector<PathRequest> _requestQueue;
+    std::vector<PathRequest> _deferredRequests;
+    std::unordered_map<Entity*, int> _latestRequestIdByOwner;
+    int _nextRequestId = 0;
+
+    std::vector<FlowFieldJob> _jobs;
 };
\ No newline at end of file
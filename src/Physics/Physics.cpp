@@ -1,7 +1,10 @@
 #include "Physics.hpp"
 
+#include <algorithm>
+
 #include <box2d/b2_contact.h>
 #include <box2d/b2_fixture.h>
+#include <box2d/b2_joint.h>
 #include <box2d/b2_world.h>
 #include <box2d/b2_polygon_shape.h>
 #include <box2d/b2_circle_shape.h>
@@ -12,6 +15,7 @@
 #include "Scene/Entity.hpp"
 #include "Scene/Scene.hpp"
 #include "PathFinding.hpp"
+#include "Tools/Profiler.hpp"
 
 void MoveEntityRecursive(RigidBodyComponent* rigidBody, Vector2 offset)
 {
@@ -23,46 +27,181 @@ void MoveEntityRecursive(RigidBodyComponent* rigidBody, Vector2 offset)
 
     for(auto child = entity->children; child != nullptr; child = child->nextSibling)
     {
-        // FIXME: this is really inefficient
-        auto childRigidBody = child->GetComponent<RigidBodyComponent>();
+        // GetComponent() reports children without a rigid body
+        auto childRigidBody = child->rigidBody != nullptr
+            ? child->rigidBody
+            : child->GetComponent<RigidBodyComponent>();
+
         MoveEntityRecursive(childRigidBody, offset);
     }
 }
 
+static constexpr int NotWaitingForSync = -1;
+static constexpr int ForgottenBody = -2;
+
 void CollisionManager::UpdateEntityPositions()
 {
-    for (auto body = _world->GetBodyList(); body != nullptr; body = body->GetNext())
+    PROFILE_ZONE("UpdateEntityPositions");
+
+    AddBodiesWokenWithIslands();
+
+    // Bodies marked while syncing are checked next time
+    std::swap(_bodiesToSync, _bodiesBeingSynced);
+    _bodiesToSync.clear();
+
+    for (auto body : _bodiesBeingSynced)
+    {
+        RigidBodyComponent::FromB2Body(body)->syncListIndex = NotWaitingForSync;
+    }
+
+    // Same order as the world's body list, newest first, which matters for hierarchies
+    std::sort(_bodiesBeingSynced.begin(), _bodiesBeingSynced.end(), [](b2Body* lhs, b2Body* rhs)
     {
-        auto data = body->GetUserData().pointer;
-        auto rigidBody = reinterpret_cast<RigidBodyComponent*>(data);
+        return RigidBodyComponent::FromB2Body(lhs)->creationOrder > RigidBodyComponent::FromB2Body(rhs)->creationOrder;
+    });
 
-        if (rigidBody != nullptr)
+    _isSyncing = true;
+
+    for (auto body : _bodiesBeingSynced)
+    {
+        // Forgotten while syncing
+        if (body == nullptr)
+        {
+            continue;
+        }
+
+        // A body that falls asleep still moves during the step it falls asleep in, so it's checked once more
+        if (body->GetType() != b2_staticBody && body->IsAwake())
         {
+            MarkBodyForSync(body);
+        }
 
-            auto entity = rigidBody->owner;
+        SyncBody(body);
+    }
 
-            auto oldPosition = entity->Center();
+    _isSyncing = false;
+    _bodiesBeingSynced.clear();
+}
 
-            if (entity->flags.HasFlag(EntityFlags::WasTeleported))
-            {
-                auto newPosition = entity->TopLeft();
-                auto scaled = (newPosition + entity->Dimensions() / 2) * Scene::PixelsToBox2DRatio;
-                auto angle = body->GetAngle();
+void CollisionManager::AddBodiesWokenWithIslands()
+{
+    // Box2D wakes a whole island when one of its bodies is awake, including bodies that only touch or are jointed to
+    // other sleeping bodies. Those are found by following contacts and joints from the bodies that are already waiting.
+    for (int i = 0; i < (int)_bodiesToSync.size(); ++i)
+    {
+        auto body = _bodiesToSync[i];
 
-                body->SetTransform(b2Vec2(scaled.x, scaled.y), angle);
+        if (body->GetType() == b2_staticBody || !body->IsAwake())
+        {
+            continue;
+        }
 
-                entity->flags.ResetFlag(EntityFlags::WasTeleported);
+        for (auto edge = body->GetContactList(); edge != nullptr; edge = edge->next)
+        {
+            MarkIfAwake(edge->other);
+        }
 
-                entity->SendEvent(EntityTeleportedEvent());
-            }
-            else
-            {
-                auto offset = Scene::Box2DToPixel(body->GetPosition()) - oldPosition;
+        for (auto edge = body->GetJointList(); edge != nullptr; edge = edge->next)
+        {
+            MarkIfAwake(edge->other);
+        }
+    }
+}
 
-                if (offset != Vector2::Zero())
-                {
-                    MoveEntityRecursive(rigidBody, offset);
-                }
+void CollisionManager::MarkIfAwake(b2Body* body)
+{
+    if (body->GetType() != b2_staticBody && body->IsAwake())
+    {
+        MarkBodyForSync(body);
+    }
+}
+
+void CollisionManager::AddBody(b2Body* body)
+{
+    auto rigidBody = RigidBodyComponent::FromB2Body(body);
+    rigidBody->creationOrder = _totalBodiesAdded++;
+    rigidBody->syncListIndex = NotWaitingForSync;
+
+    // The body may not start where the owner is
+    MarkBodyForSync(body);
+}
+
+void CollisionManager::MarkBodyForSync(b2Body* body)
+{
+    auto rigidBody = RigidBodyComponent::FromB2Body(body);
+
+    if (rigidBody->syncListIndex == NotWaitingForSync)
+    {
+        rigidBody->syncListIndex = (int)_bodiesToSync.size();
+        _bodiesToSync.push_back(body);
+    }
+}
+
+void CollisionManager::MarkContactBodiesForSync(b2Contact* contact)
+{
+    // A touching contact wakes both bodies when it ends, and isn't there anymore to be followed
+    for (auto body : { contact->GetFixtureA()->GetBody(), contact->GetFixtureB()->GetBody() })
+    {
+        if (body->GetType() != b2_staticBody)
+        {
+            MarkBodyForSync(body);
+        }
+    }
+}
+
+void CollisionManager::ForgetBody(b2Body* body)
+{
+    auto rigidBody = RigidBodyComponent::FromB2Body(body);
+    auto index = rigidBody->syncListIndex;
+
+    if (index >= 0)
+    {
+        auto last = _bodiesToSync.back();
+        _bodiesToSync[index] = last;
+        RigidBodyComponent::FromB2Body(last)->syncListIndex = index;
+        _bodiesToSync.pop_back();
+    }
+
+    if (_isSyncing)
+    {
+        std::replace(_bodiesBeingSynced.begin(), _bodiesBeingSynced.end(), body, (b2Body*)nullptr);
+    }
+
+    // Destroying the body ends its contacts, which would mark it again
+    rigidBody->syncListIndex = ForgottenBody;
+}
+
+void CollisionManager::SyncBody(b2Body* body)
+{
+    auto data = body->GetUserData().pointer;
+    auto rigidBody = reinterpret_cast<RigidBodyComponent*>(data);
+
+    if (rigidBody != nullptr)
+    {
+
+        auto entity = rigidBody->owner;
+
+        auto oldPosition = entity->Center();
+
+        if (entity->flags.HasFlag(EntityFlags::WasTeleported))
+        {
+            auto newPosition = entity->TopLeft();
+            auto scaled = (newPosition + entity->Dimensions() / 2) * Scene::PixelsToBox2DRatio;
+            auto angle = body->GetAngle();
+
+            body->SetTransform(b2Vec2(scaled.x, scaled.y), angle);
+
+            entity->flags.ResetFlag(EntityFlags::WasTeleported);
+
+            entity->SendEvent(EntityTeleportedEvent());
+        }
+        else
+        {
+            auto offset = Scene::Box2DToPixel(body->GetPosition()) - oldPosition;
+
+            if (offset != Vector2::Zero())
+            {
+                MoveEntityRecursive(rigidBody, offset);
             }
         }
     }
@@ -167,6 +306,8 @@ void CollisionManager::BeginContact(b2Contact* contact)
 
 void CollisionManager::EndContact(b2Contact* contact)
 {
+    MarkContactBodiesForSync(contact);
+
     auto entityA = ColliderHandle(contact->GetFixtureA());
     auto entityB = ColliderHandle(contact->GetFixtureB());
 
@@ -192,6 +333,7 @@ void CollisionManager::PreSolve(b2Contact* contact, const b2Manifold* oldManifol
 float FindClosestRaycastCallback::ReportFixture(b2Fixture* fixture, const b2Vec2& point, const b2Vec2& normal, float fraction)
 {
     if ((!allowTriggers && fixture->IsSensor())
+        || (fixture->GetFilterData().categoryBits & maskBits) == 0
         || includeFixture != nullptr && !includeFixture({ fixture }))
     {
         return lastFraction;
@@ -1,10 +1,12 @@
 #pragma once
 #include <functional>
+#include <vector>
 #include <box2d/b2_fixture.h>
 #include <box2d/b2_world.h>
 #include <box2d/b2_world_callbacks.h>
 
 #include "ColliderHandle.hpp"
+#include "Memory/FrameArena.hpp"
 
 class Renderer;
 
@@ -38,6 +40,23 @@ struct FindFixturesQueryCallback : b2QueryCallback
     int count = 0;
 };
 
+struct CollectFixturesQueryCallback : b2QueryCallback
+{
+    CollectFixturesQueryCallback(FrameVector<ColliderHandle>& foundFixtures_)
+        : foundFixtures(foundFixtures_)
+    {
+
+    }
+
+    bool ReportFixture(b2Fixture* fixture) override
+    {
+        foundFixtures.push_back(ColliderHandle(fixture));
+        return true;
+    }
+
+    FrameVector<ColliderHandle>& foundFixtures;
+};
+
 class CollisionManager : public b2ContactListener
 {
 public:
@@ -47,17 +66,50 @@ public:
 
     }
 
+    /// <summary>
+    /// Moves the entities of the bodies Box2D moved, and moves the bodies of teleported entities. Only the bodies that
+    /// were awake during the last sync, were marked with MarkBodyForSync(), touched a contact or were woken through a
+    /// contact or joint are checked. Static and sleeping bodies cost nothing.
+    /// </summary>
     void UpdateEntityPositions();
 
+    /// <summary>
+    /// Must be called after a body is created. The body is checked by the next UpdateEntityPositions().
+    /// </summary>
+    void AddBody(b2Body* body);
+
+    /// <summary>
+    /// Makes the next UpdateEntityPositions() check the body even if it's static or sleeping. RigidBodyComponent calls
+    /// this when its owner moves outside of the physics step and when it wakes the body. Code that moves or wakes a body
+    /// directly, for example with b2Body::SetTransform(), b2Body::SetAwake() or b2World::DestroyJoint(), which wakes
+    /// both bodies, must call this too, usually through RigidBodyComponent::NotifyBodyChanged().
+    /// </summary>
+    void MarkBodyForSync(b2Body* body);
+
+    /// <summary>
+    /// Must be called before a body is destroyed
+    /// </summary>
+    void ForgetBody(b2Body* body);
+
     void RenderColliderOutlines(Renderer* renderer);
 
 private:
+    void SyncBody(b2Body* body);
+    void MarkContactBodiesForSync(b2Contact* contact);
+    void AddBodiesWokenWithIslands();
+    void MarkIfAwake(b2Body* body);
 
     void BeginContact(b2Contact* contact) override;
     void EndContact(b2Contact* contact) override;
     void PreSolve(b2Contact* contact, const b2Manifold* oldManifold) override;
 
     b2World* _world;
+
+    // Every awake body is in here between syncs, so sleeping bodies are never visited
+    std::vector<b2Body*> _bodiesToSync;
+    std::vector<b2Body*> _bodiesBeingSynced;
+    unsigned int _totalBodiesAdded = 0;
+    bool _isSyncing = false;
 };
 
 struct Entity;
@@ -65,8 +117,12 @@ struct Entity;
 class FindClosestRaycastCallback : public b2RayCastCallback
 {
 public:
-    FindClosestRaycastCallback(bool allowTriggers_, const std::function<bool(ColliderHandle handle)>& includeFixture_ = nullptr)
+    FindClosestRaycastCallback(
+        bool allowTriggers_,
+        const std::function<bool(ColliderHandle handle)>& includeFixture_ = nullptr,
+        uint16 maskBits_ = 0xFFFF)
         : allowTriggers(allowTriggers_),
+        maskBits(maskBits_),
         includeFixture(includeFixture_)
     {
         
@@ -79,5 +135,6 @@ public:
     float lastFraction = 1;
     b2Vec2 closestNormal;
     bool allowTriggers;
+    uint16 maskBits;        // Fixtures whose category bits don't overlap these are ignored
     const std::function<bool(ColliderHandle handle)>& includeFixture;
 };
\ No newline at end of file
@@ -12,6 +12,9 @@
 #include "Math/Vector4.hpp"
 #include "gsl/span"
 
+template<typename T>
+struct ShaderUniform;
+
 class Shader
 {
 public:
@@ -20,6 +23,13 @@ public:
 
     int ProgramId() const { return _id; }
 
+    /// <summary>
+    /// Looks up the location of a uniform. Call once after compiling and keep the result, the lookup is a string
+    /// search inside the driver.
+    /// </summary>
+    template<typename T>
+    ShaderUniform<T> GetUniform(const char* name) const;
+
 private:
     void CheckCompileErrors(GLuint object, std::string type);
 
@@ -130,6 +140,13 @@ struct ShaderUniform
     int id;
 };
 
+template<typename T>
+ShaderUniform<T> Shader::GetUniform(const char* name) const
+{
+    int id = glGetUniformLocation(_id, name);
+    return ShaderUniform<T>(id);
+}
+
 struct Texture;
 struct Effect;
 struct Camera;
@@ -190,8 +207,7 @@ struct Effect
 template<typename T>
 ShaderUniform<T> Effect::GetUniform(const char* name)
 {
-    int id = glGetUniformLocation(ProgramId(), name);
-    return ShaderUniform<T>(id);
+    return shader->GetUniform<T>(name);
 }
 
 template<typename T>
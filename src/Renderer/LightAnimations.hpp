@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <random>
 
 #include "Renderer/Lighting.hpp"
@@ -155,12 +156,22 @@ private:
 
 struct BaseLightAnimator : LightAnimator
 {
-    BaseLightAnimator(BaseLight* light)
+    /// <summary>
+    /// With a light manager, the light is updated in it whenever its maxDistance changes so that it stays visible
+    /// </summary>
+    template<typename TLight>
+    BaseLightAnimator(TLight* light, LightManager* lightManager = nullptr)
         : intensity(&light->intensity),
-        maxDistance(&light->maxDistance)
+        maxDistance(&light->maxDistance),
+        _lastMaxDistance(light->maxDistance)
     {
         intensity.min = light->minIntensity;
         intensity.max = light->maxIntensity;
+
+        if (lightManager != nullptr)
+        {
+            _updateLight = [=] { lightManager->UpdateLight(light); };
+        }
     }
 
 
@@ -177,18 +188,33 @@ struct BaseLightAnimator : LightAnimator
     {
         intensity.Update(deltaTime);
         maxDistance.Update(deltaTime);
+
+        // Also catches maxDistance.Set() and Hold() since the last update
+        if (*maxDistance.value != _lastMaxDistance)
+        {
+            _lastMaxDistance = *maxDistance.value;
+
+            if (_updateLight)
+            {
+                _updateLight();
+            }
+        }
     }
 
     virtual ~BaseLightAnimator() = default;
 
     Interpolator<float> intensity;
     Interpolator<float> maxDistance;
+
+private:
+    float _lastMaxDistance;
+    std::function<void()> _updateLight;
 };
 
 struct SpotLightAnimator : BaseLightAnimator
 {
-    SpotLightAnimator(SpotLight* spotlight)
-        : BaseLightAnimator(spotlight),
+    SpotLightAnimator(SpotLight* spotlight, LightManager* lightManager = nullptr)
+        : BaseLightAnimator(spotlight, lightManager),
         beamAngle(&spotlight->beamAngle),
         facingAngle(&spotlight->facingAngle)
     {
@@ -212,8 +238,8 @@ struct SpotLightAnimator : BaseLightAnimator
 
 struct LampAnimator : BaseLightAnimator
 {
-    LampAnimator(PointLight* pointLight_, SpotLight* spotLight_)
-        : BaseLightAnimator(pointLight_),
+    LampAnimator(PointLight* pointLight_, SpotLight* spotLight_, LightManager* lightManager = nullptr)
+        : BaseLightAnimator(pointLight_, lightManager),
         pointLight(pointLight_),
         spotLight(spotLight_)
     {
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <robin_hood.h>
+
+#include "Math/Rectangle.hpp"
+#include "System/Logger.hpp"
+
+/// <summary>
+/// Sparse uniform grid of light bounds, so the lights that touch the camera can be found without looking at every
+/// light in the level. A light is stored in each cell its bounds overlap. Lights that would cover more than
+/// MaxCellsPerLight cells are kept in a list that is always tested instead.
+///
+/// A light is placed by the first PlacePendingLights() after it's added, so its properties can still be set after
+/// AddLight(). After that, Update() has to be called when it moves or its bounds change size.
+/// </summary>
+template<typename TLight>
+class LightGrid
+{
+public:
+    static constexpr float DefaultCellSize = 512;
+    static constexpr int MaxCellsPerLight = 64;
+
+    explicit LightGrid(float cellSize = DefaultCellSize);
+
+    void Add(TLight* light);
+    void Remove(TLight* light);
+    void Update(TLight* light);
+
+    void PlacePendingLights();
+
+    /// <summary>
+    /// Appends the lights whose bounds intersect bounds to outLights, each once. Pending lights are not included.
+    /// </summary>
+    void FindIntersecting(const Rectangle& bounds, std::vector<TLight*>& outLights) const;
+
+    int TotalLights() const { return (int)_placements.size() + (int)_pendingLights.size(); }
+
+private:
+    struct CellRange
+    {
+        int Width() const { return maxX - minX + 1; }
+        int Height() const { return maxY - minY + 1; }
+        bool IsOversized() const { return (int64_t)Width() * Height() > MaxCellsPerLight; }
+
+        bool operator==(const CellRange& rhs) const
+        {
+            return minX == rhs.minX && minY == rhs.minY && maxX == rhs.maxX && maxY == rhs.maxY;
+        }
+
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    struct Entry
+    {
+        TLight* light;
+
+        // Top left cell of the light, used to report a light only from the first cell of the query that has it
+        int minX;
+        int minY;
+    };
+
+    int CellCoordinate(float value) const { return (int)std::floor(value / _cellSize); }
+    static int64_t CellKey(int x, int y) { return ((int64_t)x << 32) | (uint32_t)y; }
+
+    CellRange GetCellRange(const Rectangle& bounds) const;
+
+    void Place(TLight* light, const CellRange& range);
+    void Unplace(TLight* light, const CellRange& range);
+
+    float _cellSize;
+    robin_hood::unordered_flat_map<int64_t, std::vector<Entry>> _cells;
+    robin_hood::unordered_flat_map<TLight*, CellRange> _placements;
+    std::vector<TLight*> _oversizedLights;
+    std::vector<TLight*> _pendingLights;
+};
+
+template<typename TLight>
+LightGrid<TLight>::LightGrid(float cellSize)
+    : _cellSize(cellSize)
+{
+    if (!(cellSize > 0))
+    {
+        FatalError("Invalid light grid cell size: %f", cellSize);
+    }
+}
+
+template<typename TLight>
+void LightGrid<TLight>::Add(TLight* light)
+{
+    _pendingLights.push_back(light);
+}
+
+template<typename TLight>
+void LightGrid<TLight>::Remove(TLight* light)
+{
+    auto pending = std::find(_pendingLights.begin(), _pendingLights.end(), light);
+    if (pending != _pendingLights.end())
+    {
+        _pendingLights.erase(pending);
+        return;
+    }
+
+    auto placement = _placements.find(light);
+    if (placement == _placements.end())
+    {
+        return;
+    }
+
+    Unplace(light, placement->second);
+    _placements.erase(placement);
+}
+
+template<typename TLight>
+void LightGrid<TLight>::Update(TLight* light)
+{
+    auto placement = _placements.find(light);
+    if (placement == _placements.end())
+    {
+        // Not added, or still pending
+        return;
+    }
+
+    auto range = GetCellRange(light->Bounds());
+    if (range == placement->second)
+    {
+        return;
+    }
+
+    Unplace(light, placement->second);
+    Place(light, range);
+    placement->second = range;
+}
+
+template<typename TLight>
+void LightGrid<TLight>::PlacePendingLights()
+{
+    for (auto light : _pendingLights)
+    {
+        auto range = GetCellRange(light->Bounds());
+        Place(light, range);
+        _placements[light] = range;
+    }
+
+    _pendingLights.clear();
+}
+
+template<typename TLight>
+void LightGrid<TLight>::FindIntersecting(const Rectangle& bounds, std::vector<TLight*>& outLights) const
+{
+    for (auto light : _oversizedLights)
+    {
+        if (light->Bounds().IntersectsWith(bounds))
+        {
+            outLights.push_back(light);
+        }
+    }
+
+    auto range = GetCellRange(bounds);
+
+    auto addCell = [&](int x, int y, const std::vector<Entry>& entries)
+    {
+        for (auto& entry : entries)
+        {
+            // A light in several of the cells is only reported by the first one
+            if (x != std::max(range.minX, entry.minX) || y != std::max(range.minY, entry.minY))
+            {
+                continue;
+            }
+
+            if (entry.light->Bounds().IntersectsWith(bounds))
+            {
+                outLights.push_back(entry.light);
+            }
+        }
+    };
+
+    // A zoomed out camera can cover more cells than the grid has
+    if ((int64_t)range.Width() * range.Height() > (int64_t)_cells.size())
+    {
+        for (auto& cell : _cells)
+        {
+            int x = (int)(cell.first >> 32);
+            int y = (int)(uint32_t)cell.first;
+
+            if (x >= range.minX && x <= range.maxX && y >= range.minY && y <= range.maxY)
+            {
+                addCell(x, y, cell.second);
+            }
+        }
+    }
+    else
+    {
+        for (int y = range.minY; y <= range.maxY; ++y)
+        {
+            for (int x = range.minX; x <= range.maxX; ++x)
+            {
+                auto cell = _cells.find(CellKey(x, y));
+                if (cell != _cells.end())
+                {
+                    addCell(x, y, cell->second);
+                }
+            }
+        }
+    }
+}
+
+template<typename TLight>
+typename LightGrid<TLight>::CellRange LightGrid<TLight>::GetCellRange(const Rectangle& bounds) const
+{
+    return CellRange
+    {
+        CellCoordinate(bounds.Left()),
+        CellCoordinate(bounds.Top()),
+        CellCoordinate(bounds.Right()),
+        CellCoordinate(bounds.Bottom())
+    };
+}
+
+template<typename TLight>
+void LightGrid<TLight>::Place(TLight* light, const CellRange& range)
+{
+    if (range.IsOversized())
+    {
+        _oversizedLights.push_back(light);
+        return;
+    }
+
+    for (int y = range.minY; y <= range.maxY; ++y)
+    {
+        for (int x = range.minX; x <= range.maxX; ++x)
+        {
+            _cells[CellKey(x, y)].push_back({ light, range.minX, range.minY });
+        }
+    }
+}
+
+template<typename TLight>
+void LightGrid<TLight>::Unplace(TLight* light, const CellRange& range)
+{
+    if (range.IsOversized())
+    {
+        _oversizedLights.erase(std::find(_oversizedLights.begin(), _oversizedLights.end(), light));
+        return;
+    }
+
+    for (int y = range.minY; y <= range.maxY; ++y)
+    {
+        for (int x = range.minX; x <= range.maxX; ++x)
+        {
+            auto cell = _cells.find(CellKey(x, y));
+            auto& entries = cell->second;
+
+            for (auto& entry : entries)
+            {
+                if (entry.light == light)
+                {
+                    entry = entries.back();
+                    entries.pop_back();
+                    break;
+                }
+            }
+
+            // Empty cells are kept, lights usually come back to the same place
+        }
+    }
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstddef>
 #include <box2d/b2_polygon_shape.h>
 
 #include "Lighting.hpp"
@@ -6,6 +8,7 @@
 #include "Renderer.hpp"
 #include "GL/gl3w.h"
 #include "Scene/Scene.hpp"
+#include "Tools/Profiler.hpp"
 
 static const char* g_linearFalloffLightVertexShader = R"(
 #version 330 core
@@ -141,6 +144,69 @@ void main()
 
 )";
 
+static const char* g_lightBatchVertexShader = R"(
+#version 330 core
+
+uniform mat4x4 view;
+
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 lightPosition;
+layout (location = 2) in float maxDistance;
+layout (location = 3) in vec3 color;
+
+out vec2 fragPosition;
+out vec2 colorBufferCoord;
+flat out vec2 fragLightPosition;
+flat out float fragMaxDistance;
+flat out vec3 fragColor;
+
+void main()
+{
+    gl_Position = view * vec4(position, 0, 1);
+    fragPosition = position;
+    colorBufferCoord = gl_Position.xy / 2 + vec2(0.5, 0.5);
+
+    fragLightPosition = lightPosition;
+    fragMaxDistance = maxDistance;
+    fragColor = color;
+}
+)";
+
+static const char* g_lightBatchFragmentShader = R"(
+#version 330 core
+
+uniform sampler2D colorBuffer;
+
+in vec2 fragPosition;
+in vec2 colorBufferCoord;
+flat in vec2 fragLightPosition;
+flat in float fragMaxDistance;
+flat in vec3 fragColor;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec3 sceneColor = texture(colorBuffer, colorBufferCoord).rgb;
+    vec3 lightColor = clamp(1 - length(fragPosition - fragLightPosition) / fragMaxDistance, 0, 1) * fragColor;
+
+    FragColor = vec4(sceneColor * lightColor, 1);
+}
+
+)";
+
+void LightManager::LightShaderUniforms::Resolve(const Shader& shader)
+{
+    view = shader.GetUniform<glm::mat4x4>("view");
+    colorBuffer = shader.GetUniform<Texture>("colorBuffer");
+    lightPosition = shader.GetUniform<Vector2>("lightPosition");
+    maxDistance = shader.GetUniform<float>("maxDistance");
+    intensity = shader.GetUniform<float>("intensity");
+    color = shader.GetUniform<Vector3>("color");
+    normal = shader.GetUniform<Vector2>("normal");
+    d = shader.GetUniform<float>("d");
+}
+
 LightManager::LightManager()
 {
     glGenBuffers(1, &_lightVertexVbo);
@@ -150,6 +216,7 @@ LightManager::LightManager()
     // Linear falloff light shader
     {
         _linearFalloffLightShader.Compile(g_linearFalloffLightVertexShader, g_linearFalloffLightFragmentShader);
+        _linearFalloffLightUniforms.Resolve(_linearFalloffLightShader);
 
         _linearFalloffLightShader.Use();
         glGenVertexArrays(1, &_shadowBufferVao);
@@ -162,6 +229,7 @@ LightManager::LightManager()
     // Line light shader
     {
         _lineLightShader.Compile(g_linearFalloffLightVertexShader, g_lineLinearFalloffLightFragmentShader);
+        _lineLightUniforms.Resolve(_lineLightShader);
 
         _lineLightShader.Use();
         glGenVertexArrays(1, &_lineLightVao);
@@ -174,6 +242,7 @@ LightManager::LightManager()
     // Ambient light shader
     {
         _ambientLightShader.Compile(g_ambientLightVertexShader, g_ambientLightFragmentShader);
+        _ambientLightUniforms.Resolve(_ambientLightShader);
         _ambientLightShader.Use();
 
         glGenVertexArrays(1, &_ambientLightVao);
@@ -186,6 +255,7 @@ LightManager::LightManager()
     // Stencil volumetric shadow shader
     {
         _stencilShadowShader.Compile(g_stencilShadowVertexShader, g_stencilShadowFragmentShader);
+        _stencilShadowUniforms.Resolve(_stencilShadowShader);
         _stencilShadowShader.Use();
 
         glGenVertexArrays(1, &_stencilShadowVao);
@@ -199,54 +269,124 @@ LightManager::LightManager()
         glVertexAttribPointer(0, 2, GL_FLOAT, false, 0, (void*)0);
     }
 
+    // Light batch shader
+    {
+        _lightBatchShader.Compile(g_lightBatchVertexShader, g_lightBatchFragmentShader);
+        _lightBatchUniforms.Resolve(_lightBatchShader);
+        _lightBatchShader.Use();
+
+        glGenVertexArrays(1, &_lightBatchVao);
+        glBindVertexArray(_lightBatchVao);
+
+        glGenBuffers(1, &_lightBatchVbo);
+        glBindBuffer(GL_ARRAY_BUFFER, _lightBatchVbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(LightVertex) * MaxLightBatchVertices, nullptr, GL_DYNAMIC_DRAW);
+
+        int stride = sizeof(LightVertex);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, false, stride, (void*)offsetof(LightVertex, position));
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, false, stride, (void*)offsetof(LightVertex, lightPosition));
+
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, false, stride, (void*)offsetof(LightVertex, maxDistance));
+
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, false, stride, (void*)offsetof(LightVertex, color));
+    }
+
     glBindVertexArray(0);
 }
 
 LightManager::~LightManager()
 {
     glDeleteBuffers(1, &_lightVertexVbo);
+    glDeleteBuffers(1, &_lightBatchVbo);
+}
+
+template<typename T>
+static void RemoveFromList(std::vector<T*>& list, T* item)
+{
+    list.erase(std::remove(list.begin(), list.end(), item), list.end());
 }
 
 void LightManager::AddLight(SpotLight* light)
 {
-    _spotLights.PushBackIfRoom(light);
+    _spotLights.Add(light);
 }
 
 void LightManager::AddLight(PointLight* light)
 {
-    _pointLights.PushBackIfRoom(light);
+    _pointLights.Add(light);
 }
 
 void LightManager::AddLight(AmbientLight* light)
 {
-    _ambientLights.PushBackIfRoom(light);
+    _ambientLights.push_back(light);
 }
 
 void LightManager::AddLight(CapsuleLight* light)
 {
-    _capsuleLights.PushBackIfRoom(light);
+    _capsuleLights.Add(light);
 }
 
 void LightManager::RemoveLight(SpotLight* light)
 {
-    visibleSpotLights.RemoveSingle(light);
-    _spotLights.RemoveSingle(light);
+    RemoveFromList(visibleSpotLights, light);
+    _spotLights.Remove(light);
 }
 
 void LightManager::RemoveLight(PointLight* light)
 {
-    _pointLights.RemoveSingle(light);
-    visiblePointLights.RemoveSingle(light);
+    _pointLights.Remove(light);
+    RemoveFromList(visiblePointLights, light);
 }
 
 void LightManager::RemoveLight(AmbientLight* light)
 {
-    _ambientLights.RemoveSingle(light);
+    RemoveFromList(_ambientLights, light);
+    RemoveFromList(visibleAmbientLights, light);
 }
 
 void LightManager::RemoveLight(CapsuleLight* light)
 {
-    _capsuleLights.RemoveSingle(light);
+    _capsuleLights.Remove(light);
+    RemoveFromList(visibleCapsuleLights, light);
+}
+
+void LightManager::UpdateLight(SpotLight* light)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        deferredChanges->AddAction([=] { UpdateLight(light); });
+        return;
+    }
+
+    _spotLights.Update(light);
+}
+
+void LightManager::UpdateLight(PointLight* light)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        deferredChanges->AddAction([=] { UpdateLight(light); });
+        return;
+    }
+
+    _pointLights.Update(light);
+}
+
+void LightManager::UpdateLight(CapsuleLight* light)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        deferredChanges->AddAction([=] { UpdateLight(light); });
+        return;
+    }
+
+    _capsuleLights.Update(light);
 }
 
 void AddHalfCircle(gsl::span<Vector2> vertices, Vector2 center, float radius, float startAngle)
@@ -279,139 +419,153 @@ void CreateCapsuleOutline(gsl::span<Vector2> vertices, Vector2 center, float rad
 }
 
 
-void LightManager::RenderPointLight(int id, PointLight* pointLight)
+void LightBatch::BuildOutline(
+    Vector2 position,
+    float maxDistance,
+    float facingAngle,
+    float beamAngle,
+    gsl::span<Vector2, OutlinePoints> outPoints)
 {
-    glUniform2f(glGetUniformLocation(id, "lightPosition"), pointLight->position.x, pointLight->position.y);
-    glUniform1f(glGetUniformLocation(id, "maxDistance"), pointLight->maxDistance);
-    glUniform1f(glGetUniformLocation(id, "intensity"), pointLight->intensity);
-
-    auto c = pointLight->color.ToVector4();
-    glUniform3f(glGetUniformLocation(id, "color"), c.x, c.y, c.z);
-
-    auto size = Vector2(pointLight->maxDistance, pointLight->maxDistance);
-    auto topLeft = pointLight->position - size;
-    Rectangle bounds(topLeft, size * 2);
-
-    Vector2 loop[32];
-
-    float dAngle = pointLight->beamAngle / (2 * 3.14159);
+    float startAngle = facingAngle - beamAngle / 2;
+    float dAngle = beamAngle / (OutlinePoints - 1);
 
-    for (int i = 0; i < 32; ++i)
+    for (int i = 0; i < OutlinePoints; ++i)
     {
-        float angle = i * 2 * 3.14159f / 31.0f * dAngle + pointLight->facingAngle - pointLight->beamAngle / 2;
-        loop[i] = pointLight->position + Vector2(cos(angle), sin(angle)) * pointLight->maxDistance;
+        float angle = startAngle + i * dAngle;
+        outPoints[i] = position + Vector2(cos(angle), sin(angle)) * maxDistance;
     }
+}
 
-    Vector2 vertices[32 * 2 + 1];
+void LightBatch::AddLight(Vector2 position, float maxDistance, float facingAngle, float beamAngle, float intensity, Color color)
+{
+    Vector2 outline[OutlinePoints];
+    BuildOutline(position, maxDistance, facingAngle, beamAngle, outline);
 
-    vertices[0] = pointLight->position;
+    auto c = color.ToVector4();
+    Vector3 lightColor(c.x * intensity, c.y * intensity, c.z * intensity);
 
-    for (int i = 0; i < 31; ++i)
+    for (int i = 0; i < OutlinePoints - 1; ++i)
     {
-        vertices[i * 2 + 1] = loop[i];
-        vertices[i * 2 + 2] = loop[i + 1];
+        vertices.push_back({ position, position, maxDistance, lightColor });
+        vertices.push_back({ outline[i], position, maxDistance, lightColor });
+        vertices.push_back({ outline[i + 1], position, maxDistance, lightColor });
     }
-
-
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vector2) * 65 - 2, vertices);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 65 - 2);
 }
 
-void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* texture)
+void LightManager::FindVisibleLights(const Rectangle& cameraBounds)
 {
-    auto cameraBounds = camera->Bounds();
+    PROFILE_ZONE("FindVisibleLights");
 
-    visibleSpotLights.Clear();
+    auto isDisabled = [](BaseLight* light) { return !light->isEnabled; };
 
-    // Find visible spotlights
-    for (auto spotLight : _spotLights)
-    {
-        if (spotLight->isEnabled && (spotLight->Bounds().IntersectsWith(cameraBounds)))
-        {
-            visibleSpotLights.PushBack(spotLight);
+    _spotLights.PlacePendingLights();
+    visibleSpotLights.clear();
+    _spotLights.FindIntersecting(cameraBounds, visibleSpotLights);
+    visibleSpotLights.erase(std::remove_if(visibleSpotLights.begin(), visibleSpotLights.end(), isDisabled), visibleSpotLights.end());
 
-            if (visibleSpotLights.Size() == visibleSpotLights.Capacity())
-            {
-                break;
-            }
-        }
-    }
+    _pointLights.PlacePendingLights();
+    visiblePointLights.clear();
+    _pointLights.FindIntersecting(cameraBounds, visiblePointLights);
+    visiblePointLights.erase(std::remove_if(visiblePointLights.begin(), visiblePointLights.end(), isDisabled), visiblePointLights.end());
+
+    _capsuleLights.PlacePendingLights();
+    visibleCapsuleLights.clear();
+    _capsuleLights.FindIntersecting(cameraBounds, visibleCapsuleLights);
+    visibleCapsuleLights.erase(std::remove_if(visibleCapsuleLights.begin(), visibleCapsuleLights.end(), isDisabled), visibleCapsuleLights.end());
 
-    // Find visible point lights
-    visiblePointLights.Clear();
+    // There are only a few ambient lights and their bounds are set directly, so they're not in a grid
+    visibleAmbientLights.clear();
 
-    for (auto pointLight : _pointLights)
+    for (auto ambientLight : _ambientLights)
     {
-        if (pointLight->isEnabled && pointLight->Bounds().IntersectsWith(cameraBounds))
+        if (ambientLight->bounds.IntersectsWith(cameraBounds))
         {
-            visiblePointLights.PushBack(pointLight);
-
-            if (visiblePointLights.Size() == visiblePointLights.Capacity())
-            {
-                break;
-            }
+            visibleAmbientLights.push_back(ambientLight);
         }
     }
+}
 
-    {
-        glBindVertexArray(_shadowBufferVao);
-
-        _linearFalloffLightShader.Use();
+void LightManager::RenderLightBatch()
+{
+    auto& vertices = _lightBatch.vertices;
 
-        int id = _linearFalloffLightShader.ProgramId();
+    glBindBuffer(GL_ARRAY_BUFFER, _lightBatchVbo);
 
-        glUniform1i(glGetUniformLocation(id, "colorBuffer"), 0);
+    for (int i = 0; i < vertices.size(); i += MaxLightBatchVertices)
+    {
+        int totalVertices = std::min(MaxLightBatchVertices, (int)vertices.size() - i);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture->Id());
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(LightVertex) * totalVertices, &vertices[i]);
+        glDrawArrays(GL_TRIANGLES, 0, totalVertices);
+    }
+}
 
-        glUniformMatrix4fv(glGetUniformLocation(id, "view"), 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
+void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* texture)
+{
+    PROFILE_ZONE("UpdateVisibleLights");
 
-        glBindBuffer(GL_ARRAY_BUFFER, _lightVertexVbo);
+    FindVisibleLights(camera->Bounds());
 
-        glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
-        glBlendFuncSeparate(GL_SRC_ALPHA, GL_DST_ALPHA, GL_ONE, GL_ONE);
-        glDisable(GL_DEPTH_TEST);
+    // Point lights and capsule light ends don't cast shadows, so they're drawn together
+    {
+        _lightBatch.Clear();
 
-        // Render point lights
         for (auto pointLight : visiblePointLights)
         {
-            RenderPointLight(id, pointLight);
+            _lightBatch.AddLight(
+                pointLight->position,
+                pointLight->maxDistance,
+                pointLight->facingAngle,
+                pointLight->beamAngle,
+                pointLight->intensity,
+                pointLight->color);
         }
 
-        // Render capsule light ends
-        for (auto capsuleLight : _capsuleLights)
+        for (auto capsuleLight : visibleCapsuleLights)
         {
-            if (!capsuleLight->isEnabled || !capsuleLight->Bounds().IntersectsWith(cameraBounds))
-            {
-                continue;
-            }
-
-            PointLight capsuleCap;
-
-            capsuleCap.position = RotateXY(
+            auto leftEnd = RotateXY(
                 capsuleLight->position,
                 capsuleLight->position - Vector2(capsuleLight->halfLength, 0),
                 capsuleLight->angle);
 
-            
-            capsuleCap.color = capsuleLight->color;
-            capsuleCap.maxDistance = capsuleLight->maxDistance;
-            capsuleCap.intensity = capsuleLight->intensity;
-            capsuleCap.beamAngle = 3.14159;
-            capsuleCap.facingAngle = 3 * 3.14159 / 2 + capsuleLight->angle - capsuleCap.beamAngle / 2;
-
-            RenderPointLight(id, &capsuleCap);
-
-            capsuleCap.position = RotateXY(
+            auto rightEnd = RotateXY(
                 capsuleLight->position,
                 capsuleLight->position + Vector2(capsuleLight->halfLength, 0),
                 capsuleLight->angle);
 
-            capsuleCap.facingAngle = 3.14159 / 2 + capsuleLight->angle - capsuleCap.beamAngle / 2;
-
-            RenderPointLight(id, &capsuleCap);
+            _lightBatch.AddLight(
+                leftEnd,
+                capsuleLight->maxDistance,
+                3.14159 + capsuleLight->angle,
+                3.14159,
+                capsuleLight->intensity,
+                capsuleLight->color);
+
+            _lightBatch.AddLight(
+                rightEnd,
+                capsuleLight->maxDistance,
+                capsuleLight->angle,
+                3.14159,
+                capsuleLight->intensity,
+                capsuleLight->color);
         }
+
+        glBindVertexArray(_lightBatchVao);
+
+        _lightBatchShader.Use();
+
+        glUniform1i(_lightBatchUniforms.colorBuffer.id, 0);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture->Id());
+
+        glUniformMatrix4fv(_lightBatchUniforms.view.id, 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
+
+        glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_DST_ALPHA, GL_ONE, GL_ONE);
+        glDisable(GL_DEPTH_TEST);
+
+        RenderLightBatch();
     }
 
     // Render capsule lights
@@ -419,24 +573,19 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
         glBindVertexArray(_lineLightVao);
         _lineLightShader.Use();
 
-        int id = _lineLightShader.ProgramId();
+        auto& uniforms = _lineLightUniforms;
 
-        glUniform1i(glGetUniformLocation(id, "colorBuffer"), 0);
+        glUniform1i(uniforms.colorBuffer.id, 0);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture->Id());
 
-        glUniformMatrix4fv(glGetUniformLocation(id, "view"), 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
+        glUniformMatrix4fv(uniforms.view.id, 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
 
         glBindBuffer(GL_ARRAY_BUFFER, _lightVertexVbo);
 
-        for (auto capsuleLight : _capsuleLights)
+        for (auto capsuleLight : visibleCapsuleLights)
         {
-            if (!capsuleLight->isEnabled || !capsuleLight->Bounds().IntersectsWith(cameraBounds))
-            {
-                continue;
-            }
-
             auto v1 = RotateXY(
                 capsuleLight->position,
                 capsuleLight->position - Vector2(capsuleLight->halfLength, 0),
@@ -449,17 +598,17 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
 
             auto dir = v2 - v1;
             auto axis = Vector2(-dir.y, dir.x).Normalize();
-            glUniform2f(glGetUniformLocation(id, "normal"), axis.x, axis.y);
+            glUniform2f(uniforms.normal.id, axis.x, axis.y);
 
             auto d = -axis.Dot(v1);
-            glUniform1f(glGetUniformLocation(id, "d"), d);
+            glUniform1f(uniforms.d.id, d);
 
-            glUniform1f(glGetUniformLocation(id, "maxDistance"), capsuleLight->maxDistance);
+            glUniform1f(uniforms.maxDistance.id, capsuleLight->maxDistance);
 
-            glUniform1f(glGetUniformLocation(id, "intensity"), capsuleLight->intensity);
+            glUniform1f(uniforms.intensity.id, capsuleLight->intensity);
 
             auto c = capsuleLight->color.ToVector4();
-            glUniform3f(glGetUniformLocation(id, "color"), c.x, c.y, c.z);
+            glUniform3f(uniforms.color.id, c.x, c.y, c.z);
 
             Vector2 halfSize(capsuleLight->halfLength, capsuleLight->maxDistance);
             Rectangle bounds(capsuleLight->position - halfSize, halfSize * 2);
@@ -489,28 +638,23 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
 
         _ambientLightShader.Use();
 
-        int id = _ambientLightShader.ProgramId();
+        auto& uniforms = _ambientLightUniforms;
 
-        glUniform1i(glGetUniformLocation(id, "colorBuffer"), 0);
+        glUniform1i(uniforms.colorBuffer.id, 0);
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture->Id());
 
-        glUniformMatrix4fv(glGetUniformLocation(id, "view"), 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
+        glUniformMatrix4fv(uniforms.view.id, 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
 
         glBindBuffer(GL_ARRAY_BUFFER, _lightVertexVbo);
 
-        for (auto ambientLight : _ambientLights)
+        for (auto ambientLight : visibleAmbientLights)
         {
-            if (!ambientLight->bounds.IntersectsWith(cameraBounds))
-            {
-                continue;
-            }
-
-            glUniform1f(glGetUniformLocation(id, "intensity"), ambientLight->intensity);
+            glUniform1f(uniforms.intensity.id, ambientLight->intensity);
 
             auto c = ambientLight->color.ToVector4();
-            glUniform3f(glGetUniformLocation(id, "color"), c.x, c.y, c.z);
+            glUniform3f(uniforms.color.id, c.x, c.y, c.z);
 
             Rectangle& bounds = ambientLight->bounds;
 
@@ -526,6 +670,14 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
     }
 
     // Render spot lights
+    if (!visibleSpotLights.empty())
+    {
+        _linearFalloffLightShader.Use();
+
+        glUniform1i(_linearFalloffLightUniforms.colorBuffer.id, 0);
+        glUniformMatrix4fv(_linearFalloffLightUniforms.view.id, 1, GL_FALSE, &camera->ViewMatrix()[0][0]);
+    }
+
     for (auto spotLight : visibleSpotLights)
     {
         glStencilMask(0xFF);
@@ -537,7 +689,7 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
             continue;
         }
 
-        glBindVertexArray(_lightVertexVbo);
+        glBindVertexArray(_shadowBufferVao);
         _linearFalloffLightShader.Use();
         glBindBuffer(GL_ARRAY_BUFFER, _lightVertexVbo);
 
@@ -546,37 +698,28 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
         glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
         glStencilMask(0);
 
-        int id = _linearFalloffLightShader.ProgramId();
+        auto& uniforms = _linearFalloffLightUniforms;
 
-        glUniform2f(glGetUniformLocation(id, "lightPosition"), spotLight->position.x, spotLight->position.y);
-        glUniform1f(glGetUniformLocation(id, "maxDistance"), spotLight->maxDistance);
-        glUniform1f(glGetUniformLocation(id, "intensity"), spotLight->intensity);
+        glUniform2f(uniforms.lightPosition.id, spotLight->position.x, spotLight->position.y);
+        glUniform1f(uniforms.maxDistance.id, spotLight->maxDistance);
+        glUniform1f(uniforms.intensity.id, spotLight->intensity);
 
         auto c = spotLight->color.ToVector4();
-        glUniform3f(glGetUniformLocation(id, "color"), c.x, c.y, c.z);
-
-        Vector2 loop[32];
+        glUniform3f(uniforms.color.id, c.x, c.y, c.z);
 
-        float dAngle = spotLight->beamAngle / (2 * 3.14159);
-
-        for (int i = 0; i < 32; ++i)
-        {
-            float angle = i * 2 * 3.14159f / 31.0f * dAngle + spotLight->facingAngle - spotLight->beamAngle / 2;
-            loop[i] = spotLight->position + Vector2(cos(angle), sin(angle)) * spotLight->maxDistance;
-        }
-
-        Vector2 vertices[32 * 2 + 1];
+        // Drawn as a fan around the light
+        Vector2 vertices[LightBatch::OutlinePoints + 1];
 
         vertices[0] = spotLight->position;
-
-        for (int i = 0; i < 31; ++i)
-        {
-            vertices[i * 2 + 1] = loop[i];
-            vertices[i * 2 + 2] = loop[i + 1];
-        }
-
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vector2) * 65 - 2, vertices);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, 65 - 2);
+        LightBatch::BuildOutline(
+            spotLight->position,
+            spotLight->maxDistance,
+            spotLight->facingAngle,
+            spotLight->beamAngle,
+            gsl::span<Vector2, LightBatch::OutlinePoints>(vertices + 1, LightBatch::OutlinePoints));
+
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, LightBatch::OutlinePoints + 1);
         glDisable(GL_STENCIL_TEST);
     }
 
@@ -586,11 +729,9 @@ void LightManager::UpdateVisibleLights(Camera* camera, Scene* scene, Texture* te
 
 bool LightManager::RenderShadows(Scene* scene, SpotLight* spotLight, Camera* cam)
 {
-    static ColliderHandle overlappingColliders[8192];
-
     _shadowVertices.Clear();
 
-    auto colliders = scene->FindOverlappingColliders(spotLight->Bounds(), overlappingColliders);
+    auto colliders = scene->FindOverlappingColliders(spotLight->Bounds());
 
 
     for (auto collider : colliders)
@@ -692,7 +833,7 @@ bool LightManager::RenderShadows(Scene* scene, SpotLight* spotLight, Camera* cam
     glBindVertexArray(_stencilShadowVao);
     _stencilShadowShader.Use();
 
-    glUniformMatrix4fv(glGetUniformLocation(_stencilShadowShader.ProgramId(), "view"), 1, GL_FALSE, &cam->ViewMatrix()[0][0]);
+    glUniformMatrix4fv(_stencilShadowUniforms.view.id, 1, GL_FALSE, &cam->ViewMatrix()[0][0]);
 
     glBindBuffer(GL_ARRAY_BUFFER, _stencilShadowVertexVbo);
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vector2) * _shadowVertices.Size(), _shadowVertices.begin());
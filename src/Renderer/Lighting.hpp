@@ -1,7 +1,11 @@
 #pragma once
+#include <vector>
+#include <glm/mat4x4.hpp>
+
 #include "Color.hpp"
 #include "FrameBuffer.hpp"
 #include "GL/Shader.hpp"
+#include "LightGrid.hpp"
 #include "Math/Rectangle.hpp"
 #include "Math/Vector2.hpp"
 #include "Memory/FixedLengthString.hpp"
@@ -52,6 +56,7 @@ struct PointLight : BaseLight
 
 struct CapsuleLight : BaseLight
 {
+    // Big enough for any angle, so turning the light doesn't move it in the light grid
     Rectangle Bounds() const
     {
         float max = maxDistance * 2 + halfLength * 2;
@@ -70,12 +75,45 @@ struct AmbientLight
     float intensity;
 };
 
+/// <summary>
+/// Vertex of the point light batch. The light's properties are repeated in each of its vertices so that all the lights
+/// without shadows can be drawn at once.
+/// </summary>
+struct LightVertex
+{
+    Vector2 position;
+    Vector2 lightPosition;
+    float maxDistance;
+    Vector3 color;      // Multiplied by the intensity
+};
+
+/// <summary>
+/// Triangles of the lights drawn in one batch
+/// </summary>
+struct LightBatch
+{
+    static constexpr int OutlinePoints = 32;
+    static constexpr int VerticesPerLight = (OutlinePoints - 1) * 3;
+
+    /// <summary>
+    /// Writes the points of the arc at maxDistance from position that spans beamAngle, centered on facingAngle
+    /// </summary>
+    static void BuildOutline(
+        Vector2 position,
+        float maxDistance,
+        float facingAngle,
+        float beamAngle,
+        gsl::span<Vector2, OutlinePoints> outPoints);
+
+    void AddLight(Vector2 position, float maxDistance, float facingAngle, float beamAngle, float intensity, Color color);
+    void Clear() { vertices.clear(); }
+
+    std::vector<LightVertex> vertices;
+};
+
 class LightManager
 {
 public:
-    static constexpr int MaxVisibleSpotLights = 128;
-    static constexpr int MaxVisiblePointLights = 128;
-
     LightManager();
     ~LightManager();
 
@@ -89,32 +127,76 @@ public:
     void RemoveLight(AmbientLight* light);
     void RemoveLight(CapsuleLight* light);
 
-    void RenderPointLight(int id, PointLight* pointLight);
-    void UpdateVisibleLights(Camera* camera, Scene* scene, Texture* texture);
+    /// <summary>
+    /// Must be called after a light's position, maxDistance or halfLength changes, otherwise it may not be found when
+    /// it's visible. The light grid isn't thread safe, so calls from a concurrent hook are applied when the hook's
+    /// changes are merged.
+    /// </summary>
+    void UpdateLight(SpotLight* light);
+    void UpdateLight(PointLight* light);
+    void UpdateLight(CapsuleLight* light);
 
-    FixedSizeVector<SpotLight*, 64> visibleSpotLights;
-    FixedSizeVector<PointLight*, 64> visiblePointLights;
+    /// <summary>
+    /// Fills the visible light lists with the enabled lights that touch the bounds
+    /// </summary>
+    void FindVisibleLights(const Rectangle& cameraBounds);
 
-    FixedSizeVector<SpotLight*, 1024> _spotLights;
-    FixedSizeVector<PointLight*, 1024> _pointLights;
-    FixedSizeVector<AmbientLight*, 1024> _ambientLights;
-    FixedSizeVector<CapsuleLight*, 1024> _capsuleLights;
+    void UpdateVisibleLights(Camera* camera, Scene* scene, Texture* texture);
+
+    std::vector<SpotLight*> visibleSpotLights;
+    std::vector<PointLight*> visiblePointLights;
+    std::vector<CapsuleLight*> visibleCapsuleLights;
+    std::vector<AmbientLight*> visibleAmbientLights;
 
 private:
     static constexpr int MaxLightVertices = 128;
+    static constexpr int MaxLightBatchVertices = LightBatch::VerticesPerLight * 256;
     static constexpr int MaxShadowVertices = 8192;
 
+    // Locations are looked up once after compiling. Uniforms a shader doesn't have are -1, which GL ignores.
+    struct LightShaderUniforms
+    {
+        void Resolve(const Shader& shader);
+
+        ShaderUniform<glm::mat4x4> view;
+        ShaderUniform<Texture> colorBuffer;
+        ShaderUniform<Vector2> lightPosition;
+        ShaderUniform<float> maxDistance;
+        ShaderUniform<float> intensity;
+        ShaderUniform<Vector3> color;
+        ShaderUniform<Vector2> normal;
+        ShaderUniform<float> d;
+    };
+
+    void RenderLightBatch();
     bool RenderShadows(Scene* scene, SpotLight* spotLight, Camera* cam);
 
+    LightGrid<SpotLight> _spotLights;
+    LightGrid<PointLight> _pointLights;
+    LightGrid<CapsuleLight> _capsuleLights;
+    std::vector<AmbientLight*> _ambientLights;
+
+    LightBatch _lightBatch;
+
     Shader _linearFalloffLightShader;
+    Shader _lightBatchShader;
     Shader _lineLightShader;
     Shader _ambientLightShader;
 
+    LightShaderUniforms _linearFalloffLightUniforms;
+    LightShaderUniforms _lightBatchUniforms;
+    LightShaderUniforms _lineLightUniforms;
+    LightShaderUniforms _ambientLightUniforms;
+    LightShaderUniforms _stencilShadowUniforms;
+
     unsigned int _lightVertexVbo;
     unsigned int _shadowBufferVao;
     unsigned int _ambientLightVao;
     unsigned int _lineLightVao;
 
+    unsigned int _lightBatchVbo;
+    unsigned int _lightBatchVao;
+
     Shader _stencilShadowShader;
     unsigned int _stencilShadowVertexVbo;
     unsigned int _stencilShadowVao;
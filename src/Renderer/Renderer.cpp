@@ -87,6 +87,15 @@ void Renderer::RenderSprite(const Sprite* sprite, const Vector2 position, float
     spriteEffect->RenderPolygon(v, sprite->GetTexture());
 }
 
+void Renderer::BuildSpriteQuad(const Sprite* sprite, Vector2 position, float depth, RenderVertex outVertices[4]) const
+{
+    Rectangle bounds(
+        position,
+        sprite->Bounds().Size());
+
+    ConstructSpriteQuad(bounds, sprite->UVBounds(), depth, 0, Color(), false, outVertices);
+}
+
 void Renderer::RenderString(const FontSettings& fontSettings, const char* str, Vector2 topLeft, float depth)
 {
     if (fontSettings.spriteFont == nullptr)
@@ -280,6 +289,11 @@ void Renderer::RenderPolygon(gsl::span<RenderVertex> vertices, Texture* texture)
     spriteEffect->RenderPolygon(vertices, texture);
 }
 
+void Renderer::RenderQuads(gsl::span<RenderVertex> vertices, gsl::span<Texture*> textures, Vector2 offset)
+{
+    spriteEffect->RenderQuads(vertices, textures, offset + _renderOffset);
+}
+
 void Renderer::RenderSolidColorPolygon(gsl::span<Vector2> vertices, Color color, float depth)
 {
     RenderVertex rv[128];
@@ -76,7 +76,18 @@ public:
 
     void RenderSprite(const Sprite* sprite, Vector2 position, float depth, Vector2 scale = Vector2(1, 1), float angle = 0, bool flipHorizontal = false, Color blendColor = Color());
 
+    /// <summary>
+    /// Fills in the vertices RenderSprite() would submit with the default scale, angle and color, except for the render
+    /// offset, for callers that cache them and submit them with RenderQuads()
+    /// </summary>
+    void BuildSpriteQuad(const Sprite* sprite, Vector2 position, float depth, RenderVertex outVertices[4]) const;
+
     void RenderPolygon(gsl::span<RenderVertex> vertices, Texture* texture);
+
+    /// <summary>
+    /// Submits cached quads, four vertices per texture, moved by the offset and the render offset
+    /// </summary>
+    void RenderQuads(gsl::span<RenderVertex> vertices, gsl::span<Texture*> textures, Vector2 offset);
     void RenderSolidColorPolygon(gsl::span<Vector2> vertices, Color color, float depth);
 
     void RenderString(const FontSettings& fontSettings, const char* str, Vector2 topLeft, float depth);
@@ -0,0 +1,133 @@
+#include <algorithm>
+
+#include "SpriteBatcher.hpp"
+#include "System/Logger.hpp"
+
+SpriteBatcher::SpriteBatcher(int maxVerticesInBatch)
+    : _maxVerticesInBatch(maxVerticesInBatch),
+    _maxIndicesInBatch(maxVerticesInBatch * 3)
+{
+    if (maxVerticesInBatch > 65536)
+    {
+        FatalError("Sprite batches can't have more than 65536 vertices (requested %d)", maxVerticesInBatch);
+    }
+
+    _batchVertices = std::make_unique<RenderVertex[]>(_maxVerticesInBatch);
+    _batchIndices = std::make_unique<uint16_t[]>(_maxIndicesInBatch);
+}
+
+void SpriteBatcher::AddPolygon(gsl::span<RenderVertex> vertices, Texture* texture)
+{
+    if (vertices.size() < 3)
+    {
+        return;
+    }
+
+    if ((int)vertices.size() > _maxVerticesInBatch)
+    {
+        FatalError("Polygon has too many vertices for a sprite batch (%d > %d)", (int)vertices.size(), _maxVerticesInBatch);
+    }
+
+    PolygonCommand command;
+    command.depth = vertices[0].position.z;
+    command.texture = texture;
+    command.firstVertex = _pendingVertices.size();
+    command.vertexCount = vertices.size();
+
+    _pendingVertices.insert(_pendingVertices.end(), vertices.begin(), vertices.end());
+    _commands.push_back(command);
+}
+
+void SpriteBatcher::AddQuads(gsl::span<RenderVertex> vertices, gsl::span<Texture*> textures, Vector2 offset)
+{
+    if (vertices.size() != textures.size() * 4)
+    {
+        FatalError("Expected 4 vertices per quad (%d vertices for %d quads)", (int)vertices.size(), (int)textures.size());
+    }
+
+    int firstVertex = _pendingVertices.size();
+    _pendingVertices.insert(_pendingVertices.end(), vertices.begin(), vertices.end());
+
+    for (int i = firstVertex; i < (int)_pendingVertices.size(); ++i)
+    {
+        _pendingVertices[i].position.x += offset.x;
+        _pendingVertices[i].position.y += offset.y;
+    }
+
+    for (int i = 0; i < (int)textures.size(); ++i)
+    {
+        PolygonCommand command;
+        command.depth = vertices[i * 4].position.z;
+        command.texture = textures[i];
+        command.firstVertex = firstVertex + i * 4;
+        command.vertexCount = 4;
+
+        _commands.push_back(command);
+    }
+}
+
+void SpriteBatcher::Flush(const std::function<void(const SpriteBatch& batch)>& drawBatch)
+{
+    lastFlushPolygonCount = _commands.size();
+    lastFlushBatchCount = 0;
+
+    if (_commands.empty())
+    {
+        return;
+    }
+
+    // Stable so that polygons at the same depth are drawn in the order they were submitted
+    std::stable_sort(_commands.begin(), _commands.end(), [](const PolygonCommand& lhs, const PolygonCommand& rhs)
+    {
+        return lhs.depth > rhs.depth;
+    });
+
+    SpriteBatch batch;
+    int vertexCount = 0;
+    int indexCount = 0;
+
+    auto drawCurrentBatch = [&]()
+    {
+        if (vertexCount == 0) return;
+
+        batch.vertices = gsl::span<RenderVertex>(_batchVertices.get(), vertexCount);
+        batch.indices = gsl::span<uint16_t>(_batchIndices.get(), indexCount);
+        drawBatch(batch);
+
+        ++lastFlushBatchCount;
+        vertexCount = 0;
+        indexCount = 0;
+    };
+
+    for (auto& command : _commands)
+    {
+        int polygonIndexCount = (command.vertexCount - 2) * 3;
+
+        bool canMerge = vertexCount > 0
+            && command.texture == batch.texture
+            && vertexCount + command.vertexCount <= _maxVerticesInBatch
+            && indexCount + polygonIndexCount <= _maxIndicesInBatch;
+
+        if (!canMerge)
+        {
+            drawCurrentBatch();
+            batch.texture = command.texture;
+        }
+
+        // Split the convex polygon into triangles
+        for (int i = 1; i < command.vertexCount - 1; ++i)
+        {
+            _batchIndices[indexCount++] = vertexCount;
+            _batchIndices[indexCount++] = vertexCount + i;
+            _batchIndices[indexCount++] = vertexCount + i + 1;
+        }
+
+        std::copy_n(_pendingVertices.begin() + command.firstVertex, command.vertexCount, _batchVertices.get() + vertexCount);
+        vertexCount += command.vertexCount;
+    }
+
+    drawCurrentBatch();
+
+    _commands.clear();
+    _pendingVertices.clear();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "RenderVertex.hpp"
+#include "gsl/span"
+
+struct Texture;
+
+/// <summary>
+/// A run of polygons that share a texture, drawn with a single indexed draw call
+/// </summary>
+struct SpriteBatch
+{
+    Texture* texture;
+    gsl::span<RenderVertex> vertices;
+    gsl::span<uint16_t> indices;
+};
+
+/// <summary>
+/// Collects the polygons submitted between flushes, sorts them back to front by depth and merges consecutive polygons
+/// with the same texture into as few batches as fit. Polygons at the same depth keep their submission order, since
+/// they may overlap, so only runs that are already adjacent at a depth are merged. Doesn't touch OpenGL or the
+/// textures; the caller supplies the draw call.
+/// </summary>
+class SpriteBatcher
+{
+public:
+    explicit SpriteBatcher(int maxVerticesInBatch);
+
+    void AddPolygon(gsl::span<RenderVertex> vertices, Texture* texture);
+
+    /// <summary>
+    /// Adds quads that were built ahead of time, four vertices per texture, moved by the offset. Same result as
+    /// calling AddPolygon() for each quad, without copying them one at a time.
+    /// </summary>
+    void AddQuads(gsl::span<RenderVertex> vertices, gsl::span<Texture*> textures, Vector2 offset);
+    void Flush(const std::function<void(const SpriteBatch& batch)>& drawBatch);
+
+    bool IsEmpty() const { return _commands.empty(); }
+
+    int MaxVerticesInBatch() const { return _maxVerticesInBatch; }
+    int MaxIndicesInBatch() const { return _maxIndicesInBatch; }
+
+    // Stats for the most recent flush
+    int lastFlushPolygonCount = 0;
+    int lastFlushBatchCount = 0;
+
+private:
+    struct PolygonCommand
+    {
+        float depth;
+        Texture* texture;
+        int firstVertex;
+        int vertexCount;
+    };
+
+    int _maxVerticesInBatch;
+    int _maxIndicesInBatch;
+
+    std::vector<RenderVertex> _pendingVertices;
+    std::vector<PolygonCommand> _commands;
+
+    std::unique_ptr<RenderVertex[]> _batchVertices;
+    std::unique_ptr<uint16_t[]> _batchIndices;
+};
@@ -3,11 +3,11 @@
 #include "Camera.hpp"
 
 SpriteEffect::SpriteEffect(Shader* shader, int batchSize)
-    : Effect(shader)
+    : Effect(shader),
+    batcher(batchSize)
 {
-    vertexVbo = CreateBuffer<RenderVertex>(batchSize, VboType::Vertex);
-    maxVerticesInBatch = batchSize;
-    vertices = std::make_unique<RenderVertex[]>(maxVerticesInBatch);
+    vertexVbo = CreateBuffer<RenderVertex>(batcher.MaxVerticesInBatch(), VboType::Vertex);
+    indexVbo = CreateBuffer<uint16_t>(batcher.MaxIndicesInBatch(), VboType::Element);
 
     BindVertexAttribute("aPos", vertexVbo, [=](auto rv) { return &rv->position; });
     BindVertexAttribute("textureCoord", vertexVbo, [=](auto rv) { return &rv->textureCoord; });
@@ -24,44 +24,35 @@ void SpriteEffect::Start()
 
 void SpriteEffect::RenderPolygon(gsl::span<RenderVertex> vertices, Texture* texture)
 {
-    if (currentTexture == nullptr)
+    // Makes sure whatever was drawn before is flushed first, and that the stage flushes these polygons when it ends
+    if (renderer->activeEffect != this)
     {
-        currentTexture = texture;
+        renderer->SetActiveEffect(this);
     }
 
-    if (texture->Id() != currentTexture->Id())
-    {
-        FlushEffect();
-        currentTexture = texture;
-    }
+    batcher.AddPolygon(vertices, texture);
+}
 
-    // Split the convex polygon into triangles
+void SpriteEffect::RenderQuads(gsl::span<RenderVertex> vertices, gsl::span<Texture*> textures, Vector2 offset)
+{
+    if (renderer->activeEffect != this)
     {
-        int first = 0;
-
-        for (int i = 1; i < vertices.size() - 1; ++i)
-        {
-            int a = first, b = first + i, c = first + i + 1;
-
-            if (currentVertexCount + 3 > maxVerticesInBatch)
-            {
-                FlushEffect();
-            }
-
-            this->vertices[currentVertexCount++] = vertices[a];
-            this->vertices[currentVertexCount++] = vertices[b];
-            this->vertices[currentVertexCount++] = vertices[c];
-        }
+        renderer->SetActiveEffect(this);
     }
+
+    batcher.AddQuads(vertices, textures, offset);
 }
 
 void SpriteEffect::Flush()
 {
-    if (currentVertexCount == 0) return;
+    batcher.Flush([=](const SpriteBatch& batch) { DrawBatch(batch); });
+}
 
-    renderer->BindTexture(spriteTexture, currentTexture, 0);
-    vertexVbo->BufferSub(gsl::span<RenderVertex>(vertices.get(), currentVertexCount));
-    glDrawArrays(GL_TRIANGLES, 0, currentVertexCount);
+void SpriteEffect::DrawBatch(const SpriteBatch& batch)
+{
+    renderer->BindTexture(spriteTexture, batch.texture, 0);
+    vertexVbo->BufferSub(batch.vertices);
+    indexVbo->BufferSub(batch.indices);
 
-    currentVertexCount = 0;
+    glDrawElements(GL_TRIANGLES, batch.indices.size(), GL_UNSIGNED_SHORT, nullptr);
 }
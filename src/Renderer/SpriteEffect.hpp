@@ -3,6 +3,7 @@
 #include "GL/Shader.hpp"
 #include "glm/mat4x4.hpp"
 #include "RenderVertex.hpp"
+#include "SpriteBatcher.hpp"
 #include "gsl/span"
 
 struct SpriteEffect : Effect
@@ -12,14 +13,16 @@ struct SpriteEffect : Effect
     void Start() override;
     void Flush() override;
     void RenderPolygon(gsl::span<RenderVertex> vertices, Texture* texture);
+    void RenderQuads(gsl::span<RenderVertex> vertices, gsl::span<Texture*> textures, Vector2 offset);
 
     ShaderUniform<glm::mat4x4> view;
     ShaderUniform<Texture> spriteTexture;
 
     Vbo<RenderVertex>* vertexVbo;
+    Vbo<uint16_t>* indexVbo;
 
-    std::unique_ptr<RenderVertex[]> vertices;
-    int currentVertexCount = 0;
-    int maxVerticesInBatch;
-    Texture* currentTexture = nullptr;
-};
\ No newline at end of file
+    SpriteBatcher batcher;
+
+private:
+    void DrawBatch(const SpriteBatch& batch);
+};
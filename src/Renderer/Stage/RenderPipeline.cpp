@@ -3,6 +3,7 @@
 #include "Scene/Scene.hpp"
 #include "Tools/Console.hpp"
 #include "Scene/IEntityEvent.hpp"
+#include "Tools/Profiler.hpp"
 
 PipelineRunner& PipelineRunner::ModifyRendererState(const std::function<void(RendererState&)>& modifyState)
 {
@@ -12,6 +13,8 @@ PipelineRunner& PipelineRunner::ModifyRendererState(const std::function<void(Ren
 
 PipelineRunner& PipelineRunner::RunStage(const std::function<void(RenderPipelineState&)>& executeStage)
 {
+    PROFILE_ZONE("RenderStage");
+
     executeStage(state);
     state.rendererState->FlushActiveEffect();
     return *this;
@@ -1,5 +1,7 @@
 #include "TilemapRenderer.hpp"
 
+#include <algorithm>
+
 #include "Camera.hpp"
 #include "Renderer.hpp"
 #include "Resource/SpriteResource.hpp"
@@ -38,77 +40,174 @@ void TilemapRenderer::SetMapSegment(const MapSegment* mapSegment, Scene* scene)
     {
         _layers.emplace_back(&layer);
     }
-}
 
+    _isLaidOut = false;
+}
 
-void TilemapRenderer::Render(Renderer* renderer) const
+void TilemapRenderer::Render(Renderer* renderer)
 {
-    if (_scene->perspective == ScenePerspective::Isometric)
+    if (!_isLaidOut)
     {
-        int layerId = 0;
+        LayOutChunks();
+    }
+
+    auto cameraBounds = renderer->GetCamera()->Bounds();
+    _stats = TilemapRenderStats();
+
+    for (int layerIndex = 0; layerIndex < (int)_layers.size(); ++layerIndex)
+    {
+        auto& layer = _layers[layerIndex];
+
+        _visibleChunks.clear();
+        GetVisibleChunks(layerIndex, cameraBounds, _visibleChunks);
 
-        for (auto& layer : _layers)
+        _stats.totalChunks += layer.chunks.size();
+        _stats.visibleChunks += _visibleChunks.size();
+
+        for (int chunkIndex : _visibleChunks)
         {
-            auto& map = layer.GetMapLayer()->tileMap;
-            for (int i = 0; i < map.Rows(); ++i)
+            auto& chunk = layer.chunks[chunkIndex];
+
+            if (!chunk.isBuilt)
             {
-                for (int j = 0; j < map.Cols(); ++j)
-                {
-                    if (map[i][j] == nullptr) continue;
-
-                    int layerToUse = layerId != 0 ? layerId : -1;
-                    auto position = _scene->isometricSettings.TileToScreen(Vector2(j, i));
-                    auto worldPosition = _scene->isometricSettings.TileToWorld(Vector2(j, i) + Vector2(0.5));
-                    renderer->RenderSprite(&map[i][j]->sprite, position - Vector2(32, 32), _scene->isometricSettings.GetTileDepth(worldPosition, layerToUse));
-                }
+                BuildChunk(renderer, layerIndex, chunkIndex);
             }
-            ++layerId;
+
+            renderer->RenderQuads(chunk.vertices, chunk.textures, GetLayerOffset(layerIndex));
+
+            _stats.submittedQuads += chunk.totalTiles;
         }
     }
-    else
+}
+
+void TilemapRenderer::GetVisibleChunks(int layerIndex, const Rectangle& cameraBounds, std::vector<int>& outChunks)
+{
+    if (!_isLaidOut)
     {
-        auto depth = TilemapBackgroundLayer;
+        LayOutChunks();
+    }
+
+    auto& chunks = _layers[layerIndex].chunks;
+
+    // Chunks are laid out without the layer's offset
+    auto bounds = cameraBounds.AddPosition(-GetLayerOffset(layerIndex));
 
-        for (auto& layer : _layers)
+    for (int i = 0; i < (int)chunks.size(); ++i)
+    {
+        if (chunks[i].totalTiles != 0 && chunks[i].bounds.IntersectsWith(bounds))
         {
-            auto mapLayer = layer.GetMapLayer();
-            auto& tileMap = mapLayer->tileMap;
-            auto tileSize = mapLayer->tileSize.AsVectorOfType<float>();
-            auto camera = renderer->GetCamera();
+            outChunks.push_back(i);
+        }
+    }
+}
 
-            Rectangle bounds(layer.Offset(), Vector2(tileMap.Cols(), tileMap.Cols()) * tileSize);
+void TilemapRenderer::LayOutChunks()
+{
+    auto depth = TilemapBackgroundLayer;
 
-            if (!camera->Bounds().IntersectsWith(bounds))
-            {
-                return;
-            }
+    for (int layerIndex = 0; layerIndex < (int)_layers.size(); ++layerIndex)
+    {
+        auto& layer = _layers[layerIndex];
+        auto& tileMap = layer.GetMapLayer()->tileMap;
+        int chunkRows = (tileMap.Rows() + ChunkSize - 1) / ChunkSize;
 
-            auto cameraBounds = camera->Bounds();
-            auto topLeft = ((cameraBounds.TopLeft() - bounds.TopLeft()) / tileSize)
-                .Floor()
-                .Max(Vector2i(0, 0));
-            auto bottomRight = ((cameraBounds.BottomRight() - bounds.TopLeft()) / tileSize)
-                .Floor()
-                .Min(Vector2i(tileMap.Cols() - 1, tileMap.Rows() - 1));
+        layer.orthographicDepth = depth;
+        depth -= 0.00001;
 
-            for (int i = topLeft.y; i <= bottomRight.y; ++i)
+        layer.chunkCols = (tileMap.Cols() + ChunkSize - 1) / ChunkSize;
+        layer.chunks.clear();
+        layer.chunks.resize(chunkRows * layer.chunkCols);
+
+        // The bounds come from the quads themselves, so they cover the diamond of an isometric chunk and any tiles
+        // whose sprites are larger than a tile
+        for (int i = 0; i < tileMap.Rows(); ++i)
+        {
+            for (int j = 0; j < tileMap.Cols(); ++j)
             {
-                for (int j = topLeft.x; j <= bottomRight.x; ++j)
-                {
-                    TileProperties* tile = tileMap[i][j];
-                    if (tile != nullptr)
-                    {
-                        renderer->RenderSprite(
-                            &tile->sprite,
-                            Vector2(layer.Offset() + Vector2(j, i) * tileSize),
-                            depth);
-                    }
-                }
+                TileProperties* tile = tileMap[i][j];
+                if (tile == nullptr) continue;
+
+                auto& chunk = layer.chunks[(i / ChunkSize) * layer.chunkCols + j / ChunkSize];
+                Rectangle quad(GetTilePosition(layerIndex, i, j), tile->sprite.Bounds().Size());
+
+                chunk.bounds = chunk.totalTiles == 0 ? quad : chunk.bounds.Union(quad);
+                ++chunk.totalTiles;
             }
+        }
+    }
 
-            depth -= 0.00001;
+    _isLaidOut = true;
+}
+
+void TilemapRenderer::BuildChunk(Renderer* renderer, int layerIndex, int chunkIndex)
+{
+    auto& layer = _layers[layerIndex];
+    auto& tileMap = layer.GetMapLayer()->tileMap;
+    auto& chunk = layer.chunks[chunkIndex];
+
+    int firstRow = chunkIndex / layer.chunkCols * ChunkSize;
+    int firstCol = chunkIndex % layer.chunkCols * ChunkSize;
+    int endRow = std::min(firstRow + ChunkSize, tileMap.Rows());
+    int endCol = std::min(firstCol + ChunkSize, tileMap.Cols());
+
+    chunk.vertices.resize(chunk.totalTiles * 4);
+    chunk.textures.clear();
+
+    for (int i = firstRow; i < endRow; ++i)
+    {
+        for (int j = firstCol; j < endCol; ++j)
+        {
+            TileProperties* tile = tileMap[i][j];
+            if (tile == nullptr) continue;
+
+            renderer->BuildSpriteQuad(
+                &tile->sprite,
+                GetTilePosition(layerIndex, i, j),
+                GetTileDepth(layerIndex, i, j),
+                chunk.vertices.data() + chunk.textures.size() * 4);
+
+            chunk.textures.push_back(tile->sprite.GetTexture());
         }
     }
+
+    chunk.isBuilt = true;
+}
+
+Vector2 TilemapRenderer::GetTilePosition(int layerIndex, int row, int col) const
+{
+    if (_scene->perspective == ScenePerspective::Isometric)
+    {
+        return _scene->isometricSettings.TileToScreen(Vector2(col, row)) - Vector2(32, 32);
+    }
+    else
+    {
+        auto tileSize = _layers[layerIndex].GetMapLayer()->tileSize.AsVectorOfType<float>();
+
+        return Vector2(col, row) * tileSize;
+    }
+}
+
+Vector2 TilemapRenderer::GetLayerOffset(int layerIndex) const
+{
+    // Isometric tiles have always been drawn without the tilemap's offset
+    return _scene->perspective == ScenePerspective::Isometric
+        ? Vector2(0, 0)
+        : _layers[layerIndex].Offset();
+}
+
+float TilemapRenderer::GetTileDepth(int layerIndex, int row, int col) const
+{
+    if (_scene->perspective == ScenePerspective::Isometric)
+    {
+        int layerToUse = layerIndex != 0 ? layerIndex : -1;
+        auto worldPosition = _scene->isometricSettings.TileToWorld(Vector2(col, row) + Vector2(0.5));
+
+        return _scene->isometricSettings.GetTileDepth(worldPosition, layerToUse);
+    }
+    else
+    {
+        return _layers[layerIndex].orthographicDepth;
+    }
 }
 
 void TilemapRenderer::SetOffset(Vector2 offset)
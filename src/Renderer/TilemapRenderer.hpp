@@ -10,6 +10,26 @@ class Camera;
 class SpriteBatcher;
 class Renderer;
 
+/// <summary>
+/// A square block of tiles in one layer. Its quads are built the first time it's visible and reused after that. They
+/// don't include the layer's offset or the render offset, which are added when they're submitted.
+/// </summary>
+struct TilemapChunk
+{
+    Rectangle bounds;           // Covers the quad of every tile, without the layer's offset
+    int totalTiles = 0;
+    bool isBuilt = false;
+    std::vector<RenderVertex> vertices;     // Four per tile
+    std::vector<Texture*> textures;         // One per tile
+};
+
+struct TilemapRenderStats
+{
+    int totalChunks = 0;
+    int visibleChunks = 0;
+    int submittedQuads = 0;
+};
+
 class TilemapLayerRenderer
 {
 public:
@@ -29,6 +49,10 @@ public:
 
     const MapLayer* GetMapLayer() const { return _layer; };
 
+    std::vector<TilemapChunk> chunks;
+    int chunkCols = 0;
+    float orthographicDepth = 0;
+
 private:
     const MapLayer* _layer;
     Vector2 _offset;
@@ -37,11 +61,37 @@ private:
 class TilemapRenderer
 {
 public:
+    static constexpr int ChunkSize = 16;
+
     void SetMapSegment(const MapSegment* mapSegment, Scene* scene);
-    void Render(Renderer* renderer) const;
+    void Render(Renderer* renderer);
     void SetOffset(Vector2 offset);
 
+    /// <summary>
+    /// Appends the indices of the layer's chunks that overlap the camera bounds. Only uses the tile positions and
+    /// sprite sizes, so it can be checked without a renderer.
+    /// </summary>
+    void GetVisibleChunks(int layerIndex, const Rectangle& cameraBounds, std::vector<int>& outChunks);
+
+    const TilemapChunk& GetChunk(int layerIndex, int chunkIndex) const { return _layers[layerIndex].chunks[chunkIndex]; }
+    int TotalLayers() const { return _layers.size(); }
+
+    const TilemapRenderStats& LastFrameStats() const { return _stats; }
+
 private:
+    void LayOutChunks();
+    void BuildChunk(Renderer* renderer, int layerIndex, int chunkIndex);
+
+    // Where the tile's sprite is drawn, without the layer's offset, and at which depth. The same as when every tile was
+    // drawn with RenderSprite().
+    Vector2 GetTilePosition(int layerIndex, int row, int col) const;
+    float GetTileDepth(int layerIndex, int row, int col) const;
+    Vector2 GetLayerOffset(int layerIndex) const;
+
     std::vector<TilemapLayerRenderer> _layers;
     Scene* _scene;
+
+    bool _isLaidOut = false;
+    std::vector<int> _visibleChunks;
+    TilemapRenderStats _stats;
 };
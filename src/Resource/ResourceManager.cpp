@@ -10,6 +10,7 @@
 #include "ResourceSettings.hpp"
 #include "System/FileSystem.hpp"
 #include "SpriteAtlasResource.hpp"
+#include "System/WorkerPool.hpp"
 
 ConsoleVar<std::string> assetPath("asset-path", "./assets", true);
 
@@ -20,16 +21,7 @@ void ResourceManager::LoadResourceFromFile(const ResourceSettings& settings)
         return;
     }
 
-    auto resourceType = settings.resourceType;
-
-    BaseResource* resource = nullptr;
-
-    if (strcmp(resourceType, "sprite") == 0) resource = new SpriteResource;
-    else if (strcmp(resourceType, "map") == 0) resource = new TilemapResource;
-    else if (strcmp(resourceType, "sprite-font") == 0) resource = new SpriteFontResource;
-    else if (strcmp(resourceType, "shader") == 0) resource = new ShaderResource;
-    else if (strcmp(resourceType, "file") == 0) resource = new FileResource;
-    else if (strcmp(resourceType, "atlas") == 0) resource = new SpriteAtlasResource;
+    BaseResource* resource = CreateResource(StringId(settings.resourceType));
 
     if (resource == nullptr)
     {
@@ -48,10 +40,98 @@ void ResourceManager::LoadResourceFromFile(const ResourceSettings& settings)
     }
 }
 
+BaseResource* ResourceManager::CreateResource(StringId resourceType)
+{
+    // Pack entries store the StringId of the type name, so compare keys for both
+    if (resourceType.key == StringId("sprite").key) return new SpriteResource;
+    else if (resourceType.key == StringId("map").key) return new TilemapResource;
+    else if (resourceType.key == StringId("sprite-font").key) return new SpriteFontResource;
+    else if (resourceType.key == StringId("shader").key) return new ShaderResource;
+    else if (resourceType.key == StringId("file").key) return new FileResource;
+    else if (resourceType.key == StringId("atlas").key) return new SpriteAtlasResource;
+    else return nullptr;
+}
+
+void ResourceManager::LoadResourcePack(const char* filePath)
+{
+    auto absolutePath = GetAssetPath(filePath).string();
+
+    auto pack = std::make_unique<ResourcePack>();
+    pack->reader.OpenMapped(absolutePath.c_str());
+
+    auto entries = pack->fileReader.LoadEntries();
+    int addedEntries = 0;
+
+    for (auto& entry : entries)
+    {
+        // try_emplace() doesn't touch resources that are already loaded
+        if (!_resourcesByStringId.try_emplace(entry.header.key).second)
+        {
+            continue;
+        }
+
+        _pendingPackEntries.emplace(entry.header.key, PendingPackEntry { pack.get(), entry });
+        ++addedEntries;
+    }
+
+    Log("Registered %d of %d resources from %s\n", addedEntries, (int)entries.size(), absolutePath.c_str());
+
+    _resourcePacks.push_back(std::move(pack));
+}
+
+BaseResource* ResourceManager::LoadPackEntry(unsigned int key, ResourceSlot& slot)
+{
+    std::lock_guard<std::mutex> lock(_packEntryMutex);
+
+    // Another thread may have loaded it while we were waiting
+    if (auto loadedResource = slot.Get())
+    {
+        return loadedResource;
+    }
+
+    auto pendingEntry = _pendingPackEntries.find(key);
+    if (pendingEntry == _pendingPackEntries.end())
+    {
+        return nullptr;
+    }
+
+    auto& entry = pendingEntry->second.entry;
+    auto name = entry.header.name.empty()
+        ? std::to_string(key)
+        : entry.header.name;
+
+    BaseResource* resource = CreateResource(StringId(entry.header.type));
+    if (resource == nullptr)
+    {
+        FatalError("Unknown resource type %u for packed resource %s", entry.header.type, name.c_str());
+    }
+
+    if (resource->CreatesGpuObjects() && WorkerPool::IsWorkerThread())
+    {
+        FatalError("Packed resource %s was first used from a worker thread, look it up on the main thread first\n", name.c_str());
+    }
+
+    auto data = pendingEntry->second.pack->fileReader.LoadResource(entry, _packEntryBuffer);
+
+    BinaryStreamReader dataReader;
+    dataReader.Open(data);
+
+    if (!resource->LoadFromBinary(dataReader))
+    {
+        FatalError("Failed to load packed resource %s\n", name.c_str());
+    }
+
+    resource->name = name;
+    slot.Set(std::unique_ptr<BaseResource>(resource));
+    _pendingPackEntries.erase(pendingEntry);
+
+    return resource;
+}
+
 void ResourceManager::AddResource(BaseResource* resource, const char* name)
 {
     // TODO: check for duplicates
-    _resourcesByStringId[StringId(name).key] = std::unique_ptr<BaseResource>(resource);
+    _resourcesByStringId[StringId(name).key].Set(std::unique_ptr<BaseResource>(resource));
 }
 
 ResourceManager* ResourceManager::GetInstance()
@@ -5,7 +5,12 @@
 #include <Memory/StringId.hpp>
 #include <filesystem>
 #include "System/Logger.hpp"
+#include "System/ResourceFileReader.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <vector>
 #include <nlohmann/json_fwd.hpp>
 
 struct Engine;
@@ -22,6 +27,9 @@ public:
 
     virtual bool TryCleanup() { return false; }
 
+    // Resources that create OpenGL objects when loaded can only be loaded on the thread that owns the context
+    virtual bool CreatesGpuObjects() const { return false; }
+
     template<typename TResource>
     TResource* As();
 
@@ -58,9 +66,17 @@ class ResourceManager
 public:
     void LoadContentFile(const char* filePath);
     void LoadResourceFromFile(const ResourceSettings& settings);
+
+    /// <summary>
+    /// Memory maps a pack and registers its entries without loading them. Each entry is decrypted, checked and loaded
+    /// the first time it's looked up. Entries that are already loaded under the same name are skipped. Entries that
+    /// create GPU objects, like sprites, have to be looked up on the main thread first; looking one up for the first
+    /// time from a worker thread is a fatal error.
+    /// </summary>
+    void LoadResourcePack(const char* filePath);
     void AddResource(const char* name, BaseResource* resource)
     {
-        _resourcesByStringId[StringId(name)] = std::unique_ptr<BaseResource>(resource);
+        _resourcesByStringId[StringId(name).key].Set(std::unique_ptr<BaseResource>(resource));
     }
 
     std::string GetBaseAssetPath() const;
@@ -68,9 +84,16 @@ public:
     BaseResource* GetResourceByStringId(StringId id)
     {
         auto resource = _resourcesByStringId.find(id.key);
-        return resource != _resourcesByStringId.end()
-            ? resource->second.get()
-            : nullptr;
+        if (resource == _resourcesByStringId.end())
+        {
+            return nullptr;
+        }
+
+        // Pack entries have an empty slot until they're first used
+        auto loadedResource = resource->second.Get();
+        return loadedResource != nullptr
+            ? loadedResource
+            : LoadPackEntry(id.key, resource->second);
     }
 
     BaseResource* GetResourceByName(const char* name)
@@ -84,10 +107,55 @@ public:
     std::filesystem::path GetAssetPath(const std::string& relativePath);
 
 private:
+    // The pointer is published atomically, so that a lookup from a concurrent entity update can see whether a pack entry
+    // is loaded without taking the lock
+    struct ResourceSlot
+    {
+        BaseResource* Get() const { return _resource.load(std::memory_order_acquire); }
+
+        void Set(std::unique_ptr<BaseResource> resource)
+        {
+            _owner = std::move(resource);
+            _resource.store(_owner.get(), std::memory_order_release);
+        }
+
+    private:
+        std::unique_ptr<BaseResource> _owner;
+        std::atomic<BaseResource*> _resource { nullptr };
+    };
+
+    struct ResourcePack
+    {
+        ResourcePack()
+            : fileReader(reader)
+        {
+
+        }
+
+        BinaryStreamReader reader;
+        ResourceFileReader fileReader;
+    };
+
+    struct PendingPackEntry
+    {
+        ResourcePack* pack;
+        ResourceFileEntry entry;
+    };
+
+    static BaseResource* CreateResource(StringId resourceType);
+
     void AddResource(BaseResource* resource, const char* name);
+    BaseResource* LoadPackEntry(unsigned int key, ResourceSlot& slot);
 
-    std::unordered_map<unsigned int, std::unique_ptr<BaseResource>> _resourcesByStringId;
+    std::unordered_map<unsigned int, ResourceSlot> _resourcesByStringId;
     bool _replaceWithDefault = true;
+
+    std::vector<std::unique_ptr<ResourcePack>> _resourcePacks;
+    std::unordered_map<unsigned int, PendingPackEntry> _pendingPackEntries;
+    std::vector<std::byte> _packEntryBuffer;
+
+    // Lookups can come from concurrent entity updates, so loading a pack entry is serialized
+    std::mutex _packEntryMutex;
 };
 
 template<typename TResource>
@@ -9,4 +9,6 @@ struct SpriteResource : ResourceTemplate<Sprite>
     bool LoadFromFile(const ResourceSettings& settings) override;
     bool WriteToBinary(const ResourceSettings& settings, BinaryStreamWriter& writer) override;
     bool LoadFromBinary(BinaryStreamReader& reader) override;
+
+    bool CreatesGpuObjects() const override { return true; }
 };
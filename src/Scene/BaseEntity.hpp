@@ -39,6 +39,11 @@ struct BaseEntity : Entity
 {
     static constexpr StringId Type = StringId(EntityName<TDerived>);
 
+    // Hide these in an entity type to let its hooks run on worker threads. Such hooks may only modify the entity
+    // itself; anything else has to go through Scene::ExecuteDeferred(). See EntityGroupFlags.
+    static constexpr bool ConcurrentUpdate = false;
+    static constexpr bool ConcurrentFixedUpdate = false;
+
     virtual EntityUtil::EntityMetadata* GetMetadata()
     {
         return &metadata;
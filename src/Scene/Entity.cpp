@@ -3,14 +3,19 @@
 #include "Engine.hpp"
 #include "Scene.hpp"
 #include "IEntityEvent.hpp"
+#include "SpatialHashService.hpp"
 
 #include <unordered_map>
 
 const EntityHeader InvalidEntityHeader::InvalidHeader;
 
-void* AllocateComponent(Scene* scene, int size)
+void* AllocateComponent(Scene* scene, int size, int typeId)
 {
-    return scene->AllocateMemory(size);
+    auto& componentManager = scene->GetComponentManager();
+
+    return componentManager.StorageMode() == ComponentStorageMode::Pooled
+        ? componentManager.AllocateComponent(typeId, size)
+        : scene->AllocateMemory(size);
 }
 
 std::unordered_map<unsigned, EntityUtil::EntityMetadata*>& GetEntityMetadataByType()
@@ -131,9 +136,14 @@ void Entity::Serialize(EntitySerializer& serializer)
     DoSerialize(serializer);
 }
 
-void Entity::StartTimer(float timeSeconds, const std::function<void()>& callback)
+TimerHandle Entity::StartTimer(float timeSeconds, const std::function<void()>& callback)
 {
-    scene->StartEntityTimer(timeSeconds, callback, this);
+    return scene->StartEntityTimer(timeSeconds, callback, this);
+}
+
+TimerHandle Entity::StartRepeatingTimer(float intervalSeconds, const std::function<void()>& callback)
+{
+    return scene->StartRepeatingTimer(intervalSeconds, callback, this);
 }
 
 void Entity::AddChild(Entity* child)
@@ -185,6 +195,20 @@ void Entity::RemoveComponent(IEntityComponent* component)
 
 void Entity::NotifyMovement()
 {
+    // Listeners touch shared state like the spatial hash and the physics world, so moves made from a concurrent hook
+    // are passed on when the batch is merged
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        deferredChanges->AddMove(this);
+        return;
+    }
+
+    // Not registered yet when moved from its constructor
+    if (spatialHashBucket != -1)
+    {
+        scene->spatialHash->NotifyMovement(this);
+    }
+
     SendEvent(EntityMovedEvent());
 
     for (auto component = _componentList; component != nullptr; component = component->next)
@@ -203,7 +227,7 @@ static void DisableHook(Entity* entity, THookSelector selector)
 {
     auto& entityManager = entity->scene->GetEntityManager();
     auto set = selector(entityManager);
-    entityManager.scheduledHookRemovals.emplace_back(set, entity->entityGroup);
+    entityManager.ScheduleHookRemoval(set, entity->entityGroup);
 }
 
 void Entity::Update(float deltaTime)
@@ -17,6 +17,7 @@
 #include "Sound/SoundManager.hpp"
 #include "EntitySerializer.hpp"
 #include "Memory/DLinkNode.hpp"
+#include "TimerHandle.hpp"
 
 class b2Body;
 struct IEntityEvent;
@@ -71,6 +72,14 @@ struct Entity : DLinkedNode<Entity>
     /// </summary>
     /// <param name="newPosition"></param>
     void SetCenter(const Vector2& newPosition);
+
+    /// <summary>
+    /// Sends the position with fewer bits, see Quantization. Has to be set the same way on the server and the client
+    /// before the entity is first sent, so call it from OnAdded(). FixedPoint(-65536, 65536, 22) is a step of 1/32 pixel
+    /// in 44 bits per update instead of 64, as long as the map fits in its range.
+    /// </summary>
+    void SetPositionQuantization(const Quantization& quantization) { _position.quantization = quantization; }
+
     void SetRotation(float angle);
 
     Vector2 TopLeft() const
@@ -168,7 +177,12 @@ struct Entity : DLinkedNode<Entity>
     /// </summary>
     /// <param name="timeSeconds"></param>
     /// <param name="callback"></param>
-    void StartTimer(float timeSeconds, const std::function<void()>& callback);
+    TimerHandle StartTimer(float timeSeconds, const std::function<void()>& callback);
+
+    /// <summary>
+    /// Runs the callback every intervalSeconds until it's cancelled through the scene or the entity is destroyed.
+    /// </summary>
+    TimerHandle StartRepeatingTimer(float intervalSeconds, const std::function<void()>& callback);
     void AddChild(Entity* child);
 
     SoundChannel* GetChannel(int id);
@@ -201,6 +215,13 @@ struct Entity : DLinkedNode<Entity>
 
     long long lastQueryId = -1;
 
+    // Location in the scene's SpatialHashService, -1 if not in it
+    int spatialHashBucket = -1;
+    int spatialHashSlot = -1;
+
+    // Set by RigidBodyComponent so physics can move hierarchies without looking up components
+    RigidBodyComponent* rigidBody = nullptr;
+
 protected:
     void NotifyMovement();
 
@@ -234,8 +255,7 @@ private:
 
     }
 
-    SyncVar<Vector2> _position{{ 0, 0 }, SyncVarInterpolation::Linear, SyncVarUpdateFrequency::Frequent,
-                               SyncVarDeltaMode::Full };
+    SyncVar<Vector2> _position{{ 0, 0 }, SyncVarInterpolation::Linear };
 
     Vector2 _dimensions;
     float _rotation = 0;
@@ -259,12 +279,12 @@ bool Entity::Is(TEntity*& outEntity)
     }
 }
 
-void* AllocateComponent(Scene* scene, int size);
+void* AllocateComponent(Scene* scene, int size, int typeId);
 
 template<typename TComponent, typename ...Args>
 TComponent* Entity::AddComponent(Args&& ...args)
 {
-    auto newComponent = static_cast<TComponent*>(AllocateComponent(scene, sizeof(TComponent)));
+    auto newComponent = static_cast<TComponent*>(AllocateComponent(scene, sizeof(TComponent), TComponent::TypeId()));
 
     new(newComponent) TComponent(std::forward<Args>(args)...);
     newComponent->owner = this;
@@ -1,7 +1,17 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
 #include "EntityComponent.hpp"
 #include "Entity.hpp"
 #include "Scene.hpp"
 
+int NextComponentTypeId()
+{
+	static int nextTypeId = 0;
+	return nextTypeId++;
+}
+
 Scene* IEntityComponent::GetScene() const
 {
     return owner->scene;
@@ -41,8 +51,158 @@ void IEntityComponent::Register()
 	GetScene()->GetComponentManager().Register(this);
 }
 
+ComponentPool::ComponentPool(int componentSize_)
+	// Keep every slot aligned the same way new[] aligns the chunk
+	: componentSize((componentSize_ + alignof(std::max_align_t) - 1) & ~(int)(alignof(std::max_align_t) - 1))
+{
+
+}
+
+void* ComponentPool::Allocate()
+{
+	if (freeSlots.empty())
+	{
+		chunks.emplace_back(new unsigned char[componentSize * SlotsPerChunk]);
+
+		for (int i = 0; i < SlotsPerChunk; ++i)
+		{
+			freeSlots.push(totalSlots + i);
+		}
+
+		totalSlots += SlotsPerChunk;
+	}
+
+	int slot = freeSlots.top();
+	freeSlots.pop();
+
+	void* memory = chunks[slot / SlotsPerChunk].get() + (slot % SlotsPerChunk) * componentSize;
+	memset(memory, 0, componentSize);
+
+	return memory;
+}
+
+void ComponentPool::Free(IEntityComponent* component)
+{
+	int slot = component->poolSlot != -1
+		? component->poolSlot
+		: GetSlot(component->GetMemoryBlock().second);
+
+	freeSlots.push(slot);
+}
+
+int ComponentPool::GetSlot(const void* memory) const
+{
+	auto address = static_cast<const unsigned char*>(memory);
+
+	for (int i = 0; i < (int)chunks.size(); ++i)
+	{
+		auto chunkStart = chunks[i].get();
+		if (address >= chunkStart && address < chunkStart + componentSize * SlotsPerChunk)
+		{
+			return i * SlotsPerChunk + (int)(address - chunkStart) / componentSize;
+		}
+	}
+
+	FatalError("Component at %p does not belong to its pool", memory);
+}
+
+static void InsertBySlot(std::vector<IEntityComponent*>& hook, IEntityComponent* component)
+{
+	auto it = std::lower_bound(hook.begin(), hook.end(), component, [](auto lhs, auto rhs)
+	{
+		return lhs->poolSlot < rhs->poolSlot;
+	});
+
+	if (it == hook.end() || *it != component)
+	{
+		hook.insert(it, component);
+	}
+}
+
+static void EraseBySlot(std::vector<IEntityComponent*>& hook, IEntityComponent* component)
+{
+	auto it = std::lower_bound(hook.begin(), hook.end(), component, [](auto lhs, auto rhs)
+	{
+		return lhs->poolSlot < rhs->poolSlot;
+	});
+
+	if (it != hook.end() && *it == component)
+	{
+		hook.erase(it);
+	}
+}
+
+void EntityComponentManager::SetStorageMode(ComponentStorageMode mode)
+{
+	if (!renderables.empty() || !updatables.empty() || !fixedUpdatables.empty() || !_poolsByTypeId.empty())
+	{
+		FatalError("Component storage mode must be set before any components are added");
+	}
+
+	_storageMode = mode;
+}
+
+void* EntityComponentManager::AllocateComponent(int typeId, int size)
+{
+	if (typeId >= (int)_poolsByTypeId.size())
+	{
+		_poolsByTypeId.resize(typeId + 1);
+	}
+
+	auto& pool = _poolsByTypeId[typeId];
+	if (pool == nullptr)
+	{
+		pool = std::make_unique<ComponentPool>(size);
+	}
+
+	return pool->Allocate();
+}
+
+void EntityComponentManager::FreeComponent(IEntityComponent* component)
+{
+	GetPool(component)->Free(component);
+}
+
+ComponentPool* EntityComponentManager::GetPool(IEntityComponent* component)
+{
+	int typeId = component->GetComponentTypeId();
+	if (typeId >= (int)_poolsByTypeId.size() || _poolsByTypeId[typeId] == nullptr)
+	{
+		FatalError("Component %s was not allocated from a component pool", typeid(*component).name());
+	}
+
+	return _poolsByTypeId[typeId].get();
+}
+
+void EntityComponentManager::RegisterPooled(IEntityComponent* component)
+{
+	auto pool = GetPool(component);
+
+	if (component->poolSlot == -1)
+	{
+		component->poolSlot = pool->GetSlot(component->GetMemoryBlock().second);
+	}
+
+	if (component->componentFlags.HasFlag(EntityComponentFlags::EnableUpdate)) InsertBySlot(pool->updatables, component);
+	else EraseBySlot(pool->updatables, component);
+
+	if (component->componentFlags.HasFlag(EntityComponentFlags::EnableRender)) InsertBySlot(pool->renderables, component);
+	else EraseBySlot(pool->renderables, component);
+
+	if (component->componentFlags.HasFlag(EntityComponentFlags::EnableFixedUpdate)) InsertBySlot(pool->fixedUpdatables, component);
+	else EraseBySlot(pool->fixedUpdatables, component);
+}
+
 void EntityComponentManager::Register(IEntityComponent* component)
 {
+	if (_storageMode == ComponentStorageMode::Pooled)
+	{
+		if (_isSweeping) ScheduleToUpdateInterfaces(component);
+		else RegisterPooled(component);
+
+		return;
+	}
+
 	if (component->componentFlags.HasFlag(EntityComponentFlags::EnableUpdate)) updatables.insert(component);
 	else updatables.erase(component);
 
@@ -55,11 +215,62 @@ void EntityComponentManager::Register(IEntityComponent* component)
 
 void EntityComponentManager::Unregister(IEntityComponent* component)
 {
+	toBeUpdated.erase(component);
+
+	if (_storageMode == ComponentStorageMode::Pooled)
+	{
+		auto pool = GetPool(component);
+
+		if (_isSweeping)
+		{
+			_unregisteredDuringSweep.emplace_back(pool, component);
+			return;
+		}
+
+		EraseBySlot(pool->renderables, component);
+		EraseBySlot(pool->updatables, component);
+		EraseBySlot(pool->fixedUpdatables, component);
+
+		return;
+	}
+
 	renderables.erase(component);
 	updatables.erase(component);
 	fixedUpdatables.erase(component);
 }
 
+bool EntityComponentManager::WasUnregisteredDuringSweep(IEntityComponent* component) const
+{
+	for (auto& unregistered : _unregisteredDuringSweep)
+	{
+		if (unregistered.second == component)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void EntityComponentManager::RemoveComponentsUnregisteredDuringSweep()
+{
+	// The slot of a destroyed component may already belong to a new one, so the entries are found by address instead
+	// of by slot. New components aren't in the hook lists yet, their registration is still scheduled.
+	auto wasUnregistered = [=](IEntityComponent* component) { return WasUnregisteredDuringSweep(component); };
+
+	for (auto& unregistered : _unregisteredDuringSweep)
+	{
+		auto pool = unregistered.first;
+
+		for (auto hook : { &pool->renderables, &pool->updatables, &pool->fixedUpdatables })
+		{
+			hook->erase(std::remove_if(hook->begin(), hook->end(), wasUnregistered), hook->end());
+		}
+	}
+
+	_unregisteredDuringSweep.clear();
+}
+
 void EntityComponentManager::ScheduleToUpdateInterfaces(IEntityComponent* component)
 {
 	toBeUpdated.insert(component);
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <queue>
 #include <utility>
 #include <typeinfo>
 #include <unordered_set>
+#include <vector>
 
 #include "Memory/Flags.hpp"
 
@@ -14,6 +18,12 @@ enum class EntityComponentFlags
 	EnableRender = 4,
 };
 
+enum class ComponentStorageMode
+{
+	Scattered,
+	Pooled
+};
+
 struct Entity;
 class Scene;
 class Renderer;
@@ -35,6 +45,7 @@ struct IEntityComponent
     void Register();
 
     virtual std::pair<int, void*> GetMemoryBlock() = 0;
+    virtual int GetComponentTypeId() const = 0;
 
     template<typename TComponent>
     TComponent* Is()
@@ -56,31 +67,163 @@ struct IEntityComponent
     Entity* owner;
     const char* name = "<default>";
 
+    // Slot within the owning ComponentPool, only used with ComponentStorageMode::Pooled
+    int poolSlot = -1;
+
 private:
 	void FlagsChanged();
 };
 
+int NextComponentTypeId();
+
 template<typename TComponent>
 struct ComponentTemplate : IEntityComponent
 {
+    static int TypeId()
+    {
+        static const int typeId = NextComponentTypeId();
+        return typeId;
+    }
+
     std::pair<int, void*> GetMemoryBlock() override
     {
         return { (int)sizeof(TComponent), static_cast<TComponent*>(this) };
     }
+
+    int GetComponentTypeId() const override
+    {
+        return TypeId();
+    }
+};
+
+/// <summary>
+/// Stores every component of one concrete type in fixed-size chunks so that updating them walks memory linearly.
+/// Free slots are reused lowest first and the hook lists are kept sorted by slot, so the iteration order only depends
+/// on the order in which components were added and removed.
+/// </summary>
+struct ComponentPool
+{
+	static constexpr int SlotsPerChunk = 256;
+
+	explicit ComponentPool(int componentSize_);
+
+	void* Allocate();
+	void Free(IEntityComponent* component);
+	int GetSlot(const void* memory) const;
+
+	int componentSize;
+	int totalSlots = 0;
+	std::vector<std::unique_ptr<unsigned char[]>> chunks;
+	std::priority_queue<int, std::vector<int>, std::greater<>> freeSlots;
+
+	std::vector<IEntityComponent*> renderables;
+	std::vector<IEntityComponent*> updatables;
+	std::vector<IEntityComponent*> fixedUpdatables;
 };
 
 struct EntityComponentManager
 {
+	void SetStorageMode(ComponentStorageMode mode);
+	ComponentStorageMode StorageMode() const { return _storageMode; }
+
+	void* AllocateComponent(int typeId, int size);
+	void FreeComponent(IEntityComponent* component);
+
 	void Register(IEntityComponent* component);
 	void Unregister(IEntityComponent* component);
 	void ScheduleToUpdateInterfaces(IEntityComponent* component);
 	void UpdateScheduledComponents();
 
+	template<typename TFunc> void ForEachRenderable(TFunc&& func);
+	template<typename TFunc> void ForEachUpdatable(TFunc&& func);
+	template<typename TFunc> void ForEachFixedUpdatable(TFunc&& func);
+
 	std::unordered_set<IEntityComponent*> renderables;
 	std::unordered_set<IEntityComponent*> updatables;
 	std::unordered_set<IEntityComponent*> fixedUpdatables;
 	std::unordered_set<IEntityComponent*> toBeUpdated;
+
+private:
+	using PoolHook = std::vector<IEntityComponent*> ComponentPool::*;
+
+	template<typename TFunc>
+	void ForEachComponent(std::unordered_set<IEntityComponent*>& scatteredHook, PoolHook poolHook, TFunc&& func);
+
+	ComponentPool* GetPool(IEntityComponent* component);
+	void RegisterPooled(IEntityComponent* component);
+
+	bool WasUnregisteredDuringSweep(IEntityComponent* component) const;
+	void RemoveComponentsUnregisteredDuringSweep();
+
+	ComponentStorageMode _storageMode = ComponentStorageMode::Scattered;
+	std::vector<std::unique_ptr<ComponentPool>> _poolsByTypeId;
+	bool _isSweeping = false;
+
+	// Components unregistered while a sweep walks the hook lists. They're skipped by the sweep and erased when it
+	// ends. Only the addresses are compared, since the components may already be destroyed.
+	std::vector<std::pair<ComponentPool*, IEntityComponent*>> _unregisteredDuringSweep;
 };
 
+template<typename TFunc>
+void EntityComponentManager::ForEachComponent(std::unordered_set<IEntityComponent*>& scatteredHook, PoolHook poolHook, TFunc&& func)
+{
+	if (_storageMode == ComponentStorageMode::Scattered)
+	{
+		for (auto component : scatteredHook)
+		{
+			func(component);
+		}
+
+		return;
+	}
+
+	// Registrations that happen during the sweep are deferred until UpdateScheduledComponents() and unregistrations
+	// until the end of the sweep, so the hook lists don't shift underneath us
+	_isSweeping = true;
+
+	for (auto& pool : _poolsByTypeId)
+	{
+		if (pool == nullptr) continue;
+
+		auto& hook = (*pool).*poolHook;
+		for (int i = 0; i < (int)hook.size(); ++i)
+		{
+			auto component = hook[i];
+
+			if (!_unregisteredDuringSweep.empty() && WasUnregisteredDuringSweep(component))
+			{
+				continue;
+			}
+
+			func(component);
+		}
+	}
+
+	_isSweeping = false;
+
+	if (!_unregisteredDuringSweep.empty())
+	{
+		RemoveComponentsUnregisteredDuringSweep();
+	}
+}
+
+template<typename TFunc>
+void EntityComponentManager::ForEachRenderable(TFunc&& func)
+{
+	ForEachComponent(renderables, &ComponentPool::renderables, std::forward<TFunc>(func));
+}
+
+template<typename TFunc>
+void EntityComponentManager::ForEachUpdatable(TFunc&& func)
+{
+	ForEachComponent(updatables, &ComponentPool::updatables, std::forward<TFunc>(func));
+}
+
+template<typename TFunc>
+void EntityComponentManager::ForEachFixedUpdatable(TFunc&& func)
+{
+	ForEachComponent(fixedUpdatables, &ComponentPool::fixedUpdatables, std::forward<TFunc>(func));
+}
+
 
 #define DEFINE_COMPONENT(comeponentStructName_) struct comeponentStructName_ : ComponentTemplate<comeponentStructName_>
\ No newline at end of file
@@ -47,6 +47,24 @@ void EntityManager::UnregisterEntity(Entity* entity)
     freeEntityHeaders.Return(header);
 }
 
+DeferredEntityChanges*& DeferredEntityChanges::Current()
+{
+    static thread_local DeferredEntityChanges* current = nullptr;
+    return current;
+}
+
+void EntityManager::ScheduleHookRemoval(robin_hood::unordered_flat_set<EntityGroup*>* hookSet, EntityGroup* entityGroup)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        deferredChanges->AddHookRemoval(hookSet, entityGroup);
+    }
+    else
+    {
+        scheduledHookRemovals.emplace_back(hookSet, entityGroup);
+    }
+}
+
 void EntityManager::RunHookRemovals()
 {
     for (auto& removal : scheduledHookRemovals)
@@ -74,10 +74,19 @@ struct IEntityObserver
     virtual void OnEntityRemoved(Entity* entity) { }
 };
 
+enum class EntityGroupFlags
+{
+    // Update() and ServerUpdate() only touch the entity's own state and can run on worker threads
+    ConcurrentUpdate = 1,
+    // FixedUpdate() and ServerFixedUpdate() only touch the entity's own state and can run on worker threads
+    ConcurrentFixedUpdate = 2
+};
+
 struct EntityGroup
 {
     DLinkedList<Entity> entities;
     std::vector<IEntityObserver*> observers;
+    Flags<EntityGroupFlags> flags;
 };
 
 struct ScheduledHookRemoval
@@ -93,6 +102,98 @@ struct ScheduledHookRemoval
     EntityGroup* entityGroup;
 };
 
+// A timer given out by TimerManager::ReserveTimer() in a concurrent hook, started when its batch is merged
+struct DeferredTimerStart
+{
+    DeferredTimerStart(TimerHandle handle, Entity* entity)
+        : handle(handle),
+          entity(entity)
+    {
+
+    }
+
+    TimerHandle handle;
+    Entity* entity;
+};
+
+enum class DeferredChangeType
+{
+    Destroy,
+    HookRemoval,
+    Action,
+    TimerStart,
+    Move
+};
+
+struct DeferredChange
+{
+    DeferredChangeType type;
+    int index;      // Into the list of changes of that type
+};
+
+/// <summary>
+/// Structural changes recorded by one batch of entities while a hook runs on worker threads. The batches are merged
+/// back in order once the hook finishes, and each batch's changes are applied in the order they were recorded, which
+/// is the order they would have happened in serially.
+///
+/// Two things still differ from a serial run. The changes are applied after the whole group has updated, so an entity
+/// later in the group doesn't see them, but concurrent hooks may only touch their own entity anyway. Moves are
+/// notified with the entity's position at merge time, so an entity that moves twice in one hook is notified twice of
+/// its final position.
+/// </summary>
+struct DeferredEntityChanges
+{
+    void AddDestroy(Entity* entity)
+    {
+        order.push_back({ DeferredChangeType::Destroy, (int)toBeDestroyed.size() });
+        toBeDestroyed.push_back(entity);
+    }
+
+    void AddHookRemoval(robin_hood::unordered_flat_set<EntityGroup*>* hookSet, EntityGroup* entityGroup)
+    {
+        order.push_back({ DeferredChangeType::HookRemoval, (int)hookRemovals.size() });
+        hookRemovals.emplace_back(hookSet, entityGroup);
+    }
+
+    void AddAction(const std::function<void()>& action)
+    {
+        order.push_back({ DeferredChangeType::Action, (int)actions.size() });
+        actions.push_back(action);
+    }
+
+    void AddTimerStart(TimerHandle handle, Entity* entity)
+    {
+        order.push_back({ DeferredChangeType::TimerStart, (int)timerStarts.size() });
+        timerStarts.emplace_back(handle, entity);
+    }
+
+    void AddMove(Entity* entity)
+    {
+        order.push_back({ DeferredChangeType::Move, (int)movedEntities.size() });
+        movedEntities.push_back(entity);
+    }
+
+    void Clear()
+    {
+        order.clear();
+        toBeDestroyed.clear();
+        hookRemovals.clear();
+        actions.clear();
+        movedEntities.clear();
+        timerStarts.clear();
+    }
+
+    // The batch being run on the current thread, or nullptr if not inside a concurrent hook
+    static DeferredEntityChanges*& Current();
+
+    std::vector<DeferredChange> order;
+    std::vector<Entity*> toBeDestroyed;
+    std::vector<ScheduledHookRemoval> hookRemovals;
+    std::vector<std::function<void()>> actions;
+    std::vector<Entity*> movedEntities;
+    std::vector<DeferredTimerStart> timerStarts;
+};
+
 struct EntityManager
 {
     static constexpr int InvalidEntityHeaderId = -2;
@@ -103,6 +204,7 @@ struct EntityManager
     void RegisterEntity(Entity* entity);
     void UnregisterEntity(Entity* entity);
     void RunHookRemovals();
+    void ScheduleHookRemoval(robin_hood::unordered_flat_set<EntityGroup*>* hookSet, EntityGroup* entityGroup);
 
     template<typename TEntity>
     EntityList<TEntity> GetEntitiesOfType();
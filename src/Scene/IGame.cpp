@@ -21,6 +21,11 @@ void IGame::Run()
             _engine->GetConsole()->RunUserConfig(_config.userConfigFile.value().c_str());
         }
 
+        for (auto& resourcePack : _config.resourcePacks)
+        {
+            ResourceManager::GetInstance()->LoadResourcePack(resourcePack.c_str());
+        }
+
         LoadResources(ResourceManager::GetInstance());
 
         _engine->SetGame(this);
@@ -66,6 +66,26 @@ struct GameConfig
         return *this;
     }
 
+    /// <summary>
+    /// Stores components of the same type together in per-type pools and updates them in a linear sweep instead of
+    /// hashing them into a single set.
+    /// </summary>
+    GameConfig& UsePooledComponentStorage()
+    {
+        componentStorage = ComponentStorageMode::Pooled;
+        return *this;
+    }
+
+    /// <summary>
+    /// How far back sync var values are kept. Has to cover the client's jitter buffer plus the round trip time, since
+    /// deltas are based on the last snapshot the client acknowledged.
+    /// </summary>
+    GameConfig& SetSyncVarHistoryDuration(float seconds)
+    {
+        syncVarHistorySeconds = seconds;
+        return *this;
+    }
+
     StringId defaultScene = "empty-map"_sid;
     std::string gameName;
     std::optional<std::string> windowCaption;
@@ -74,6 +94,8 @@ struct GameConfig
     std::vector<std::string> resourcePacks;
     bool isMultiplayer = false;
     ScenePerspective perspective = ScenePerspective::Orothgraphic;
+    ComponentStorageMode componentStorage = ComponentStorageMode::Scattered;
+    float syncVarHistorySeconds = 0.5f;
 };
 
 class IGame
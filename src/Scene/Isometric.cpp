@@ -3,6 +3,10 @@
 #include "Scene/MapSegment.hpp"
 #include "Scene/TilemapEntity.hpp"
 #include "Components/RigidBodyComponent.hpp"
+#include "System/Logger.hpp"
+#include "Tools/ConsoleVar.hpp"
+
+static ConsoleVar<bool> g_mergeTerrainEdges("merge-terrain-edges", true);
 
 static bool TileIsRamp(TileProperties* properties)
 {
@@ -87,37 +91,7 @@ void IsometricSettings::BuildFromMapSegment(const MapSegment& mapSegment, PathFi
     auto scene = pathFinder->scene;
 
     // Add line collider between walkable/unwalkable ares
-    {
-        for (int i = 0; i < terrain.Rows(); ++i)
-        {
-            for (int j = 0; j < terrain.Cols(); ++j)
-            {
-                auto tilemapRb = tilemap->GetComponent<RigidBodyComponent>();
-
-                Vector2 points[4] =
-                    {
-                        scene->isometricSettings.TileToWorld(Vector2(j, i)),
-                        scene->isometricSettings.TileToWorld(Vector2(j + 1, i)),
-                        scene->isometricSettings.TileToWorld(Vector2(j + 1, i + 1)),
-                        scene->isometricSettings.TileToWorld(Vector2(j, i + 1)),
-                    };
-
-                ObstacleEdgeFlags flags[4] =
-                    {
-                        ObstacleEdgeFlags::NorthBlocked,
-                        ObstacleEdgeFlags::EastBlocked,
-                        ObstacleEdgeFlags::SouthBlocked,
-                        ObstacleEdgeFlags::WestBlocked
-                    };
-
-                for (int k = 0; k < 4; ++k)
-                {
-                    if (pathFinder->GetCell(Vector2(j, i)).flags.HasFlag(flags[k]))
-                       tilemapRb->CreateLineCollider(points[k], points[(k + 1) % 4], false);
-                }
-            }
-        }
-    }
+    CreateTerrainColliders(pathFinder, tilemap->GetComponent<RigidBodyComponent>());
 
 
     // Create walkable ares for the grid sensor
@@ -147,6 +121,114 @@ void IsometricSettings::BuildFromMapSegment(const MapSegment& mapSegment, PathFi
     }
 }
 
+void IsometricSettings::CreateTerrainColliders(PathFinderService* pathFinder, RigidBodyComponent* rigidBody)
+{
+    if (g_mergeTerrainEdges.Value())
+    {
+        CreateMergedEdgeColliders(pathFinder, rigidBody);
+    }
+    else
+    {
+        CreateEdgeColliders(pathFinder, rigidBody);
+    }
+}
+
+void IsometricSettings::CreateEdgeColliders(PathFinderService* pathFinder, RigidBodyComponent* rigidBody)
+{
+    for (int i = 0; i < terrain.Rows(); ++i)
+    {
+        for (int j = 0; j < terrain.Cols(); ++j)
+        {
+            Vector2 points[4] =
+                {
+                    TileToWorld(Vector2(j, i)),
+                    TileToWorld(Vector2(j + 1, i)),
+                    TileToWorld(Vector2(j + 1, i + 1)),
+                    TileToWorld(Vector2(j, i + 1)),
+                };
+
+            ObstacleEdgeFlags flags[4] =
+                {
+                    ObstacleEdgeFlags::NorthBlocked,
+                    ObstacleEdgeFlags::EastBlocked,
+                    ObstacleEdgeFlags::SouthBlocked,
+                    ObstacleEdgeFlags::WestBlocked
+                };
+
+            for (int k = 0; k < 4; ++k)
+            {
+                if (pathFinder->GetCell(Vector2(j, i)).flags.HasFlag(flags[k]))
+                   rigidBody->CreateLineCollider(points[k], points[(k + 1) % 4], false);
+            }
+        }
+    }
+}
+
+void IsometricSettings::CreateMergedEdgeColliders(PathFinderService* pathFinder, RigidBodyComponent* rigidBody)
+{
+    // A blocked edge is flagged on the cells on both sides, so it's only added once here. Runs of blocked edges along
+    // the same grid line become one two-sided collider. Chain shapes aren't used because they're one-sided in Box2D.
+    int rows = terrain.Rows();
+    int cols = terrain.Cols();
+    int totalEdges = 0;
+    int totalColliders = 0;
+
+    auto hasFlag = [&](int x, int y, ObstacleEdgeFlags flag)
+    {
+        return x >= 0 && x < cols && y >= 0 && y < rows && pathFinder->GetCell(Vector2(x, y)).flags.HasFlag(flag);
+    };
+
+    // Horizontal grid lines, between row y - 1 and row y
+    for (int y = 0; y <= rows; ++y)
+    {
+        int runStart = -1;
+
+        for (int x = 0; x <= cols; ++x)
+        {
+            bool isBlocked = x < cols
+                && (hasFlag(x, y, ObstacleEdgeFlags::NorthBlocked) || hasFlag(x, y - 1, ObstacleEdgeFlags::SouthBlocked));
+
+            if (isBlocked)
+            {
+                ++totalEdges;
+                if (runStart == -1) runStart = x;
+            }
+            else if (runStart != -1)
+            {
+                rigidBody->CreateLineCollider(TileToWorld(Vector2(runStart, y)), TileToWorld(Vector2(x, y)), false);
+                ++totalColliders;
+                runStart = -1;
+            }
+        }
+    }
+
+    // Vertical grid lines, between column x - 1 and column x
+    for (int x = 0; x <= cols; ++x)
+    {
+        int runStart = -1;
+
+        for (int y = 0; y <= rows; ++y)
+        {
+            bool isBlocked = y < rows
+                && (hasFlag(x, y, ObstacleEdgeFlags::WestBlocked) || hasFlag(x - 1, y, ObstacleEdgeFlags::EastBlocked));
+
+            if (isBlocked)
+            {
+                ++totalEdges;
+                if (runStart == -1) runStart = y;
+            }
+            else if (runStart != -1)
+            {
+                rigidBody->CreateLineCollider(TileToWorld(Vector2(x, runStart)), TileToWorld(Vector2(x, y)), false);
+                ++totalColliders;
+                runStart = -1;
+            }
+        }
+    }
+
+    Log("Merged %d blocked terrain edges into %d colliders\n", totalEdges, totalColliders);
+}
+
 void IsometricSettings::BuildTerrainIsometric(const MapSegment& mapSegment, PathFinderService* pathFinder)
 {
     // Exclude layer 0, since that has background tiles
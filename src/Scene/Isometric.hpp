@@ -19,6 +19,7 @@ struct IsometricTerrainCell
 };
 
 class PathFinderService;
+struct RigidBodyComponent;
 
 struct IsometricSettings
 {
@@ -99,6 +100,12 @@ struct IsometricSettings
     void BuildFromMapSegment(const MapSegment& mapSegment, PathFinderService* pathFinder, struct TilemapEntity* tilemap);
     int GetCurrentLayer(Vector2 position) const;
 
+    /// <summary>
+    /// Adds line colliders along the pathfinder's blocked edges. The merge-terrain-edges console variable picks between
+    /// merged runs of edges and one collider per edge of each cell.
+    /// </summary>
+    void CreateTerrainColliders(PathFinderService* pathFinder, RigidBodyComponent* rigidBody);
+
     Vector2 tileSize;
     float baseDepth = 0;
     VariableSizedGrid<IsometricTerrainCell> terrain;
@@ -107,4 +114,6 @@ struct IsometricSettings
 private:
     void BuildTerrainIsometric(const MapSegment& mapSegment, PathFinderService* pathFinder);
     void BuildTerrainOrthographic(const MapSegment& mapSegment, PathFinderService* pathFinder);
+    void CreateEdgeColliders(PathFinderService* pathFinder, RigidBodyComponent* rigidBody);
+    void CreateMergedEdgeColliders(PathFinderService* pathFinder, RigidBodyComponent* rigidBody);
 };
\ No newline at end of file
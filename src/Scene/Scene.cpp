@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <Resource/ResourceManager.hpp>
 #include <Resource/TilemapResource.hpp>
 #include "Scene.hpp"
@@ -9,6 +10,11 @@
 #include "Scene/TilemapEntity.hpp"
 #include "Tools/Console.hpp"
 #include "Net/ReplicationManager.hpp"
+#include "Scene/SpatialHashService.hpp"
+#include "System/WorkerPool.hpp"
+#include "Tools/Profiler.hpp"
+
+static ConsoleVar<float> g_spatialHashCellSize("spatial-hash-cell-size", SpatialHashService::DefaultCellSize);
 
 Entity* Scene::entityUnderConstruction = nullptr;
 
@@ -25,6 +31,7 @@ Scene::Scene(Engine* engine, StringId mapSegmentName, bool isServer)
     _camera.SetScreenSize(engine->GetSdlManager() == nullptr ? Vector2(0, 0)
                                                              : engine->GetSdlManager()->WindowSize().AsVectorOfType<float>());
     replicationManager = AddService<ReplicationManager>(this, isServer);
+    spatialHash = AddService<SpatialHashService>(g_spatialHashCellSize.Value());
 }
 
 Scene::~Scene()
@@ -52,12 +59,14 @@ void Scene::RegisterEntity(Entity* entity)
 {
     _entityManager.RegisterEntity(entity);
     _engine->GetSoundManager()->AddSoundEmitter(&entity->_soundEmitter, entity);
+    spatialHash->AddEntity(entity);
 }
 
 void Scene::RemoveEntity(Entity* entity)
 {
     entity->OnDestroyed();
     _engine->GetSoundManager()->RemoveSoundEmitter(&entity->_soundEmitter);
+    spatialHash->RemoveEntity(entity);
 
     // Remove components
     {
@@ -70,8 +79,17 @@ void Scene::RemoveEntity(Entity* entity)
             entity->_componentList = next;
 
             component->OnRemoved();
-            auto block = component->GetMemoryBlock();
-            FreeMemory(block.second, block.first);
+
+            if (_componentManager.StorageMode() == ComponentStorageMode::Pooled)
+            {
+                _componentManager.FreeComponent(component);
+            }
+            else
+            {
+                auto block = component->GetMemoryBlock();
+                FreeMemory(block.second, block.first);
+            }
+
             component = next;
         }
 
@@ -90,6 +108,13 @@ void Scene::RemoveEntity(Entity* entity)
 
 void Scene::MarkEntityForDestruction(Entity* entity)
 {
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        // Merged back on the main thread once the concurrent hook finishes
+        deferredChanges->AddDestroy(entity);
+        return;
+    }
+
     if (entity->isDestroyed)
     {
         return;
@@ -114,6 +139,11 @@ void Scene::DestroyScheduledEntities()
 
 void* Scene::AllocateMemory(int size) const
 {
+    if (DeferredEntityChanges::Current() != nullptr)
+    {
+        FatalError("Can't allocate scene memory from a concurrent entity update, use Scene::ExecuteDeferred()");
+    }
+
     return _engine->GetDefaultBlockAllocator()->Allocate(size);
 }
 
@@ -141,16 +171,134 @@ static void RunHook(const robin_hood::unordered_flat_set<EntityGroup*>& hook, co
     }
 }
 
+void Scene::RunUpdateHook(const robin_hood::unordered_flat_set<EntityGroup*>& hook, EntityGroupFlags concurrentFlag, const std::function<void(Entity*)>& func)
+{
+    auto workerPool = _engine->GetWorkerPool();
+    bool canRunConcurrently = workerPool != nullptr && workerPool->TotalThreads() > 1;
+
+    _isRunningUpdateHook = true;
+
+    for (auto group : hook)
+    {
+        if (canRunConcurrently && group->flags.HasFlag(concurrentFlag))
+        {
+            RunGroupConcurrently(group, func);
+        }
+        else
+        {
+            for (auto entity : group->entities)
+            {
+                func(entity);
+            }
+        }
+    }
+
+    _isRunningUpdateHook = false;
+
+    for (auto& action : _deferredActions)
+    {
+        action();
+    }
+
+    _deferredActions.clear();
+}
+
+void Scene::RunGroupConcurrently(EntityGroup* group, const std::function<void(Entity*)>& func)
+{
+    auto workerPool = _engine->GetWorkerPool();
+
+    _concurrentHookEntities.clear();
+    for (auto entity : group->entities)
+    {
+        _concurrentHookEntities.push_back(entity);
+    }
+
+    int totalEntities = _concurrentHookEntities.size();
+    int totalBatches = std::min(
+        (totalEntities + MinEntitiesPerConcurrentBatch - 1) / MinEntitiesPerConcurrentBatch,
+        workerPool->TotalThreads() * 4);
+
+    if (totalBatches == 0)
+    {
+        return;
+    }
+
+    if ((int)_deferredChangeBatches.size() < totalBatches)
+    {
+        _deferredChangeBatches.resize(totalBatches);
+    }
+
+    // Batches are contiguous ranges of the group so that merging them in batch order gives the same result as
+    // running the hook serially
+    workerPool->ParallelFor(totalBatches, [&](int batchId)
+    {
+        PROFILE_ZONE("ConcurrentUpdateBatch");
+
+        auto& currentChanges = DeferredEntityChanges::Current();
+        currentChanges = &_deferredChangeBatches[batchId];
+
+        int begin = (long long)totalEntities * batchId / totalBatches;
+        int end = (long long)totalEntities * (batchId + 1) / totalBatches;
+
+        for (int i = begin; i < end; ++i)
+        {
+            func(_concurrentHookEntities[i]);
+        }
+
+        currentChanges = nullptr;
+    });
+
+    for (int i = 0; i < totalBatches; ++i)
+    {
+        MergeDeferredChanges(_deferredChangeBatches[i]);
+    }
+}
+
+void Scene::MergeDeferredChanges(DeferredEntityChanges& changes)
+{
+    // In the order they were recorded. A move notifies listeners that can destroy entities and start timers
+    // themselves, so applying each type of change in one go would change the order those happen in.
+    for (auto& change : changes.order)
+    {
+        switch (change.type)
+        {
+        case DeferredChangeType::Destroy:
+            MarkEntityForDestruction(changes.toBeDestroyed[change.index]);
+            break;
+
+        case DeferredChangeType::HookRemoval:
+            _entityManager.scheduledHookRemovals.push_back(changes.hookRemovals[change.index]);
+            break;
+
+        case DeferredChangeType::Action:
+            _deferredActions.push_back(std::move(changes.actions[change.index]));
+            break;
+
+        case DeferredChangeType::TimerStart:
+        {
+            auto& timerStart = changes.timerStarts[change.index];
+            _timerManager.StartReservedTimer(timerStart.handle, timerStart.entity);
+            break;
+        }
+
+        case DeferredChangeType::Move:
+            changes.movedEntities[change.index]->NotifyMovement();
+            break;
+        }
+    }
+
+    changes.Clear();
+}
+
 void Scene::RenderEntities(Renderer* renderer)
 {
+    PROFILE_ZONE("RenderEntities");
+
     SendEvent(RenderEvent(renderer));
 
     RunHook(_entityManager.renderables, [=](Entity* entity) { entity->Render(renderer); });
 
-    for (auto component : _componentManager.renderables)
-    {
-        component->Render(renderer);
-    }
+    _componentManager.ForEachRenderable([=](IEntityComponent* component) { component->Render(renderer); });
 
     if (g_drawColliders.Value())
     {
@@ -160,6 +308,7 @@ void Scene::RenderEntities(Renderer* renderer)
 
 void Scene::StepPhysicsSimulation()
 {
+    PROFILE_ZONE("StepPhysics");
     _world->Step(PhysicsDeltaTime, 8, 3);
     _collisionManager.UpdateEntityPositions();
 }
@@ -204,14 +353,71 @@ void Scene::LoadMapSegment(const MapSegment& segment)
     tileMap->SetMapSegment(segment);
 }
 
-void Scene::StartTimer(float timeSeconds, const std::function<void()>& callback)
+TimerHandle Scene::StartTimer(float timeSeconds, const std::function<void()>& callback)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        auto handle = _timerManager.ReserveTimer(timeSeconds, callback, false);
+        deferredChanges->AddTimerStart(handle, nullptr);
+        return handle;
+    }
+
+    return _timerManager.StartTimer(timeSeconds, callback);
+}
+
+TimerHandle Scene::StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        auto handle = _timerManager.ReserveTimer(timeSeconds, callback, false);
+        deferredChanges->AddTimerStart(handle, entity);
+        return handle;
+    }
+
+    return _timerManager.StartEntityTimer(timeSeconds, callback, entity);
+}
+
+TimerHandle Scene::StartRepeatingTimer(float intervalSeconds, const std::function<void()>& callback, Entity* entity)
+{
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        auto handle = _timerManager.ReserveTimer(intervalSeconds, callback, true);
+        deferredChanges->AddTimerStart(handle, entity);
+        return handle;
+    }
+
+    return _timerManager.StartRepeatingTimer(intervalSeconds, callback, entity);
+}
+
+bool Scene::CancelTimer(TimerHandle handle)
+{
+    if (DeferredEntityChanges::Current() != nullptr)
+    {
+        FatalError("Timers can't be cancelled from a concurrent update hook");
+    }
+
+    return _timerManager.CancelTimer(handle);
+}
+
+bool Scene::IsTimerActive(TimerHandle handle) const
 {
-    _timerManager.StartTimer(timeSeconds, callback);
+    return _timerManager.IsTimerActive(handle);
 }
 
-void Scene::StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity)
+void Scene::ExecuteDeferred(const std::function<void()>& action)
 {
-    _timerManager.StartEntityTimer(timeSeconds, callback, entity);
+    if (auto deferredChanges = DeferredEntityChanges::Current())
+    {
+        deferredChanges->AddAction(action);
+    }
+    else if (_isRunningUpdateHook)
+    {
+        _deferredActions.push_back(action);
+    }
+    else
+    {
+        action();
+    }
 }
 
 gsl::span<ColliderHandle>
@@ -227,10 +433,22 @@ Scene::FindOverlappingColliders(const Rectangle& bounds, gsl::span<ColliderHandl
     return callback.Results();
 }
 
+FrameVector<ColliderHandle> Scene::FindOverlappingColliders(const Rectangle& bounds)
+{
+    FrameVector<ColliderHandle> colliders(_frameArena);
+    CollectFixturesQueryCallback callback(colliders);
+    b2AABB aabb;
+    aabb.lowerBound = PixelToBox2D(bounds.TopLeft());
+    aabb.upperBound = PixelToBox2D(bounds.BottomRight());
+
+    _world->QueryAABB(&callback, aabb);
+
+    return colliders;
+}
+
 gsl::span<Entity*> Scene::FindOverlappingEntities(const Rectangle& bounds, gsl::span<Entity*> storage)
 {
-    static ColliderHandle overlappingColliders[MaxEntities * 4];
-    auto colliders = FindOverlappingColliders(bounds, overlappingColliders);
+    auto colliders = FindOverlappingColliders(bounds);
 
     int totalOverlappingEntities = 0;
     int queryId = BeginQuery();
@@ -251,14 +469,68 @@ gsl::span<Entity*> Scene::FindOverlappingEntities(const Rectangle& bounds, gsl::
 
 bool Scene::Raycast(Vector2 start, Vector2 end, RaycastResult& outResult, bool allowTriggers,
     const std::function<bool(ColliderHandle handle)>& includeFixture) const
+{
+    FindClosestRaycastCallback callback(allowTriggers, includeFixture);
+
+    return CastRay(start, end, callback, outResult);
+}
+
+gsl::span<RaycastResult> Scene::RaycastBatch(gsl::span<const RaycastRequest> rays, gsl::span<RaycastResult> outResults) const
+{
+    if (outResults.size() < rays.size())
+    {
+        FatalError("Raycast batch of %d rays only has room for %d results", (int)rays.size(), (int)outResults.size());
+    }
+
+    int totalRays = rays.size();
+    std::function<bool(ColliderHandle handle)> includeAllFixtures;
+
+    auto castRays = [&](int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            auto& ray = rays[i];
+            FindClosestRaycastCallback callback(ray.allowTriggers, includeAllFixtures, ray.maskBits);
+
+            if (!CastRay(ray.start, ray.end, callback, outResults[i]))
+            {
+                outResults[i] = RaycastResult();
+            }
+        }
+    };
+
+    // Box2D's ray casts only read the broadphase tree, so the world can be shared by the workers
+    auto workerPool = _engine->GetWorkerPool();
+    int totalBatches = workerPool != nullptr
+        ? std::min(totalRays / MinRaysPerConcurrentBatch, workerPool->TotalThreads() * 4)
+        : 0;
+
+    if (totalBatches > 1)
+    {
+        PROFILE_ZONE("RaycastBatch");
+
+        workerPool->ParallelFor(totalBatches, [&](int batchId)
+        {
+            castRays(
+                (long long)totalRays * batchId / totalBatches,
+                (long long)totalRays * (batchId + 1) / totalBatches);
+        });
+    }
+    else
+    {
+        castRays(0, totalRays);
+    }
+
+    return outResults.subspan(0, totalRays);
+}
+
+bool Scene::CastRay(Vector2 start, Vector2 end, FindClosestRaycastCallback& callback, RaycastResult& outResult) const
 {
     if (IsApproximately((end - start).TaxiCabDistance(), 0))
     {
         return false;
     }
 
-    FindClosestRaycastCallback callback(allowTriggers, includeFixture);
-
     _world->RayCast(&callback, PixelToBox2D(start), PixelToBox2D(end));
 
     if (callback.lastFraction == 1)
@@ -278,6 +550,8 @@ bool Scene::Raycast(Vector2 start, Vector2 end, RaycastResult& outResult, bool a
 
 void Scene::UpdateEntities(float deltaTime)
 {
+    PROFILE_ZONE("UpdateEntities");
+
     _physicsTimeLeft += deltaTime;
     relativeTime += deltaTime;
 
@@ -297,7 +571,10 @@ void Scene::UpdateEntities(float deltaTime)
 
     SendEvent(EndOfUpdateEvent());
 
-    _timerManager.TickTimers(deltaTime);
+    {
+        PROFILE_ZONE("TickTimers");
+        _timerManager.TickTimers(deltaTime);
+    }
 
     _cameraFollower.Update(deltaTime);
     _componentManager.UpdateScheduledComponents();
@@ -308,45 +585,43 @@ void Scene::UpdateEntities(float deltaTime)
 
 void Scene::NotifyFixedUpdate()
 {
+    PROFILE_ZONE("FixedUpdate");
     SendEvent(FixedUpdateEvent());
 
     if (!isServer)
     {
-        RunHook(_entityManager.fixedUpdatables, [=](Entity* entity) { entity->FixedUpdate(PhysicsDeltaTime); });
+        RunUpdateHook(_entityManager.fixedUpdatables, EntityGroupFlags::ConcurrentFixedUpdate, [=](Entity* entity) { entity->FixedUpdate(PhysicsDeltaTime); });
     }
 
-    for (auto component : _componentManager.fixedUpdatables)
-    {
-        component->FixedUpdate(deltaTime);
-    }
+    _componentManager.ForEachFixedUpdatable([=](IEntityComponent* component) { component->FixedUpdate(deltaTime); });
 }
 
 void Scene::NotifyServerFixedUpdate()
 {
+    PROFILE_ZONE("ServerFixedUpdate");
     if (isServer)
     {
-        RunHook(_entityManager.serverFixedUpdatables, [=](Entity* entity) { entity->ServerFixedUpdate(PhysicsDeltaTime); });
+        RunUpdateHook(_entityManager.serverFixedUpdatables, EntityGroupFlags::ConcurrentFixedUpdate, [=](Entity* entity) { entity->ServerFixedUpdate(PhysicsDeltaTime); });
     }
 }
 
 void Scene::NotifyUpdate(float deltaTime)
 {
+    PROFILE_ZONE("Update");
     if (!isServer)
     {
-        RunHook(_entityManager.updatables, [=](Entity* entity) { entity->Update(deltaTime); });
+        RunUpdateHook(_entityManager.updatables, EntityGroupFlags::ConcurrentUpdate, [=](Entity* entity) { entity->Update(deltaTime); });
     }
 
-    for (auto component : _componentManager.updatables)
-    {
-        component->Update(deltaTime);
-    }
+    _componentManager.ForEachUpdatable([=](IEntityComponent* component) { component->Update(deltaTime); });
 }
 
 void Scene::NotifyServerUpdate(float deltaTime)
 {
+    PROFILE_ZONE("ServerUpdate");
     if (isServer)
     {
-        RunHook(_entityManager.serverUpdatables, [=](Entity* entity) { entity->ServerUpdate(deltaTime); });
+        RunUpdateHook(_entityManager.serverUpdatables, EntityGroupFlags::ConcurrentUpdate, [=](Entity* entity) { entity->ServerUpdate(deltaTime); });
     }
 }
 
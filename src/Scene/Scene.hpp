@@ -12,6 +12,7 @@
 #include "EntityManager.hpp"
 #include "Renderer/Lighting.hpp"
 #include "Memory/FreeList.hpp"
+#include "Memory/FrameArena.hpp"
 #include "MapSegment.hpp"
 #include "Timer.hpp"
 #include "Isometric.hpp"
@@ -60,6 +61,14 @@ struct RaycastResult
 	Vector2 normal;
 };
 
+struct RaycastRequest
+{
+	Vector2 start;
+	Vector2 end;
+	uint16 maskBits = 0xFFFF;	// Only colliders whose category bits overlap these are hit
+	bool allowTriggers = false;
+};
+
 struct Transform
 {
 	constexpr Transform()
@@ -79,6 +88,7 @@ struct Transform
 };
 
 class ReplicationManager;
+class SpatialHashService;
 
 enum class ScenePerspective
 {
@@ -122,6 +132,11 @@ public:
 		return _world.get();
 	}
 
+	CollisionManager& GetCollisionManager()
+	{
+		return _collisionManager;
+	}
+
 	StringId SceneName() const
 	{
 		return _sceneName;
@@ -142,6 +157,9 @@ public:
 	template<typename TService>
 	TService* GetService();
 
+	template<typename TService>
+	TService* TryGetService();
+
 	void SendEvent(const IEntityEvent& ev);
 
 	void BroadcastEvent(const IEntityEvent& ev);
@@ -153,13 +171,37 @@ public:
 	void LoadMapSegment(const char* name);
 	void LoadMapSegment(const MapSegment& segment);
 
-	void StartTimer(float timeSeconds, const std::function<void()>& callback);
+	/// <summary>
+	/// Timers started from a concurrent update hook get their handle right away, but only start when the hook's batch
+	/// is merged. Batches are merged in order, so the timers fire in the same order as if the hook had run serially.
+	/// </summary>
+	TimerHandle StartTimer(float timeSeconds, const std::function<void()>& callback);
+
+	TimerHandle StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity);
+
+	TimerHandle StartRepeatingTimer(float intervalSeconds, const std::function<void()>& callback, Entity* entity = nullptr);
 
-	void StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity);
+	bool CancelTimer(TimerHandle handle);
+
+	/// <summary>
+	/// Can be called from a concurrent update hook, unlike CancelTimer().
+	/// </summary>
+	bool IsTimerActive(TimerHandle handle) const;
+
+	/// <summary>
+	/// Runs an action once the update hook that is currently running has finished, or immediately if no hook is
+	/// running. Entities that update concurrently must use this to create entities or modify other entities.
+	/// </summary>
+	void ExecuteDeferred(const std::function<void()>& action);
 
 	gsl::span<ColliderHandle>
 	FindOverlappingColliders(const Rectangle& bounds, gsl::span<ColliderHandle> storage) const;
 
+	/// <summary>
+	/// Finds every overlapping collider, however many there are. The result lives in the frame arena.
+	/// </summary>
+	FrameVector<ColliderHandle> FindOverlappingColliders(const Rectangle& bounds);
+
 	gsl::span<Entity*> FindOverlappingEntities(const Rectangle& bounds, gsl::span<Entity*> storage);
 
 	bool Raycast(
@@ -169,6 +211,13 @@ public:
 			bool allowTriggers = false,
 			const std::function<bool(ColliderHandle handle)>& includeFixture = nullptr) const;
 
+	/// <summary>
+	/// Casts every ray and writes the closest hit of rays[i] to outResults[i], with a null handle if it doesn't hit
+	/// anything. The results are the same as calling Raycast() for each ray. Large batches are split across the worker
+	/// threads, so the world must not change until it returns.
+	/// </summary>
+	gsl::span<RaycastResult> RaycastBatch(gsl::span<const RaycastRequest> rays, gsl::span<RaycastResult> outResults) const;
+
 	template<typename TEntity>
 	EntityList<TEntity> GetEntitiesOfType();
 
@@ -200,6 +249,20 @@ public:
 		return _componentManager;
 	}
 
+	SyncVarHistoryPool& GetSyncVarHistoryPool()
+	{
+		return _syncVarHistoryPool;
+	}
+
+	/// <summary>
+	/// Scratch memory for the current frame. Everything allocated from it is released when the engine finishes running
+	/// the frame, so nothing allocated from it may be kept across frames.
+	/// </summary>
+	FrameArena& GetFrameArena()
+	{
+		return _frameArena;
+	}
+
     long long BeginQuery()
     {
         return _nextQueryId++;
@@ -215,6 +278,7 @@ public:
 	bool inEditor = false;
 	EntityReference<Entity> soundListener;
 	ReplicationManager* replicationManager;
+	SpatialHashService* spatialHash;
 	bool isServer;
 
     ScenePerspective perspective = ScenePerspective::Orothgraphic;
@@ -239,6 +303,18 @@ private:
 	void NotifyFixedUpdate();
 	void NotifyServerFixedUpdate();
 
+	template<typename TEntity>
+	static void SetEntityGroupFlags(EntityGroup* group);
+
+	void RunUpdateHook(const robin_hood::unordered_flat_set<EntityGroup*>& hook, EntityGroupFlags concurrentFlag, const std::function<void(Entity*)>& func);
+	void RunGroupConcurrently(EntityGroup* group, const std::function<void(Entity*)>& func);
+	void MergeDeferredChanges(DeferredEntityChanges& changes);
+
+	bool CastRay(Vector2 start, Vector2 end, FindClosestRaycastCallback& callback, RaycastResult& outResult) const;
+
+	static constexpr int MinEntitiesPerConcurrentBatch = 32;
+	static constexpr int MinRaysPerConcurrentBatch = 256;
+
 	StringId _sceneName;
 
 	Camera _camera;
@@ -252,8 +328,15 @@ private:
 	long long _nextQueryId = 0;
 
 	TimerManager _timerManager;
+	SyncVarHistoryPool _syncVarHistoryPool;
+	FrameArena _frameArena;
 	EntityManager _entityManager;
 	EntityComponentManager _componentManager;
+
+	bool _isRunningUpdateHook = false;
+	std::vector<Entity*> _concurrentHookEntities;
+	std::vector<DeferredEntityChanges> _deferredChangeBatches;
+	std::vector<std::function<void()>> _deferredActions;
 };
 
 template<typename TEntity, typename ... Args>
@@ -274,6 +357,7 @@ TEntity* Scene::CreateEntity(const Transform& transform, Args&& ... constructorA
 	entity->scene = this;
 
 	RegisterEntity(entity);
+	SetEntityGroupFlags<TEntity>(entity->entityGroup);
 	((Entity*)entity)->OnAdded();
 	entityUnderConstruction = oldEntityUnderConstruction;
 
@@ -307,6 +391,7 @@ TEntity* Scene::CreateEntity(EntitySerializer& serializer, Args&& ... constructo
     entity->DoSerialize(serializer);
 
     RegisterEntity(entity);
+    SetEntityGroupFlags<TEntity>(entity->entityGroup);
     ((Entity*)entity)->OnAdded();
     entityUnderConstruction = oldEntityUnderConstruction;
 
@@ -314,6 +399,12 @@ TEntity* Scene::CreateEntity(EntitySerializer& serializer, Args&& ... constructo
 }
 
 
+template<typename TEntity>
+void Scene::SetEntityGroupFlags(EntityGroup* group)
+{
+	if constexpr (TEntity::ConcurrentUpdate) group->flags.SetFlag(EntityGroupFlags::ConcurrentUpdate);
+	if constexpr (TEntity::ConcurrentFixedUpdate) group->flags.SetFlag(EntityGroupFlags::ConcurrentFixedUpdate);
+}
 
 template<typename TService, typename ... Args>
 TService* Scene::AddService(Args&& ... args)
@@ -331,6 +422,18 @@ TService* Scene::AddService(Args&& ... args)
 
 template<typename TService>
 TService* Scene::GetService()
+{
+	auto service = TryGetService<TService>();
+	if (service == nullptr)
+	{
+		FatalError("Missing service");
+	}
+
+	return service;
+}
+
+template<typename TService>
+TService* Scene::TryGetService()
 {
 	for (auto& service : _services)
 	{
@@ -340,7 +443,7 @@ TService* Scene::GetService()
 		}
 	}
 
-	FatalError("Missing service");
+	return nullptr;
 }
 
 template<typename TEntity>
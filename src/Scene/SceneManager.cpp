@@ -1,5 +1,6 @@
 #include <Resource/TilemapResource.hpp>
 #include <Net/PlayerCommandRunner.hpp>
+#include <Net/ServerGame.hpp>
 #include "Tools/Console.hpp"
 #include "Engine.hpp"
 
@@ -69,9 +70,18 @@ void SceneManager::BuildNewScene(TilemapResource* tilemap)
     auto& config = game->GetConfig();
 
     _scene->perspective = config.perspective;
+    _scene->GetComponentManager().SetStorageMode(config.componentStorage);
 
     if (config.isMultiplayer)
     {
+        BaseGameInstance* gameInstance = _isServer
+            ? static_cast<BaseGameInstance*>(_engine->GetServerGame())
+            : static_cast<BaseGameInstance*>(_engine->GetClientGame());
+        float tickRate = gameInstance != nullptr ? gameInstance->targetTickRate : 60;
+
+        _scene->GetSyncVarHistoryPool().SetHistoryLength(
+            SyncVarHistoryPool::CalculateHistoryLength(tickRate, config.syncVarHistorySeconds));
+
         _scene->AddService<PlayerCommandRunner>(_scene->isServer);
     }
 
@@ -0,0 +1,307 @@
+#include "SpatialHashService.hpp"
+
+#include <algorithm>
+
+#include "Scene/Entity.hpp"
+#include "Scene/EntityManager.hpp"
+#include "System/Logger.hpp"
+
+SpatialHashService::SpatialHashService(float cellSize)
+    : _cellSize(cellSize)
+{
+    if (!(cellSize > 0))
+    {
+        FatalError("Invalid spatial hash cell size: %f", cellSize);
+    }
+}
+
+void SpatialHashService::AddEntity(Entity* entity)
+{
+    if (entity->spatialHashBucket != -1)
+    {
+        FatalError("Entity is already in the spatial hash");
+    }
+
+    auto position = entity->Center();
+    int x = CellCoordinate(position.x);
+    int y = CellCoordinate(position.y);
+
+    auto result = _bucketByCell.try_emplace(CellKey(x, y), (int)_buckets.size());
+    if (result.second)
+    {
+        _buckets.push_back(Bucket{ x, y, { } });
+    }
+
+    int bucketIndex = result.first->second;
+    auto& elements = _buckets[bucketIndex].elements;
+
+    entity->spatialHashBucket = bucketIndex;
+    entity->spatialHashSlot = (int)elements.size();
+    elements.push_back({ entity, position });
+
+    // Nothing was ever added
+    if (_maxCellX < _minCellX)
+    {
+        _minCellX = _maxCellX = x;
+        _minCellY = _maxCellY = y;
+    }
+    else
+    {
+        _minCellX = std::min(_minCellX, x);
+        _minCellY = std::min(_minCellY, y);
+        _maxCellX = std::max(_maxCellX, x);
+        _maxCellY = std::max(_maxCellY, y);
+    }
+
+    ++_totalEntities;
+}
+
+void SpatialHashService::RemoveEntity(Entity* entity)
+{
+    if (entity->spatialHashBucket == -1)
+    {
+        return;
+    }
+
+    // Swap with the last element so the bucket stays packed. Empty buckets are kept for when an entity comes back.
+    auto& elements = _buckets[entity->spatialHashBucket].elements;
+    int slot = entity->spatialHashSlot;
+
+    elements[slot] = elements.back();
+    elements[slot].entity->spatialHashSlot = slot;
+    elements.pop_back();
+
+    entity->spatialHashBucket = -1;
+    entity->spatialHashSlot = -1;
+
+    --_totalEntities;
+}
+
+void SpatialHashService::NotifyMovement(Entity* entity)
+{
+    UpdateEntity(entity);
+}
+
+void SpatialHashService::UpdateEntity(Entity* entity)
+{
+    if (entity->spatialHashBucket == -1)
+    {
+        return;
+    }
+
+    auto position = entity->Center();
+    auto& bucket = _buckets[entity->spatialHashBucket];
+
+    if (bucket.x == CellCoordinate(position.x) && bucket.y == CellCoordinate(position.y))
+    {
+        bucket.elements[entity->spatialHashSlot].position = position;
+        return;
+    }
+
+    RemoveEntity(entity);
+    AddEntity(entity);
+}
+
+Vector2 SpatialHashService::GetPosition(Entity* entity) const
+{
+    return _buckets[entity->spatialHashBucket].elements[entity->spatialHashSlot].position;
+}
+
+float SpatialHashService::DistanceSquared(Entity* entity, Vector2 point) const
+{
+    return (GetPosition(entity) - point).LengthSquared();
+}
+
+template<typename TFunc>
+void SpatialHashService::ForEachElementInCells(int minX, int minY, int maxX, int maxY, TFunc func) const
+{
+    minX = std::max(minX, _minCellX);
+    minY = std::max(minY, _minCellY);
+    maxX = std::min(maxX, _maxCellX);
+    maxY = std::min(maxY, _maxCellY);
+
+    if (minX > maxX || minY > maxY)
+    {
+        return;
+    }
+
+    // A large area is mostly empty cells, so it's faster to go through the buckets instead
+    if ((int64_t)(maxX - minX + 1) * (maxY - minY + 1) > (int64_t)_buckets.size())
+    {
+        for (auto& bucket : _buckets)
+        {
+            if (bucket.x < minX || bucket.x > maxX || bucket.y < minY || bucket.y > maxY)
+            {
+                continue;
+            }
+
+            for (auto& element : bucket.elements)
+            {
+                if (!func(element))
+                {
+                    return;
+                }
+            }
+        }
+
+        return;
+    }
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            auto bucketIndex = _bucketByCell.find(CellKey(x, y));
+            if (bucketIndex == _bucketByCell.end())
+            {
+                continue;
+            }
+
+            for (auto& element : _buckets[bucketIndex->second].elements)
+            {
+                if (!func(element))
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+gsl::span<Entity*> SpatialHashService::FindInRectangle(const Rectangle& bounds, gsl::span<Entity*> storage) const
+{
+    int count = 0;
+
+    if (storage.size() == 0)
+    {
+        return storage.subspan(0, 0);
+    }
+
+    ForEachElementInCells(
+        CellCoordinate(bounds.topLeft.x),
+        CellCoordinate(bounds.topLeft.y),
+        CellCoordinate(bounds.bottomRight.x),
+        CellCoordinate(bounds.bottomRight.y),
+        [&](const Element& element)
+        {
+            if (bounds.ContainsPoint(element.position))
+            {
+                storage[count++] = element.entity;
+            }
+
+            return count < (int)storage.size();
+        });
+
+    return storage.subspan(0, count);
+}
+
+gsl::span<Entity*> SpatialHashService::FindInRadius(Vector2 center, float radius, gsl::span<Entity*> storage) const
+{
+    int count = 0;
+    float radiusSquared = radius * radius;
+
+    if (storage.size() == 0 || radius < 0)
+    {
+        return storage.subspan(0, 0);
+    }
+
+    ForEachElementInCells(
+        CellCoordinate(center.x - radius),
+        CellCoordinate(center.y - radius),
+        CellCoordinate(center.x + radius),
+        CellCoordinate(center.y + radius),
+        [&](const Element& element)
+        {
+            if ((element.position - center).LengthSquared() <= radiusSquared)
+            {
+                storage[count++] = element.entity;
+            }
+
+            return count < (int)storage.size();
+        });
+
+    return storage.subspan(0, count);
+}
+
+gsl::span<Entity*> SpatialHashService::FindNearest(Vector2 point, gsl::span<Entity*> storage, float maxDistance) const
+{
+    int count = 0;
+    int maxCount = (int)storage.size();
+
+    if (maxCount == 0 || _totalEntities == 0 || maxDistance < 0)
+    {
+        return storage.subspan(0, 0);
+    }
+
+    float maxDistanceSquared = maxDistance * maxDistance;
+    int centerX = CellCoordinate(point.x);
+    int centerY = CellCoordinate(point.y);
+
+    // Rings of cells around the point's cell. Once the storage is full, stop at the first ring that can't have anything
+    // closer than the furthest entity found.
+    int lastRing = std::max(
+        std::max(std::abs(centerX - _minCellX), std::abs(_maxCellX - centerX)),
+        std::max(std::abs(centerY - _minCellY), std::abs(_maxCellY - centerY)));
+
+    if (std::isfinite(maxDistance))
+    {
+        lastRing = std::min(lastRing, (int)std::ceil(maxDistance / _cellSize) + 1);
+    }
+
+    auto addCandidate = [&](const Element& element)
+    {
+        float distanceSquared = (element.position - point).LengthSquared();
+        if (distanceSquared > maxDistanceSquared)
+        {
+            return true;
+        }
+
+        if (count == maxCount)
+        {
+            if (distanceSquared >= DistanceSquared(storage[count - 1], point))
+            {
+                return true;
+            }
+
+            --count;
+        }
+
+        // Insertion sort, which is fast for the small number of neighbors usually asked for
+        int i = count++;
+        while (i > 0 && DistanceSquared(storage[i - 1], point) > distanceSquared)
+        {
+            storage[i] = storage[i - 1];
+            --i;
+        }
+
+        storage[i] = element.entity;
+
+        return true;
+    };
+
+    for (int ring = 0; ring <= lastRing; ++ring)
+    {
+        if (ring == 0)
+        {
+            ForEachElementInCells(centerX, centerY, centerX, centerY, addCandidate);
+        }
+        else
+        {
+            // Top and bottom rows, then the left and right columns without the corners
+            ForEachElementInCells(centerX - ring, centerY - ring, centerX + ring, centerY - ring, addCandidate);
+            ForEachElementInCells(centerX - ring, centerY + ring, centerX + ring, centerY + ring, addCandidate);
+            ForEachElementInCells(centerX - ring, centerY - ring + 1, centerX - ring, centerY + ring - 1, addCandidate);
+            ForEachElementInCells(centerX + ring, centerY - ring + 1, centerX + ring, centerY + ring - 1, addCandidate);
+        }
+
+        // Anything in the next ring is at least this far from the point
+        float nextRingDistance = ring * _cellSize;
+
+        if (count == maxCount && DistanceSquared(storage[count - 1], point) <= nextRingDistance * nextRingDistance)
+        {
+            break;
+        }
+    }
+
+    return storage.subspan(0, count);
+}
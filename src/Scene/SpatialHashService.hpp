@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <gsl/span>
+#include <robin_hood.h>
+
+#include "Math/Rectangle.hpp"
+#include "Math/Vector2.hpp"
+#include "Scene/Scene.hpp"
+
+/// <summary>
+/// Uniform grid of entity positions, hashed by cell. Unlike FindOverlappingEntities(), it includes entities without
+/// colliders and only looks at their centers.
+///
+/// The queries are const and don't share any state, so they can run on several threads at once, including worker
+/// threads, as long as no entity is added, removed or moved at the same time. Moves made during a concurrent entity
+/// update are applied when the update's changes are merged.
+/// </summary>
+class SpatialHashService : public ISceneService
+{
+public:
+    static constexpr float DefaultCellSize = 128;
+
+    explicit SpatialHashService(float cellSize = DefaultCellSize);
+
+    void AddEntity(Entity* entity);
+    void RemoveEntity(Entity* entity);
+
+    /// <summary>
+    /// Called when an entity moves. Moves from a concurrent entity update reach it once the update's batch is merged.
+    /// </summary>
+    void NotifyMovement(Entity* entity);
+    void UpdateEntity(Entity* entity);
+
+    /// <summary>
+    /// Writes the entities whose center is inside the bounds into storage, until it's full
+    /// </summary>
+    gsl::span<Entity*> FindInRectangle(const Rectangle& bounds, gsl::span<Entity*> storage) const;
+
+    /// <summary>
+    /// Writes the entities whose center is within radius of center into storage, until it's full
+    /// </summary>
+    gsl::span<Entity*> FindInRadius(Vector2 center, float radius, gsl::span<Entity*> storage) const;
+
+    /// <summary>
+    /// Writes the storage.size() entities closest to point into storage, closest first. Entities further than
+    /// maxDistance are ignored.
+    /// </summary>
+    gsl::span<Entity*> FindNearest(
+        Vector2 point,
+        gsl::span<Entity*> storage,
+        float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+    int TotalEntities() const { return _totalEntities; }
+
+private:
+    struct Element
+    {
+        Entity* entity;
+        Vector2 position;
+    };
+
+    struct Bucket
+    {
+        int x;
+        int y;
+        std::vector<Element> elements;
+    };
+
+    void ReceiveEvent(const IEntityEvent& ev) override { }
+
+    int CellCoordinate(float value) const { return (int)std::floor(value / _cellSize); }
+    static int64_t CellKey(int x, int y) { return ((int64_t)x << 32) | (uint32_t)y; }
+
+    Vector2 GetPosition(Entity* entity) const;
+    float DistanceSquared(Entity* entity, Vector2 point) const;
+
+    /// <summary>
+    /// Calls func(const Element&) for each entity in the cells in [minX, maxX] x [minY, maxY] until it returns false
+    /// </summary>
+    template<typename TFunc>
+    void ForEachElementInCells(int minX, int minY, int maxX, int maxY, TFunc func) const;
+
+    float _cellSize;
+    robin_hood::unordered_flat_map<int64_t, int> _bucketByCell;
+    std::vector<Bucket> _buckets;
+    int _totalEntities = 0;
+
+    // Every cell that has ever had an entity is inside these, which bounds the nearest neighbor search
+    int _minCellX = 0;
+    int _minCellY = 0;
+    int _maxCellX = -1;
+    int _maxCellY = -1;
+};
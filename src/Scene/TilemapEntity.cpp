@@ -5,6 +5,9 @@
 #include "Components/RigidBodyComponent.hpp"
 #include "Physics/PathFinding.hpp"
 #include "Renderer/Renderer.hpp"
+#include "Engine.hpp"
+#include "Net/ServerGame.hpp"
+#include "Tools/Console.hpp"
 
 void TilemapEntity::OnAdded()
 {
@@ -29,6 +32,31 @@ void TilemapEntity::Render(Renderer* renderer)
     _renderer.Render(renderer);
 }
 
+static void TilemapStatsCommand(ConsoleCommandBinder& binder)
+{
+    binder.Help("Shows how many tilemap chunks and quads the client drew in the last frame");
+
+    auto game = binder.GetEngine()->GetClientGame();
+    Scene* scene = game != nullptr ? game->GetScene() : nullptr;
+    if (scene == nullptr)
+    {
+        binder.GetConsole()->Log("No client scene\n");
+        return;
+    }
+
+    for (auto tilemap : scene->GetEntitiesOfType<TilemapEntity>())
+    {
+        auto& stats = tilemap->GetRenderer().LastFrameStats();
+
+        binder.GetConsole()->Log("%d of %d chunks visible, %d quads submitted\n",
+            stats.visibleChunks,
+            stats.totalChunks,
+            stats.submittedQuads);
+    }
+}
+
+ConsoleCmd tilemapStatsCmd("tilemap-stats", TilemapStatsCommand);
+
 void TilemapEntity::SetMapSegment(const MapSegment& mapSegment)
 {
     static constexpr int MAX_POINTS = 8;
@@ -8,6 +8,7 @@ DEFINE_ENTITY(TilemapEntity, "tilemap")
 {
     void SetMapSegment(const MapSegment& mapSegment);
     const MapSegment* GetMapSegment() const { return _mapSegment; }
+    const TilemapRenderer& GetRenderer() const { return _renderer; }
 
 	void Render(Renderer* renderer) override;
 
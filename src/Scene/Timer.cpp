@@ -1,46 +1,336 @@
+#include <algorithm>
+#include <cmath>
+
 #include "Timer.hpp"
 
-void TimerManager::StartTimer(float timeSeconds, const std::function<void()>& callback)
+TimerManager::TimerManager()
 {
-    _timers.emplace_back(timeSeconds, callback);
+    std::fill(std::begin(_slotHeads), std::end(_slotHeads), -1);
 }
 
-void TimerManager::StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity)
+TimerHandle TimerManager::StartTimer(float timeSeconds, const std::function<void()>& callback)
 {
-    _entityTimerInstances.emplace_back(timeSeconds, callback, entity);
+    return AddTimer(timeSeconds, callback, nullptr, false);
+}
+
+TimerHandle TimerManager::StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity)
+{
+    return AddTimer(timeSeconds, callback, entity, false);
+}
+
+TimerHandle TimerManager::StartRepeatingTimer(float intervalSeconds, const std::function<void()>& callback, Entity* entity)
+{
+    return AddTimer(intervalSeconds, callback, entity, true);
+}
+
+bool TimerManager::CancelTimer(TimerHandle handle)
+{
+    std::lock_guard<std::mutex> lock(_nodeMutex);
+
+    if (!IsNodeActive(handle))
+    {
+        return false;
+    }
+
+    auto& node = _nodes[handle.index];
+    node.isActive = false;
+    --_activeTimerCount;
+
+    // Timers that are firing or waiting to fire are freed once FireDueTimers() gets to them
+    if (!node.isFiring && node.slot != DueSlot)
+    {
+        Unlink(handle.index);
+        FreeNode(handle.index);
+    }
+
+    return true;
+}
+
+bool TimerManager::IsTimerActive(TimerHandle handle) const
+{
+    std::lock_guard<std::mutex> lock(_nodeMutex);
+
+    return IsNodeActive(handle);
+}
+
+bool TimerManager::IsNodeActive(TimerHandle handle) const
+{
+    return handle.index >= 0
+        && handle.index < (int)_nodes.size()
+        && _nodes[handle.index].generation == handle.generation
+        && _nodes[handle.index].isActive;
 }
 
 void TimerManager::TickTimers(float timeSeconds)
 {
+    // Timers started with no delay since the last tick
+    FireDueTimers();
+
+    _tickRemainder += (double)timeSeconds * TicksPerSecond;
+    auto totalTicks = (uint64_t)_tickRemainder;
+    _tickRemainder -= totalTicks;
+
+    for (uint64_t i = 0; i < totalTicks; ++i)
     {
-        auto it = _timers.begin();
-        while (it != _timers.end())
+        if (_activeTimerCount == 0)
         {
-            auto timer = it++;
-            timer->timeLeft -= timeSeconds;
-            if (timer->timeLeft <= 0)
+            // Nothing is scheduled, so there are no slots to visit
+            _currentTick += totalTicks - i;
+            break;
+        }
+
+        AdvanceTick();
+    }
+}
+
+TimerHandle TimerManager::ReserveTimer(float timeSeconds, const std::function<void()>& callback, bool isRepeating)
+{
+    std::lock_guard<std::mutex> lock(_nodeMutex);
+
+    int nodeIndex = AllocateNode(timeSeconds, callback, isRepeating);
+    return { nodeIndex, _nodes[nodeIndex].generation };
+}
+
+void TimerManager::StartReservedTimer(TimerHandle handle, Entity* entity)
+{
+    auto& node = _nodes[handle.index];
+    node.entity = entity;
+    node.hasEntity = entity != nullptr;
+    node.sequence = _nextSequence++;
+
+    Schedule(handle.index);
+}
+
+TimerHandle TimerManager::AddTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity, bool isRepeating)
+{
+    int nodeIndex = AllocateNode(timeSeconds, callback, isRepeating);
+    TimerHandle handle { nodeIndex, _nodes[nodeIndex].generation };
+    StartReservedTimer(handle, entity);
+
+    return handle;
+}
+
+int TimerManager::AllocateNode(float timeSeconds, const std::function<void()>& callback, bool isRepeating)
+{
+    int nodeIndex;
+    if (!_freeNodes.empty())
+    {
+        nodeIndex = _freeNodes.back();
+        _freeNodes.pop_back();
+    }
+    else
+    {
+        nodeIndex = _nodes.size();
+        _nodes.emplace_back();
+    }
+
+    auto ticks = SecondsToTicks(timeSeconds);
+
+    auto& node = _nodes[nodeIndex];
+    node.callback = callback;
+    node.expireTick = _currentTick + ticks;
+    node.intervalTicks = isRepeating ? std::max<uint64_t>(ticks, 1) : 0;
+    node.isActive = true;
+    node.isFiring = false;
+
+    ++_activeTimerCount;
+
+    return nodeIndex;
+}
+
+uint64_t TimerManager::SecondsToTicks(float timeSeconds) const
+{
+    double ticks = ceil((double)timeSeconds * TicksPerSecond);
+
+    if (ticks <= 0) return 0;
+    else if (ticks >= (double)MaxTicksAhead) return MaxTicksAhead;
+    else return (uint64_t)ticks;
+}
+
+void TimerManager::Schedule(int nodeIndex)
+{
+    auto& node = _nodes[nodeIndex];
+
+    if (node.expireTick <= _currentTick)
+    {
+        node.slot = DueSlot;
+        _dueTimers.push_back(nodeIndex);
+        return;
+    }
+
+    // Timers further out than the outermost wheel are parked in its last slot and rescheduled when it cascades
+    uint64_t ticksAhead = std::min(node.expireTick - _currentTick, MaxTicksAhead);
+    uint64_t placementTick = _currentTick + ticksAhead;
+
+    if (ticksAhead < RootWheelSize)
+    {
+        LinkIntoSlot(nodeIndex, placementTick & (RootWheelSize - 1));
+        return;
+    }
+
+    for (int wheel = 1; wheel < TotalWheels; ++wheel)
+    {
+        int shift = RootWheelBits + (wheel - 1) * WheelBits;
+
+        if (ticksAhead < (1ull << (shift + WheelBits)) || wheel == TotalWheels - 1)
+        {
+            int slot = RootWheelSize + (wheel - 1) * WheelSize + ((placementTick >> shift) & (WheelSize - 1));
+            LinkIntoSlot(nodeIndex, slot);
+            return;
+        }
+    }
+}
+
+void TimerManager::LinkIntoSlot(int nodeIndex, int slot)
+{
+    auto& node = _nodes[nodeIndex];
+    node.slot = slot;
+    node.previous = -1;
+    node.next = _slotHeads[slot];
+
+    if (node.next != -1)
+    {
+        _nodes[node.next].previous = nodeIndex;
+    }
+
+    _slotHeads[slot] = nodeIndex;
+}
+
+void TimerManager::Unlink(int nodeIndex)
+{
+    auto& node = _nodes[nodeIndex];
+
+    if (node.slot >= 0)
+    {
+        if (node.previous != -1) _nodes[node.previous].next = node.next;
+        else _slotHeads[node.slot] = node.next;
+
+        if (node.next != -1) _nodes[node.next].previous = node.previous;
+    }
+
+    node.slot = NoSlot;
+    node.previous = -1;
+    node.next = -1;
+}
+
+void TimerManager::FreeNode(int nodeIndex)
+{
+    auto& node = _nodes[nodeIndex];
+
+    // Release whatever the callback captured right away
+    node.callback = nullptr;
+    node.entity.Invalidate();
+    node.hasEntity = false;
+    node.slot = NoSlot;
+    ++node.generation;
+
+    _freeNodes.push_back(nodeIndex);
+}
+
+void TimerManager::AdvanceTick()
+{
+    ++_currentTick;
+
+    // Each time a wheel wraps around, the next slot of the coarser wheel is spread over the finer ones
+    if ((_currentTick & (RootWheelSize - 1)) == 0)
+    {
+        for (int wheel = 1; wheel < TotalWheels; ++wheel)
+        {
+            Cascade(wheel);
+
+            int shift = RootWheelBits + (wheel - 1) * WheelBits;
+            if (((_currentTick >> shift) & (WheelSize - 1)) != 0)
             {
-                timer->callback();
-                _timers.erase(timer);
+                break;
             }
         }
     }
+
+    int slot = _currentTick & (RootWheelSize - 1);
+    while (_slotHeads[slot] != -1)
+    {
+        int nodeIndex = _slotHeads[slot];
+        Unlink(nodeIndex);
+        _nodes[nodeIndex].slot = DueSlot;
+        _dueTimers.push_back(nodeIndex);
+    }
+
+    FireDueTimers();
+}
+
+void TimerManager::Cascade(int wheel)
+{
+    int shift = RootWheelBits + (wheel - 1) * WheelBits;
+    int slot = RootWheelSize + (wheel - 1) * WheelSize + ((_currentTick >> shift) & (WheelSize - 1));
+
+    int nodeIndex = _slotHeads[slot];
+    _slotHeads[slot] = -1;
+
+    while (nodeIndex != -1)
+    {
+        int next = _nodes[nodeIndex].next;
+        _nodes[nodeIndex].slot = NoSlot;
+        Schedule(nodeIndex);
+        nodeIndex = next;
+    }
+}
+
+void TimerManager::FireDueTimers()
+{
+    // Callbacks can start timers that are already due, so keep going until none are left
+    while (!_dueTimers.empty())
     {
-        auto it = _entityTimerInstances.begin();
-        while (it != _entityTimerInstances.end())
+        _firingTimers.swap(_dueTimers);
+        _dueTimers.clear();
+
+        std::sort(_firingTimers.begin(), _firingTimers.end(), [=](int lhs, int rhs)
+        {
+            auto& lhsNode = _nodes[lhs];
+            auto& rhsNode = _nodes[rhs];
+
+            return lhsNode.expireTick != rhsNode.expireTick
+                ? lhsNode.expireTick < rhsNode.expireTick
+                : lhsNode.sequence < rhsNode.sequence;
+        });
+
+        for (int nodeIndex : _firingTimers)
         {
-            auto timer = it++;
-            timer->timeLeft -= timeSeconds;
+            auto& node = _nodes[nodeIndex];
+            node.slot = NoSlot;
+
+            if (!node.isActive)
+            {
+                FreeNode(nodeIndex);
+                continue;
+            }
 
-            if (timer->timeLeft <= 0)
+            bool entityDestroyed = node.hasEntity && !node.entity.IsValid();
+
+            if (!entityDestroyed)
+            {
+                node.isFiring = true;
+                node.callback();
+                node.isFiring = false;
+            }
+
+            if (node.isActive && node.intervalTicks != 0 && !entityDestroyed)
             {
-                if (timer->entity.IsValid())
+                node.expireTick += node.intervalTicks;
+                node.sequence = _nextSequence++;
+                Schedule(nodeIndex);
+            }
+            else
+            {
+                if (node.isActive)
                 {
-                    timer->callback();
+                    node.isActive = false;
+                    --_activeTimerCount;
                 }
-                
-                _entityTimerInstances.erase(timer);
+
+                FreeNode(nodeIndex);
             }
         }
+
+        _firingTimers.clear();
     }
 }
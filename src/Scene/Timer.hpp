@@ -1,46 +1,123 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
+#include <mutex>
+#include <vector>
 
 #include "Entity.hpp"
+#include "TimerHandle.hpp"
 
+/// <summary>
+/// Timers are kept in a hierarchical timing wheel with millisecond ticks: a 256 slot wheel for the next 256 ticks and
+/// four 64 slot wheels for each coarser range. Starting and cancelling a timer is O(1), and each tick only looks at one
+/// slot plus the occasional cascade of a coarser slot into finer ones. Timers that expire on the same tick fire in the
+/// order they were started, so expiry order doesn't depend on frame timing.
+/// </summary>
 class TimerManager
 {
 public:
-    void StartTimer(float timeSeconds, const std::function<void()>& callback);
-    void StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity);
+    static constexpr int TicksPerSecond = 1000;
+
+    TimerManager();
+
+    TimerHandle StartTimer(float timeSeconds, const std::function<void()>& callback);
+
+    /// <summary>
+    /// Like StartTimer(), but the callback isn't run if the entity has been destroyed by the time the timer expires.
+    /// </summary>
+    TimerHandle StartEntityTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity);
+
+    /// <summary>
+    /// Runs the callback every intervalSeconds until cancelled, or until the entity is destroyed if one is given.
+    /// </summary>
+    TimerHandle StartRepeatingTimer(float intervalSeconds, const std::function<void()>& callback, Entity* entity = nullptr);
+
+    /// <summary>
+    /// Returns false if the timer has already expired or been cancelled. Timers can cancel themselves from their own
+    /// callback.
+    /// </summary>
+    bool CancelTimer(TimerHandle handle);
+
+    /// <summary>
+    /// Safe to call while other threads are reserving timers.
+    /// </summary>
+    bool IsTimerActive(TimerHandle handle) const;
+
+    /// <summary>
+    /// Gives out the handle of a timer that is started later by StartReservedTimer(). Safe to call from several
+    /// threads at once, and alongside IsTimerActive(), as long as nothing else uses the TimerManager until the
+    /// reserved timers are started. Reserved
+    /// timers count down from the tick they were reserved on, but they are ordered by when they were started, so
+    /// starting them in the order they would have been started serially keeps the firing order the same.
+    /// </summary>
+    TimerHandle ReserveTimer(float timeSeconds, const std::function<void()>& callback, bool isRepeating);
+    void StartReservedTimer(TimerHandle handle, Entity* entity);
+
     void TickTimers(float timeSeconds);
 
+    int ActiveTimerCount() const { return _activeTimerCount; }
+
 private:
-    struct TimerInstance
+    static constexpr int RootWheelBits = 8;
+    static constexpr int WheelBits = 6;
+    static constexpr int TotalWheels = 5;
+    static constexpr int RootWheelSize = 1 << RootWheelBits;
+    static constexpr int WheelSize = 1 << WheelBits;
+    static constexpr int TotalSlots = RootWheelSize + (TotalWheels - 1) * WheelSize;
+    static constexpr uint64_t MaxTicksAhead = (1ull << (RootWheelBits + (TotalWheels - 1) * WheelBits)) - 1;
+
+    // Slot index of timers that are already due and are waiting for the current tick to be processed
+    static constexpr int DueSlot = -1;
+    static constexpr int NoSlot = -2;
+
+    struct TimerNode
     {
-        TimerInstance(float timeLeft_, const std::function<void()>& callback_)
-            : timeLeft(timeLeft_),
-            callback(callback_)
-        {
-            
-        }
-
-        float timeLeft;
         std::function<void()> callback;
+        EntityReference<Entity> entity;
+        bool hasEntity = false;
+
+        uint64_t expireTick = 0;
+        uint64_t intervalTicks = 0;     // Non-zero for repeating timers
+        uint64_t sequence = 0;          // Start order, used to break ties between timers that expire on the same tick
+
+        unsigned int generation = 0;
+        int slot = NoSlot;
+        int previous = -1;
+        int next = -1;
+        bool isActive = false;
+        bool isFiring = false;
     };
 
-    struct EntityTimerInstance
-    {
-        EntityTimerInstance(float timeLeft_, const std::function<void()>& callback_, Entity* entity)
-            : timeLeft(timeLeft_),
-            callback(callback_),
-            entity(entity)
-        {
+    TimerHandle AddTimer(float timeSeconds, const std::function<void()>& callback, Entity* entity, bool isRepeating);
+    bool IsNodeActive(TimerHandle handle) const;
+    int AllocateNode(float timeSeconds, const std::function<void()>& callback, bool isRepeating);
+    uint64_t SecondsToTicks(float timeSeconds) const;
 
-        }
+    void Schedule(int nodeIndex);
+    void LinkIntoSlot(int nodeIndex, int slot);
+    void Unlink(int nodeIndex);
+    void FreeNode(int nodeIndex);
 
-        float timeLeft;
-        std::function<void()> callback;
-        EntityReference<Entity> entity;
-    };
+    void AdvanceTick();
+    void Cascade(int wheel);
+    void FireDueTimers();
+
+    // A deque so that nodes don't move when a callback starts another timer
+    std::deque<TimerNode> _nodes;
+    std::vector<int> _freeNodes;
+
+    int _slotHeads[TotalSlots];
+    std::vector<int> _dueTimers;
+    std::vector<int> _firingTimers;
+
+    uint64_t _currentTick = 0;
+    double _tickRemainder = 0;
+    uint64_t _nextSequence = 0;
+    int _activeTimerCount = 0;
 
-    std::list<TimerInstance> _timers;
-    std::list<EntityTimerInstance> _entityTimerInstances;
+    // Taken by everything that can run while timers are being reserved: reserving grows _nodes and reuses free nodes,
+    // so handle lookups on other threads have to wait for it
+    mutable std::mutex _nodeMutex;
 };
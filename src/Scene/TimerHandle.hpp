@@ -0,0 +1,13 @@
+#pragma once
+
+/// <summary>
+/// Identifies a started timer. Stays safe to use after the timer expires or is cancelled; the slot it referred to is
+/// recycled with a new generation.
+/// </summary>
+struct TimerHandle
+{
+    bool IsValid() const { return index >= 0; }
+
+    int index = -1;
+    unsigned int generation = 0;
+};
@@ -47,6 +47,36 @@ void BinaryStreamReader::Open(gsl::span<std::byte> data)
 	Open(reinterpret_cast<unsigned char*>(&data[0]), data.size());
 }
 
+void BinaryStreamReader::OpenMapped(const char* fileName)
+{
+	Close();
+
+	if (!_mappedFile.TryOpen(fileName))
+	{
+		FatalError("Failed to map %s for reading", fileName);
+	}
+
+	_freeOnClose = false;
+	_buffer = _mappedFile.Data();
+	_bufferSize = _mappedFile.Size();
+	_bufferIndex = 0;
+}
+
+void BinaryStreamReader::CopyIntoOwnedBuffer()
+{
+	if (_freeOnClose)
+	{
+		return;
+	}
+
+	auto buf = new unsigned char[_bufferSize];
+	memcpy(buf, _buffer, _bufferSize);
+
+	_mappedFile.Close();
+	_buffer = buf;
+	_freeOnClose = true;
+}
+
 int BinaryStreamReader::ReadInt()
 {
 	int value;
@@ -91,6 +121,9 @@ void BinaryStreamReader::Close()
 		delete [] _buffer;
 	}
 
+	_mappedFile.Close();
+	_freeOnClose = false;
+
 	_bufferIndex = 0;
 	_bufferSize = 0;
 	_buffer = nullptr;
@@ -98,6 +131,11 @@ void BinaryStreamReader::Close()
 
 void BinaryStreamReader::DecryptRange(int startInclusive, int endExclusive, Cipher& cipher)
 {
+	if (IsReadOnly())
+	{
+		FatalError("Can't decrypt a memory mapped stream in place");
+	}
+
 	cipher.Decrypt((byte*)_buffer + startInclusive, (byte*)_buffer + endExclusive);
 }
 
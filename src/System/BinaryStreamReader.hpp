@@ -3,6 +3,8 @@
 #include <cstdio>
 #include <gsl/span>
 
+#include "FileSystem.hpp"
+
 class Cipher;
 
 class BinaryStreamReader
@@ -12,6 +14,14 @@ public:
     void Open(const unsigned char* buffer, size_t size);
     void Open(gsl::span<std::byte> data);
 
+    /// <summary>
+    /// Maps the file instead of reading it up front. The data is read-only, so it can't be decrypted in place until
+    /// CopyIntoOwnedBuffer() is called.
+    /// </summary>
+    void OpenMapped(const char* fileName);
+    bool IsReadOnly() const { return _mappedFile.IsOpen(); }
+    void CopyIntoOwnedBuffer();
+
     int ReadInt();
     float ReadFloat();
     void ReadBlob(void* dest, int size);
@@ -29,4 +39,5 @@ private:
     const unsigned char* _buffer = nullptr;
     size_t _bufferSize = 0;
     size_t _bufferIndex = 0;
+    MemoryMappedFile _mappedFile;
 };
@@ -5,6 +5,15 @@
 
 #include "Logger.hpp"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 FILE* OpenFile(const char* path, const char* mode)
 {
 	return fopen(path, mode);
@@ -70,3 +79,100 @@ bool TryReadFileContents(const wchar_t* path, std::vector<unsigned char>& result
     return false;
 #endif
 }
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    Close();
+}
+
+bool MemoryMappedFile::TryOpen(const char* path)
+{
+    Close();
+
+#ifdef WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        Log("Failed to open %s for mapping\n", path);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        Log("Failed to map %s: file is empty\n", path);
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping != nullptr
+        ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+        : nullptr;
+
+    if (view == nullptr)
+    {
+        Log("Failed to map %s\n", path);
+        if (mapping != nullptr) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _fileHandle = file;
+    _mappingHandle = mapping;
+    _data = static_cast<const unsigned char*>(view);
+    _size = (size_t)size.QuadPart;
+#else
+    int file = open(path, O_RDONLY);
+    if (file == -1)
+    {
+        Log("Failed to open %s for mapping\n", path);
+        return false;
+    }
+
+    struct stat fileStats;
+    if (fstat(file, &fileStats) != 0 || fileStats.st_size == 0)
+    {
+        Log("Failed to map %s: file is empty\n", path);
+        close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    // The mapping keeps its own reference to the file
+    close(file);
+
+    if (view == MAP_FAILED)
+    {
+        Log("Failed to map %s\n", path);
+        return false;
+    }
+
+    _data = static_cast<const unsigned char*>(view);
+    _size = (size_t)fileStats.st_size;
+#endif
+
+    return true;
+}
+
+void MemoryMappedFile::Close()
+{
+    if (_data == nullptr)
+    {
+        return;
+    }
+
+#ifdef WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(_mappingHandle);
+    CloseHandle(_fileHandle);
+    _mappingHandle = nullptr;
+    _fileHandle = nullptr;
+#else
+    munmap(const_cast<unsigned char*>(_data), _size);
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
@@ -7,4 +7,32 @@
 FILE* OpenFile(const char* path, const char* mode);
 bool TryReadFileContents(const char* path, std::string& result);
 bool TryReadFileContents(const char* path, std::vector<unsigned char>& result);
-bool TryReadFileContents(const wchar_t* path, std::vector<unsigned char>& result);
\ No newline at end of file
+bool TryReadFileContents(const wchar_t* path, std::vector<unsigned char>& result);
+
+/// <summary>
+/// Read-only view of a whole file. Pages are only read from disk when they're touched.
+/// </summary>
+class MemoryMappedFile
+{
+public:
+    MemoryMappedFile() = default;
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+    ~MemoryMappedFile();
+
+    bool TryOpen(const char* path);
+    void Close();
+
+    const unsigned char* Data() const { return _data; }
+    size_t Size() const { return _size; }
+    bool IsOpen() const { return _data != nullptr; }
+
+private:
+    const unsigned char* _data = nullptr;
+    size_t _size = 0;
+
+#ifdef WIN32
+    void* _fileHandle = nullptr;
+    void* _mappingHandle = nullptr;
+#endif
+};
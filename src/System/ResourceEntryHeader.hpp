@@ -2,10 +2,16 @@
 
 #include <string>
 
+// Version 0 packs encrypt everything after the signature as one stream, so they have to be read and decrypted whole.
+// Version 1 packs encrypt the header table and each entry separately, so an entry can be decrypted on its own.
+constexpr int LegacyResourcePackVersion = 0;
+constexpr int ResourcePackVersion = 1;
+
 struct ResourceEntryHeader
 {
 	unsigned int key;
 	unsigned int type;
 	unsigned int offset;
-	std::string name;
-};
\ No newline at end of file
+	int size = -1;		// Only stored in the header table since version 1
+	std::string name;	// Only stored in the header table since version 1
+};
@@ -3,7 +3,6 @@
 
 #include "ResourceFileReader.hpp"
 
-#include "Memory/Cipher.hpp"
 #include "Logger.hpp"
 #include "Memory/Crc32.hpp"
 
@@ -18,13 +17,25 @@ std::vector<ResourceFileEntry> ResourceFileReader::LoadEntries()
         FatalError("Invalid resource file");
     }
 
-    if (_reader.ReadInt() != 0)
+    _version = _reader.ReadInt();
+
+    if (_version == ResourcePackVersion)
+    {
+        return LoadEntryTable();
+    }
+    else if (_version != LegacyResourcePackVersion)
     {
         FatalError("Content file incompatible with game. Please update game and content.");
     }
 
-    auto cipher = GetDefaultCipher();
-    _reader.DecryptRange(8, _reader.TotalSize(), cipher);
+    return LoadLegacyEntries();
+}
+
+std::vector<ResourceFileEntry> ResourceFileReader::LoadLegacyEntries()
+{
+    // The whole file is one cipher stream, so there's no way around reading and decrypting all of it
+    _reader.CopyIntoOwnedBuffer();
+    _reader.DecryptRange(8, _reader.TotalSize(), _cipher);
 
     int headerOffset = _reader.ReadInt();
 
@@ -46,17 +57,90 @@ std::vector<ResourceFileEntry> ResourceFileReader::LoadEntries()
     return entries;
 }
 
-gsl::span<std::byte> ResourceFileReader::LoadResource(const ResourceFileEntry& entry)
+std::vector<ResourceFileEntry> ResourceFileReader::LoadEntryTable()
 {
-    _reader.Seek(entry.header.offset);
+    int headerOffset = _reader.ReadInt();
+    int headerSize = _reader.ReadInt();
+
+    if (headerOffset < 0 || headerSize < 4 || (size_t)headerOffset + headerSize > _reader.TotalSize())
+    {
+        FatalError("Corrupt resource file header");
+    }
 
-    unsigned int correctCrc32 = _reader.ReadInt();
+    std::vector<unsigned char> headerData(_reader.Data() + headerOffset, _reader.Data() + headerOffset + headerSize);
+    _cipher.Decrypt(headerData.data(), headerData.data() + headerData.size());
 
-    int size = _reader.ReadInt();
-    unsigned int typeKey = entry.header.type;
+    BinaryStreamReader headerReader;
+    headerReader.Open(headerData.data(), headerData.size());
 
-    auto data = new std::byte[size];
-    _reader.ReadBlob(data, size);
+    int totalEntries = headerReader.ReadInt();
+
+    std::vector<ResourceFileEntry> entries;
+    entries.reserve(totalEntries);
+
+    for (int i = 0; i < totalEntries; ++i)
+    {
+        ResourceEntryHeader header;
+        header.key = headerReader.ReadInt();
+        header.type = headerReader.ReadInt();
+        header.offset = headerReader.ReadInt();
+        header.size = headerReader.ReadInt();
+
+        int nameLength = headerReader.ReadInt();
+        header.name.resize(nameLength);
+        headerReader.ReadBlob(header.name.data(), nameLength);
+
+        entries.emplace_back(header);
+    }
+
+    return entries;
+}
+
+gsl::span<std::byte> ResourceFileReader::LoadResource(const ResourceFileEntry& entry, std::vector<std::byte>& buffer)
+{
+    if (_version == LegacyResourcePackVersion)
+    {
+        _reader.Seek(entry.header.offset);
+
+        unsigned int correctCrc32 = _reader.ReadInt();
+        int size = _reader.ReadInt();
+
+        if (size < 0 || (size_t)entry.header.offset + 8 + size > _reader.TotalSize())
+        {
+            FatalError("Corrupt resource %u, invalid size %d", entry.header.key, size);
+        }
+
+        // Already decrypted by LoadEntries(), so there's no need to copy it
+        auto data = (std::byte*)_reader.Data() + entry.header.offset + 8;
+        CheckCrc32(entry, data, size, correctCrc32);
+
+        return gsl::span<std::byte>(data, size);
+    }
+
+    int size = entry.header.size;
+    int encryptedSize = 4 + size;
+
+    if (size < 0 || (size_t)entry.header.offset + encryptedSize > _reader.TotalSize())
+    {
+        FatalError("Corrupt resource %u, invalid size %d", entry.header.key, size);
+    }
+
+    buffer.resize(encryptedSize);
+    memcpy(buffer.data(), _reader.Data() + entry.header.offset, encryptedSize);
+    _cipher.Decrypt((byte*)buffer.data(), (byte*)buffer.data() + encryptedSize);
+
+    unsigned int correctCrc32;
+    memcpy(&correctCrc32, buffer.data(), 4);
+
+    auto data = buffer.data() + 4;
+    CheckCrc32(entry, data, size, correctCrc32);
+
+    return gsl::span<std::byte>(data, size);
+}
+
+void ResourceFileReader::CheckCrc32(const ResourceFileEntry& entry, const std::byte* data, int size, unsigned int correctCrc32)
+{
+    unsigned int typeKey = entry.header.type;
 
     unsigned int computedCrc32 = Crc32(reinterpret_cast<const char*>(&size), 4);
     computedCrc32 = Crc32AddBytes(computedCrc32, reinterpret_cast<const char*>(&typeKey), 4);
@@ -66,6 +150,4 @@ gsl::span<std::byte> ResourceFileReader::LoadResource(const ResourceFileEntry& e
     {
         FatalError("Corrupt resource %u, got %u expected %u", entry.header.key, computedCrc32, correctCrc32);
     }
-
-    return gsl::span<std::byte>(data, data + size);
 }
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <cstddef>
+#include <vector>
 
 #include "gsl/span"
 
 #include "ResourceEntryHeader.hpp"
 #include "BinaryStreamReader.hpp"
+#include "Memory/Cipher.hpp"
 
 class ResourceFileEntry
 {
@@ -19,17 +21,28 @@ public:
 	ResourceEntryHeader header;
 };
 
+/// <summary>
+/// Reads STRF resource packs. Version 1 packs can be opened with BinaryStreamReader::OpenMapped(), in which case only
+/// the header table and the entries that are asked for are ever read from disk and decrypted. Legacy packs are always
+/// copied into memory and decrypted in full by LoadEntries().
+/// </summary>
 class ResourceFileReader
 {
 public:
     ResourceFileReader(BinaryStreamReader& reader)
-		: _reader(reader)
+		: _reader(reader),
+		  _cipher(GetDefaultCipher())
     {
         
     }
 
     std::vector<ResourceFileEntry> LoadEntries();
-    gsl::span<std::byte> LoadResource(const ResourceFileEntry& entry);
+
+    /// <summary>
+    /// Checks the entry's CRC and returns its contents. The result points either into the reader or into buffer, so it's
+    /// only valid until the next call that uses the same buffer.
+    /// </summary>
+    gsl::span<std::byte> LoadResource(const ResourceFileEntry& entry, std::vector<std::byte>& buffer);
 
 	void Close()
 	{
@@ -37,5 +50,11 @@ public:
 	}
 
 private:
+    std::vector<ResourceFileEntry> LoadLegacyEntries();
+    std::vector<ResourceFileEntry> LoadEntryTable();
+    void CheckCrc32(const ResourceFileEntry& entry, const std::byte* data, int size, unsigned int correctCrc32);
+
 	BinaryStreamReader& _reader;
-};
\ No newline at end of file
+	Cipher _cipher;
+	int _version = -1;
+};
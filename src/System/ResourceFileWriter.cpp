@@ -11,8 +11,11 @@ void ResourceFileWriter::Initialize(const char* outputFileName)
 
 	_outputFileName = outputFileName;
 	_writer.WriteBlob({ reinterpret_cast<const unsigned char*>(signature), 4 });
-	_writer.WriteInt(0);
+	_writer.WriteInt(ResourcePackVersion);
 	_writer.WriteInt(0); // Reserve space for header offset in file
+	_writer.WriteInt(0); // Reserve space for header size in file
+
+	_cipher = GetDefaultCipher();
 }
 
 bool ResourceFileWriter::HasResource(const std::string& name) const
@@ -44,19 +47,21 @@ StringId ResourceFileWriter::WriteResource(void* data, int size, const std::stri
 	header.key = key.key;
 	header.offset = _writer.CurrentPosition();
 	header.type = typeKey;
+	header.size = size;
 
 	unsigned int crc32 = Crc32(reinterpret_cast<const char*>(&size), 4);
 	crc32 = Crc32AddBytes(crc32, reinterpret_cast<const char*>(&typeKey), 4);
 	crc32 = Crc32AddBytes(crc32, reinterpret_cast<const char*>(data), size);
 
 	_writer.WriteInt(crc32);
-	_writer.WriteInt(size);
+	_writer.WriteBlob({ reinterpret_cast<const unsigned char*>(data), (size_t)size });
+
+	// Each entry is encrypted on its own so that it can be decrypted without touching the rest of the file
+	_writer.EncryptRange(header.offset, _writer.CurrentPosition(), *_cipher);
 
 	_resources[name] = header;
 	_keysByName[name] = key;
 
-	_writer.WriteBlob({ reinterpret_cast<const unsigned char*>(data), (size_t)size });
-
 	return key;
 }
 
@@ -96,9 +101,6 @@ StringId ResourceFileWriter::WriteResourceFile(
 void ResourceFileWriter::Finish()
 {
 	WriteHeader();
-	auto cipher = GetDefaultCipher();
-
-	_writer.EncryptRange(8, _writer.TotalSize(), cipher);
 	_writer.WriteToFile(_outputFileName);
 }
 
@@ -117,9 +119,16 @@ void ResourceFileWriter::WriteHeader()
 		_writer.WriteInt(resource.second.key);
 		_writer.WriteInt(resource.second.type);
 		_writer.WriteInt(resource.second.offset);
+		_writer.WriteInt(resource.second.size);
+		_writer.WriteInt(resource.first.size());
+		_writer.WriteBlob(resource.first.data(), resource.first.size());
 	}
 
-	// Write header starting position at position 8 of file (we already reserved space for it)
+	int headerSize = _writer.CurrentPosition() - headerPosition;
+	_writer.EncryptRange(headerPosition, headerPosition + headerSize, *_cipher);
+
+	// Write header position and size at position 8 of file (we already reserved space for them)
 	_writer.Seek(8);
 	_writer.WriteInt(headerPosition);
+	_writer.WriteInt(headerSize);
 }
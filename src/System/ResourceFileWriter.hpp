@@ -1,8 +1,10 @@
 #pragma once
 
 #include <map>
+#include <optional>
 #include <string>
 
+#include "Memory/Cipher.hpp"
 #include "Memory/StringId.hpp"
 #include "System/BinaryStreamWriter.hpp"
 #include "ResourceEntryHeader.hpp"
@@ -24,4 +26,5 @@ private:
 	std::map<std::string, ResourceEntryHeader> _resources;
 	std::map<std::string, StringId> _keysByName;
     const char* _outputFileName;
+    std::optional<Cipher> _cipher;
 };
@@ -0,0 +1,143 @@
+#include "WorkerPool.hpp"
+
+static thread_local bool g_isWorkerThread = false;
+
+WorkerPool::WorkerPool(int totalWorkerThreads)
+{
+    for (int i = 0; i < totalWorkerThreads; ++i)
+    {
+        _threads.emplace_back([=] { WorkerMain(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+}
+
+bool WorkerPool::IsWorkerThread()
+{
+    return g_isWorkerThread;
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& func)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (_threads.empty() || count == 1 || g_isWorkerThread)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            func(i);
+        }
+
+        return;
+    }
+
+    std::lock_guard<std::mutex> dispatchLock(_dispatchMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batchFunc = &func;
+        _batchCount = count;
+        _nextIndex = 0;
+        _workersInBatch = (int)_threads.size();
+        _batchException = nullptr;
+        ++_batchGeneration;
+    }
+
+    _workAvailable.notify_all();
+
+    // The calling thread counts as a worker for the duration of the batch so nested loops don't deadlock
+    g_isWorkerThread = true;
+    RunBatch();
+    g_isWorkerThread = false;
+
+    std::exception_ptr exception;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _batchComplete.wait(lock, [=] { return _workersInBatch == 0; });
+        _batchFunc = nullptr;
+        exception = _batchException;
+    }
+
+    if (exception != nullptr)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+void WorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+
+    _workAvailable.notify_all();
+
+    for (auto& thread : _threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+    _threads.clear();
+}
+
+void WorkerPool::WorkerMain()
+{
+    g_isWorkerThread = true;
+    unsigned int lastGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _workAvailable.wait(lock, [&] { return _stop || _batchGeneration != lastGeneration; });
+
+            if (_stop)
+            {
+                return;
+            }
+
+            lastGeneration = _batchGeneration;
+        }
+
+        RunBatch();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_workersInBatch == 0)
+            {
+                _batchComplete.notify_one();
+            }
+        }
+    }
+}
+
+void WorkerPool::RunBatch()
+{
+    int index;
+    while ((index = _nextIndex.fetch_add(1)) < _batchCount)
+    {
+        try
+        {
+            (*_batchFunc)(index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_batchException == nullptr)
+            {
+                _batchException = std::current_exception();
+            }
+        }
+    }
+}
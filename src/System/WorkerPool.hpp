@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A fixed set of worker threads used to split per-tick work across cores. ParallelFor() blocks until every index has
+/// been processed, and the calling thread processes indices too, so it can be used for work that must finish within
+/// the current frame.
+/// </summary>
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int totalWorkerThreads);
+    ~WorkerPool();
+
+    /// <summary>
+    /// Calls func(i) for every i in [0, count). Indices are handed out to threads in order, but may complete in any
+    /// order. If called from inside a worker, the loop runs serially on that worker.
+    /// </summary>
+    void ParallelFor(int count, const std::function<void(int index)>& func);
+
+    void Stop();
+
+    int TotalThreads() const { return (int)_threads.size() + 1; }
+
+    static bool IsWorkerThread();
+
+private:
+    void WorkerMain();
+    void RunBatch();
+
+    std::vector<std::thread> _threads;
+
+    std::mutex _dispatchMutex;
+    std::mutex _mutex;
+    std::condition_variable _workAvailable;
+    std::condition_variable _batchComplete;
+
+    const std::function<void(int)>* _batchFunc = nullptr;
+    int _batchCount = 0;
+    std::atomic<int> _nextIndex { 0 };
+    int _workersInBatch = 0;
+    unsigned int _batchGeneration = 0;
+    std::exception_ptr _batchException;
+    bool _stop = false;
+};
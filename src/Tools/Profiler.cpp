@@ -0,0 +1,312 @@
+#include <cstdio>
+#include <map>
+
+#include "Profiler.hpp"
+#include "Console.hpp"
+#include "System/FileSystem.hpp"
+#include "System/Logger.hpp"
+
+// Lets headless servers capture without anyone typing into a console
+static ConsoleVar<int> g_profileOnStart("profile-on-start", 0);
+static ConsoleVar<std::string> g_profileOutput("profile-output", "profile.json");
+
+static thread_local ProfileThread* t_profileThread = nullptr;
+
+void Profiler::EndFrame()
+{
+    static bool checkedProfileOnStart = false;
+    if (!checkedProfileOnStart)
+    {
+        checkedProfileOnStart = true;
+
+        if (g_profileOnStart.Value() > 0)
+        {
+            StartCapture(g_profileOnStart.Value(), true);
+        }
+    }
+
+    if (IsCapturing())
+    {
+        ++_capturedFrames;
+
+        if (--_framesLeft <= 0)
+        {
+            _isCapturing.store(false, std::memory_order_relaxed);
+            Log("Captured %d frames of profiling data\n", _capturedFrames);
+
+            if (_exportWhenDone)
+            {
+                TryExportChromeTrace(g_profileOutput.Value().c_str());
+            }
+        }
+    }
+
+    if (_pendingCaptureFrames > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_threadsMutex);
+            for (auto& thread : _threads)
+            {
+                thread->events.clear();
+                thread->currentZone = -1;
+                thread->droppedEvents = 0;
+            }
+        }
+
+        _framesLeft = _pendingCaptureFrames;
+        _exportWhenDone = _pendingExportWhenDone;
+        _capturedFrames = 0;
+        _pendingCaptureFrames = 0;
+        _captureStart = std::chrono::steady_clock::now();
+        _isCapturing.store(true, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::StartCapture(int totalFrames, bool exportWhenDone)
+{
+    _pendingCaptureFrames = totalFrames;
+    _pendingExportWhenDone = exportWhenDone;
+}
+
+int Profiler::BeginZone(const char* name)
+{
+    auto thread = GetCurrentThread();
+
+    if ((int)thread->events.size() >= MaxEventsPerThread)
+    {
+        ++thread->droppedEvents;
+        return -1;
+    }
+
+    int index = thread->events.size();
+    thread->events.push_back({ name, NanosecondsSinceCaptureStart(), 0, thread->currentZone });
+    thread->currentZone = index;
+
+    return index;
+}
+
+void Profiler::EndZone(int eventIndex)
+{
+    auto thread = GetCurrentThread();
+    auto& event = thread->events[eventIndex];
+
+    event.durationNanoseconds = NanosecondsSinceCaptureStart() - event.startNanoseconds;
+    thread->currentZone = event.parent;
+}
+
+ProfileThread* Profiler::GetCurrentThread()
+{
+    if (t_profileThread == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(_threadsMutex);
+
+        auto thread = std::make_unique<ProfileThread>();
+        thread->threadId = _threads.size();
+        thread->events.reserve(4096);
+
+        t_profileThread = thread.get();
+        _threads.push_back(std::move(thread));
+    }
+
+    return t_profileThread;
+}
+
+int64_t Profiler::NanosecondsSinceCaptureStart() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _captureStart).count();
+}
+
+void Profiler::WriteReport(std::vector<std::string>& outLines)
+{
+    struct ReportNode
+    {
+        const char* name;
+        int depth;
+        int64_t totalNanoseconds = 0;
+        int calls = 0;
+        std::vector<int> children;
+    };
+
+    std::lock_guard<std::mutex> lock(_threadsMutex);
+
+    int totalFrames = _capturedFrames > 0 ? _capturedFrames : 1;
+    char line[256];
+
+    for (auto& thread : _threads)
+    {
+        if (thread->events.empty())
+        {
+            continue;
+        }
+
+        // Zones are merged by their path from the root, so the same zone reached through different parents stays separate
+        std::vector<ReportNode> nodes;
+        std::vector<int> roots;
+        std::map<std::pair<int, std::string>, int> nodeByParentAndName;
+        std::vector<int> nodeByEvent(thread->events.size());
+
+        for (int i = 0; i < (int)thread->events.size(); ++i)
+        {
+            auto& event = thread->events[i];
+            int parentNode = event.parent >= 0 ? nodeByEvent[event.parent] : -1;
+
+            auto key = std::make_pair(parentNode, std::string(event.name));
+            auto it = nodeByParentAndName.find(key);
+            int node;
+
+            if (it == nodeByParentAndName.end())
+            {
+                node = nodes.size();
+                nodes.push_back({ event.name, parentNode >= 0 ? nodes[parentNode].depth + 1 : 0 });
+                nodeByParentAndName[key] = node;
+                (parentNode >= 0 ? nodes[parentNode].children : roots).push_back(node);
+            }
+            else
+            {
+                node = it->second;
+            }
+
+            nodeByEvent[i] = node;
+            nodes[node].totalNanoseconds += event.durationNanoseconds;
+            ++nodes[node].calls;
+        }
+
+        snprintf(line, sizeof(line), "Thread %d (%d events, %d dropped)", thread->threadId, (int)thread->events.size(), thread->droppedEvents);
+        outLines.emplace_back(line);
+
+        std::vector<int> stack(roots.rbegin(), roots.rend());
+        while (!stack.empty())
+        {
+            auto& node = nodes[stack.back()];
+            stack.pop_back();
+
+            snprintf(
+                line,
+                sizeof(line),
+                "%*s%-32s %8.3f ms/frame %8d calls",
+                2 + node.depth * 2,
+                "",
+                node.name,
+                node.totalNanoseconds / 1e6 / totalFrames,
+                node.calls);
+            outLines.emplace_back(line);
+
+            stack.insert(stack.end(), node.children.rbegin(), node.children.rend());
+        }
+    }
+}
+
+static void WriteJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (; *str != '\0'; ++str)
+    {
+        if (*str == '"' || *str == '\\') fputc('\\', file);
+        fputc(*str, file);
+    }
+    fputc('"', file);
+}
+
+bool Profiler::TryExportChromeTrace(const char* fileName)
+{
+    FILE* file = OpenFile(fileName, "w");
+    if (file == nullptr)
+    {
+        Log("Failed to open %s for writing\n", fileName);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_threadsMutex);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool isFirstEvent = true;
+
+    for (auto& thread : _threads)
+    {
+        fprintf(
+            file,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}",
+            isFirstEvent ? "" : ",\n",
+            thread->threadId,
+            thread->threadId);
+        isFirstEvent = false;
+
+        for (auto& event : thread->events)
+        {
+            fprintf(file, ",\n{\"name\":");
+            WriteJsonString(file, event.name);
+            fprintf(
+                file,
+                ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                thread->threadId,
+                event.startNanoseconds / 1000.0,
+                event.durationNanoseconds / 1000.0);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    Log("Wrote profile to %s\n", fileName);
+
+    return true;
+}
+
+static void ProfileCmd(ConsoleCommandBinder& binder)
+{
+    int totalFrames = 60;
+    binder.TryBind(totalFrames, "totalFrames");
+    binder.Help("Captures profiling zones for the next few frames");
+
+    if (totalFrames <= 0)
+    {
+        binder.Error("Must capture at least one frame");
+        return;
+    }
+
+    Profiler::GetInstance()->StartCapture(totalFrames);
+    binder.GetConsole()->Log("Capturing %d frames\n", totalFrames);
+}
+
+static void ProfileReportCmd(ConsoleCommandBinder& binder)
+{
+    binder.Help("Shows the average time per frame spent in each zone of the last capture");
+
+    auto profiler = Profiler::GetInstance();
+    if (!profiler->HasCapture())
+    {
+        binder.GetConsole()->Log("No capture available, run profile first\n");
+        return;
+    }
+
+    std::vector<std::string> lines;
+    profiler->WriteReport(lines);
+
+    for (auto& line : lines)
+    {
+        binder.GetConsole()->Log("%s\n", line.c_str());
+    }
+}
+
+static void ProfileExportCmd(ConsoleCommandBinder& binder)
+{
+    std::string fileName = g_profileOutput.Value();
+    binder.TryBind(fileName, "fileName");
+    binder.Help("Writes the last capture as Chrome trace-event JSON (open in chrome://tracing or Perfetto)");
+
+    auto profiler = Profiler::GetInstance();
+    if (!profiler->HasCapture())
+    {
+        binder.GetConsole()->Log("No capture available, run profile first\n");
+        return;
+    }
+
+    if (!profiler->TryExportChromeTrace(fileName.c_str()))
+    {
+        binder.GetConsole()->Log("Failed to write %s\n", fileName.c_str());
+    }
+}
+
+ConsoleCmd _profileCmd("profile", ProfileCmd);
+ConsoleCmd _profileReportCmd("profile-report", ProfileReportCmd);
+ConsoleCmd _profileExportCmd("profile-export", ProfileExportCmd);
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef DISABLE_PROFILER
+// Times the rest of the enclosing scope. The name is stored by pointer, so it must be a string literal.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(_profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+struct ProfileEvent
+{
+    const char* name;
+    int64_t startNanoseconds;       // Relative to the start of the capture
+    int64_t durationNanoseconds;
+    int parent;                     // Index of the enclosing zone on the same thread, or -1
+};
+
+/// <summary>
+/// Events recorded by one thread. Only that thread writes to it while a capture is running.
+/// </summary>
+struct ProfileThread
+{
+    int threadId;
+    std::vector<ProfileEvent> events;
+    int currentZone = -1;
+    int droppedEvents = 0;
+};
+
+/// <summary>
+/// Records nested timing zones on every thread for a fixed number of frames. When no capture is running, a zone costs
+/// a single relaxed atomic load. Captures only start and stop in EndFrame(), which the engine calls between frames
+/// when no zone is open on any thread.
+/// </summary>
+class Profiler
+{
+public:
+    static constexpr int MaxEventsPerThread = 1 << 20;
+
+    static Profiler* GetInstance()
+    {
+        static Profiler profiler;
+        return &profiler;
+    }
+
+    void EndFrame();
+
+    // Takes effect at the end of the current frame
+    void StartCapture(int totalFrames, bool exportWhenDone = false);
+
+    bool IsCapturing() const { return _isCapturing.load(std::memory_order_relaxed); }
+    bool HasCapture() const { return _capturedFrames > 0 && !IsCapturing(); }
+
+    void WriteReport(std::vector<std::string>& outLines);
+    bool TryExportChromeTrace(const char* fileName);
+
+    int BeginZone(const char* name);
+    void EndZone(int eventIndex);
+
+private:
+    ProfileThread* GetCurrentThread();
+    int64_t NanosecondsSinceCaptureStart() const;
+
+    std::atomic<bool> _isCapturing { false };
+    std::chrono::steady_clock::time_point _captureStart;
+
+    int _pendingCaptureFrames = 0;
+    bool _pendingExportWhenDone = false;
+    int _framesLeft = 0;
+    int _capturedFrames = 0;
+    bool _exportWhenDone = false;
+
+    std::mutex _threadsMutex;
+    std::vector<std::unique_ptr<ProfileThread>> _threads;
+};
+
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* name)
+    {
+        if (Profiler::GetInstance()->IsCapturing())
+        {
+            _eventIndex = Profiler::GetInstance()->BeginZone(name);
+        }
+    }
+
+    ~ProfileZone()
+    {
+        if (_eventIndex >= 0)
+        {
+            Profiler::GetInstance()->EndZone(_eventIndex);
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    int _eventIndex = -1;
+};
@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Memory/BlockAllocator.hpp"
+#include "Memory/FreeList.hpp"
+#include "Memory/StackAllocator.hpp"
+
+// Allocate/free pairs with sizes spread over every size class: the thread-safe BlockAllocator against the
+// single-threaded one it replaced and against new[]. Each thread keeps a window of live blocks and frees the oldest one
+// for every new one. With several threads the old allocator is behind a lock, which is what sharing it would have
+// taken.
+
+static constexpr int OperationsPerThread = 2000000;
+static constexpr int LiveBlocksPerThread = 1024;
+static constexpr int BufferSize = 256 * 1024 * 1024;
+
+/// <summary>
+/// The BlockAllocator before it had thread caches. Sizes that match a block size exactly go to the next size up.
+/// </summary>
+class SingleThreadedBlockAllocator
+{
+public:
+    SingleThreadedBlockAllocator(int bufSize)
+        : _stackAllocator(bufSize)
+    {
+
+    }
+
+    void* Allocate(int size)
+    {
+        int blockId = GetBlockId(size);
+        if (blockId == TooBig)
+        {
+            return new char[size];
+        }
+
+        void* block = _blocks[blockId].HasFreeItem()
+            ? _blocks[blockId].Borrow()
+            : _stackAllocator.AllocateOrFatalError(BlockSizes[blockId]);
+
+        memset(block, 0, BlockSizes[blockId]);
+        return block;
+    }
+
+    void Free(void* data, int size)
+    {
+        int blockId = GetBlockId(size);
+        if (blockId == TooBig)
+        {
+            delete[](char*)(data);
+        }
+        else
+        {
+            _blocks[blockId].Return((Block*)data);
+        }
+    }
+
+private:
+    static constexpr int BlockSizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+    static constexpr int TotalBlockSizes = sizeof(BlockSizes) / sizeof(int);
+    static constexpr int TooBig = -1;
+
+    struct Block
+    {
+        void* next;
+    };
+
+    static int GetBlockId(int size)
+    {
+        for (int i = 0; i < TotalBlockSizes; ++i)
+        {
+            if (size < BlockSizes[i]) return i;
+        }
+
+        return TooBig;
+    }
+
+    FreeList<Block> _blocks[TotalBlockSizes];
+    StackAllocator _stackAllocator;
+};
+
+struct NewAllocator
+{
+    void* Allocate(int size)
+    {
+        auto data = new char[size];
+        memset(data, 0, size);
+        return data;
+    }
+
+    void Free(void* data, int size) { delete[](char*)(data); }
+};
+
+/// <summary>
+/// Runs the same allocations on every thread and returns the nanoseconds per allocate/free pair
+/// </summary>
+template<typename TAllocate, typename TFree>
+static double MeasurePairs(int totalThreads, TAllocate&& allocate, TFree&& free)
+{
+    std::vector<int> sizes;
+    std::mt19937 random(1);
+    for (int i = 0; i < 4096; ++i)
+    {
+        // Mostly small, like components and sync var histories, with exact block sizes now and then
+        int size = random() % 8 == 0 ? 64 << (random() % 7) : 16 + random() % (random() % 4 == 0 ? 4000 : 400);
+        sizes.push_back(size);
+    }
+
+    auto runThread = [&](int threadId)
+    {
+        std::vector<std::pair<void*, int>> live(LiveBlocksPerThread, { nullptr, 0 });
+
+        for (int i = 0; i < OperationsPerThread; ++i)
+        {
+            auto& slot = live[i % LiveBlocksPerThread];
+            if (slot.first != nullptr)
+            {
+                free(slot.first, slot.second);
+            }
+
+            int size = sizes[(i + threadId * 97) % sizes.size()];
+            slot = { allocate(size), size };
+        }
+
+        for (auto& slot : live)
+        {
+            if (slot.first != nullptr) free(slot.first, slot.second);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int threadId = 0; threadId < totalThreads; ++threadId)
+    {
+        threads.emplace_back(runThread, threadId);
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    double totalNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return totalNs / OperationsPerThread;
+}
+
+int main()
+{
+    printf("ns per allocate/free pair per thread, %d live blocks per thread, %d hardware threads\n",
+        LiveBlocksPerThread,
+        (int)std::thread::hardware_concurrency());
+    printf("  threads   block allocator   single-threaded   new[]\n");
+
+    for (int totalThreads : { 1, 4, 8 })
+    {
+        BlockAllocator blockAllocator(BufferSize);
+        double blockNs = MeasurePairs(totalThreads,
+            [&](int size) { return blockAllocator.Allocate(size); },
+            [&](void* data, int size) { blockAllocator.Free(data, size); });
+
+        SingleThreadedBlockAllocator oldAllocator(BufferSize);
+        std::mutex oldAllocatorMutex;
+        double oldNs = MeasurePairs(totalThreads,
+            [&](int size)
+            {
+                if (totalThreads == 1) return oldAllocator.Allocate(size);
+
+                std::lock_guard<std::mutex> lock(oldAllocatorMutex);
+                return oldAllocator.Allocate(size);
+            },
+            [&](void* data, int size)
+            {
+                if (totalThreads == 1) return oldAllocator.Free(data, size);
+
+                std::lock_guard<std::mutex> lock(oldAllocatorMutex);
+                oldAllocator.Free(data, size);
+            });
+
+        NewAllocator newAllocator;
+        double newNs = MeasurePairs(totalThreads,
+            [&](int size) { return newAllocator.Allocate(size); },
+            [&](void* data, int size) { newAllocator.Free(data, size); });
+
+        printf("  %7d   %15.1f   %15.1f   %5.1f\n", totalThreads, blockNs, oldNs, newNs);
+    }
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Memory/BlockAllocator.hpp"
+#include "TestUtil.hpp"
+
+// Blocks allocated on one thread and freed on another, at every size class and on both sides of every block size,
+// including the exact 4096 byte boundary between the largest class and new[]. Every block is filled with a pattern
+// that is checked when it's freed, so a block handed out twice is caught. Once everything is freed, the live and
+// requested bytes summed over every thread cache must be back at zero.
+//
+// Also covers thread caches that overflow and are flushed, caches left behind by threads that exited, and a thread
+// that outlives an allocator and then uses a new one, which may be at the same address.
+
+static constexpr int TotalThreads = 8;
+static constexpr int OperationsPerThread = 200000;
+static constexpr int MaxMailboxSize = 256;
+
+static const int TestSizes[] =
+{
+    1, 8, 63, 64, 65, 127, 128, 129, 255, 256, 257, 511, 512, 513,
+    1023, 1024, 1025, 2047, 2048, 2049, 4095, 4096, 4097, 6000
+};
+
+struct Allocation
+{
+    unsigned char* data;
+    int size;
+    uint8_t pattern;
+};
+
+// Blocks waiting to be freed by the thread that owns the mailbox
+struct Mailbox
+{
+    std::mutex mutex;
+    std::vector<Allocation> allocations;
+};
+
+static bool HasPattern(const Allocation& allocation)
+{
+    for (int i = 0; i < allocation.size; ++i)
+    {
+        if (allocation.data[i] != allocation.pattern) return false;
+    }
+
+    return true;
+}
+
+static void CheckBalanced(BlockAllocator& allocator)
+{
+    std::vector<BlockSizeClassStats> stats;
+    allocator.GetStats(stats);
+
+    for (auto& sizeClass : stats)
+    {
+        CHECK(sizeClass.liveBytes == 0);
+        CHECK(sizeClass.requestedBytes == 0);
+        CHECK(sizeClass.peakBytes <= sizeClass.reservedBytes);
+    }
+
+    CHECK(allocator.LargeLiveBytes() == 0);
+}
+
+static void TestCrossThreadFreesBalance()
+{
+    BlockAllocator allocator(64 * 1024 * 1024);
+    Mailbox mailboxes[TotalThreads];
+    std::vector<int> failedPatterns(TotalThreads);
+
+    auto freeMailbox = [&](int threadId, bool all)
+    {
+        std::vector<Allocation> toFree;
+        {
+            std::lock_guard<std::mutex> lock(mailboxes[threadId].mutex);
+            auto& allocations = mailboxes[threadId].allocations;
+            if (!all && (int)allocations.size() < MaxMailboxSize) return;
+            toFree.swap(allocations);
+        }
+
+        for (auto& allocation : toFree)
+        {
+            failedPatterns[threadId] += !HasPattern(allocation);
+            allocator.Free(allocation.data, allocation.size);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int threadId = 0; threadId < TotalThreads; ++threadId)
+    {
+        threads.emplace_back([&, threadId]
+        {
+            std::mt19937 random(threadId);
+
+            for (int i = 0; i < OperationsPerThread; ++i)
+            {
+                int size = TestSizes[random() % (sizeof(TestSizes) / sizeof(int))];
+                bool zeroMemory = random() % 2 == 0;
+                auto data = (unsigned char*)allocator.Allocate(size, zeroMemory);
+
+                if (zeroMemory)
+                {
+                    failedPatterns[threadId] += !HasPattern({ data, size, 0 });
+                }
+
+                Allocation allocation { data, size, (uint8_t)(1 + (i + threadId) % 255) };
+                memset(data, allocation.pattern, size);
+
+                // Most blocks are freed by another thread
+                int freeingThread = random() % 4 == 0 ? threadId : random() % TotalThreads;
+                {
+                    std::lock_guard<std::mutex> lock(mailboxes[freeingThread].mutex);
+                    mailboxes[freeingThread].allocations.push_back(allocation);
+                }
+
+                freeMailbox(threadId, false);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // The threads that allocated these are gone, their caches are left for the next threads
+    std::vector<std::thread> drainThreads;
+    for (int threadId = 0; threadId < TotalThreads; ++threadId)
+    {
+        drainThreads.emplace_back([&, threadId] { freeMailbox(threadId, true); });
+    }
+
+    for (auto& thread : drainThreads)
+    {
+        thread.join();
+    }
+
+    for (int failed : failedPatterns)
+    {
+        CHECK(failed == 0);
+    }
+
+    CheckBalanced(allocator);
+
+    std::vector<BlockSizeClassStats> stats;
+    allocator.GetStats(stats);
+    for (auto& sizeClass : stats)
+    {
+        CHECK(sizeClass.peakBytes > 0);
+    }
+
+    CHECK(allocator.LargePeakBytes() > 0);
+}
+
+static void TestSizeClassBoundaries()
+{
+    BlockAllocator allocator(1024 * 1024);
+    std::vector<BlockSizeClassStats> stats;
+
+    auto liveBytesOfClass = [&](int blockSize)
+    {
+        stats.clear();
+        allocator.GetStats(stats);
+
+        for (auto& sizeClass : stats)
+        {
+            if (sizeClass.blockSize == blockSize) return sizeClass.liveBytes;
+        }
+
+        return (int64_t)-1;
+    };
+
+    // Sizes that match a block size exactly use that block, one byte more uses the next size up
+    for (int blockSize = 64; blockSize <= BlockAllocator::MaxBlockSize; blockSize *= 2)
+    {
+        auto exact = allocator.Allocate(blockSize);
+        CHECK(liveBytesOfClass(blockSize) == blockSize);
+        allocator.Free(exact, blockSize);
+        CHECK(liveBytesOfClass(blockSize) == 0);
+
+        auto larger = allocator.Allocate(blockSize + 1);
+        if (blockSize == BlockAllocator::MaxBlockSize)
+        {
+            CHECK(allocator.LargeLiveBytes() == blockSize + 1);
+        }
+        else
+        {
+            CHECK(liveBytesOfClass(blockSize * 2) == blockSize * 2);
+        }
+
+        allocator.Free(larger, blockSize + 1);
+    }
+
+    CheckBalanced(allocator);
+}
+
+static void TestThreadCacheOverflowAndReuse()
+{
+    BlockAllocator allocator(16 * 1024 * 1024);
+    std::vector<void*> blocks;
+    std::vector<BlockSizeClassStats> stats;
+
+    auto reservedBytes = [&]
+    {
+        int64_t total = 0;
+        stats.clear();
+        allocator.GetStats(stats);
+        for (auto& sizeClass : stats) total += sizeClass.reservedBytes;
+        return total;
+    };
+
+    int64_t firstRoundReserved = 0;
+
+    // Far more than a thread caches, so frees flush half of the cache back again and again
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int i = 0; i < 2000; ++i)
+        {
+            auto block = (unsigned char*)allocator.Allocate(256);
+
+            bool isZeroed = true;
+            for (int j = 0; j < 256; ++j) isZeroed &= block[j] == 0;
+            CHECK(isZeroed);
+
+            memset(block, 0xCD, 256);
+            blocks.push_back(block);
+        }
+
+        int64_t reservedAfterAllocating = reservedBytes();
+
+        for (auto block : blocks)
+        {
+            allocator.Free(block, 256);
+        }
+
+        blocks.clear();
+        CheckBalanced(allocator);
+
+        // The second round gets the blocks of the first one back
+        if (round == 0) firstRoundReserved = reservedAfterAllocating;
+        else CHECK(reservedAfterAllocating == firstRoundReserved);
+    }
+}
+
+static void TestThreadOutlivesAllocator()
+{
+    std::thread thread([]
+    {
+        // Leaves this thread with a cache for the first allocator, which is never released while it exists
+        auto first = new BlockAllocator(1024 * 1024);
+        first->Free(first->Allocate(100), 100);
+        delete first;
+
+        // Likely at the same address, but a new id, so it gets a new cache instead of the dead one
+        auto second = new BlockAllocator(1024 * 1024);
+        auto block = second->Allocate(100);
+
+        std::vector<BlockSizeClassStats> stats;
+        second->GetStats(stats);
+        CHECK(stats[1].liveBytes == 128);
+        CHECK(stats[1].requestedBytes == 100);
+
+        second->Free(block, 100);
+        CheckBalanced(*second);
+        delete second;
+
+        // Exiting releases the caches of both allocators, which must not touch either of them
+    });
+
+    thread.join();
+}
+
+int main()
+{
+    TestSizeClassBoundaries();
+    TestThreadCacheOverflowAndReuse();
+    TestThreadOutlivesAllocator();
+    TestCrossThreadFreesBalance();
+
+    return TestResult("BlockAllocatorStressTest");
+}
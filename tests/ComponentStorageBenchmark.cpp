@@ -0,0 +1,128 @@
+#include <cstdio>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "Memory/BlockAllocator.hpp"
+#include "Scene/EntityComponent.hpp"
+#include "TestUtil.hpp"
+
+// Ticks 8192 entities with three components each, with the components in the shared block allocator and hashed
+// hook sets (ComponentStorageMode::Scattered) and in per-type pools (ComponentStorageMode::Pooled)
+
+static constexpr int TotalEntities = 8192;
+static constexpr int TotalTicks = 200;
+
+struct MotionComponent : ComponentTemplate<MotionComponent>
+{
+    void Update(float deltaTime) override
+    {
+        x += velocityX * deltaTime;
+        y += velocityY * deltaTime;
+    }
+
+    float x = 0, y = 0;
+    float velocityX = 1, velocityY = 2;
+};
+
+struct HealthComponent : ComponentTemplate<HealthComponent>
+{
+    void Update(float deltaTime) override
+    {
+        health = health + regeneration * deltaTime > maxHealth ? maxHealth : health + regeneration * deltaTime;
+    }
+
+    float health = 50;
+    float maxHealth = 100;
+    float regeneration = 0.5f;
+};
+
+struct CooldownComponent : ComponentTemplate<CooldownComponent>
+{
+    void Update(float deltaTime) override
+    {
+        remaining -= deltaTime;
+
+        if (remaining <= 0)
+        {
+            remaining += duration;
+            ++timesFired;
+        }
+    }
+
+    float remaining = 1;
+    float duration = 1;
+    int timesFired = 0;
+};
+
+struct ComponentLayout
+{
+    ComponentLayout(ComponentStorageMode mode)
+        : allocator(64 * 1024 * 1024)
+    {
+        manager.SetStorageMode(mode);
+
+        // Entities are created over time next to other allocations, like they are in a running game
+        std::mt19937 random(1);
+        std::vector<std::pair<void*, int>> otherAllocations;
+
+        for (int i = 0; i < TotalEntities; ++i)
+        {
+            Add<MotionComponent>();
+            Add<HealthComponent>();
+            Add<CooldownComponent>();
+
+            int size = 64 << (random() % 4);
+            otherAllocations.emplace_back(allocator.Allocate(size), size);
+
+            if (random() % 2 == 0)
+            {
+                auto& freed = otherAllocations[random() % otherAllocations.size()];
+                allocator.Free(freed.first, freed.second);
+                freed = otherAllocations.back();
+                otherAllocations.pop_back();
+            }
+        }
+    }
+
+    template<typename TComponent>
+    void Add()
+    {
+        auto memory = manager.StorageMode() == ComponentStorageMode::Pooled
+            ? manager.AllocateComponent(TComponent::TypeId(), sizeof(TComponent))
+            : allocator.Allocate(sizeof(TComponent));
+
+        auto component = new (memory) TComponent;
+        manager.Register(component);
+    }
+
+    void Tick()
+    {
+        manager.ForEachUpdatable([](IEntityComponent* component) { component->Update(1.0f / 60); });
+    }
+
+    BlockAllocator allocator;
+    EntityComponentManager manager;
+};
+
+static double MeasureTick(ComponentStorageMode mode)
+{
+    ComponentLayout layout(mode);
+
+    // Warm up
+    layout.Tick();
+
+    return MedianMilliseconds(TotalTicks, [&] { layout.Tick(); });
+}
+
+int main()
+{
+    double scattered = MeasureTick(ComponentStorageMode::Scattered);
+    double pooled = MeasureTick(ComponentStorageMode::Pooled);
+
+    printf("%d entities x 3 components, median of %d ticks\n", TotalEntities, TotalTicks);
+    printf("  scattered: %.3f ms/tick\n", scattered);
+    printf("  pooled:    %.3f ms/tick (%.2fx)\n", pooled, scattered / pooled);
+
+    return 0;
+}
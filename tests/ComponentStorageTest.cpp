@@ -0,0 +1,138 @@
+#include <new>
+#include <vector>
+
+#include "Scene/EntityComponent.hpp"
+#include "TestUtil.hpp"
+
+// Pooled component storage: deterministic sweep order and components that unregister other components mid-sweep
+
+struct CounterComponent : ComponentTemplate<CounterComponent>
+{
+    void Update(float deltaTime) override
+    {
+        ++updateCount;
+
+        if (onUpdate != nullptr)
+        {
+            onUpdate(this);
+        }
+    }
+
+    int id = 0;
+    int updateCount = 0;
+    void (*onUpdate)(CounterComponent* self) = nullptr;
+    CounterComponent* other = nullptr;
+    EntityComponentManager* manager = nullptr;
+};
+
+static CounterComponent* CreateComponent(EntityComponentManager& manager, int id)
+{
+    auto memory = manager.AllocateComponent(CounterComponent::TypeId(), sizeof(CounterComponent));
+    auto component = new (memory) CounterComponent;
+    component->id = id;
+    component->manager = &manager;
+    manager.Register(component);
+
+    return component;
+}
+
+static void DestroyComponent(EntityComponentManager& manager, CounterComponent* component)
+{
+    manager.Unregister(component);
+    component->~CounterComponent();
+    manager.FreeComponent(component);
+}
+
+static std::vector<int> SweepOrder(EntityComponentManager& manager)
+{
+    std::vector<int> order;
+    manager.ForEachUpdatable([&](IEntityComponent* component)
+    {
+        order.push_back(static_cast<CounterComponent*>(component)->id);
+        component->Update(0);
+    });
+
+    return order;
+}
+
+static void TestOrderIsBySlot()
+{
+    EntityComponentManager manager;
+    manager.SetStorageMode(ComponentStorageMode::Pooled);
+
+    std::vector<CounterComponent*> components;
+    for (int i = 0; i < 600; ++i)
+    {
+        components.push_back(CreateComponent(manager, i));
+    }
+
+    // Freed slots are reused lowest first, so the new components take the place of the removed ones
+    DestroyComponent(manager, components[10]);
+    DestroyComponent(manager, components[300]);
+    CreateComponent(manager, 1000);
+    CreateComponent(manager, 1001);
+
+    auto order = SweepOrder(manager);
+    CHECK(order.size() == 600);
+    CHECK(order[10] == 1000);
+    CHECK(order[300] == 1001);
+    CHECK(order[599] == 599);
+    CHECK(order == SweepOrder(manager));
+}
+
+static void TestUnregisterDuringSweep()
+{
+    EntityComponentManager manager;
+    manager.SetStorageMode(ComponentStorageMode::Pooled);
+
+    std::vector<CounterComponent*> components;
+    for (int i = 0; i < 8; ++i)
+    {
+        components.push_back(CreateComponent(manager, i));
+    }
+
+    // Component 2 destroys the component after it. Components 5 and 6 destroy themselves and create a new component,
+    // which takes the lowest free slot: first the one of component 3, then the one of component 5, whose address is
+    // still waiting to be erased from the hook lists.
+    components[2]->other = components[3];
+    components[2]->onUpdate = [](CounterComponent* self)
+    {
+        DestroyComponent(*self->manager, self->other);
+    };
+
+    auto replaceSelf = [](CounterComponent* self)
+    {
+        auto manager = self->manager;
+        int newId = 100 + self->id;
+
+        DestroyComponent(*manager, self);
+        CreateComponent(*manager, newId);
+    };
+
+    components[5]->onUpdate = replaceSelf;
+    components[6]->onUpdate = replaceSelf;
+
+    std::vector<int> order = SweepOrder(manager);
+
+    // Every component that wasn't destroyed before its turn ran once, including the ones after a removed one, and
+    // the new components wait for the next sweep
+    CHECK((order == std::vector<int> { 0, 1, 2, 4, 5, 6, 7 }));
+
+    for (int i : { 0, 1, 2, 4, 7 })
+    {
+        CHECK(components[i]->updateCount == 1);
+    }
+
+    manager.UpdateScheduledComponents();
+    components[2]->onUpdate = nullptr;
+
+    CHECK((SweepOrder(manager) == std::vector<int> { 0, 1, 2, 105, 4, 106, 7 }));
+}
+
+int main()
+{
+    TestOrderIsBySlot();
+    TestUnregisterDuringSweep();
+
+    return TestResult("ComponentStorageTest");
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Scene/BaseEntity.hpp"
+#include "System/WorkerPool.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Entities whose update hook runs on the worker pool must leave the scene in the same state as the same entities
+// updated serially. Both runs go through a real scene, so the concurrent one is split into batches by
+// Scene::RunGroupConcurrently() and merged by MergeDeferredChanges().
+//
+// The hooks move, start timers, look up their last timer, queue deferred actions and destroy themselves. Move
+// listeners start timers and destroy entities too, so the changes of one batch have to be applied in the order they
+// were made, not grouped by type, to give the serial order.
+
+static constexpr int TotalEntities = 2000;
+static constexpr int TotalFrames = 60;
+
+enum class LogEntryType
+{
+    Moved = 1,
+    TimerFired,
+    ListenerTimerFired,
+    ActionRan,
+    Destroyed
+};
+
+struct LogEntry
+{
+    LogEntryType type;
+    int entityIndex;
+    float value;
+};
+
+// Only written on the main thread: by move listeners, timers, deferred actions and OnDestroyed()
+static std::vector<LogEntry> g_log;
+
+static std::atomic<int> g_updatesOnWorkers;
+
+static uint32_t Mix(int entityIndex, int update)
+{
+    uint32_t hash = (uint32_t)entityIndex * 0x9E3779B1u ^ ((uint32_t)update + 0x7F4A7C15u) * 0x85EBCA6Bu;
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+struct HookState
+{
+    int index = 0;
+    int updates = 0;
+    int moves = 0;
+    int activeTimerLookups = 0;
+    TimerHandle lastTimer;
+};
+
+struct HookBehaviour
+{
+    static void ServerUpdate(Entity* entity, HookState& state)
+    {
+        if (WorkerPool::IsWorkerThread())
+        {
+            ++g_updatesOnWorkers;
+        }
+
+        auto scene = entity->scene;
+        uint32_t roll = Mix(state.index, state.updates++);
+        int index = state.index;
+
+        if (roll % 3 == 0)
+        {
+            entity->SetCenter(entity->Center() + Vector2(1 + roll % 5, 0));
+        }
+
+        if (roll % 4 == 0)
+        {
+            // Other batches reserve timers while this looks up its own
+            state.activeTimerLookups += scene->IsTimerActive(state.lastTimer);
+            state.lastTimer = entity->StartTimer(0, [=] { g_log.push_back({ LogEntryType::TimerFired, index, 0 }); });
+        }
+
+        if (roll % 5 == 0)
+        {
+            scene->ExecuteDeferred([=] { g_log.push_back({ LogEntryType::ActionRan, index, 0 }); });
+        }
+
+        if (roll % 61 == 0)
+        {
+            entity->Destroy();
+        }
+    }
+
+    static void OnMoved(Entity* entity, HookState& state)
+    {
+        int index = state.index;
+        g_log.push_back({ LogEntryType::Moved, index, entity->Center().x });
+
+        if (++state.moves % 4 == 0)
+        {
+            entity->StartTimer(0, [=] { g_log.push_back({ LogEntryType::ListenerTimerFired, index, 0 }); });
+        }
+
+        if (state.moves % 9 == 0)
+        {
+            entity->Destroy();
+        }
+    }
+};
+
+DEFINE_ENTITY(SerialHookEntity, "serial-hook-entity")
+{
+    void ServerUpdate(float deltaTime) override { HookBehaviour::ServerUpdate(this, state); }
+    void OnDestroyed() override { g_log.push_back({ LogEntryType::Destroyed, state.index, 0 }); }
+
+    HookState state;
+
+private:
+    void ReceiveServerEvent(const IEntityEvent& ev) override
+    {
+        if (ev.Is<EntityMovedEvent>()) HookBehaviour::OnMoved(this, state);
+    }
+};
+
+DEFINE_ENTITY(ConcurrentHookEntity, "concurrent-hook-entity")
+{
+    static constexpr bool ConcurrentUpdate = true;
+
+    void ServerUpdate(float deltaTime) override { HookBehaviour::ServerUpdate(this, state); }
+    void OnDestroyed() override { g_log.push_back({ LogEntryType::Destroyed, state.index, 0 }); }
+
+    HookState state;
+
+private:
+    void ReceiveServerEvent(const IEntityEvent& ev) override
+    {
+        if (ev.Is<EntityMovedEvent>()) HookBehaviour::OnMoved(this, state);
+    }
+};
+
+struct EntityState
+{
+    int index;
+    int updates;
+    int moves;
+    int activeTimerLookups;
+    float x;
+    float y;
+};
+
+struct SceneState
+{
+    std::vector<LogEntry> log;
+    std::vector<EntityState> entities;
+};
+
+template<typename TEntity>
+static SceneState RunScene(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+
+    // After the old server is gone, since its entities log when they're destroyed
+    g_log.clear();
+
+    for (int i = 0; i < TotalEntities; ++i)
+    {
+        auto entity = scene->CreateEntity<TEntity>(Vector2(i * 10, 0));
+        entity->state.index = i;
+    }
+
+    for (int frame = 0; frame < TotalFrames; ++frame)
+    {
+        engine->RunFrame();
+    }
+
+    SceneState result;
+    result.log = g_log;
+
+    for (auto entity : scene->GetEntities())
+    {
+        if (auto hookEntity = dynamic_cast<TEntity*>(entity))
+        {
+            auto& state = hookEntity->state;
+            auto center = hookEntity->Center();
+            result.entities.push_back({ state.index, state.updates, state.moves, state.activeTimerLookups, center.x, center.y });
+        }
+    }
+
+    std::sort(result.entities.begin(), result.entities.end(), [](auto& lhs, auto& rhs) { return lhs.index < rhs.index; });
+
+    return result;
+}
+
+template<typename T>
+static bool SameBytes(const std::vector<T>& lhs, const std::vector<T>& rhs)
+{
+    return lhs.size() == rhs.size() && memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(T)) == 0;
+}
+
+static void TestConcurrentHooksMatchSerial(Engine* engine)
+{
+    CHECK(engine->GetWorkerPool()->TotalThreads() > 1);
+
+    auto serial = RunScene<SerialHookEntity>(engine);
+    CHECK(g_updatesOnWorkers == 0);
+
+    auto concurrent = RunScene<ConcurrentHookEntity>(engine);
+    CHECK(g_updatesOnWorkers > 0);
+
+    // Some of everything happened, and some entities are left
+    for (auto type : { LogEntryType::Moved, LogEntryType::TimerFired, LogEntryType::ListenerTimerFired, LogEntryType::ActionRan, LogEntryType::Destroyed })
+    {
+        CHECK(std::count_if(serial.log.begin(), serial.log.end(), [=](auto& entry) { return entry.type == type; }) > 0);
+    }
+
+    CHECK(!serial.entities.empty());
+
+    CHECK(SameBytes(serial.log, concurrent.log));
+    CHECK(SameBytes(serial.entities, concurrent.entities));
+
+    printf("  %d log entries, %d entities left, %d updates on worker threads\n",
+        (int)serial.log.size(),
+        (int)serial.entities.size(),
+        g_updatesOnWorkers.load());
+}
+
+int main()
+{
+    HeadlessGame game(
+        [](Engine* engine)
+        {
+            TestConcurrentHooksMatchSerial(engine);
+        },
+        [](EngineConfig& config)
+        {
+            // Batches run on several threads even on a machine with one core
+            config.workerThreadCount = 4;
+        });
+
+    game.Run();
+
+    return TestResult("ConcurrentHookTest");
+}
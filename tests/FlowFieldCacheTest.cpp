@@ -0,0 +1,141 @@
+#include <memory>
+
+#include "Physics/FlowFieldCache.hpp"
+#include "Physics/PathFinding.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Cached flow fields are reused until a static obstacle or edge changes, and are never returned after that
+
+static constexpr int GridSize = 32;
+
+DEFINE_ENTITY(PathRequesterEntity, "path-requester-entity")
+{
+    std::shared_ptr<FlowField> field;
+
+private:
+    void ReceiveServerEvent(const IEntityEvent& ev) override
+    {
+        if (auto ready = ev.Is<FlowFieldReadyEvent>())
+        {
+            field = ready->result;
+        }
+    }
+};
+
+static std::shared_ptr<FlowField> RequestPath(PathFinderService* pathFinder, PathRequesterEntity* requester)
+{
+    requester->field = nullptr;
+    pathFinder->RequestFlowField(Vector2(1, 1), Vector2(30, 30), requester);
+    pathFinder->SendEvent(UpdateEvent(), false);
+
+    return requester->field;
+}
+
+static void TestObstacleChangesInvalidateCachedFields(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    auto pathFinder = scene->AddService<PathFinderService>(GridSize, GridSize);
+    auto requester = scene->CreateEntity<PathRequesterEntity>(Vector2(1, 1));
+    auto& stats = pathFinder->GetFlowFieldCache().GetStats();
+
+    auto first = RequestPath(pathFinder, requester);
+    CHECK(first != nullptr);
+    CHECK(stats.misses == 1);
+
+    // Nothing changed, so the same field is handed out again
+    auto second = RequestPath(pathFinder, requester);
+    CHECK(second == first);
+    CHECK(stats.hits == 1);
+
+    // A wall across most of the grid, between the requester and the target
+    Rectangle wall(10, 0, 1, 28);
+    pathFinder->AddObstacle(wall);
+
+    auto afterWall = RequestPath(pathFinder, requester);
+    CHECK(afterWall != nullptr && afterWall != first);
+    CHECK(stats.invalidations == 1);
+
+    if (afterWall != nullptr)
+    {
+        // The wall can't be entered, and the path goes around it
+        CHECK(afterWall->grid[Vector2(10, 5)].distance == -1);
+        CHECK(afterWall->grid[Vector2(1, 1)].distance > first->grid[Vector2(1, 1)].distance);
+    }
+
+    // The field handed out before the change is still intact for whoever holds it
+    CHECK(first->grid[Vector2(10, 5)].distance >= 0);
+
+    pathFinder->RemoveObstacle(wall);
+    auto afterRemove = RequestPath(pathFinder, requester);
+    CHECK(stats.invalidations == 2);
+    CHECK(afterRemove != nullptr && afterRemove != afterWall);
+    if (afterRemove != nullptr)
+    {
+        CHECK(afterRemove->grid[Vector2(1, 1)].distance == first->grid[Vector2(1, 1)].distance);
+    }
+
+    pathFinder->AddEdge(Vector2(29, 30), Vector2(30, 30));
+    RequestPath(pathFinder, requester);
+    CHECK(stats.invalidations == 3);
+
+    pathFinder->RemoveEdge(Vector2(29, 30), Vector2(30, 30));
+    RequestPath(pathFinder, requester);
+    CHECK(stats.invalidations == 4);
+}
+
+static std::shared_ptr<FlowField> MakeField()
+{
+    return std::make_shared<FlowField>(GridSize, GridSize, Vector2(0, 0));
+}
+
+static void TestVersionMismatchAndEviction()
+{
+    FlowFieldCache cache;
+    auto fieldSize = FlowFieldCache::FieldSizeBytes(*MakeField());
+    cache.SetBudgetBytes(fieldSize * 2);
+
+    auto a = MakeField();
+    cache.Add(1, 7, a);
+    CHECK(cache.TryGet(1, 7) == a);
+
+    // A field from another version is dropped, not returned
+    CHECK(cache.TryGet(1, 8) == nullptr);
+    CHECK(cache.GetStats().invalidations == 1);
+    CHECK(cache.TotalFields() == 0);
+    CHECK(cache.TryGet(1, 7) == nullptr);
+
+    // Least recently used first out
+    auto b = MakeField();
+    auto c = MakeField();
+    auto d = MakeField();
+    cache.Add(2, 8, b);
+    cache.Add(3, 8, c);
+    CHECK(cache.TryGet(2, 8) == b);
+    cache.Add(4, 8, d);
+
+    CHECK(cache.GetStats().evictions == 1);
+    CHECK(cache.TryGet(3, 8) == nullptr);
+    CHECK(cache.TryGet(2, 8) == b);
+    CHECK(cache.TryGet(4, 8) == d);
+    CHECK(cache.BytesHeld() <= fieldSize * 2);
+
+    // Evicted fields stay alive for whoever holds them
+    CHECK(c->grid.Rows() == GridSize);
+}
+
+int main()
+{
+    TestVersionMismatchAndEviction();
+
+    HeadlessGame game([](Engine* engine)
+    {
+        TestObstacleChangesInvalidateCachedFields(engine);
+    });
+
+    game.Run();
+
+    return TestResult("FlowFieldCacheTest");
+}
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Physics/PathFinding.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+
+// Time for a path finder tick on a 512x512 grid where a crowd keeps requesting the same target while it moves: the
+// cached field repaired around the cells that changed, against a field calculated from scratch every tick. Requesters
+// can enter their own start cell even if it's blocked, so those that walk over obstacles change the field a little
+// every tick.
+
+static constexpr int GridSize = 512;
+static constexpr float ObstacleDensity = 0.2f;
+static constexpr int TotalRequesters = 32;
+static constexpr int TotalTicks = 100;
+
+DEFINE_ENTITY(BenchmarkRequesterEntity, "benchmark-requester-entity")
+{
+};
+
+struct TickTimes
+{
+    double repairMs = 0;
+    double fullMs = 0;
+};
+
+static double TimeTick(PathFinderService* pathFinder, std::vector<BenchmarkRequesterEntity*>& requesters, const std::vector<Vector2>& startCells, Vector2 endCell)
+{
+    for (int i = 0; i < (int)requesters.size(); ++i)
+    {
+        pathFinder->RequestFlowField(startCells[i], endCell, requesters[i]);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pathFinder->SendEvent(UpdateEvent(), false);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static TickTimes MeasureTicks(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+
+    auto repaired = scene->AddService<PathFinderService>(GridSize, GridSize);
+    auto full = scene->AddService<PathFinderService>(GridSize, GridSize);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+    Vector2 endCell(GridSize / 2, GridSize / 2);
+
+    for (int y = 0; y < GridSize; ++y)
+    {
+        for (int x = 0; x < GridSize; ++x)
+        {
+            if (unit(random) < ObstacleDensity && Vector2(x, y) != endCell)
+            {
+                repaired->AddObstacle(Rectangle(x, y, 1, 1));
+                full->AddObstacle(Rectangle(x, y, 1, 1));
+            }
+        }
+    }
+
+    std::vector<BenchmarkRequesterEntity*> requesters;
+    std::vector<Vector2> startCells;
+    for (int i = 0; i < TotalRequesters; ++i)
+    {
+        requesters.push_back(scene->CreateEntity<BenchmarkRequesterEntity>(Vector2(0, 0)));
+        startCells.push_back(Vector2(random() % GridSize, random() % GridSize));
+    }
+
+    // The first tick calculates the field that's cached
+    TimeTick(repaired, requesters, startCells, endCell);
+
+    TickTimes times;
+    const Vector2 steps[] = { Vector2(1, 0), Vector2(-1, 0), Vector2(0, 1), Vector2(0, -1) };
+
+    for (int tick = 0; tick < TotalTicks; ++tick)
+    {
+        for (auto& startCell : startCells)
+        {
+            auto next = startCell + steps[random() % 4];
+            if (next.x >= 0 && next.x < GridSize && next.y >= 0 && next.y < GridSize)
+            {
+                startCell = next;
+            }
+        }
+
+        times.repairMs += TimeTick(repaired, requesters, startCells, endCell);
+
+        full->ClearFlowFieldCache();
+        times.fullMs += TimeTick(full, requesters, startCells, endCell);
+    }
+
+    times.repairMs /= TotalTicks;
+    times.fullMs /= TotalTicks;
+
+    return times;
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        auto times = MeasureTicks(engine);
+
+        printf("%dx%d grid, %.0f%% obstacles, %d requesters moving one cell per tick to the same target\n",
+            GridSize,
+            GridSize,
+            ObstacleDensity * 100,
+            TotalRequesters);
+        printf("  repair cached field: %8.3f ms/tick\n", times.repairMs);
+        printf("  calculate new field: %8.3f ms/tick\n", times.fullMs);
+    });
+
+    game.Run();
+
+    return 0;
+}
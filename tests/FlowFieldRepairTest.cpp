@@ -0,0 +1,166 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Physics/PathFinding.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// A cached flow field that's repaired around requesters that moved must match a field calculated from scratch, and the
+// field that was handed out before the repair must not change under the followers that are using it.
+//
+// Requesters can always enter their own start cell, so a requester standing in a wall is a door in it. Moving them
+// around opens and closes doors, which changes the field the same way path followers do.
+
+static constexpr int GridSize = 48;
+static constexpr int TotalRequesters = 4;
+static constexpr int TotalRounds = 200;
+
+DEFINE_ENTITY(RepairRequesterEntity, "repair-requester-entity")
+{
+    std::shared_ptr<FlowField> field;
+
+private:
+    void ReceiveServerEvent(const IEntityEvent& ev) override
+    {
+        if (auto ready = ev.Is<FlowFieldReadyEvent>())
+        {
+            field = ready->result;
+        }
+    }
+};
+
+static const Vector2 EndCell(44, 24);
+
+static std::shared_ptr<FlowField> RequestPaths(
+    PathFinderService* pathFinder,
+    std::vector<RepairRequesterEntity*>& requesters,
+    const std::vector<Vector2>& startCells)
+{
+    for (int i = 0; i < (int)requesters.size(); ++i)
+    {
+        requesters[i]->field = nullptr;
+        pathFinder->RequestFlowField(startCells[i], EndCell, requesters[i]);
+    }
+
+    pathFinder->SendEvent(UpdateEvent(), false);
+
+    return requesters[0]->field;
+}
+
+static int CountDifferentCells(const FlowField& lhs, const FlowField& rhs)
+{
+    int differentCells = 0;
+
+    for (int y = 0; y < GridSize; ++y)
+    {
+        for (int x = 0; x < GridSize; ++x)
+        {
+            auto& a = lhs.grid[Vector2(x, y)];
+            auto& b = rhs.grid[Vector2(x, y)];
+
+            if (a.alreadyVisited != b.alreadyVisited
+                || a.hasLineOfSightToGoal != b.hasLineOfSightToGoal
+                || a.dir != b.dir
+                || a.distance != b.distance)
+            {
+                ++differentCells;
+            }
+        }
+    }
+
+    return differentCells;
+}
+
+static void TestRepairedFieldMatchesFreshField(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+
+    // Same obstacles in both. The fresh one has its cache cleared before every request.
+    auto repaired = scene->AddService<PathFinderService>(GridSize, GridSize);
+    auto fresh = scene->AddService<PathFinderService>(GridSize, GridSize);
+
+    std::mt19937 random(1);
+
+    for (int y = 0; y < GridSize; ++y)
+    {
+        for (int x = 0; x < GridSize; ++x)
+        {
+            bool isWall = x == 16 || x == 32;
+            bool isScattered = random() % 10 == 0;
+
+            if ((isWall || isScattered) && Vector2(x, y) != EndCell)
+            {
+                repaired->AddObstacle(Rectangle(x, y, 1, 1));
+                fresh->AddObstacle(Rectangle(x, y, 1, 1));
+            }
+        }
+    }
+
+    std::vector<RepairRequesterEntity*> requesters;
+    for (int i = 0; i < TotalRequesters; ++i)
+    {
+        requesters.push_back(scene->CreateEntity<RepairRequesterEntity>(Vector2(0, 0)));
+    }
+
+    std::shared_ptr<FlowField> lastField;
+    std::vector<int> lastFieldDistances;
+    std::vector<Vector2> startCells(TotalRequesters);
+
+    for (int round = 0; round < TotalRounds; ++round)
+    {
+        for (auto& startCell : startCells)
+        {
+            startCell = random() % 4 == 0
+                ? Vector2(random() % 2 == 0 ? 16 : 32, random() % GridSize)
+                : Vector2(random() % GridSize, random() % GridSize);
+        }
+
+        auto repairedField = RequestPaths(repaired, requesters, startCells);
+
+        fresh->ClearFlowFieldCache();
+        auto freshField = RequestPaths(fresh, requesters, startCells);
+
+        CHECK(repairedField != nullptr && freshField != nullptr);
+        if (repairedField == nullptr || freshField == nullptr)
+        {
+            break;
+        }
+
+        CHECK(CountDifferentCells(*repairedField, *freshField) == 0);
+
+        // Copy on write: the field from the last round is still what its followers were given
+        if (lastField != nullptr)
+        {
+            for (int i = 0; i < GridSize * GridSize; ++i)
+            {
+                CHECK(lastField->grid[Vector2(i % GridSize, i / GridSize)].distance == lastFieldDistances[i]);
+            }
+        }
+
+        lastField = repairedField;
+        lastFieldDistances.clear();
+        for (int i = 0; i < GridSize * GridSize; ++i)
+        {
+            lastFieldDistances.push_back(lastField->grid[Vector2(i % GridSize, i / GridSize)].distance);
+        }
+    }
+
+    // Most rounds went through the cache, rather than every field being calculated from scratch
+    CHECK(repaired->GetFlowFieldCache().GetStats().hits >= TotalRounds / 2);
+    CHECK(fresh->GetFlowFieldCache().GetStats().hits == 0);
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        TestRepairedFieldMatchesFreshField(engine);
+    });
+
+    game.Run();
+
+    return TestResult("FlowFieldRepairTest");
+}
@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "Memory/FrameArena.hpp"
+#include "TestUtil.hpp"
+
+// Once the frame size has settled, frames that only use the frame arena must not touch the heap
+
+static std::atomic<int> g_heapAllocations { 0 };
+
+void* operator new(size_t size)
+{
+    ++g_heapAllocations;
+
+    if (auto memory = malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t size) noexcept
+{
+    free(memory);
+}
+
+struct Candidate
+{
+    int id;
+    float score;
+};
+
+// A frame's worth of throwaway containers, with a size that varies from frame to frame like real frames do
+static void RunFrame(FrameArena& arena, int frame)
+{
+    int totalCandidates = 100 + (frame * 37) % 900;
+
+    FrameVector<Candidate> candidates(arena);
+    for (int i = 0; i < totalCandidates; ++i)
+    {
+        candidates.push_back({ i, (float)((i * 13) % 17) });
+    }
+
+    FrameVector<int> best(arena);
+    best.reserve(candidates.size() / 4);
+    for (auto& candidate : candidates)
+    {
+        if (candidate.score > 12) best.push_back(candidate.id);
+    }
+
+    auto scores = arena.AllocateArray<float>(totalCandidates);
+    for (int i = 0; i < totalCandidates; ++i)
+    {
+        scores[i] = candidates[i].score;
+    }
+}
+
+static void TestSteadyStateMakesNoHeapAllocations()
+{
+    // Start small so the arena has to grow during the warm up
+    FrameArena arena(4 * 1024);
+
+    // Long enough to see every frame size once
+    int warmUpFrames = 900;
+    for (int frame = 0; frame < warmUpFrames; ++frame)
+    {
+        RunFrame(arena, frame);
+        arena.Reset();
+    }
+
+    CHECK(arena.TotalOverflowFrames() > 0);
+
+    int overflowFramesAfterWarmUp = arena.TotalOverflowFrames();
+    size_t capacityAfterWarmUp = arena.Capacity();
+    int heapAllocationsBefore = g_heapAllocations;
+
+    for (int frame = warmUpFrames; frame < warmUpFrames + 10000; ++frame)
+    {
+        RunFrame(arena, frame);
+        arena.Reset();
+    }
+
+    CHECK(g_heapAllocations == heapAllocationsBefore);
+    CHECK(arena.TotalOverflowFrames() == overflowFramesAfterWarmUp);
+    CHECK(arena.Capacity() == capacityAfterWarmUp);
+}
+
+static void TestStats()
+{
+    FrameArena arena(1024);
+
+    arena.Allocate(100);
+    arena.Allocate(300);
+    CHECK(arena.BytesUsed() >= 400);
+    arena.Reset();
+
+    size_t busyFrameBytes = arena.LastFrameBytes();
+    CHECK(busyFrameBytes >= 400);
+    CHECK(arena.BytesUsed() == 0);
+
+    arena.Allocate(10);
+    arena.Reset();
+
+    CHECK(arena.LastFrameBytes() < busyFrameBytes);
+    CHECK(arena.HighWaterMark() == busyFrameBytes);
+
+    // Overflowing frames still work and make the arena grow
+    arena.Allocate(2000);
+    CHECK(arena.BytesUsed() >= 2000);
+    arena.Reset();
+
+    CHECK(arena.TotalOverflowFrames() == 1);
+    CHECK(arena.Capacity() >= 2000);
+    CHECK(arena.HighWaterMark() >= 2000);
+}
+
+int main()
+{
+    TestSteadyStateMakesNoHeapAllocations();
+    TestStats();
+
+    return TestResult("FrameArenaTest");
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+
+#include "Engine.hpp"
+#include "Scene/IGame.hpp"
+
+/// <summary>
+/// A multiplayer game without content that runs as a server, so it needs no window or assets. The test body runs from
+/// OnGameStart() and drives the engine itself; the game quits when it returns. configureEngine can change the engine
+/// settings after the defaults are set.
+/// </summary>
+class HeadlessGame : public IGame
+{
+public:
+    explicit HeadlessGame(
+        std::function<void(Engine* engine)> run,
+        std::function<void(EngineConfig& config)> configureEngine = nullptr)
+        : _run(std::move(run)),
+          _configureEngine(std::move(configureEngine))
+    {
+
+    }
+
+    void ConfigureEngine(EngineConfig& config) override
+    {
+        config.consoleVarsFile = std::nullopt;
+        config.initialConsoleCmd = "server 1";
+        config.maxServerClients = 64;
+
+        if (_configureEngine != nullptr)
+        {
+            _configureEngine(config);
+        }
+    }
+
+    void ConfigureGame(GameConfig& config) override
+    {
+        config.EnableMultiplayer();
+    }
+
+    void OnGameStart() override
+    {
+        _run(GetEngine());
+        GetEngine()->QuitGame();
+    }
+
+private:
+    std::function<void(Engine* engine)> _run;
+    std::function<void(EngineConfig& config)> _configureEngine;
+};
@@ -0,0 +1,155 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Physics/FlowFieldCache.hpp"
+#include "Physics/HierarchicalPathFinder.hpp"
+#include "Physics/PathFinding.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "HeadlessGame.hpp"
+
+// Cost and memory of a single path request on a 512x512 grid: a path from the hierarchical path finder against the
+// breadth-first flow field over the whole grid. Short hops stay within 64 cells of the requester, long ones go
+// anywhere on the map.
+
+static constexpr int GridSize = 512;
+static constexpr float ObstacleDensity = 0.2f;
+static constexpr int TotalRequests = 200;
+
+DEFINE_ENTITY(HierarchicalBenchmarkEntity, "hierarchical-benchmark-entity")
+{
+    int pathsReceived = 0;
+
+private:
+    void ReceiveServerEvent(const IEntityEvent& ev) override
+    {
+        if (ev.Is<FlowFieldReadyEvent>())
+        {
+            ++pathsReceived;
+        }
+    }
+};
+
+static void AddRandomObstacles(VariableSizedGrid<ObstacleCell>& obstacles, PathFinderService* pathFinder)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    for (int y = 0; y < GridSize; ++y)
+    {
+        for (int x = 0; x < GridSize; ++x)
+        {
+            if (unit(random) < ObstacleDensity)
+            {
+                obstacles[Vector2(x, y)].count = 1;
+                if (pathFinder != nullptr)
+                {
+                    pathFinder->AddObstacle(Rectangle(x, y, 1, 1));
+                }
+            }
+        }
+    }
+}
+
+static double MeasureRequests(Engine* engine, bool hierarchical, int maxDistance)
+{
+    GetConsoleVar("path-hierarchical")->TrySetValue(hierarchical ? "true" : "false");
+
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    auto pathFinder = scene->AddService<PathFinderService>(GridSize, GridSize);
+    auto requester = scene->CreateEntity<HierarchicalBenchmarkEntity>(Vector2(0, 0));
+
+    VariableSizedGrid<ObstacleCell> obstacles(GridSize, GridSize);
+    obstacles.FillWithZero();
+    AddRandomObstacles(obstacles, pathFinder);
+
+    std::mt19937 random(2);
+    auto randomOpenCell = [&](Vector2 center, int range)
+    {
+        while (true)
+        {
+            Vector2 cell(center.x - range + (int)(random() % (2 * range + 1)), center.y - range + (int)(random() % (2 * range + 1)));
+            if (cell.x >= 0 && cell.x < GridSize && cell.y >= 0 && cell.y < GridSize && obstacles[cell].count == 0)
+            {
+                return cell;
+            }
+        }
+    };
+
+    // Builds the abstract graph, which only happens again when obstacles change
+    auto warmUpStart = randomOpenCell(Vector2(GridSize / 2, GridSize / 2), GridSize / 2);
+    pathFinder->RequestFlowField(warmUpStart, randomOpenCell(warmUpStart, 8), requester);
+    pathFinder->SendEvent(UpdateEvent(), false);
+
+    double totalMs = 0;
+    for (int i = 0; i < TotalRequests; ++i)
+    {
+        auto start = randomOpenCell(Vector2(GridSize / 2, GridSize / 2), GridSize / 2);
+        auto end = randomOpenCell(start, maxDistance);
+
+        // Targets rarely repeat, but a cached field would make the flow field look cheaper than it is
+        pathFinder->ClearFlowFieldCache();
+        pathFinder->RequestFlowField(start, end, requester);
+
+        auto startTime = std::chrono::steady_clock::now();
+        pathFinder->SendEvent(UpdateEvent(), false);
+        totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    if (requester->pathsReceived != TotalRequests + 1)
+    {
+        printf("  %d of %d requests were answered\n", requester->pathsReceived - 1, TotalRequests);
+    }
+
+    return totalMs / TotalRequests;
+}
+
+static void PrintMemory()
+{
+    VariableSizedGrid<ObstacleCell> obstacles(GridSize, GridSize);
+    obstacles.FillWithZero();
+    AddRandomObstacles(obstacles, nullptr);
+
+    HierarchicalPathFinder pathFinder(GridSize, GridSize);
+
+    auto start = std::chrono::steady_clock::now();
+    pathFinder.Update(obstacles);
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    FlowField field(GridSize, GridSize, Vector2(0, 0));
+
+    printf("  abstract graph: %8.2f MB, built in %.1f ms, shared by every request\n",
+        pathFinder.MemoryUsageBytes() / (1024.0 * 1024.0),
+        buildMs);
+    printf("  flow field:     %8.2f MB per target cell\n",
+        FlowFieldCache::FieldSizeBytes(field) / (1024.0 * 1024.0));
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        printf("%dx%d grid, %.0f%% obstacles\n", GridSize, GridSize, ObstacleDensity * 100);
+        PrintMemory();
+
+        printf("\nms per request, %d requests\n", TotalRequests);
+        printf("  request     hierarchical   flow field\n");
+
+        for (int maxDistance : { 64, GridSize })
+        {
+            printf("  %-9s   %12.3f   %10.3f\n",
+                maxDistance == GridSize ? "long" : "short",
+                MeasureRequests(engine, true, maxDistance),
+                MeasureRequests(engine, false, maxDistance));
+        }
+
+        GetConsoleVar("path-hierarchical")->TrySetValue("false");
+    });
+
+    game.Run();
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Physics/HierarchicalPathFinder.hpp"
+#include "Physics/PathFinding.hpp"
+#include "TestUtil.hpp"
+
+// The hierarchical path finder must find a path exactly when a breadth-first search over the cells does, on random
+// grids with obstacles and blocked edges, after clusters were rebuilt because cells changed. Every path it returns must
+// be made of legal moves from the start to the end. Like path requests, the start and end can always be entered.
+
+static constexpr int TotalGrids = 300;
+static constexpr int QueriesPerGrid = 50;
+
+static bool CanMove(const VariableSizedGrid<ObstacleCell>& obstacles, Vector2 from, Vector2 to, Vector2 start, Vector2 end)
+{
+    if (to.x < 0 || to.x >= obstacles.Cols() || to.y < 0 || to.y >= obstacles.Rows())
+    {
+        return false;
+    }
+
+    auto diff = to - from;
+    auto fromEdge = diff.x > 0 ? ObstacleEdgeFlags::EastBlocked
+        : diff.x < 0 ? ObstacleEdgeFlags::WestBlocked
+        : diff.y > 0 ? ObstacleEdgeFlags::SouthBlocked
+        : ObstacleEdgeFlags::NorthBlocked;
+
+    auto toEdge = diff.x > 0 ? ObstacleEdgeFlags::WestBlocked
+        : diff.x < 0 ? ObstacleEdgeFlags::EastBlocked
+        : diff.y > 0 ? ObstacleEdgeFlags::NorthBlocked
+        : ObstacleEdgeFlags::SouthBlocked;
+
+    if (obstacles[from].flags.HasFlag(fromEdge) || obstacles[to].flags.HasFlag(toEdge))
+    {
+        return false;
+    }
+
+    return obstacles[to].count == 0 || to == start || to == end;
+}
+
+/// <summary>
+/// Returns the number of steps from start to end, or -1 if end can't be reached
+/// </summary>
+static int FindDistanceWithBfs(const VariableSizedGrid<ObstacleCell>& obstacles, Vector2 start, Vector2 end)
+{
+    int cols = obstacles.Cols();
+    std::vector<int> distance(obstacles.Rows() * cols, -1);
+    std::vector<Vector2> queue { start };
+    distance[(int)start.y * cols + (int)start.x] = 0;
+
+    for (int i = 0; i < (int)queue.size(); ++i)
+    {
+        auto cell = queue[i];
+
+        for (auto step : { Vector2(1, 0), Vector2(-1, 0), Vector2(0, 1), Vector2(0, -1) })
+        {
+            auto next = cell + step;
+            if (!CanMove(obstacles, cell, next, start, end))
+            {
+                continue;
+            }
+
+            int& nextDistance = distance[(int)next.y * cols + (int)next.x];
+            if (nextDistance == -1)
+            {
+                nextDistance = distance[(int)cell.y * cols + (int)cell.x] + 1;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    return distance[(int)end.y * cols + (int)end.x];
+}
+
+static bool IsLegalPath(const VariableSizedGrid<ObstacleCell>& obstacles, Vector2 start, Vector2 end, const std::vector<Vector2>& path)
+{
+    auto cell = start;
+
+    for (auto next : path)
+    {
+        auto diff = next - cell;
+        if (std::abs(diff.x) + std::abs(diff.y) != 1 || !CanMove(obstacles, cell, next, start, end))
+        {
+            return false;
+        }
+
+        cell = next;
+    }
+
+    return cell == end;
+}
+
+static void TestPathExistsExactlyWhenBfsFindsOne()
+{
+    std::mt19937 random(1);
+    int totalFound = 0;
+    int totalUnreachable = 0;
+
+    for (int gridIndex = 0; gridIndex < TotalGrids; ++gridIndex)
+    {
+        // Sizes that aren't multiples of the cluster size leave partial clusters on the right and bottom
+        int rows = 20 + random() % 60;
+        int cols = 20 + random() % 60;
+        int obstaclePercent = random() % 35;
+
+        VariableSizedGrid<ObstacleCell> obstacles(rows, cols);
+        obstacles.FillWithZero();
+
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < cols; ++x)
+            {
+                obstacles[Vector2(x, y)].count = (int)(random() % 100) < obstaclePercent;
+            }
+        }
+
+        for (int i = 0; i < rows * cols / 20; ++i)
+        {
+            Vector2 cell(random() % (cols - 1), random() % rows);
+            obstacles[cell].flags.SetFlag(ObstacleEdgeFlags::EastBlocked);
+            obstacles[cell + Vector2(1, 0)].flags.SetFlag(ObstacleEdgeFlags::WestBlocked);
+        }
+
+        HierarchicalPathFinder pathFinder(rows, cols);
+        pathFinder.Update(obstacles);
+
+        // Only the clusters around these cells are rebuilt
+        for (int i = 0; i < 5; ++i)
+        {
+            Vector2 cell(random() % cols, random() % rows);
+            obstacles[cell].count ^= 1;
+            pathFinder.MarkCellsChanged(cell, cell + Vector2(1, 1));
+        }
+
+        pathFinder.Update(obstacles);
+
+        HierarchicalPathFinder::Scratch scratch;
+
+        for (int query = 0; query < QueriesPerGrid; ++query)
+        {
+            Vector2 start(random() % cols, random() % rows);
+            Vector2 end(random() % cols, random() % rows);
+
+            int distance = FindDistanceWithBfs(obstacles, start, end);
+
+            std::vector<Vector2> path;
+            bool found = pathFinder.FindPath(obstacles, start, end, scratch, path);
+
+            CHECK(found == (distance >= 0));
+            if (found && distance >= 0)
+            {
+                CHECK(IsLegalPath(obstacles, start, end, path));
+                CHECK((int)path.size() >= distance);
+            }
+
+            found ? ++totalFound : ++totalUnreachable;
+        }
+    }
+
+    printf("  %d paths found, %d unreachable\n", totalFound, totalUnreachable);
+}
+
+int main()
+{
+    TestPathExistsExactlyWhenBfsFindsOne();
+
+    return TestResult("HierarchicalPathTest");
+}
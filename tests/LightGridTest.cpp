@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "Renderer/LightGrid.hpp"
+#include "Renderer/Lighting.hpp"
+#include "TestUtil.hpp"
+
+// Light culling without a GPU. The grid must find exactly the lights a linear scan over every light finds, each once,
+// while lights are added, removed, moved and resized. The batched light triangles must cover the same area as the
+// fan each light used to be drawn with.
+
+static constexpr int TotalRounds = 20;
+static constexpr int StepsPerRound = 200;
+
+static std::set<PointLight*> FindWithLinearScan(const std::vector<std::unique_ptr<PointLight>>& lights, const Rectangle& bounds)
+{
+    std::set<PointLight*> found;
+
+    for (auto& light : lights)
+    {
+        if (light->Bounds().IntersectsWith(bounds))
+        {
+            found.insert(light.get());
+        }
+    }
+
+    return found;
+}
+
+static void TestGridMatchesLinearScan()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> world(-10000, 10000);
+    std::uniform_real_distribution<float> radius(32, 400);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    auto createLight = [&]
+    {
+        auto light = std::make_unique<PointLight>();
+        light->position = Vector2(world(random), world(random));
+
+        // A few cover more cells than a light is allowed to be stored in
+        light->maxDistance = unit(random) < 0.01f ? 6000 : radius(random);
+        return light;
+    };
+
+    for (int round = 0; round < TotalRounds; ++round)
+    {
+        std::vector<std::unique_ptr<PointLight>> lights;
+        LightGrid<PointLight> grid;
+
+        for (int i = 0; i < 5000; ++i)
+        {
+            lights.push_back(createLight());
+            grid.Add(lights.back().get());
+        }
+
+        grid.PlacePendingLights();
+
+        for (int step = 0; step < StepsPerRound; ++step)
+        {
+            for (int change = 0; change < 50; ++change)
+            {
+                auto& light = lights[random() % lights.size()];
+                float roll = unit(random);
+
+                if (roll < 0.6f)
+                {
+                    light->position = light->position + Vector2(world(random), world(random)) * 0.01f;
+                    grid.Update(light.get());
+                }
+                else if (roll < 0.8f)
+                {
+                    light->maxDistance = radius(random) * (unit(random) < 0.05f ? 20 : 1);
+                    grid.Update(light.get());
+                }
+                else if (roll < 0.9f)
+                {
+                    grid.Remove(light.get());
+                    std::swap(light, lights.back());
+                    lights.pop_back();
+                }
+                else
+                {
+                    lights.push_back(createLight());
+                    grid.Add(lights.back().get());
+                }
+            }
+
+            grid.PlacePendingLights();
+            CHECK(grid.TotalLights() == (int)lights.size());
+
+            // Some cameras are zoomed out far enough to cover more cells than are occupied
+            float zoom = unit(random) < 0.2f ? 20 : 1;
+            Rectangle camera(Vector2(world(random), world(random)), Vector2(1920, 1080) * zoom);
+
+            std::vector<PointLight*> visibleLights;
+            grid.FindIntersecting(camera, visibleLights);
+
+            std::set<PointLight*> found(visibleLights.begin(), visibleLights.end());
+            CHECK(found.size() == visibleLights.size());
+            CHECK(found == FindWithLinearScan(lights, camera));
+        }
+    }
+}
+
+static void TestPendingLightsAreNotFound()
+{
+    PointLight light;
+    light.position = Vector2(100, 100);
+    light.maxDistance = 50;
+
+    LightGrid<PointLight> grid;
+    grid.Add(&light);
+
+    Rectangle camera(Vector2(0, 0), Vector2(1920, 1080));
+    std::vector<PointLight*> visibleLights;
+
+    // Updating a light that isn't placed yet does nothing, it's placed where it is when the pending lights are placed
+    light.position = Vector2(300, 300);
+    grid.Update(&light);
+    grid.FindIntersecting(camera, visibleLights);
+    CHECK(visibleLights.empty());
+
+    grid.PlacePendingLights();
+    grid.FindIntersecting(camera, visibleLights);
+    CHECK(visibleLights.size() == 1);
+
+    grid.Remove(&light);
+    visibleLights.clear();
+    grid.FindIntersecting(camera, visibleLights);
+    CHECK(visibleLights.empty());
+    CHECK(grid.TotalLights() == 0);
+}
+
+static void TestBatchMatchesFan()
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> world(-10000, 10000);
+    std::uniform_real_distribution<float> radius(32, 400);
+    std::uniform_real_distribution<float> angle(0, 6.28318f);
+
+    Color color(255, 128, 64);
+    float intensity = 0.5f;
+    auto c = color.ToVector4();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        Vector2 position(world(random), world(random));
+        float maxDistance = radius(random);
+        float facingAngle = angle(random);
+
+        // Capsule light ends are half circles
+        float beamAngle = i % 2 == 0 ? angle(random) : 3.14159f;
+
+        LightBatch batch;
+        batch.AddLight(position, maxDistance, facingAngle, beamAngle, intensity, color);
+        CHECK(batch.vertices.size() == LightBatch::VerticesPerLight);
+        if (batch.vertices.size() != LightBatch::VerticesPerLight)
+        {
+            continue;
+        }
+
+        // The old fan went around the arc in the same number of steps, from the light's center
+        for (int triangle = 0; triangle < LightBatch::OutlinePoints - 1; ++triangle)
+        {
+            float startAngle = facingAngle - beamAngle / 2;
+            float dAngle = beamAngle / (LightBatch::OutlinePoints - 1);
+
+            Vector2 expected[3] =
+            {
+                position,
+                position + Vector2(std::cos(startAngle + triangle * dAngle), std::sin(startAngle + triangle * dAngle)) * maxDistance,
+                position + Vector2(std::cos(startAngle + (triangle + 1) * dAngle), std::sin(startAngle + (triangle + 1) * dAngle)) * maxDistance
+            };
+
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                auto& vertex = batch.vertices[triangle * 3 + corner];
+
+                CHECK(std::abs(vertex.position.x - expected[corner].x) < 0.05f);
+                CHECK(std::abs(vertex.position.y - expected[corner].y) < 0.05f);
+                CHECK(vertex.lightPosition.x == position.x && vertex.lightPosition.y == position.y);
+                CHECK(vertex.maxDistance == maxDistance);
+                CHECK(vertex.color.x == c.x * intensity && vertex.color.y == c.y * intensity && vertex.color.z == c.z * intensity);
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestGridMatchesLinearScan();
+    TestPendingLightsAreNotFound();
+    TestBatchMatchesFan();
+
+    return TestResult("LightGridTest");
+}
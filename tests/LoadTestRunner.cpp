@@ -0,0 +1,45 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "Net/LoadTest.hpp"
+#include "Net/ReplicationManager.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Runs the load test headless and fails if the server couldn't keep up with the synthetic clients, so it can run in CI
+// without a window or a console.
+//
+// Usage: LoadTestRunner [map name] [clients] [seconds] [p99 tick time budget in ms]
+
+int main(int argc, char** argv)
+{
+    LoadTestSettings settings;
+    settings.mapName = argc > 1 ? argv[1] : "empty-map";
+    settings.totalClients = argc > 2 ? atoi(argv[2]) : 32;
+    settings.durationSeconds = argc > 3 ? (float)atof(argv[3]) : 5;
+
+    // A server tick at 60Hz
+    float tickTimeBudgetMs = argc > 4 ? (float)atof(argv[4]) : 1000.0f / 60;
+
+    HeadlessGame game([&](Engine* engine)
+    {
+        LoadTest loadTest(engine, settings);
+        auto& results = loadTest.Run();
+
+        CHECK(results.connectedClients == settings.totalClients);
+        CHECK(results.rejectedClients == 0);
+        CHECK(results.acknowledgedCommands > 0);
+        CHECK(results.deltaUpdatesReceived > 0);
+        CHECK(results.maxSnapshotsBehind <= (uint32)ReplicationManager::MaxSnapshotsWithoutAck());
+
+        if (results.tickTimeP99Ms > tickTimeBudgetMs)
+        {
+            printf("p99 tick time %.3f ms is over the budget of %.3f ms\n", results.tickTimeP99Ms, tickTimeBudgetMs);
+            ++FailedChecks();
+        }
+    });
+
+    game.Run();
+
+    return TestResult("LoadTestRunner");
+}
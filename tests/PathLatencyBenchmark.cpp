@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Physics/PathFinding.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "System/WorkerPool.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "HeadlessGame.hpp"
+
+// Time from a path request to its result with 500 followers on a 256x256 grid. Each tick the path finder calculates
+// as many flow fields as it has threads, so the latency depends on how many different targets the followers have.
+//
+// In a burst every follower requests a path on the same tick. In the steady state each follower requests a new path
+// every RequestIntervalTicks, staggered, which is what followers chasing a moving target do. A follower that's still
+// waiting when it requests again only gets the newest path, so its latency counts from its first request. Latencies
+// are in ticks, 0 when the result arrives in the tick the request was made.
+
+static constexpr int GridSize = 256;
+static constexpr float ObstacleDensity = 0.2f;
+static constexpr int TotalFollowers = 500;
+static constexpr int RequestIntervalTicks = 30;
+static constexpr int SteadyStateTicks = 240;
+
+static int g_tick;
+
+DEFINE_ENTITY(LatencyFollowerEntity, "latency-follower-entity")
+{
+    int waitingSinceTick = -1;
+    std::vector<int> latencies;
+
+private:
+    void ReceiveServerEvent(const IEntityEvent& ev) override
+    {
+        if (ev.Is<FlowFieldReadyEvent>() && waitingSinceTick != -1)
+        {
+            latencies.push_back(g_tick - waitingSinceTick);
+            waitingSinceTick = -1;
+        }
+    }
+};
+
+struct LatencyResults
+{
+    int burstTicks = 0;
+    double burstMsPerTick = 0;
+    double steadyMsPerTick = 0;
+    int medianLatencyTicks = 0;
+    int maxLatencyTicks = 0;
+    int totalDelivered = 0;
+};
+
+struct Scenario
+{
+    const char* name;
+    bool hierarchical;
+    int totalTargets;
+};
+
+static double RunTick(PathFinderService* pathFinder)
+{
+    auto start = std::chrono::steady_clock::now();
+    pathFinder->SendEvent(UpdateEvent(), false);
+    ++g_tick;
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Request(PathFinderService* pathFinder, LatencyFollowerEntity* follower, Vector2 start, Vector2 end)
+{
+    if (follower->waitingSinceTick == -1)
+    {
+        follower->waitingSinceTick = g_tick;
+    }
+
+    pathFinder->RequestFlowField(start, end, follower);
+}
+
+static LatencyResults MeasureLatency(Engine* engine, const Scenario& scenario)
+{
+    GetConsoleVar("path-hierarchical")->TrySetValue(scenario.hierarchical ? "true" : "false");
+
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    auto pathFinder = scene->AddService<PathFinderService>(GridSize, GridSize);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    for (int y = 0; y < GridSize; ++y)
+    {
+        for (int x = 0; x < GridSize; ++x)
+        {
+            if (unit(random) < ObstacleDensity)
+            {
+                pathFinder->AddObstacle(Rectangle(x, y, 1, 1));
+            }
+        }
+    }
+
+    auto randomOpenCell = [&]
+    {
+        while (true)
+        {
+            Vector2 cell(random() % GridSize, random() % GridSize);
+            if (pathFinder->GetCell(cell).count == 0)
+            {
+                return cell;
+            }
+        }
+    };
+
+    std::vector<Vector2> targets;
+    for (int i = 0; i < scenario.totalTargets; ++i)
+    {
+        targets.push_back(randomOpenCell());
+    }
+
+    std::vector<LatencyFollowerEntity*> followers;
+    std::vector<Vector2> startCells;
+    for (int i = 0; i < TotalFollowers; ++i)
+    {
+        followers.push_back(scene->CreateEntity<LatencyFollowerEntity>(Vector2(0, 0)));
+        startCells.push_back(randomOpenCell());
+    }
+
+    auto targetOf = [&](int followerIndex, int tick)
+    {
+        // Followers in a group share a target, which moves now and then
+        return targets[(followerIndex + tick / (RequestIntervalTicks * 4)) % targets.size()];
+    };
+
+    LatencyResults results;
+    g_tick = 0;
+
+    for (int i = 0; i < TotalFollowers; ++i)
+    {
+        Request(pathFinder, followers[i], startCells[i], targetOf(i, 0));
+    }
+
+    auto anyWaiting = [&]
+    {
+        return std::any_of(followers.begin(), followers.end(), [](auto follower) { return follower->waitingSinceTick != -1; });
+    };
+
+    double burstMs = 0;
+    while (anyWaiting())
+    {
+        burstMs += RunTick(pathFinder);
+        ++results.burstTicks;
+    }
+
+    results.burstMsPerTick = burstMs / results.burstTicks;
+
+    for (auto follower : followers)
+    {
+        follower->latencies.clear();
+    }
+
+    double steadyMs = 0;
+    for (int tick = 0; tick < SteadyStateTicks; ++tick)
+    {
+        for (int i = 0; i < TotalFollowers; ++i)
+        {
+            if ((g_tick + i) % RequestIntervalTicks == 0)
+            {
+                Request(pathFinder, followers[i], startCells[i], targetOf(i, g_tick));
+            }
+        }
+
+        steadyMs += RunTick(pathFinder);
+    }
+
+    results.steadyMsPerTick = steadyMs / SteadyStateTicks;
+
+    std::vector<int> latencies;
+    for (auto follower : followers)
+    {
+        latencies.insert(latencies.end(), follower->latencies.begin(), follower->latencies.end());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    results.totalDelivered = latencies.size();
+    if (!latencies.empty())
+    {
+        results.medianLatencyTicks = latencies[latencies.size() / 2];
+        results.maxLatencyTicks = latencies.back();
+    }
+
+    return results;
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        const Scenario scenarios[] =
+        {
+            { "flow fields, 500 targets", false, TotalFollowers },
+            { "flow fields, 10 targets", false, 10 },
+            { "hierarchical, 500 targets", true, TotalFollowers },
+            { "hierarchical, 10 targets", true, 10 },
+        };
+
+        printf("%dx%d grid, %.0f%% obstacles, %d followers, %d threads\n",
+            GridSize,
+            GridSize,
+            ObstacleDensity * 100,
+            TotalFollowers,
+            engine->GetWorkerPool()->TotalThreads());
+        printf("  %-26s   burst ticks   burst ms/tick   steady ms/tick   median latency   max latency   delivered\n", "");
+
+        for (auto& scenario : scenarios)
+        {
+            auto results = MeasureLatency(engine, scenario);
+            printf("  %-26s   %11d   %13.3f   %14.3f   %14d   %11d   %9d\n",
+                scenario.name,
+                results.burstTicks,
+                results.burstMsPerTick,
+                results.steadyMsPerTick,
+                results.medianLatencyTicks,
+                results.maxLatencyTicks,
+                results.totalDelivered);
+        }
+
+        GetConsoleVar("path-hierarchical")->TrySetValue("false");
+    });
+
+    game.Run();
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <box2d/b2_world.h>
+
+#include "Components/RigidBodyComponent.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+
+// Time to sync entities with their bodies after a physics step, for 5000 bodies of which only some are moving. The rest
+// are asleep, which is how most props and dropped items spend their time. Walking the whole body list is shown for
+// comparison: that's the least the sync used to cost before it skipped sleeping bodies.
+
+static constexpr int TotalBodies = 5000;
+static constexpr int BodiesPerRow = 100;
+static constexpr float Spacing = 64;
+static constexpr int MeasuredTicks = 200;
+
+DEFINE_ENTITY(PhysicsBenchmarkEntity, "physics-benchmark-entity")
+{
+    void OnAdded() override
+    {
+        rigidBody = AddComponent<RigidBodyComponent>(b2_dynamicBody);
+        rigidBody->CreateCircleCollider(0.5f);
+    }
+
+    RigidBodyComponent* rigidBody = nullptr;
+};
+
+struct SyncTimes
+{
+    double syncMs = 0;
+    double walkMs = 0;
+};
+
+template<typename TFunc>
+static double Milliseconds(TFunc&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static SyncTimes MeasureSync(Engine* engine, int movingBodies)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    auto world = scene->GetWorld();
+
+    std::vector<PhysicsBenchmarkEntity*> entities;
+    for (int i = 0; i < TotalBodies; ++i)
+    {
+        auto position = Vector2(i % BodiesPerRow, i / BodiesPerRow) * Spacing;
+        entities.push_back(scene->CreateEntity<PhysicsBenchmarkEntity>(position));
+    }
+
+    // Nothing touches or moves, so every body falls asleep
+    for (int i = 0; i < 200; ++i)
+    {
+        scene->StepPhysicsSimulation();
+    }
+
+    SyncTimes times;
+
+    for (int tick = 0; tick < MeasuredTicks; ++tick)
+    {
+        // Back and forth, so they never reach their neighbours
+        auto velocity = Vector2(tick % 2 == 0 ? 100 : -100, 0);
+        for (int i = 0; i < movingBodies; ++i)
+        {
+            entities[i * (TotalBodies / movingBodies)]->rigidBody->SetVelocity(velocity);
+        }
+
+        world->Step(Scene::PhysicsDeltaTime, 8, 3);
+
+        times.syncMs += Milliseconds([&] { scene->GetCollisionManager().UpdateEntityPositions(); });
+
+        int awakeBodies = 0;
+        times.walkMs += Milliseconds([&]
+        {
+            for (auto body = world->GetBodyList(); body != nullptr; body = body->GetNext())
+            {
+                awakeBodies += body->GetType() != b2_staticBody && body->IsAwake();
+            }
+        });
+
+        if (awakeBodies > movingBodies)
+        {
+            printf("  %d bodies are awake, expected %d\n", awakeBodies, movingBodies);
+        }
+    }
+
+    times.syncMs /= MeasuredTicks;
+    times.walkMs /= MeasuredTicks;
+
+    return times;
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        printf("%d bodies\n", TotalBodies);
+        printf("  moving bodies   sync ms/tick   body list walk ms/tick\n");
+
+        for (int movingBodies : { 10, 100, 500, 5000 })
+        {
+            auto times = MeasureSync(engine, movingBodies);
+            printf("  %13d   %12.4f   %22.4f\n", movingBodies, times.syncMs, times.walkMs);
+        }
+    });
+
+    game.Run();
+
+    return 0;
+}
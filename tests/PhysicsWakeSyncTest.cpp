@@ -0,0 +1,219 @@
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include <box2d/b2_distance_joint.h>
+#include <box2d/b2_world.h>
+
+#include "Components/RigidBodyComponent.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// CollisionManager::UpdateEntityPositions() only checks the bodies it knows are awake. After every physics step each
+// entity must still be where a walk over the whole body list says it is, when sleeping bodies are woken through a
+// joint, through a contact, with RigidBodyComponent's own functions, and by changing the b2Body directly followed by
+// RigidBodyComponent::NotifyBodyChanged().
+//
+// Each case gets its own part of the world so nothing else touches it. Before every case all the bodies are stopped
+// and left to fall asleep.
+
+static constexpr int ChainLength = 5;
+static constexpr float Radius = 8;
+static constexpr float Spacing = 48;
+static constexpr int MovingTicks = 100;
+static constexpr int SleepingTicks = 300;
+
+DEFINE_ENTITY(WakeSyncTestEntity, "wake-sync-test-entity")
+{
+    void OnAdded() override
+    {
+        rigidBody = AddComponent<RigidBodyComponent>(b2_dynamicBody);
+    }
+
+    RigidBodyComponent* rigidBody = nullptr;
+};
+
+struct WakeSyncScene
+{
+    std::vector<WakeSyncTestEntity*> chain;
+    WakeSyncTestEntity* touching[2] = { };
+    WakeSyncTestEntity* pushed = nullptr;
+    WakeSyncTestEntity* teleported = nullptr;
+    WakeSyncTestEntity* woken = nullptr;
+    std::vector<WakeSyncTestEntity*> all;
+};
+
+static WakeSyncTestEntity* CreateCircle(Scene* scene, WakeSyncScene& test, Vector2 position)
+{
+    auto entity = scene->CreateEntity<WakeSyncTestEntity>(position);
+    entity->rigidBody->CreateCircleCollider(Radius);
+    test.all.push_back(entity);
+    return entity;
+}
+
+static WakeSyncScene CreateScene(Scene* scene)
+{
+    WakeSyncScene test;
+
+    // Far enough apart that only the joints hold the chain together
+    for (int i = 0; i < ChainLength; ++i)
+    {
+        test.chain.push_back(CreateCircle(scene, test, Vector2(i * Spacing, 0)));
+
+        if (i > 0)
+        {
+            auto bodyA = test.chain[i - 1]->rigidBody->body;
+            auto bodyB = test.chain[i]->rigidBody->body;
+
+            b2DistanceJointDef jointDef;
+            jointDef.Initialize(bodyA, bodyB, bodyA->GetPosition(), bodyB->GetPosition());
+            scene->GetWorld()->CreateJoint(&jointDef);
+        }
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        auto entity = scene->CreateEntity<WakeSyncTestEntity>(Vector2(i * 2 * Radius, 1000));
+        entity->rigidBody->CreateBoxCollider(Vector2(2 * Radius, 2 * Radius));
+        test.touching[i] = entity;
+        test.all.push_back(entity);
+    }
+
+    test.pushed = CreateCircle(scene, test, Vector2(0, 2000));
+    test.teleported = CreateCircle(scene, test, Vector2(0, 3000));
+    test.woken = CreateCircle(scene, test, Vector2(0, 4000));
+
+    return test;
+}
+
+// Returns how many entities aren't where their bodies are
+static int CountMismatches(Scene* scene)
+{
+    int mismatches = 0;
+
+    for (auto body = scene->GetWorld()->GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        auto rigidBody = RigidBodyComponent::FromB2Body(body);
+        if (rigidBody == nullptr)
+        {
+            continue;
+        }
+
+        auto expected = Scene::Box2DToPixel(body->GetPosition());
+        auto actual = rigidBody->owner->Center();
+
+        if (std::abs(expected.x - actual.x) > 0.01f || std::abs(expected.y - actual.y) > 0.01f)
+        {
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+static int CountAwake(const WakeSyncScene& test)
+{
+    int awakeBodies = 0;
+    for (auto entity : test.all)
+    {
+        awakeBodies += entity->rigidBody->body->IsAwake();
+    }
+
+    return awakeBodies;
+}
+
+static int StepAndCountMismatches(Scene* scene, int totalTicks)
+{
+    int mismatches = 0;
+    for (int tick = 0; tick < totalTicks; ++tick)
+    {
+        scene->StepPhysicsSimulation();
+        mismatches += CountMismatches(scene);
+    }
+
+    return mismatches;
+}
+
+static void StopAndSleep(Scene* scene, WakeSyncScene& test)
+{
+    for (auto entity : test.all)
+    {
+        entity->rigidBody->body->SetAngularVelocity(0);
+        entity->rigidBody->SetVelocity(Vector2::Zero());
+    }
+
+    CHECK(StepAndCountMismatches(scene, SleepingTicks) == 0);
+    CHECK(CountAwake(test) == 0);
+}
+
+// Wakes the bodies, then checks that the entities follow them and that target moved
+static void RunCase(Scene* scene, WakeSyncScene& test, const char* name, WakeSyncTestEntity* target, const std::function<void()>& wake)
+{
+    StopAndSleep(scene, test);
+
+    auto start = target->Center();
+    wake();
+
+    int mismatches = StepAndCountMismatches(scene, MovingTicks);
+    float distance = (target->Center() - start).Length();
+
+    printf("  %-40s moved %6.1f px, %d mismatches\n", name, distance, mismatches);
+
+    CHECK(mismatches == 0);
+    CHECK(distance > Radius);
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        engine->StartLoopbackServer("empty-map");
+        auto scene = engine->GetServerGame()->GetScene();
+        auto test = CreateScene(scene);
+
+        CHECK(StepAndCountMismatches(scene, 1) == 0);
+
+        // Only the first body is woken, the others follow it through the joints
+        RunCase(scene, test, "joint", test.chain.back(), [&]
+        {
+            test.chain[0]->rigidBody->SetVelocity(Vector2(-400, 0));
+        });
+
+        RunCase(scene, test, "contact", test.touching[1], [&]
+        {
+            test.touching[0]->rigidBody->SetVelocity(Vector2(200, 0));
+        });
+
+        RunCase(scene, test, "b2Body::SetLinearVelocity()", test.pushed, [&]
+        {
+            test.pushed->rigidBody->body->SetLinearVelocity(Scene::PixelToBox2D(Vector2(200, 0)));
+            test.pushed->rigidBody->NotifyBodyChanged();
+        });
+
+        // SetTransform() doesn't wake the body, which is still synced once
+        RunCase(scene, test, "b2Body::SetTransform()", test.teleported, [&]
+        {
+            auto body = test.teleported->rigidBody->body;
+            body->SetTransform(Scene::PixelToBox2D(test.teleported->Center() + Vector2(100, 0)), 0);
+            test.teleported->rigidBody->NotifyBodyChanged();
+        });
+
+        RunCase(scene, test, "RigidBodyComponent::SetAwake()", test.woken, [&]
+        {
+            test.woken->rigidBody->SetAwake(true);
+            test.woken->rigidBody->body->SetLinearVelocity(Scene::PixelToBox2D(Vector2(200, 0)));
+        });
+
+        // A body put to sleep while moving is synced where it stopped
+        test.woken->rigidBody->SetVelocity(Vector2(200, 0));
+        CHECK(StepAndCountMismatches(scene, 10) == 0);
+        test.woken->rigidBody->SetAwake(false);
+        CHECK(StepAndCountMismatches(scene, 10) == 0);
+        CHECK(!test.woken->rigidBody->body->IsAwake());
+    });
+
+    game.Run();
+
+    return TestResult("PhysicsWakeSyncTest");
+}
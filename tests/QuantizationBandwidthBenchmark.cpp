@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <random>
+
+#include "Components/NetComponent.hpp"
+#include "Net/LoadTest.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "HeadlessGame.hpp"
+
+// Download bandwidth per client of a load test with wandering replicated entities, with positions sent quantized and
+// with the net-quantization console var turned off, which sends them as full floats.
+
+static constexpr int TotalClients = 16;
+static constexpr float DurationSeconds = 5;
+static constexpr float WorldSize = 8000;
+
+DEFINE_ENTITY(QuantizedBenchmarkEntity, "quantized-benchmark-entity")
+{
+    void OnAdded() override
+    {
+        AddComponent<NetComponent>();
+    }
+
+    void ServerUpdate(float deltaTime) override
+    {
+        SetCenter(Center() + velocity * deltaTime);
+    }
+
+    Vector2 velocity;
+};
+
+static LoadTestResults RunLoadTest(Engine* engine, int totalEntities, bool quantize)
+{
+    GetConsoleVar("net-quantization")->TrySetValue(quantize ? "true" : "false");
+
+    LoadTestSettings settings;
+    settings.mapName = "empty-map";
+    settings.totalClients = TotalClients;
+    settings.durationSeconds = DurationSeconds;
+
+    LoadTest loadTest(engine, settings);
+    auto scene = engine->GetServerGame()->GetScene();
+
+    // Same entities for both runs, moving by fractions of a pixel per tick like most things do
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, WorldSize);
+    std::uniform_real_distribution<float> velocity(-60, 60);
+
+    for (int i = 0; i < totalEntities; ++i)
+    {
+        auto entity = scene->CreateEntity<QuantizedBenchmarkEntity>(Vector2(position(random), position(random)));
+        entity->velocity = Vector2(velocity(random), velocity(random));
+    }
+
+    return loadTest.Run();
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        printf("%d clients, %.0f seconds per run\n", TotalClients, DurationSeconds);
+        printf("  entities   down bytes/s/client (quantized)   down bytes/s/client (full)   saved\n");
+
+        for (int totalEntities : { 100, 500, 2000 })
+        {
+            auto quantized = RunLoadTest(engine, totalEntities, true);
+            auto full = RunLoadTest(engine, totalEntities, false);
+
+            printf("  %8d   %31.0f   %26.0f   %4.0f%%\n",
+                totalEntities,
+                quantized.downBytesPerSecondPerClient,
+                full.downBytesPerSecondPerClient,
+                100 * (1 - quantized.downBytesPerSecondPerClient / full.downBytesPerSecondPerClient));
+        }
+
+        GetConsoleVar("net-quantization")->TrySetValue("true");
+    });
+
+    game.Run();
+
+    return 0;
+}
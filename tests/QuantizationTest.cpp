@@ -0,0 +1,144 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+#include "Net/Quantization.hpp"
+#include "TestUtil.hpp"
+
+// Quantized values must come back within MaxError() of what was sent, and values that can't be represented must be
+// reported by IsInRange() instead of silently turning into something else
+
+static float RoundTrip(const Quantization& quantization, float value)
+{
+    return quantization.Decode(quantization.Encode(value));
+}
+
+static void TestFixedPointRoundTrip()
+{
+    auto quantization = Quantization::FixedPoint(-65536, 65536, 22);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> values(-65536, 65536);
+
+    float maxError = 0;
+    for (int i = 0; i < 1000000; ++i)
+    {
+        float value = values(random);
+        CHECK(quantization.IsInRange(value));
+        maxError = std::max(maxError, std::abs(RoundTrip(quantization, value) - value));
+    }
+
+    // Plus the float rounding of the decoded value, which is up to half an ulp at 65536
+    CHECK(maxError <= quantization.MaxError() + 0.004f);
+    CHECK(quantization.MaxError() < 1.0f / 64 + 1e-6f);
+
+    // The ends of the range are exact
+    CHECK(RoundTrip(quantization, -65536) == -65536);
+    CHECK(RoundTrip(quantization, 65536) == 65536);
+
+    // Encoding a decoded value gives the same code, so a value that was received and sent back doesn't drift
+    for (uint32_t code = 0; code < (1u << 22); code += 997)
+    {
+        CHECK(quantization.Encode(quantization.Decode(code)) == code);
+    }
+}
+
+static void TestFixedPointOutOfRange()
+{
+    auto quantization = Quantization::FixedPoint(0, 100, 10);
+
+    CHECK(!quantization.IsInRange(-0.5f));
+    CHECK(!quantization.IsInRange(100.5f));
+    CHECK(!quantization.IsInRange(std::numeric_limits<float>::quiet_NaN()));
+    CHECK(quantization.IsInRange(0));
+    CHECK(quantization.IsInRange(100));
+
+    // Clamped to the ends of the range
+    CHECK(RoundTrip(quantization, -1000) == 0);
+    CHECK(RoundTrip(quantization, 1000) == 100);
+    CHECK(RoundTrip(quantization, std::numeric_limits<float>::infinity()) == 100);
+    CHECK(RoundTrip(quantization, std::numeric_limits<float>::quiet_NaN()) == 0);
+}
+
+static void TestAngleRoundTrip()
+{
+    auto quantization = Quantization::Angle(12);
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> angles(-20, 20);
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        float angle = angles(random);
+        float decoded = RoundTrip(quantization, angle);
+
+        CHECK(decoded >= 0 && decoded < 6.2831855f);
+
+        // Compared on the circle, since the decoded angle is wrapped
+        float difference = std::remainder(decoded - angle, 6.283185307f);
+        CHECK(std::abs(difference) <= quantization.MaxError() + 1e-5f);
+    }
+
+    CHECK(!quantization.IsInRange(std::numeric_limits<float>::infinity()));
+    CHECK(quantization.IsInRange(-100));
+}
+
+static void TestHalfFloatRoundTrip()
+{
+    auto quantization = Quantization::HalfFloat();
+
+    // Every half survives the trip through float, except that NaNs only need to stay NaN
+    for (uint32_t half = 0; half < 0x10000; ++half)
+    {
+        float value = HalfToFloat((uint16_t)half);
+
+        if (std::isnan(value))
+        {
+            CHECK(std::isnan(HalfToFloat(FloatToHalf(value))));
+        }
+        else
+        {
+            CHECK(FloatToHalf(value) == half);
+        }
+    }
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> values(-60000, 60000);
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        float value = values(random);
+        float decoded = RoundTrip(quantization, value);
+
+        if (std::abs(value) >= 6.1e-5f)
+        {
+            CHECK(std::abs(decoded - value) <= std::abs(value) * quantization.MaxError());
+        }
+    }
+
+    CHECK(quantization.IsInRange(65504));
+    CHECK(!quantization.IsInRange(70000));
+    CHECK(std::isinf(RoundTrip(quantization, 70000)));
+}
+
+static void TestSameValueComparison()
+{
+    auto quantization = Quantization::FixedPoint(-65536, 65536, 22);
+
+    // Changes smaller than half a step from an encoded value don't need to be sent
+    float x = quantization.Decode(quantization.Encode(10));
+    float step = 2 * quantization.MaxError();
+
+    CHECK(quantization.EncodesToSameValue(Vector2(x, 20), Vector2(x + step / 4, 20)));
+    CHECK(!quantization.EncodesToSameValue(Vector2(x, 20), Vector2(x + step, 20)));
+}
+
+int main()
+{
+    TestFixedPointRoundTrip();
+    TestFixedPointOutOfRange();
+    TestAngleRoundTrip();
+    TestHalfFloatRoundTrip();
+    TestSameValueComparison();
+
+    return TestResult("QuantizationTest");
+}
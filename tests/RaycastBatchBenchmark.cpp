@@ -0,0 +1,103 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Components/RigidBodyComponent.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "System/WorkerPool.hpp"
+#include "HeadlessGame.hpp"
+
+// Random rays across a scene of static boxes and circles, cast one at a time with Scene::Raycast() and as a batch with
+// Scene::RaycastBatch(), which splits them over the worker threads. Times are per tick, with every ray cast once.
+
+static constexpr int TotalColliders = 2000;
+static constexpr int TotalTicks = 60;
+static constexpr float WorldSize = 8000;
+
+DEFINE_ENTITY(RaycastBenchmarkEntity, "raycast-benchmark-entity")
+{
+    void OnAdded() override
+    {
+        rigidBody = AddComponent<RigidBodyComponent>();
+    }
+
+    RigidBodyComponent* rigidBody = nullptr;
+};
+
+template<typename TFunc>
+static double Milliseconds(TFunc&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        engine->StartLoopbackServer("empty-map");
+        auto scene = engine->GetServerGame()->GetScene();
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(0, WorldSize);
+        std::uniform_real_distribution<float> size(8, 120);
+
+        for (int i = 0; i < TotalColliders; ++i)
+        {
+            auto entity = scene->CreateEntity<RaycastBenchmarkEntity>(Vector2(position(random), position(random)));
+            if (i % 2 == 0) entity->rigidBody->CreateBoxCollider(Vector2(size(random), size(random)));
+            else entity->rigidBody->CreateCircleCollider(size(random) / 2);
+        }
+
+        scene->StepPhysicsSimulation();
+
+        printf("%d colliders over %.0f x %.0f, %d threads\n",
+            TotalColliders,
+            WorldSize,
+            WorldSize,
+            engine->GetWorkerPool() != nullptr ? engine->GetWorkerPool()->TotalThreads() : 1);
+        printf("     rays     hits   one at a time ms/tick   batched ms/tick\n");
+
+        for (int totalRays : { 1000, 10000, 50000 })
+        {
+            std::vector<RaycastRequest> rays(totalRays);
+            for (auto& ray : rays)
+            {
+                ray.start = Vector2(position(random), position(random));
+                ray.end = Vector2(position(random), position(random));
+            }
+
+            std::vector<RaycastResult> singleResults(totalRays);
+            std::vector<RaycastResult> batchResults(totalRays);
+            int totalHits = 0;
+
+            double singleMs = Milliseconds([&]
+            {
+                for (int tick = 0; tick < TotalTicks; ++tick)
+                {
+                    totalHits = 0;
+                    for (int i = 0; i < totalRays; ++i)
+                    {
+                        totalHits += scene->Raycast(rays[i].start, rays[i].end, singleResults[i], rays[i].allowTriggers);
+                    }
+                }
+            });
+
+            double batchMs = Milliseconds([&]
+            {
+                for (int tick = 0; tick < TotalTicks; ++tick)
+                {
+                    scene->RaycastBatch(rays, batchResults);
+                }
+            });
+
+            printf("  %7d  %7d   %21.3f   %15.3f\n", totalRays, totalHits, singleMs / TotalTicks, batchMs / TotalTicks);
+        }
+    });
+
+    game.Run();
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include <box2d/b2_fixture.h>
+#include <box2d/b2_world.h>
+
+#include "Components/RigidBodyComponent.hpp"
+#include "Physics/Physics.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "System/WorkerPool.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Scene::RaycastBatch() split over the worker threads must give exactly the same results as casting the rays one at a
+// time with Scene::Raycast(). The scene has boxes and circles in three collision categories, some of them triggers, and
+// the rays use every mask and both trigger settings.
+//
+// Both go through the same code, so the results are also checked against a brute force cast on every fixture, which
+// catches a mask or trigger filter that's wrong in both.
+
+static constexpr int TotalColliders = 600;
+static constexpr int TotalRays = 8192;
+static constexpr float WorldSize = 4000;
+
+DEFINE_ENTITY(RaycastTestEntity, "raycast-test-entity")
+{
+    void OnAdded() override
+    {
+        rigidBody = AddComponent<RigidBodyComponent>();
+    }
+
+    RigidBodyComponent* rigidBody = nullptr;
+};
+
+static bool ShouldHit(b2Fixture* fixture, const RaycastRequest& ray)
+{
+    return (ray.allowTriggers || !fixture->IsSensor())
+        && (fixture->GetFilterData().categoryBits & ray.maskBits) != 0;
+}
+
+// Returns the distance to the closest fixture the ray hits, or -1
+static float BruteForceRaycast(b2World* world, const RaycastRequest& ray)
+{
+    b2RayCastInput input;
+    input.p1 = Scene::PixelToBox2D(ray.start);
+    input.p2 = Scene::PixelToBox2D(ray.end);
+    input.maxFraction = 1;
+
+    float closestFraction = 2;
+
+    for (auto body = world->GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        for (auto fixture = body->GetFixtureList(); fixture != nullptr; fixture = fixture->GetNext())
+        {
+            if (!ShouldHit(fixture, ray))
+            {
+                continue;
+            }
+
+            for (int i = 0; i < fixture->GetShape()->GetChildCount(); ++i)
+            {
+                b2RayCastOutput output;
+                if (fixture->RayCast(&output, input, i) && output.fraction < closestFraction)
+                {
+                    closestFraction = output.fraction;
+                }
+            }
+        }
+    }
+
+    return closestFraction <= 1
+        ? closestFraction * (ray.end - ray.start).Length()
+        : -1;
+}
+
+static void AddColliders(Scene* scene)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, WorldSize);
+    std::uniform_real_distribution<float> size(8, 120);
+
+    for (int i = 0; i < TotalColliders; ++i)
+    {
+        auto entity = scene->CreateEntity<RaycastTestEntity>(Vector2(position(random), position(random)));
+        bool isTrigger = i % 5 == 0;
+
+        auto fixture = i % 2 == 0
+            ? entity->rigidBody->CreateBoxCollider(Vector2(size(random), size(random)), isTrigger)
+            : entity->rigidBody->CreateCircleCollider(size(random) / 2, isTrigger);
+
+        b2Filter filter = fixture->GetFilterData();
+        filter.categoryBits = 1 << (i % 3);
+        fixture->SetFilterData(filter);
+    }
+
+    scene->StepPhysicsSimulation();
+}
+
+static std::vector<RaycastRequest> RandomRays()
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> position(-100, WorldSize + 100);
+    const uint16 masks[] = { 0xFFFF, 1, 2, 4, 1 | 4, 0 };
+
+    std::vector<RaycastRequest> rays(TotalRays);
+    for (int i = 0; i < TotalRays; ++i)
+    {
+        auto& ray = rays[i];
+        ray.start = Vector2(position(random), position(random));
+
+        // Some short rays that often start inside a collider, and a few with zero length
+        ray.end = i % 7 == 0
+            ? ray.start + Vector2(position(random), position(random)) * 0.02f
+            : (i % 101 == 0 ? ray.start : Vector2(position(random), position(random)));
+
+        ray.maskBits = masks[i % 6];
+        ray.allowTriggers = (i / 6) % 2 == 0;
+    }
+
+    return rays;
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        CHECK(engine->GetWorkerPool() != nullptr && engine->GetWorkerPool()->TotalThreads() > 1);
+
+        engine->StartLoopbackServer("empty-map");
+        auto scene = engine->GetServerGame()->GetScene();
+        AddColliders(scene);
+
+        auto rays = RandomRays();
+        std::vector<RaycastResult> batchResults(TotalRays);
+        scene->RaycastBatch(rays, batchResults);
+
+        int totalHits = 0;
+        int maskedHits = 0;
+        int triggerHits = 0;
+        int mismatches = 0;
+        int bruteForceMismatches = 0;
+
+        for (int i = 0; i < TotalRays; ++i)
+        {
+            auto& ray = rays[i];
+            auto& batch = batchResults[i];
+            bool batchHit = batch.handle.GetFixture() != nullptr;
+
+            std::function<bool(ColliderHandle handle)> inMask = [&](ColliderHandle handle)
+            {
+                return (handle.GetFixture()->GetFilterData().categoryBits & ray.maskBits) != 0;
+            };
+
+            RaycastResult single;
+            bool singleHit = scene->Raycast(ray.start, ray.end, single, ray.allowTriggers, inMask);
+
+            if (singleHit != batchHit
+                || (batchHit && (!(single.handle == batch.handle)
+                    || single.point != batch.point
+                    || single.normal != batch.normal
+                    || single.distance != batch.distance)))
+            {
+                ++mismatches;
+            }
+
+            // Box2D doesn't hit anything with a zero length ray
+            float bruteForceDistance = ray.start != ray.end ? BruteForceRaycast(scene->GetWorld(), ray) : -1;
+            if ((bruteForceDistance >= 0) != batchHit
+                || (batchHit && std::abs(bruteForceDistance - batch.distance) > 0.05f))
+            {
+                ++bruteForceMismatches;
+            }
+
+            if (batchHit)
+            {
+                ++totalHits;
+                maskedHits += ray.maskBits != 0xFFFF;
+                triggerHits += batch.handle.GetFixture()->IsSensor();
+
+                CHECK(ShouldHit(batch.handle.GetFixture(), ray));
+            }
+        }
+
+        CHECK(mismatches == 0);
+        CHECK(bruteForceMismatches == 0);
+
+        // The filters were exercised
+        CHECK(maskedHits > 0);
+        CHECK(triggerHits > 0);
+        CHECK(totalHits < TotalRays);
+
+        printf("  %d rays, %d hits, %d with a mask, %d on triggers, %d mismatches, %d brute force mismatches\n",
+            TotalRays,
+            totalHits,
+            maskedHits,
+            triggerHits,
+            mismatches,
+            bruteForceMismatches);
+    },
+    [](EngineConfig& config)
+    {
+        config.workerThreadCount = 4;
+    });
+
+    game.Run();
+
+    return TestResult("RaycastBatchTest");
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include <slikenet/BitStream.h>
+
+#include "Components/NetComponent.hpp"
+#include "Net/RelevancyFilter.hpp"
+#include "Net/ReplicationManager.hpp"
+#include "Net/ServerGame.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+
+// World update bytes per client per tick on a loopback server as the number of wandering entities grows, with every
+// entity sent to every client and with a SpatialRelevancyFilter. The clients acknowledge every update, so after the
+// first full snapshot they receive deltas.
+
+static constexpr int TotalClients = 16;
+static constexpr float WorldSize = 8000;
+static constexpr float RelevancyRadius = 1000;
+static constexpr int MaxEntitiesPerClient = 256;
+static constexpr int WarmUpTicks = 10;
+static constexpr int MeasuredTicks = 120;
+
+DEFINE_ENTITY(ReplicatedBenchmarkEntity, "replicated-benchmark-entity")
+{
+    void OnAdded() override
+    {
+        AddComponent<NetComponent>();
+    }
+
+    Vector2 velocity;
+};
+
+static double MeasureBytesPerClientPerTick(Engine* engine, int totalEntities, bool useRelevancyFilter)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    auto replicationManager = scene->replicationManager;
+
+    if (useRelevancyFilter)
+    {
+        replicationManager->SetRelevancyFilter(std::make_unique<SpatialRelevancyFilter>(RelevancyRadius, MaxEntitiesPerClient));
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, WorldSize);
+    std::uniform_real_distribution<float> velocity(-2, 2);
+
+    std::vector<ReplicatedBenchmarkEntity*> entities;
+    for (int i = 0; i < totalEntities; ++i)
+    {
+        auto entity = scene->CreateEntity<ReplicatedBenchmarkEntity>(Vector2(position(random), position(random)));
+        entity->velocity = Vector2(velocity(random), velocity(random));
+        entities.push_back(entity);
+    }
+
+    for (int clientId = 0; clientId < TotalClients; ++clientId)
+    {
+        replicationManager->GetClient(clientId);
+        replicationManager->SetClientViewpoint(clientId, Vector2(position(random), position(random)));
+    }
+
+    int64_t measuredBytes = 0;
+
+    for (int tick = 0; tick < WarmUpTicks + MeasuredTicks; ++tick)
+    {
+        for (auto entity : entities)
+        {
+            entity->SetCenter(entity->Center() + entity->velocity);
+        }
+
+        scene->deltaTime = 1.0f / 60;
+        scene->relativeTime += scene->deltaTime;
+        replicationManager->TakeSnapshot();
+
+        for (int clientId = 0; clientId < TotalClients; ++clientId)
+        {
+            SLNet::BitStream response;
+            replicationManager->Server_SendWorldUpdate(clientId, response);
+
+            if (tick >= WarmUpTicks)
+            {
+                measuredBytes += response.GetNumberOfBytesUsed();
+            }
+
+            // Acknowledged right away, like a client on a perfect connection
+            replicationManager->GetClient(clientId).lastReceivedSnapshotId = replicationManager->GetCurrentSnapshotId();
+        }
+    }
+
+    return (double)measuredBytes / TotalClients / MeasuredTicks;
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        printf("%d clients, %.0f x %.0f world, relevancy radius %.0f, at most %d entities per client\n",
+            TotalClients,
+            WorldSize,
+            WorldSize,
+            RelevancyRadius,
+            MaxEntitiesPerClient);
+        printf("  entities   bytes/client/tick (all)   bytes/client/tick (relevancy)\n");
+
+        for (int totalEntities : { 250, 1000, 4000, 8000 })
+        {
+            double all = MeasureBytesPerClientPerTick(engine, totalEntities, false);
+            double relevant = MeasureBytesPerClientPerTick(engine, totalEntities, true);
+
+            printf("  %8d   %23.0f   %29.0f\n", totalEntities, all, relevant);
+        }
+    });
+
+    game.Run();
+
+    return 0;
+}
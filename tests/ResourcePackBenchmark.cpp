@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "System/ResourceFileReader.hpp"
+#include "System/ResourceFileWriter.hpp"
+
+// Startup cost of a 1GB resource pack of which a map uses 2%: reading and decrypting the whole pack like version 0
+// packs, against memory mapping it and decrypting only the entries that are used. Reports the time until those
+// entries are loaded and how much the resident set grew.
+//
+// Usage: ResourcePackBenchmark [pack file]
+// Without a pack file a synthetic one is written first, which leaves it in the page cache. For a cold start, pass the
+// file again after dropping the page cache.
+
+static constexpr int TotalEntries = 4096;
+static constexpr int EntrySize = 256 * 1024;
+static constexpr int UsedEntryInterval = 50;
+
+static double ResidentMegabytes()
+{
+#ifdef __linux__
+    long totalPages = 0;
+    long residentPages = 0;
+
+    if (FILE* file = fopen("/proc/self/statm", "r"))
+    {
+        if (fscanf(file, "%ld %ld", &totalPages, &residentPages) != 2) residentPages = 0;
+        fclose(file);
+    }
+
+    return residentPages * 4096.0 / (1024 * 1024);
+#else
+    return 0;
+#endif
+}
+
+static void WriteSyntheticPack(const char* fileName)
+{
+    ResourceFileWriter writer;
+    writer.Initialize(fileName);
+
+    std::vector<unsigned char> data(EntrySize);
+
+    for (int i = 0; i < TotalEntries; ++i)
+    {
+        for (int j = 0; j < EntrySize; ++j)
+        {
+            data[j] = (unsigned char)(i * 31 + j);
+        }
+
+        writer.WriteResource(data.data(), EntrySize, "entry-" + std::to_string(i), "file");
+    }
+
+    writer.Finish();
+}
+
+struct LoadResult
+{
+    double milliseconds;
+    double residentMegabytes;
+};
+
+static LoadResult LoadPack(const char* fileName, bool mapped)
+{
+    double residentBefore = ResidentMegabytes();
+    auto start = std::chrono::steady_clock::now();
+
+    BinaryStreamReader reader;
+    if (mapped) reader.OpenMapped(fileName);
+    else reader.Open(fileName);
+
+    ResourceFileReader fileReader(reader);
+    auto entries = fileReader.LoadEntries();
+
+    std::vector<std::byte> buffer;
+
+    for (int i = 0; i < (int)entries.size(); ++i)
+    {
+        // Reading the whole pack used to decrypt every entry up front, whether the map used it or not
+        if (!mapped || i % UsedEntryInterval == 0)
+        {
+            fileReader.LoadResource(entries[i], buffer);
+        }
+    }
+
+    LoadResult result;
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.residentMegabytes = ResidentMegabytes() - residentBefore;
+
+    fileReader.Close();
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::string fileName = argc > 1 ? argv[1] : "synthetic-pack.strf";
+
+    if (argc <= 1)
+    {
+        printf("Writing %d MB synthetic pack to %s...\n", (int)((long long)TotalEntries * EntrySize / (1024 * 1024)), fileName.c_str());
+        WriteSyntheticPack(fileName.c_str());
+    }
+
+    auto mapped = LoadPack(fileName.c_str(), true);
+    auto whole = LoadPack(fileName.c_str(), false);
+
+    printf("Loading 1 in %d entries of %s\n", UsedEntryInterval, fileName.c_str());
+    printf("  read and decrypt whole pack: %8.1f ms, resident +%7.1f MB\n", whole.milliseconds, whole.residentMegabytes);
+    printf("  mapped, decrypt on demand:   %8.1f ms, resident +%7.1f MB\n", mapped.milliseconds, mapped.residentMegabytes);
+
+    if (argc <= 1)
+    {
+        remove(fileName.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <memory>
+#include <vector>
+#include <slikenet/BitStream.h>
+
+#include "Net/LoadTest.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// A loopback server with room for MaxClients clients that more clients try to join. Exactly the ones over the limit
+// must be turned away with PacketType::ServerFull while the server keeps ticking for the others, and the ids of
+// clients that leave must be given to the next clients that join.
+
+static constexpr int MaxClients = 6;
+static constexpr int ExtraClients = 4;
+
+static std::unique_ptr<SyntheticClient> ConnectClient(Engine* engine, int port)
+{
+    auto server = engine->GetServerGame();
+    SLNet::AddressOrGUID address(SLNet::SystemAddress("0.0.2.0", port));
+
+    auto client = std::make_unique<SyntheticClient>(server->networkInterface.raknetInterface, engine->GetDefaultBlockAllocator(), address);
+    server->networkInterface.AddLoopbackPeer(address, { &client->networkInterface, address.systemAddress });
+    client->networkInterface.AddLoopbackPeer(server->localAddress, { &server->networkInterface, server->localAddress.systemAddress });
+
+    unsigned char data[1] = { (unsigned char)PacketType::NewConnection };
+    client->networkInterface.SendReliable(server->localAddress, data);
+
+    return client;
+}
+
+static void DisconnectClient(Engine* engine, SyntheticClient& client)
+{
+    auto server = engine->GetServerGame();
+
+    unsigned char data[1] = { (unsigned char)PacketType::Disconnected };
+    client.networkInterface.SendReliable(server->localAddress, data);
+    client.clientId = -1;
+}
+
+// Runs server frames and reads each client's connection responses
+static void RunFrames(Engine* engine, std::vector<std::unique_ptr<SyntheticClient>>& clients, int totalFrames)
+{
+    for (int frame = 0; frame < totalFrames; ++frame)
+    {
+        engine->RunFrame();
+
+        for (auto& client : clients)
+        {
+            SLNet::Packet* packet;
+            while (client->networkInterface.TryGetPacket(packet))
+            {
+                SLNet::BitStream stream(packet->data, packet->length, false);
+                stream.IgnoreBytes(1);
+
+                if ((PacketType)packet->data[0] == PacketType::NewConnectionResponse)
+                {
+                    stream.Read(client->clientId);
+                }
+                else if ((PacketType)packet->data[0] == PacketType::ServerFull)
+                {
+                    client->wasRejected = true;
+                }
+            }
+        }
+    }
+}
+
+static void TestExtraClientsAreRejected(Engine* engine)
+{
+    LoadTestSettings settings;
+    settings.mapName = "empty-map";
+    settings.totalClients = MaxClients + ExtraClients;
+    settings.durationSeconds = 2;
+
+    LoadTest loadTest(engine, settings);
+    auto& results = loadTest.Run();
+
+    CHECK(results.connectedClients == MaxClients);
+    CHECK(results.rejectedClients == ExtraClients);
+
+    // The rejections didn't stop the server, and the clients that got in were sent world updates
+    CHECK(results.ticks > 60);
+    CHECK(results.deltaUpdatesReceived > 0);
+    CHECK(results.acknowledgedCommands > 0);
+}
+
+static void TestFreedSlotsAreReused(Engine* engine)
+{
+    // Left running by the load test, with all of its clients gone
+    auto server = engine->GetServerGame();
+    std::vector<std::unique_ptr<SyntheticClient>> clients;
+
+    RunFrames(engine, clients, 2);
+    CHECK(server->TotalConnectedClients() == 0);
+
+    for (int i = 0; i < MaxClients + 1; ++i)
+    {
+        clients.push_back(ConnectClient(engine, 1 + i));
+    }
+
+    RunFrames(engine, clients, 2);
+
+    std::vector<bool> idIsTaken(MaxClients, false);
+    for (int i = 0; i < MaxClients; ++i)
+    {
+        CHECK(clients[i]->IsConnected() && !clients[i]->wasRejected);
+        if (clients[i]->clientId >= 0 && clients[i]->clientId < MaxClients)
+        {
+            idIsTaken[clients[i]->clientId] = true;
+        }
+    }
+
+    for (bool isTaken : idIsTaken)
+    {
+        CHECK(isTaken);
+    }
+
+    CHECK(clients[MaxClients]->wasRejected && !clients[MaxClients]->IsConnected());
+    CHECK(server->TotalConnectedClients() == MaxClients);
+
+    // The one that leaves makes room for exactly one more, the first to ask, which gets its id
+    int freedId = clients[2]->clientId;
+    DisconnectClient(engine, *clients[2]);
+    RunFrames(engine, clients, 2);
+    CHECK(server->TotalConnectedClients() == MaxClients - 1);
+
+    clients.push_back(ConnectClient(engine, 100));
+    clients.push_back(ConnectClient(engine, 101));
+    RunFrames(engine, clients, 2);
+
+    auto& first = *clients[MaxClients + 1];
+    auto& second = *clients[MaxClients + 2];
+    CHECK(first.IsConnected() && first.clientId == freedId);
+    CHECK(second.wasRejected && !second.IsConnected());
+    CHECK(server->TotalConnectedClients() == MaxClients);
+
+    for (auto& client : clients)
+    {
+        if (client->IsConnected())
+        {
+            DisconnectClient(engine, *client);
+        }
+    }
+
+    RunFrames(engine, clients, 2);
+    CHECK(server->TotalConnectedClients() == 0);
+
+    for (auto& client : clients)
+    {
+        server->networkInterface.RemoveLoopbackPeer(client->address);
+    }
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        TestExtraClientsAreRejected(engine);
+        TestFreedSlotsAreReused(engine);
+    },
+    [](EngineConfig& config)
+    {
+        config.maxServerClients = MaxClients;
+    });
+
+    game.Run();
+
+    return TestResult("ServerCapacityTest");
+}
@@ -0,0 +1,60 @@
+#include <cstdio>
+
+#include "Net/LoadTest.hpp"
+#include "Net/ReplicationManager.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Synthetic clients on a loopback server that drops some of its unreliable packets. Deltas that are lost get replaced
+// by the next ones, and each client's full state is sent once, reliably, instead of every tick until one gets through.
+
+static constexpr int TotalClients = 8;
+
+static LoadTestResults RunLoadTest(Engine* engine, float packetLoss)
+{
+    LoadTestSettings settings;
+    settings.mapName = "empty-map";
+    settings.totalClients = TotalClients;
+    settings.durationSeconds = 3;
+    settings.packetLoss = packetLoss;
+
+    LoadTest loadTest(engine, settings);
+    return loadTest.Run();
+}
+
+static void CheckClientsKeptUp(const LoadTestResults& results)
+{
+    CHECK(results.connectedClients == TotalClients);
+    CHECK(results.deltaUpdatesReceived > 0);
+
+    // One full state each when they join. Without an acknowledgement for a full state, the server used to send
+    // another one every tick.
+    CHECK(results.fullUpdatesReceived >= TotalClients);
+    CHECK(results.fullUpdatesReceived < 2 * TotalClients);
+
+    CHECK(results.maxSnapshotsBehind <= (uint32)ReplicationManager::MaxSnapshotsWithoutAck());
+    CHECK(results.acknowledgedCommands > 0);
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        auto noLoss = RunLoadTest(engine, 0);
+        auto lossy = RunLoadTest(engine, 0.2f);
+
+        CheckClientsKeptUp(noLoss);
+        CheckClientsKeptUp(lossy);
+
+        // Lost deltas aren't resent
+        CHECK(lossy.deltaUpdatesReceived < noLoss.deltaUpdatesReceived);
+
+        printf("  packet loss   full updates   delta updates   bytes/s per client (down)\n");
+        printf("  %10.0f%%   %12d   %13d   %25.0f\n", 0.0f, noLoss.fullUpdatesReceived, noLoss.deltaUpdatesReceived, noLoss.downBytesPerSecondPerClient);
+        printf("  %10.0f%%   %12d   %13d   %25.0f\n", 20.0f, lossy.fullUpdatesReceived, lossy.deltaUpdatesReceived, lossy.downBytesPerSecondPerClient);
+    });
+
+    game.Run();
+
+    return TestResult("SnapshotPacketLossTest");
+}
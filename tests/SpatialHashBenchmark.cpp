@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Components/RigidBodyComponent.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "Scene/EntityManager.hpp"
+#include "Scene/SpatialHashService.hpp"
+#include "HeadlessGame.hpp"
+
+// Entity queries on a full scene: the spatial hash against Box2D's broadphase through FindOverlappingEntities(), with
+// every entity given a small static box. Radius and nearest neighbor queries on Box2D query the bounding box and then
+// measure distances, which is what the game did before the hash. For nearest neighbors the box starts at one cell and
+// doubles until it has enough entities.
+
+static constexpr float WorldSize = 8000;
+static constexpr float QueryRadius = 100;
+static constexpr int NearestCount = 8;
+
+DEFINE_ENTITY(SpatialHashBenchmarkEntity, "spatial-hash-benchmark-entity")
+{
+    void OnAdded() override
+    {
+        auto rigidBody = AddComponent<RigidBodyComponent>();
+        rigidBody->CreateBoxCollider(Vector2(2, 2));
+    }
+};
+
+template<typename TFunc>
+static double Milliseconds(TFunc&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int Box2DInRadius(Scene* scene, Vector2 center, float radius, std::vector<Entity*>& storage)
+{
+    auto overlapping = scene->FindOverlappingEntities(
+        Rectangle(center.x - radius, center.y - radius, 2 * radius, 2 * radius),
+        storage);
+
+    int count = 0;
+    for (auto entity : overlapping)
+    {
+        count += (entity->Center() - center).LengthSquared() <= radius * radius;
+    }
+
+    return count;
+}
+
+static int Box2DNearest(Scene* scene, Vector2 point, int maxCount, std::vector<Entity*>& storage, std::vector<float>& distances)
+{
+    for (float halfSize = SpatialHashService::DefaultCellSize; ; halfSize *= 2)
+    {
+        auto overlapping = scene->FindOverlappingEntities(
+            Rectangle(point.x - halfSize, point.y - halfSize, 2 * halfSize, 2 * halfSize),
+            storage);
+
+        if ((int)overlapping.size() < maxCount && halfSize < WorldSize)
+        {
+            continue;
+        }
+
+        // Only what's inside the circle that fits in the box is sure to be the closest
+        distances.clear();
+        for (auto entity : overlapping)
+        {
+            float distance = (entity->Center() - point).LengthSquared();
+            if (distance <= halfSize * halfSize) distances.push_back(distance);
+        }
+
+        if ((int)distances.size() < maxCount && halfSize < WorldSize)
+        {
+            continue;
+        }
+
+        int count = std::min((int)distances.size(), maxCount);
+        std::partial_sort(distances.begin(), distances.begin() + count, distances.end());
+        return count;
+    }
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        engine->StartLoopbackServer("empty-map");
+        auto scene = engine->GetServerGame()->GetScene();
+        auto spatialHash = scene->spatialHash;
+
+        // As many as the scene can hold
+        int totalEntities = MaxEntities - (int)scene->GetEntities().size();
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(0, WorldSize);
+        std::vector<Vector2> queryPoints;
+
+        for (int i = 0; i < totalEntities; ++i)
+        {
+            auto center = Vector2(position(random), position(random));
+            scene->CreateEntity<SpatialHashBenchmarkEntity>(center);
+            queryPoints.push_back(center);
+        }
+
+        std::vector<Entity*> storage(MaxEntities);
+        std::vector<float> distances;
+        int64_t hashFound = 0;
+        int64_t box2DFound = 0;
+
+        printf("%d entities over %.0f x %.0f, one query from each entity's position\n", totalEntities, WorldSize, WorldSize);
+        printf("  query                 spatial hash ms   box2d ms   found (hash / box2d)\n");
+
+        double hashMs = Milliseconds([&]
+        {
+            for (auto point : queryPoints)
+            {
+                Rectangle bounds(point.x - QueryRadius, point.y - QueryRadius, 2 * QueryRadius, 2 * QueryRadius);
+                hashFound += spatialHash->FindInRectangle(bounds, storage).size();
+            }
+        });
+
+        double box2DMs = Milliseconds([&]
+        {
+            for (auto point : queryPoints)
+            {
+                Rectangle bounds(point.x - QueryRadius, point.y - QueryRadius, 2 * QueryRadius, 2 * QueryRadius);
+                box2DFound += scene->FindOverlappingEntities(bounds, storage).size();
+            }
+        });
+
+        printf("  rectangle %4.0fx%-4.0f   %15.2f   %8.2f   %lld / %lld\n", 2 * QueryRadius, 2 * QueryRadius, hashMs, box2DMs, (long long)hashFound, (long long)box2DFound);
+
+        hashFound = box2DFound = 0;
+        hashMs = Milliseconds([&]
+        {
+            for (auto point : queryPoints)
+            {
+                hashFound += spatialHash->FindInRadius(point, QueryRadius, storage).size();
+            }
+        });
+
+        box2DMs = Milliseconds([&]
+        {
+            for (auto point : queryPoints)
+            {
+                box2DFound += Box2DInRadius(scene, point, QueryRadius, storage);
+            }
+        });
+
+        printf("  radius %-4.0f           %15.2f   %8.2f   %lld / %lld\n", QueryRadius, hashMs, box2DMs, (long long)hashFound, (long long)box2DFound);
+
+        hashFound = box2DFound = 0;
+        hashMs = Milliseconds([&]
+        {
+            for (auto point : queryPoints)
+            {
+                hashFound += spatialHash->FindNearest(point, gsl::span<Entity*>(storage.data(), NearestCount)).size();
+            }
+        });
+
+        box2DMs = Milliseconds([&]
+        {
+            for (auto point : queryPoints)
+            {
+                box2DFound += Box2DNearest(scene, point, NearestCount, storage, distances);
+            }
+        });
+
+        printf("  %d nearest             %15.2f   %8.2f   %lld / %lld\n", NearestCount, hashMs, box2DMs, (long long)hashFound, (long long)box2DFound);
+    });
+
+    game.Run();
+
+    return 0;
+}
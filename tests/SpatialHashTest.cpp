@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Scene/BaseEntity.hpp"
+#include "Scene/SpatialHashService.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Every SpatialHashService query against a brute force walk over the scene's entities. Entities are spread over a few
+// dense clusters and a sparse background, including negative coordinates and points exactly on cell edges, and some
+// are moved to other cells or destroyed between rounds.
+//
+// Queries that match more entities than fit in the storage must fill it with matching entities and stop. Nearest
+// neighbor queries from far outside the occupied cells, with a max distance and with more neighbors asked for than
+// there are entities check where the ring search stops.
+
+static constexpr int TotalEntities = 3000;
+static constexpr int QueriesPerRound = 300;
+static constexpr float CellSize = SpatialHashService::DefaultCellSize;
+
+DEFINE_ENTITY(SpatialHashTestEntity, "spatial-hash-test-entity")
+{
+
+};
+
+static std::vector<Entity*> SortedEntities(gsl::span<Entity*> entities)
+{
+    std::vector<Entity*> sorted(entities.begin(), entities.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+template<typename TPredicate>
+static std::vector<Entity*> BruteForceMatches(Scene* scene, TPredicate predicate)
+{
+    std::vector<Entity*> matches;
+    for (auto entity : scene->GetEntities())
+    {
+        if (predicate(entity->Center()))
+        {
+            matches.push_back(entity);
+        }
+    }
+
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+// With enough storage the result must be every match. Otherwise the storage must be full of distinct matches.
+static void CheckMatches(gsl::span<Entity*> result, const std::vector<Entity*>& expected, int storageSize)
+{
+    auto sorted = SortedEntities(result);
+
+    if ((int)expected.size() <= storageSize)
+    {
+        CHECK(sorted == expected);
+        return;
+    }
+
+    CHECK((int)sorted.size() == storageSize);
+    CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+    CHECK(std::includes(expected.begin(), expected.end(), sorted.begin(), sorted.end()));
+}
+
+static void CheckNearest(Scene* scene, Vector2 point, int maxCount, float maxDistance)
+{
+    std::vector<float> expected;
+    for (auto entity : scene->GetEntities())
+    {
+        float distance = (entity->Center() - point).LengthSquared();
+        if (distance <= maxDistance * maxDistance)
+        {
+            expected.push_back(distance);
+        }
+    }
+
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::min((int)expected.size(), maxCount));
+
+    std::vector<Entity*> storage(maxCount);
+    auto result = scene->spatialHash->FindNearest(point, storage, maxDistance);
+
+    // Entities at the same distance can come back in any order, so only the distances are compared
+    std::vector<float> actual;
+    for (auto entity : result)
+    {
+        actual.push_back((entity->Center() - point).LengthSquared());
+    }
+
+    CHECK(actual == expected);
+
+    auto sorted = SortedEntities(result);
+    CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+}
+
+static Vector2 RandomPosition(std::mt19937& random, const std::vector<Vector2>& clusters)
+{
+    std::uniform_real_distribution<float> background(-3000, 5000);
+    std::normal_distribution<float> spread(0, 40);
+
+    switch (random() % 6)
+    {
+    case 0:
+        return Vector2(background(random), background(random));
+    case 1:
+        // On a cell corner
+        return Vector2((int)(random() % 40) - 20, (int)(random() % 40) - 20) * CellSize;
+    default:
+    {
+        auto& cluster = clusters[random() % clusters.size()];
+        return cluster + Vector2(spread(random), spread(random));
+    }
+    }
+}
+
+static void RunQueries(Scene* scene, std::mt19937& random, const std::vector<Vector2>& clusters)
+{
+    auto spatialHash = scene->spatialHash;
+    CHECK(spatialHash->TotalEntities() == (int)scene->GetEntities().size());
+
+    std::uniform_real_distribution<float> size(0, 800);
+    std::vector<Entity*> storage(TotalEntities + 100);
+
+    for (int i = 0; i < QueriesPerRound; ++i)
+    {
+        auto point = RandomPosition(random, clusters);
+
+        // Small storage now and then, which dense clusters overflow
+        int storageSize = random() % 4 == 0 ? 1 + (int)(random() % 16) : (int)storage.size();
+        gsl::span<Entity*> span(storage.data(), storageSize);
+
+        Rectangle bounds(point.x - size(random) / 2, point.y - size(random) / 2, size(random), size(random));
+        CheckMatches(
+            spatialHash->FindInRectangle(bounds, span),
+            BruteForceMatches(scene, [&](Vector2 position) { return bounds.ContainsPoint(position); }),
+            storageSize);
+
+        float radius = i % 10 == 0 ? 0 : size(random) / 2;
+        CheckMatches(
+            spatialHash->FindInRadius(point, radius, span),
+            BruteForceMatches(scene, [&](Vector2 position) { return (position - point).LengthSquared() <= radius * radius; }),
+            storageSize);
+
+        CheckNearest(scene, point, 1 + i % 12, INFINITY);
+        CheckNearest(scene, point, 8, size(random) / 4);
+    }
+
+    // Far outside every occupied cell, where the rings are cut off by the occupied area
+    for (auto point : { Vector2(-100000, 3), Vector2(50000, 60000), Vector2(2000, -70000) })
+    {
+        CheckNearest(scene, point, 1, INFINITY);
+        CheckNearest(scene, point, 20, INFINITY);
+        CheckNearest(scene, point, 5, 1000);
+    }
+
+    // More neighbors than there are entities
+    CheckNearest(scene, clusters[0], (int)scene->GetEntities().size() + 10, INFINITY);
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        engine->StartLoopbackServer("empty-map");
+        auto scene = engine->GetServerGame()->GetScene();
+
+        std::mt19937 random(1);
+        std::vector<Vector2> clusters = { Vector2(0, 0), Vector2(-1500, 700), Vector2(3000, 3000), Vector2(127.5f, -64) };
+        std::vector<Entity*> entities;
+
+        for (int i = 0; i < TotalEntities; ++i)
+        {
+            entities.push_back(scene->CreateEntity<SpatialHashTestEntity>(RandomPosition(random, clusters)));
+        }
+
+        RunQueries(scene, random, clusters);
+
+        for (int round = 0; round < 3; ++round)
+        {
+            // Moves within a cell, to another cell and to a new area
+            for (int i = 0; i < (int)entities.size(); i += 3)
+            {
+                auto entity = entities[i];
+                switch (random() % 3)
+                {
+                case 0: entity->SetCenter(entity->Center() + Vector2(1, -1)); break;
+                case 1: entity->SetCenter(RandomPosition(random, clusters)); break;
+                default: entity->SetCenter(Vector2(-6000 - round * 500, 6000)); break;
+                }
+            }
+
+            // Destroyed entities are removed from the hash on the next frame
+            for (int i = round; i < (int)entities.size(); i += 11)
+            {
+                entities[i]->Destroy();
+            }
+
+            engine->RunFrame();
+
+            entities.erase(
+                std::remove_if(entities.begin(), entities.end(), [&](Entity* entity) { return scene->GetEntities().count(entity) == 0; }),
+                entities.end());
+
+            RunQueries(scene, random, clusters);
+        }
+    });
+
+    game.Run();
+
+    return TestResult("SpatialHashTest");
+}
@@ -0,0 +1,210 @@
+#include <memory>
+#include <vector>
+
+#include "Renderer/SpriteBatcher.hpp"
+#include "Renderer/Texture.hpp"
+#include "TestUtil.hpp"
+
+// Sprite batching without a GPU: the draw callback stands in for SpriteEffect and records the batches
+
+struct DrawnBatch
+{
+    Texture* texture;
+    int vertexCount;
+    int indexCount;
+    std::vector<float> vertexX;
+};
+
+// The batcher never looks inside a texture, and constructing a real one needs an OpenGL context, so the textures are
+// raw storage that is never constructed
+struct FakeTextures
+{
+    Texture* Get(int index)
+    {
+        return reinterpret_cast<Texture*>(storage.get() + index * sizeof(Texture));
+    }
+
+    std::unique_ptr<unsigned char[]> storage = std::make_unique<unsigned char[]>(8 * sizeof(Texture));
+};
+
+static void AddQuad(SpriteBatcher& batcher, Texture* texture, float x, float depth)
+{
+    RenderVertex vertices[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        vertices[i].position = Vector3(x, (float)i, depth);
+    }
+
+    batcher.AddPolygon(vertices, texture);
+}
+
+static std::vector<DrawnBatch> Flush(SpriteBatcher& batcher)
+{
+    std::vector<DrawnBatch> batches;
+    batcher.Flush([&](const SpriteBatch& batch)
+    {
+        DrawnBatch drawn { batch.texture, (int)batch.vertices.size(), (int)batch.indices.size() };
+        for (auto& vertex : batch.vertices)
+        {
+            drawn.vertexX.push_back(vertex.position.x);
+        }
+
+        batches.push_back(drawn);
+    });
+
+    CHECK(batcher.lastFlushBatchCount == (int)batches.size());
+    CHECK(batcher.IsEmpty());
+
+    return batches;
+}
+
+static void TestInterleavedTexturesAtSameDepthKeepOrder()
+{
+    FakeTextures textures;
+    SpriteBatcher batcher(600);
+
+    // Overlapping sprites at the same depth: reordering them would change which one is on top
+    AddQuad(batcher, textures.Get(0), 0, 0);
+    AddQuad(batcher, textures.Get(1), 1, 0);
+    AddQuad(batcher, textures.Get(0), 2, 0);
+    AddQuad(batcher, textures.Get(1), 3, 0);
+
+    auto batches = Flush(batcher);
+
+    CHECK(batches.size() == 4);
+    for (int i = 0; i < (int)batches.size() && i < 4; ++i)
+    {
+        CHECK(batches[i].texture == textures.Get(i % 2));
+        CHECK(batches[i].vertexX[0] == (float)i);
+    }
+}
+
+static void TestAdjacentRunsAreMerged()
+{
+    FakeTextures textures;
+    SpriteBatcher batcher(600);
+
+    // Three layers submitted front to back, each a run of tiles followed by a run of characters. Unbatched, this is
+    // one draw call per sprite.
+    for (int layer = 0; layer < 3; ++layer)
+    {
+        for (int i = 0; i < 50; ++i) AddQuad(batcher, textures.Get(0), (float)i, (float)layer);
+        for (int i = 0; i < 50; ++i) AddQuad(batcher, textures.Get(1), (float)(50 + i), (float)layer);
+    }
+
+    auto batches = Flush(batcher);
+
+    CHECK(batcher.lastFlushPolygonCount == 300);
+    CHECK(batches.size() == 6);
+
+    for (int i = 0; i < (int)batches.size(); ++i)
+    {
+        CHECK(batches[i].texture == textures.Get(i % 2));
+
+        // Indexed quads: 4 vertices and 6 indices each
+        CHECK(batches[i].vertexCount == 50 * 4);
+        CHECK(batches[i].indexCount == 50 * 6);
+
+        // Submission order within the run
+        for (int j = 0; j < 50 && j * 4 < (int)batches[i].vertexX.size(); ++j)
+        {
+            CHECK(batches[i].vertexX[j * 4] == (float)((i % 2) * 50 + j));
+        }
+    }
+}
+
+static void TestDrawnBackToFront()
+{
+    FakeTextures textures;
+    SpriteBatcher batcher(600);
+
+    AddQuad(batcher, textures.Get(0), 0, 1);
+    AddQuad(batcher, textures.Get(0), 1, 3);
+    AddQuad(batcher, textures.Get(0), 2, 2);
+
+    auto batches = Flush(batcher);
+
+    CHECK(batches.size() == 1);
+    if (batches.size() == 1)
+    {
+        CHECK(batches[0].vertexX == std::vector<float>({ 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }));
+    }
+}
+
+static void TestFullBatchIsSplit()
+{
+    FakeTextures textures;
+    SpriteBatcher batcher(600);
+
+    for (int i = 0; i < 200; ++i)
+    {
+        AddQuad(batcher, textures.Get(0), (float)i, 0);
+    }
+
+    auto batches = Flush(batcher);
+
+    CHECK(batches.size() == 2);
+    if (batches.size() == 2)
+    {
+        CHECK(batches[0].vertexCount == 600);
+        CHECK(batches[1].vertexCount == 200);
+    }
+}
+
+static void TestCachedQuadsMatchPolygons()
+{
+    FakeTextures textures;
+    SpriteBatcher polygonBatcher(600);
+    SpriteBatcher quadBatcher(600);
+
+    // Tiles of a cached chunk, built without the offset they're drawn at
+    std::vector<RenderVertex> vertices;
+    std::vector<Texture*> quadTextures;
+    Vector2 offset(100, -20);
+
+    for (int i = 0; i < 40; ++i)
+    {
+        auto texture = textures.Get(i / 10 % 2);
+        float depth = (float)(i % 3);
+
+        RenderVertex quad[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            quad[j].position = Vector3((float)i, (float)j, depth);
+            vertices.push_back(quad[j]);
+            quad[j].position = Vector3(i + offset.x, j + offset.y, depth);
+        }
+
+        quadTextures.push_back(texture);
+        polygonBatcher.AddPolygon(quad, texture);
+    }
+
+    quadBatcher.AddQuads(vertices, quadTextures, offset);
+
+    auto expected = Flush(polygonBatcher);
+    auto batches = Flush(quadBatcher);
+
+    CHECK(quadBatcher.lastFlushPolygonCount == 40);
+    CHECK(batches.size() == expected.size());
+
+    for (int i = 0; i < (int)batches.size() && i < (int)expected.size(); ++i)
+    {
+        CHECK(batches[i].texture == expected[i].texture);
+        CHECK(batches[i].indexCount == expected[i].indexCount);
+        CHECK(batches[i].vertexX == expected[i].vertexX);
+    }
+
+    // The cached vertices are left as they were
+    CHECK(vertices[0].position.x == 0);
+}
+
+int main()
+{
+    TestInterleavedTexturesAtSameDepthKeepOrder();
+    TestAdjacentRunsAreMerged();
+    TestDrawnBackToFront();
+    TestFullBatchIsSplit();
+    TestCachedQuadsMatchPolygons();
+
+    return TestResult("SpriteBatcherTest");
+}
@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Net/SyncVar.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+#include "LinearSnapshotHistory.hpp"
+#include "TestUtil.hpp"
+
+// Memory used by sync var snapshot histories and the cost of looking up values in them. Histories used to be a queue
+// of 256 snapshots embedded in every var, searched front to back. They're now borrowed from the scene's pool when a
+// var is first snapshotted, and searched by index or binary search.
+//
+// Lookups are timed at the shortest history length and at the old one. Consecutive snapshot ids are the usual case,
+// ids with gaps are what a client sees after packet loss.
+
+static constexpr int OldHistoryCapacity = 256;
+static constexpr int TotalLookups = 1000000;
+
+DEFINE_ENTITY(SyncVarBenchmarkEntity, "sync-var-benchmark-entity")
+{
+    SyncVar<Vector2> velocity { { 0, 0 }, SyncVarInterpolation::Linear };
+    SyncVar<float> health { 100, SyncVarInterpolation::Linear };
+};
+
+template<typename T>
+static int OldSyncVarSize()
+{
+    return sizeof(SyncVar<T>) + sizeof(FixedSizeCircularQueue<typename SyncVar<T>::Snapshot, OldHistoryCapacity>);
+}
+
+template<typename T>
+static int PooledHistorySize(int historyLength)
+{
+    return historyLength * sizeof(typename SyncVar<T>::Snapshot);
+}
+
+static void PrintMemory()
+{
+    printf("Memory per entity with a Vector2 and a float sync var, besides the position every entity has\n");
+    printf("  history length   old bytes   inline bytes   pooled bytes when replicated\n");
+
+    for (int historyLength : { 32, 64, 256 })
+    {
+        printf("  %14d   %9d   %12d   %28d\n",
+            historyLength,
+            OldSyncVarSize<Vector2>() + OldSyncVarSize<float>(),
+            (int)(sizeof(SyncVar<Vector2>) + sizeof(SyncVar<float>)),
+            PooledHistorySize<Vector2>(historyLength) + PooledHistorySize<float>(historyLength));
+    }
+}
+
+struct LookupTimes
+{
+    double pooledSnapshotMs;
+    double linearSnapshotMs;
+    double pooledTimeMs;
+    double linearTimeMs;
+};
+
+template<int HistoryLength>
+static LookupTimes MeasureLookups(Engine* engine, bool idsWithGaps)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    scene->GetSyncVarHistoryPool().SetHistoryLength(HistoryLength);
+
+    auto entity = scene->CreateEntity<SyncVarBenchmarkEntity>(Vector2(0, 0));
+    LinearSnapshotHistory<Vector2, HistoryLength> linear(SyncVarInterpolation::Linear);
+
+    std::mt19937 random(1);
+    uint32_t snapshotId = 0;
+    float time = 0;
+
+    for (int i = 0; i < HistoryLength * 2; ++i)
+    {
+        snapshotId += idsWithGaps && random() % 4 == 0 ? 3 : 1;
+        time += 1.0f / 60;
+
+        Vector2 value(i, -i);
+        entity->velocity.AddValue(value, time, snapshotId);
+        linear.AddValue(value, time, snapshotId);
+    }
+
+    // The same queries for both, spread over the whole history
+    std::vector<uint32_t> snapshotIds;
+    std::vector<float> times;
+    float oldestTime = linear.snapshots.Peek().time;
+    uint32_t oldestId = linear.snapshots.Peek().snapshotId;
+
+    for (int i = 0; i < TotalLookups; ++i)
+    {
+        snapshotIds.push_back(oldestId + random() % (snapshotId - oldestId + 1));
+        times.push_back(oldestTime + (time - oldestTime) * (random() % 1000) / 1000.0f);
+    }
+
+    float sum = 0;
+    LookupTimes result;
+
+    result.pooledSnapshotMs = MedianMilliseconds(5, [&]
+    {
+        Vector2 value;
+        for (auto id : snapshotIds) sum += entity->velocity.TryGetValueAtSnapshot(id, value) ? value.x : 0;
+    });
+
+    result.linearSnapshotMs = MedianMilliseconds(5, [&]
+    {
+        Vector2 value;
+        for (auto id : snapshotIds) sum += linear.TryGetValueAtSnapshot(id, value) ? value.x : 0;
+    });
+
+    result.pooledTimeMs = MedianMilliseconds(5, [&]
+    {
+        for (auto t : times) sum += entity->velocity.GetValueAtTime(t).x;
+    });
+
+    result.linearTimeMs = MedianMilliseconds(5, [&]
+    {
+        for (auto t : times) sum += linear.GetValueAtTime(t, entity->velocity.currentValue).x;
+    });
+
+    // Keeps the lookups from being optimized out
+    if (sum == 0.5f)
+    {
+        printf("  %f\n", sum);
+    }
+
+    return result;
+}
+
+template<int HistoryLength>
+static void PrintLookups(Engine* engine)
+{
+    for (bool idsWithGaps : { false, true })
+    {
+        auto times = MeasureLookups<HistoryLength>(engine, idsWithGaps);
+        printf("  %14d   %7s   %13.2f   %13.2f   %12.2f   %12.2f\n",
+            HistoryLength,
+            idsWithGaps ? "yes" : "no",
+            times.pooledSnapshotMs,
+            times.linearSnapshotMs,
+            times.pooledTimeMs,
+            times.linearTimeMs);
+    }
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        PrintMemory();
+
+        printf("\nms per %d lookups in a SyncVar<Vector2>\n", TotalLookups);
+        printf("  history length   id gaps   snapshot pool   snapshot scan      time pool      time scan\n");
+
+        PrintLookups<32>(engine);
+        PrintLookups<256>(engine);
+    });
+
+    game.Run();
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <random>
+
+#include "Net/SyncVar.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+#include "LinearSnapshotHistory.hpp"
+#include "TestUtil.hpp"
+
+// The pooled snapshot history finds snapshots by index or binary search. It must give the same results as the linear
+// scans over the old embedded queue, after the ring buffer has wrapped around many times, with gaps in the snapshot
+// ids and with snapshots that are dropped for not being newer than the last one.
+
+static constexpr int HistoryLength = 32;
+static constexpr int TotalSnapshots = HistoryLength * 16;
+
+DEFINE_ENTITY(SyncVarHistoryEntity, "sync-var-history-entity")
+{
+    SyncVar<float> health { 100, SyncVarInterpolation::Linear };
+    SyncVar<Vector2> velocity { { 0, 0 }, SyncVarInterpolation::Linear };
+    SyncVar<int> ammo { 10 };
+};
+
+template<typename T, typename TRandomValue>
+static void CheckAgainstLinearScan(SyncVar<T>& var, std::mt19937& random, TRandomValue&& randomValue)
+{
+    LinearSnapshotHistory<T, HistoryLength> expected(var.interpolation);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    // Nothing recorded yet
+    T value;
+    CHECK(!var.TryGetValueAtSnapshot(0, value));
+    CHECK(var.GetValueAtTime(1) == var.currentValue);
+
+    uint32_t snapshotId = 0;
+    float time = 0;
+
+    for (int i = 0; i < TotalSnapshots; ++i)
+    {
+        // Snapshots the client never received leave gaps, and some land on the same time as the last one and are
+        // ignored
+        snapshotId += random() % 4 == 0 ? 2 + random() % 3 : 1;
+        time += random() % 8 == 0 ? 0 : 1.0f / 60 + unit(random) / 100;
+
+        auto newValue = randomValue();
+        var.AddValue(newValue, time, snapshotId);
+        expected.AddValue(newValue, time, snapshotId);
+
+        // Every id from before the oldest snapshot to past the newest, including evicted and skipped ones
+        for (int64_t id = (int64_t)snapshotId - HistoryLength * 3; id <= (int64_t)snapshotId + 2; ++id)
+        {
+            if (id < 0)
+            {
+                continue;
+            }
+
+            T actualValue;
+            T expectedValue;
+            bool found = var.TryGetValueAtSnapshot((uint32_t)id, actualValue);
+
+            CHECK(found == expected.TryGetValueAtSnapshot((uint32_t)id, expectedValue));
+            CHECK(!found || actualValue == expectedValue);
+        }
+
+        // Before, between and after the snapshots, and exactly on them
+        float oldestTime = expected.snapshots.Peek().time;
+        for (int j = 0; j < 16; ++j)
+        {
+            float queryTime = j < 12
+                ? oldestTime - 0.05f + (time - oldestTime + 0.1f) * unit(random)
+                : oldestTime + (time - oldestTime) * (j - 12) / 3;
+
+            CHECK(var.GetValueAtTime(queryTime) == expected.GetValueAtTime(queryTime, var.currentValue));
+        }
+
+        for (auto& snapshot : expected.snapshots)
+        {
+            CHECK(var.GetValueAtTime(snapshot.time) == expected.GetValueAtTime(snapshot.time, var.currentValue));
+        }
+    }
+}
+
+static void TestLookupsMatchLinearScan(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+
+    // Before any history is allocated
+    scene->GetSyncVarHistoryPool().SetHistoryLength(HistoryLength);
+
+    auto entity = scene->CreateEntity<SyncVarHistoryEntity>(Vector2(0, 0));
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> values(-1000, 1000);
+
+    CheckAgainstLinearScan(entity->health, random, [&] { return values(random); });
+    CheckAgainstLinearScan(entity->velocity, random, [&] { return Vector2(values(random), values(random)); });
+    CheckAgainstLinearScan(entity->ammo, random, [&] { return (int)(random() % 100); });
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        TestLookupsMatchLinearScan(engine);
+    });
+
+    game.Run();
+
+    return TestResult("SyncVarHistoryTest");
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <tuple>
+#include <box2d/b2_edge_shape.h>
+
+#include "Components/RigidBodyComponent.hpp"
+#include "Physics/PathFinding.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "Scene/Isometric.hpp"
+#include "Tools/ConsoleVar.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Terrain colliders merged into runs along each grid line must block exactly the edges that one collider per cell edge
+// blocked, with fewer fixtures.
+
+static constexpr int TotalMaps = 20;
+
+DEFINE_ENTITY(TerrainColliderEntity, "terrain-collider-entity")
+{
+    void OnAdded() override
+    {
+        rigidBody = AddComponent<RigidBodyComponent>();
+    }
+
+    RigidBodyComponent* rigidBody = nullptr;
+};
+
+// A unit edge between two grid points, lowest point first
+using UnitEdge = std::tuple<int, int, int, int>;
+
+struct TerrainColliders
+{
+    int totalFixtures = 0;
+    std::set<UnitEdge> blockedEdges;
+};
+
+static TerrainColliders CreateColliders(Scene* scene, IsometricSettings& settings, PathFinderService* pathFinder, bool merge)
+{
+    GetConsoleVar("merge-terrain-edges")->TrySetValue(merge ? "true" : "false");
+
+    auto entity = scene->CreateEntity<TerrainColliderEntity>(Vector2(0, 0));
+    settings.CreateTerrainColliders(pathFinder, entity->rigidBody);
+
+    TerrainColliders colliders;
+
+    for (auto fixture = entity->rigidBody->body->GetFixtureList(); fixture != nullptr; fixture = fixture->GetNext())
+    {
+        ++colliders.totalFixtures;
+
+        // Back to grid points, which are a tile apart in the world
+        auto edge = static_cast<b2EdgeShape*>(fixture->GetShape());
+        int x1 = (int)std::lround(edge->m_vertex1.x * Scene::Box2DToPixelsRatio.x / 32);
+        int y1 = (int)std::lround(edge->m_vertex1.y * Scene::Box2DToPixelsRatio.y / 32);
+        int x2 = (int)std::lround(edge->m_vertex2.x * Scene::Box2DToPixelsRatio.x / 32);
+        int y2 = (int)std::lround(edge->m_vertex2.y * Scene::Box2DToPixelsRatio.y / 32);
+
+        // Split long colliders into the unit edges they cover
+        for (int x = std::min(x1, x2); x < std::max(x1, x2); ++x) colliders.blockedEdges.insert({ x, y1, x + 1, y1 });
+        for (int y = std::min(y1, y2); y < std::max(y1, y2); ++y) colliders.blockedEdges.insert({ x1, y, x1, y + 1 });
+    }
+
+    entity->Destroy();
+
+    return colliders;
+}
+
+static void TestMergedCollidersBlockTheSameEdges(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+
+    std::mt19937 random(1);
+    int totalPerCell = 0;
+    int totalMerged = 0;
+
+    for (int map = 0; map < TotalMaps; ++map)
+    {
+        int rows = 8 + random() % 56;
+        int cols = 8 + random() % 56;
+
+        IsometricSettings settings(scene);
+        settings.terrain.SetSize(rows, cols);
+        auto pathFinder = scene->AddService<PathFinderService>(rows, cols);
+
+        // Plateaus of random heights, with an edge wherever the height changes
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < cols; ++x)
+            {
+                settings.terrain[y][x].height = random() % 10 < 7 ? 0 : 1 + random() % 2;
+            }
+        }
+
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < cols; ++x)
+            {
+                if (x + 1 < cols && settings.terrain[y][x].height != settings.terrain[y][x + 1].height)
+                {
+                    pathFinder->AddEdge(Vector2(x, y), Vector2(x + 1, y));
+                }
+
+                if (y + 1 < rows && settings.terrain[y][x].height != settings.terrain[y + 1][x].height)
+                {
+                    pathFinder->AddEdge(Vector2(x, y), Vector2(x, y + 1));
+                }
+            }
+        }
+
+        auto perCell = CreateColliders(scene, settings, pathFinder, false);
+        auto merged = CreateColliders(scene, settings, pathFinder, true);
+
+        CHECK(merged.blockedEdges == perCell.blockedEdges);
+
+        // Each shared edge was added from both of its cells
+        CHECK(perCell.totalFixtures == 2 * (int)perCell.blockedEdges.size());
+        CHECK(merged.totalFixtures <= (int)perCell.blockedEdges.size());
+
+        totalPerCell += perCell.totalFixtures;
+        totalMerged += merged.totalFixtures;
+    }
+
+    CHECK(totalMerged < totalPerCell / 2);
+
+    printf("  terrain edge fixtures on %d maps: %d per cell, %d merged\n", TotalMaps, totalPerCell, totalMerged);
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        TestMergedCollidersBlockTheSameEdges(engine);
+    });
+
+    game.Run();
+
+    return TestResult("TerrainColliderTest");
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Minimal checks for the headless tests. A failed check is reported and the test keeps going, so that one run shows
+// every failure. TestResult() turns them into the exit code.
+
+inline int& FailedChecks()
+{
+    static int failedChecks = 0;
+    return failedChecks;
+}
+
+#define CHECK(condition_) \
+    do \
+    { \
+        if (!(condition_)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition_); \
+            ++FailedChecks(); \
+        } \
+    } while (false)
+
+inline int TestResult(const char* testName)
+{
+    if (FailedChecks() == 0)
+    {
+        printf("%s: passed\n", testName);
+        return 0;
+    }
+
+    printf("%s: %d checks failed\n", testName, FailedChecks());
+    return 1;
+}
+
+/// <summary>
+/// Runs func repeatCount times and returns the median time of a run in milliseconds
+/// </summary>
+template<typename TFunc>
+double MedianMilliseconds(int repeatCount, TFunc&& func)
+{
+    std::vector<double> times;
+
+    for (int i = 0; i < repeatCount; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
@@ -0,0 +1,208 @@
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Renderer/TilemapRenderer.hpp"
+#include "Renderer/Texture.hpp"
+#include "Scene/MapSegment.hpp"
+#include "Scene/Scene.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// Tilemap chunk culling without a GPU. Every tile whose quad overlaps the camera must be in a visible chunk, in both
+// perspectives and after the tilemap is moved, and far fewer quads must be submitted than there are tiles.
+
+static constexpr int MapSize = 128;
+static constexpr int TotalLayers = 2;
+static constexpr int TotalCameras = 200;
+static const Vector2 CameraSize(1280, 720);
+
+// Only the sprite bounds are used here. A real texture needs an OpenGL context, so the sprites point at zeroed storage
+// and their UVs are meaningless.
+struct FakeTileset
+{
+    FakeTileset()
+    {
+        auto texture = reinterpret_cast<Texture*>(storage.get());
+        tiles.push_back(std::make_unique<TileProperties>(Sprite(texture, Rectangle(0, 0, 64, 64)), 0, std::map<std::string, std::string>()));
+
+        // Taller than a tile, like a wall or a tree
+        tiles.push_back(std::make_unique<TileProperties>(Sprite(texture, Rectangle(0, 0, 64, 160)), 1, std::map<std::string, std::string>()));
+    }
+
+    std::unique_ptr<unsigned char[]> storage = std::make_unique<unsigned char[]>(sizeof(Texture));
+    std::vector<std::unique_ptr<TileProperties>> tiles;
+};
+
+struct CullingResults
+{
+    int missedTiles = 0;
+    double submittedQuads = 0;
+    double visibleTiles = 0;
+    int totalTiles = 0;
+};
+
+static Vector2 ExpectedTilePosition(Scene* scene, int row, int col, Vector2 offset, Vector2 tileSize)
+{
+    if (scene->perspective == ScenePerspective::Isometric)
+    {
+        return scene->isometricSettings.TileToScreen(Vector2(col, row)) - Vector2(32, 32);
+    }
+    else
+    {
+        return offset + Vector2(col, row) * tileSize;
+    }
+}
+
+static CullingResults CheckCulling(Scene* scene, TilemapRenderer& renderer, const MapSegment& segment, Vector2 offset, std::mt19937& random)
+{
+    // Over the map in both perspectives, and off its edges
+    std::uniform_real_distribution<float> cameraX(-MapSize * 32, MapSize * 32);
+    std::uniform_real_distribution<float> cameraY(-500, MapSize * 32);
+
+    CullingResults results;
+    std::vector<int> visibleChunks;
+
+    for (int camera = 0; camera < TotalCameras; ++camera)
+    {
+        Rectangle cameraBounds(Vector2(cameraX(random), cameraY(random)), CameraSize);
+
+        for (int layerIndex = 0; layerIndex < renderer.TotalLayers(); ++layerIndex)
+        {
+            visibleChunks.clear();
+            renderer.GetVisibleChunks(layerIndex, cameraBounds, visibleChunks);
+
+            std::vector<bool> isChunkVisible(MapSize / TilemapRenderer::ChunkSize * MapSize / TilemapRenderer::ChunkSize);
+            for (int chunkIndex : visibleChunks)
+            {
+                isChunkVisible[chunkIndex] = true;
+                results.submittedQuads += renderer.GetChunk(layerIndex, chunkIndex).totalTiles;
+            }
+
+            auto& layer = segment.layers[layerIndex];
+            auto tileSize = layer.tileSize.AsVectorOfType<float>();
+
+            for (int row = 0; row < MapSize; ++row)
+            {
+                for (int col = 0; col < MapSize; ++col)
+                {
+                    TileProperties* tile = layer.tileMap[row][col];
+                    if (tile == nullptr) continue;
+
+                    Rectangle quad(ExpectedTilePosition(scene, row, col, offset, tileSize), tile->sprite.Bounds().Size());
+                    if (!quad.IntersectsWith(cameraBounds)) continue;
+
+                    ++results.visibleTiles;
+
+                    int chunkIndex = (row / TilemapRenderer::ChunkSize) * (MapSize / TilemapRenderer::ChunkSize) + col / TilemapRenderer::ChunkSize;
+                    if (!isChunkVisible[chunkIndex])
+                    {
+                        ++results.missedTiles;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int layerIndex = 0; layerIndex < TotalLayers; ++layerIndex)
+    {
+        for (int row = 0; row < MapSize; ++row)
+        {
+            for (int col = 0; col < MapSize; ++col)
+            {
+                results.totalTiles += segment.layers[layerIndex].tileMap[row][col] != nullptr;
+            }
+        }
+    }
+
+    results.submittedQuads /= TotalCameras;
+    results.visibleTiles /= TotalCameras;
+
+    return results;
+}
+
+static void PrintResults(const char* name, const CullingResults& results)
+{
+    printf("  %-22s %8d %16.0f %15.0f\n", name, results.totalTiles, results.submittedQuads, results.visibleTiles);
+}
+
+static void TestVisibleChunks(Engine* engine)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+
+    FakeTileset tileset;
+    std::mt19937 random(1);
+
+    // 80% of the tiles filled, some of them with tall sprites
+    std::vector<std::unique_ptr<TileProperties*[]>> tileMaps;
+    MapSegment segment;
+
+    for (int layerIndex = 0; layerIndex < TotalLayers; ++layerIndex)
+    {
+        tileMaps.push_back(std::make_unique<TileProperties*[]>(MapSize * MapSize));
+
+        for (int i = 0; i < MapSize * MapSize; ++i)
+        {
+            int roll = random() % 10;
+            tileMaps.back()[i] = roll < 2 ? nullptr : tileset.tiles[roll == 9 ? 1 : 0].get();
+        }
+
+        segment.layers.emplace_back(tileMaps.back().get(), MapSize, MapSize, Vector2i(32, 32), StringId("layer"));
+    }
+
+    printf("  %-22s %8s %16s %15s\n", "", "tiles", "quads submitted", "tiles visible");
+
+    // Isometric
+    {
+        scene->perspective = ScenePerspective::Isometric;
+        scene->isometricSettings.tileSize = Vector2(64, 32);
+
+        TilemapRenderer renderer;
+        renderer.SetMapSegment(&segment, scene);
+
+        auto results = CheckCulling(scene, renderer, segment, Vector2(0, 0), random);
+        CHECK(results.missedTiles == 0);
+        CHECK(results.submittedQuads < results.totalTiles / 4);
+        PrintResults("isometric", results);
+    }
+
+    // Orthographic, before and after the tilemap is moved
+    {
+        scene->perspective = ScenePerspective::Orothgraphic;
+
+        TilemapRenderer renderer;
+        renderer.SetMapSegment(&segment, scene);
+
+        auto results = CheckCulling(scene, renderer, segment, Vector2(0, 0), random);
+        CHECK(results.missedTiles == 0);
+        CHECK(results.submittedQuads < results.totalTiles / 4);
+        PrintResults("orthographic", results);
+
+        auto boundsBeforeMove = renderer.GetChunk(0, 0).bounds;
+        Vector2 offset(500, 300);
+        renderer.SetOffset(offset);
+
+        auto movedResults = CheckCulling(scene, renderer, segment, offset, random);
+        CHECK(movedResults.missedTiles == 0);
+        PrintResults("orthographic, moved", movedResults);
+
+        // Moving the tilemap doesn't lay out the chunks again, the offset is added when they're culled and submitted
+        auto boundsAfterMove = renderer.GetChunk(0, 0).bounds;
+        CHECK(boundsAfterMove.TopLeft() == boundsBeforeMove.TopLeft());
+        CHECK(boundsAfterMove.Size() == boundsBeforeMove.Size());
+    }
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        TestVisibleChunks(engine);
+    });
+
+    game.Run();
+
+    return TestResult("TilemapChunkTest");
+}
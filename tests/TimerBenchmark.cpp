@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <random>
+
+#include "Scene/Timer.hpp"
+#include "TestUtil.hpp"
+
+// 100k active timers ticked at 60 frames per second: the timing wheel against the list TimerManager used to keep,
+// which subtracted the frame time from every timer each tick. Every timer that fires starts a new one, so the number
+// of active timers stays the same.
+
+static constexpr int TotalTimers = 100000;
+static constexpr int TotalFrames = 600;
+static constexpr float FrameTime = 1.0f / 60;
+
+/// <summary>
+/// The old TimerManager, without entity timers
+/// </summary>
+class ListTimerManager
+{
+public:
+    void StartTimer(float timeSeconds, const std::function<void()>& callback)
+    {
+        _timers.push_back({ timeSeconds, callback });
+    }
+
+    void TickTimers(float timeSeconds)
+    {
+        auto it = _timers.begin();
+        while (it != _timers.end())
+        {
+            auto timer = it++;
+            timer->timeLeft -= timeSeconds;
+            if (timer->timeLeft <= 0)
+            {
+                timer->callback();
+                _timers.erase(timer);
+            }
+        }
+    }
+
+private:
+    struct TimerInstance
+    {
+        float timeLeft;
+        std::function<void()> callback;
+    };
+
+    std::list<TimerInstance> _timers;
+};
+
+struct TimerTimes
+{
+    double startMs;
+    double framesMs;
+    int timersFired;
+};
+
+template<typename TTimerManager>
+static TimerTimes MeasureTimers()
+{
+    TTimerManager timerManager;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> delay(0.1f, 10);
+    TimerTimes times { 0, 0, 0 };
+
+    std::function<void()> restart = [&]
+    {
+        ++times.timersFired;
+        timerManager.StartTimer(delay(random), restart);
+    };
+
+    times.startMs = MedianMilliseconds(1, [&]
+    {
+        for (int i = 0; i < TotalTimers; ++i)
+        {
+            timerManager.StartTimer(delay(random), restart);
+        }
+    });
+
+    times.framesMs = MedianMilliseconds(1, [&]
+    {
+        for (int frame = 0; frame < TotalFrames; ++frame)
+        {
+            timerManager.TickTimers(FrameTime);
+        }
+    });
+
+    return times;
+}
+
+static double MeasureWheelCancel()
+{
+    TimerManager timerManager;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> delay(0.1f, 10);
+    std::vector<TimerHandle> handles;
+
+    for (int i = 0; i < TotalTimers; ++i)
+    {
+        handles.push_back(timerManager.StartTimer(delay(random), [] { }));
+    }
+
+    return MedianMilliseconds(1, [&]
+    {
+        for (auto handle : handles)
+        {
+            timerManager.CancelTimer(handle);
+        }
+    });
+}
+
+int main()
+{
+    auto list = MeasureTimers<ListTimerManager>();
+    auto wheel = MeasureTimers<TimerManager>();
+
+    printf("%d active timers, delays from 0.1s to 10s, %d frames at 60 fps\n", TotalTimers, TotalFrames);
+    printf("           start all ms   ms per frame   timers fired\n");
+    printf("  list     %12.2f   %12.4f   %12d\n", list.startMs, list.framesMs / TotalFrames, list.timersFired);
+    printf("  wheel    %12.2f   %12.4f   %12d\n", wheel.startMs, wheel.framesMs / TotalFrames, wheel.timersFired);
+    printf("\n  cancelling every wheel timer: %.2f ms\n", MeasureWheelCancel());
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <thread>
+#include <vector>
+
+#include "Scene/Timer.hpp"
+#include "TestUtil.hpp"
+
+// Timers started from a concurrent hook must fire in the same order as when the hook runs serially. The concurrent
+// run mirrors Scene::RunGroupConcurrently(): contiguous batches reserve their timers on separate threads, then the
+// batches are started in batch order.
+
+static constexpr int TotalEntities = 1000;
+static constexpr int TotalBatches = 8;
+
+// Few distinct delays, so that many timers expire on the same tick and the order comes down to start order
+static float TimerDelay(int entityId)
+{
+    return (entityId % 7) * 0.004f;
+}
+
+static bool IsRepeating(int entityId)
+{
+    return entityId % 5 == 0;
+}
+
+static std::vector<int> RunTimers(TimerManager& timerManager, std::vector<TimerHandle>& handles)
+{
+    // Cancel some of the timers, which requires their handles to be valid
+    for (int i = 0; i < TotalEntities; i += 11)
+    {
+        CHECK(timerManager.CancelTimer(handles[i]));
+    }
+
+    for (int i = 0; i < 50; ++i)
+    {
+        timerManager.TickTimers(0.001f);
+    }
+
+    std::vector<int> activeTimers;
+    for (int i = 0; i < TotalEntities; ++i)
+    {
+        activeTimers.push_back(timerManager.IsTimerActive(handles[i]));
+    }
+
+    return activeTimers;
+}
+
+static void TestConcurrentStartMatchesSerial()
+{
+    std::vector<int> serialOrder;
+    std::vector<int> serialActiveTimers;
+
+    {
+        TimerManager timerManager;
+        std::vector<TimerHandle> handles;
+
+        for (int i = 0; i < TotalEntities; ++i)
+        {
+            auto callback = [&serialOrder, i] { serialOrder.push_back(i); };
+            handles.push_back(IsRepeating(i)
+                ? timerManager.StartRepeatingTimer(TimerDelay(i), callback)
+                : timerManager.StartTimer(TimerDelay(i), callback));
+        }
+
+        serialActiveTimers = RunTimers(timerManager, handles);
+    }
+
+    std::vector<int> concurrentOrder;
+    std::vector<int> concurrentActiveTimers;
+
+    {
+        TimerManager timerManager;
+        std::vector<TimerHandle> handles(TotalEntities);
+        std::vector<std::thread> threads;
+
+        for (int batchId = 0; batchId < TotalBatches; ++batchId)
+        {
+            threads.emplace_back([&, batchId]
+            {
+                int begin = TotalEntities * batchId / TotalBatches;
+                int end = TotalEntities * (batchId + 1) / TotalBatches;
+
+                for (int i = begin; i < end; ++i)
+                {
+                    handles[i] = timerManager.ReserveTimer(
+                        TimerDelay(i),
+                        [&concurrentOrder, i] { concurrentOrder.push_back(i); },
+                        IsRepeating(i));
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (auto handle : handles)
+        {
+            CHECK(handle.IsValid());
+        }
+
+        // Merged in batch order, which is entity order
+        for (auto handle : handles)
+        {
+            timerManager.StartReservedTimer(handle, nullptr);
+        }
+
+        concurrentActiveTimers = RunTimers(timerManager, handles);
+    }
+
+    CHECK(!serialOrder.empty());
+    CHECK(serialOrder == concurrentOrder);
+    CHECK(serialActiveTimers == concurrentActiveTimers);
+}
+
+int main()
+{
+    TestConcurrentStartMatchesSerial();
+
+    return TestResult("TimerDeterminismTest");
+}
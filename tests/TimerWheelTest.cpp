@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Scene/Timer.hpp"
+#include "TestUtil.hpp"
+
+// Timers spread over every level of the timing wheel must fire on the same tick and in the same order as in a
+// reference that keeps every timer in a list and always fires the one that expires first. The run covers more than
+// 2^26 ticks, so the longest timers start in the outermost wheel and cascade through all five.
+//
+// Repeating timers with intervals at every level cancel themselves after a few runs, timers are cancelled from
+// outside and from other timers' callbacks, and callbacks start new timers. Delays are multiples of 1/8 of a second,
+// which are exact in a float, and the wheel is ticked 125 ticks at a time, so every timer fires at the end of a step.
+
+static constexpr uint64_t TicksPerStep = 125;
+static constexpr uint64_t TotalTicks = (1ull << 27) + TicksPerStep;
+static constexpr uint64_t TotalSteps = TotalTicks / TicksPerStep;
+static constexpr uint64_t OutermostWheelTicks = 1ull << 26;
+static constexpr int InitialTimers = 2000;
+static constexpr int MaxEighthsOfSecond = 960000;
+
+static uint64_t SecondsToTicks(float seconds)
+{
+    return (uint64_t)ceil((double)seconds * TimerManager::TicksPerSecond);
+}
+
+class WheelTimers
+{
+public:
+    void Start(int id, float seconds, bool isRepeating, const std::function<void()>& callback)
+    {
+        if (id >= (int)_handles.size()) _handles.resize(id + 1);
+
+        _handles[id] = isRepeating
+            ? _timerManager.StartRepeatingTimer(seconds, callback)
+            : _timerManager.StartTimer(seconds, callback);
+    }
+
+    bool Cancel(int id) { return _timerManager.CancelTimer(_handles[id]); }
+    bool IsActive(int id) const { return _timerManager.IsTimerActive(_handles[id]); }
+    int ActiveCount() const { return _timerManager.ActiveTimerCount(); }
+    uint64_t CurrentTick() const { return _stepEndTick; }
+
+    void Step()
+    {
+        _stepEndTick += TicksPerStep;
+        _timerManager.TickTimers(TicksPerStep / (float)TimerManager::TicksPerSecond);
+    }
+
+private:
+    TimerManager _timerManager;
+    std::vector<TimerHandle> _handles;
+    uint64_t _stepEndTick = 0;
+};
+
+class ReferenceTimers
+{
+public:
+    void Start(int id, float seconds, bool isRepeating, const std::function<void()>& callback)
+    {
+        if (id >= (int)_timers.size()) _timers.resize(id + 1);
+
+        auto ticks = SecondsToTicks(seconds);
+        _timers[id] = { _currentTick + ticks, isRepeating ? ticks : 0, _nextSequence++, true, callback };
+        _earliestExpireTick = std::min(_earliestExpireTick, _timers[id].expireTick);
+    }
+
+    bool Cancel(int id)
+    {
+        bool wasActive = _timers[id].isActive;
+        _timers[id].isActive = false;
+        return wasActive;
+    }
+
+    bool IsActive(int id) const { return _timers[id].isActive; }
+    int ActiveCount() const { return std::count_if(_timers.begin(), _timers.end(), [](auto& timer) { return timer.isActive; }); }
+    uint64_t CurrentTick() const { return _currentTick; }
+
+    void Step()
+    {
+        uint64_t endTick = _currentTick + TicksPerStep;
+
+        while (_earliestExpireTick <= endTick)
+        {
+            // The active timer that expires first, and of those the one started first
+            Timer* next = nullptr;
+            _earliestExpireTick = UINT64_MAX;
+
+            for (auto& timer : _timers)
+            {
+                if (!timer.isActive) continue;
+
+                if (timer.expireTick <= endTick
+                    && (next == nullptr
+                        || timer.expireTick < next->expireTick
+                        || (timer.expireTick == next->expireTick && timer.sequence < next->sequence)))
+                {
+                    next = &timer;
+                }
+
+                _earliestExpireTick = std::min(_earliestExpireTick, timer.expireTick);
+            }
+
+            if (next == nullptr)
+            {
+                break;
+            }
+
+            _currentTick = next->expireTick;
+            int id = next - _timers.data();
+
+            // The callback can start timers, which moves them
+            auto callback = next->callback;
+            callback();
+
+            auto& timer = _timers[id];
+            if (timer.isActive && timer.intervalTicks != 0)
+            {
+                timer.expireTick += timer.intervalTicks;
+                timer.sequence = _nextSequence++;
+            }
+            else
+            {
+                timer.isActive = false;
+            }
+
+            _earliestExpireTick = 0;
+        }
+
+        _currentTick = endTick;
+    }
+
+private:
+    struct Timer
+    {
+        uint64_t expireTick;
+        uint64_t intervalTicks;
+        uint64_t sequence;
+        bool isActive;
+        std::function<void()> callback;
+    };
+
+    std::vector<Timer> _timers;
+    uint64_t _currentTick = 0;
+    uint64_t _nextSequence = 0;
+    uint64_t _earliestExpireTick = UINT64_MAX;
+};
+
+struct RunResult
+{
+    std::vector<std::pair<int, uint64_t>> firings;
+    std::vector<int> cancelResults;
+    std::vector<int> activeCounts;
+    std::vector<int> finalActiveTimers;
+    uint64_t longestDelayFired = 0;
+};
+
+template<typename TTimers>
+class CascadeRun
+{
+public:
+    RunResult Run()
+    {
+        for (int i = 0; i < InitialTimers; ++i)
+        {
+            bool isRepeating = i % 10 == 0;
+
+            // Repeating timers that never stop fire often enough to keep the run short with long intervals only
+            float seconds = isRepeating && i % 40 == 0
+                ? (8000 + _random() % (MaxEighthsOfSecond - 8000)) / 8.0f
+                : RandomDelay();
+
+            StartTimer(seconds, isRepeating);
+
+            if (i % 7 == 0)
+            {
+                _cancelsByStep[_random() % TotalSteps].push_back(i);
+            }
+        }
+
+        for (uint64_t step = 0; step < TotalSteps; ++step)
+        {
+            auto cancels = _cancelsByStep.find(step);
+            if (cancels != _cancelsByStep.end())
+            {
+                for (int id : cancels->second)
+                {
+                    _result.cancelResults.push_back(_timers.Cancel(id));
+                }
+            }
+
+            _timers.Step();
+
+            if (step % 4096 == 0)
+            {
+                _result.activeCounts.push_back(_timers.ActiveCount());
+            }
+        }
+
+        for (int id = 0; id < (int)_startTicks.size(); ++id)
+        {
+            _result.finalActiveTimers.push_back(_timers.IsActive(id));
+        }
+
+        return _result;
+    }
+
+private:
+    // Log-uniform, so that every wheel level gets timers
+    float RandomDelay()
+    {
+        std::uniform_real_distribution<double> exponent(0, log((double)MaxEighthsOfSecond));
+        return (int)exp(exponent(_random)) / 8.0f;
+    }
+
+    void StartTimer(float seconds, bool isRepeating)
+    {
+        int id = _startTicks.size();
+        _startTicks.push_back(_timers.CurrentTick());
+        _isRepeating.push_back(isRepeating);
+        _fireCounts.push_back(0);
+
+        _timers.Start(id, seconds, isRepeating, [=] { OnFired(id); });
+    }
+
+    void OnFired(int id)
+    {
+        auto tick = _timers.CurrentTick();
+        _result.firings.emplace_back(id, tick);
+        _result.longestDelayFired = std::max(_result.longestDelayFired, tick - _startTicks[id]);
+
+        int fireCount = ++_fireCounts[id];
+
+        if (id % 13 == 0 && fireCount == 1)
+        {
+            StartTimer(RandomDelay(), id % 26 == 0);
+        }
+
+        if (_isRepeating[id] && id % 40 != 0 && fireCount == 1 + id % 5)
+        {
+            _result.cancelResults.push_back(_timers.Cancel(id));
+        }
+
+        if (id % 19 == 0 && id + 1 < (int)_startTicks.size())
+        {
+            _result.cancelResults.push_back(_timers.Cancel(id + 1));
+        }
+    }
+
+    TTimers _timers;
+    RunResult _result;
+    std::mt19937 _random { 1 };
+
+    std::vector<uint64_t> _startTicks;
+    std::vector<bool> _isRepeating;
+    std::vector<int> _fireCounts;
+    std::map<uint64_t, std::vector<int>> _cancelsByStep;
+};
+
+static void TestCascadeMatchesReference()
+{
+    auto wheel = CascadeRun<WheelTimers>().Run();
+    auto reference = CascadeRun<ReferenceTimers>().Run();
+
+    CHECK(!reference.firings.empty());
+    CHECK(reference.longestDelayFired >= OutermostWheelTicks);
+    CHECK(std::count(reference.cancelResults.begin(), reference.cancelResults.end(), 1) > 0);
+    CHECK(std::count(reference.cancelResults.begin(), reference.cancelResults.end(), 0) > 0);
+
+    CHECK(wheel.firings == reference.firings);
+    CHECK(wheel.cancelResults == reference.cancelResults);
+    CHECK(wheel.activeCounts == reference.activeCounts);
+    CHECK(wheel.finalActiveTimers == reference.finalActiveTimers);
+
+    printf("  %d timers fired, %d cancels, %d timers still active\n",
+        (int)reference.firings.size(),
+        (int)reference.cancelResults.size(),
+        reference.activeCounts.empty() ? 0 : reference.activeCounts.back());
+}
+
+int main()
+{
+    TestCascadeMatchesReference();
+
+    return TestResult("TimerWheelTest");
+}
@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <random>
+
+#include "Components/NetComponent.hpp"
+#include "Net/LoadTest.hpp"
+#include "System/WorkerPool.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+
+// Server tick times of a load test with 8 and 32 synthetic clients and moving replicated entities, so that most of a
+// tick is spent encoding world updates, which are spread over the worker threads.
+
+static constexpr int TotalEntities = 1000;
+static constexpr float DurationSeconds = 5;
+static constexpr float WorldSize = 8000;
+
+DEFINE_ENTITY(EncodingBenchmarkEntity, "encoding-benchmark-entity")
+{
+    void OnAdded() override
+    {
+        AddComponent<NetComponent>();
+    }
+
+    void ServerUpdate(float deltaTime) override
+    {
+        SetCenter(Center() + velocity * deltaTime);
+    }
+
+    Vector2 velocity;
+};
+
+static LoadTestResults RunLoadTest(Engine* engine, int totalClients)
+{
+    LoadTestSettings settings;
+    settings.mapName = "empty-map";
+    settings.totalClients = totalClients;
+    settings.durationSeconds = DurationSeconds;
+
+    LoadTest loadTest(engine, settings);
+    auto scene = engine->GetServerGame()->GetScene();
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, WorldSize);
+    std::uniform_real_distribution<float> velocity(-60, 60);
+
+    for (int i = 0; i < TotalEntities; ++i)
+    {
+        auto entity = scene->CreateEntity<EncodingBenchmarkEntity>(Vector2(position(random), position(random)));
+        entity->velocity = Vector2(velocity(random), velocity(random));
+    }
+
+    return loadTest.Run();
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        printf("%d replicated entities, %.0f seconds per run, %d threads\n",
+            TotalEntities,
+            DurationSeconds,
+            engine->GetWorkerPool() != nullptr ? engine->GetWorkerPool()->TotalThreads() : 1);
+        printf("  clients   ticks   p99 tick ms   down bytes/s/client\n");
+
+        for (int totalClients : { 8, 32 })
+        {
+            auto results = RunLoadTest(engine, totalClients);
+
+            printf("  %7d   %5d   %11.3f   %19.0f\n",
+                totalClients,
+                results.ticks,
+                results.tickTimeP99Ms,
+                results.downBytesPerSecondPerClient);
+        }
+    });
+
+    game.Run();
+
+    return 0;
+}
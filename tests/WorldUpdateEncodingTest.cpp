@@ -0,0 +1,213 @@
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include <slikenet/BitStream.h>
+
+#include "Components/NetComponent.hpp"
+#include "Net/RelevancyFilter.hpp"
+#include "Net/ReplicationManager.hpp"
+#include "Net/ServerGame.hpp"
+#include "System/WorkerPool.hpp"
+#include "Scene/BaseEntity.hpp"
+#include "HeadlessGame.hpp"
+#include "TestUtil.hpp"
+
+// The world updates encoded on worker threads by Server_WriteWorldUpdates() must be byte for byte the same as the ones
+// Server_SendWorldUpdate() encodes one client at a time. The same scene is run twice from the same seed, once each way,
+// and every client's stream is compared on every tick.
+//
+// Clients acknowledge at different rates, so some get deltas from different baselines and some fall far enough behind
+// to get the full state. Entities spawn during the run and a relevancy filter with moving viewpoints makes entities
+// enter and leave each client's view.
+
+static constexpr int TotalClients = 24;
+static constexpr int InitialEntities = 600;
+static constexpr int TotalTicks = 150;
+static constexpr float WorldSize = 4000;
+
+DEFINE_ENTITY(EncodingTestEntity, "encoding-test-entity")
+{
+    void OnAdded() override
+    {
+        AddComponent<NetComponent>();
+    }
+
+    Vector2 velocity;
+};
+
+struct EncodedUpdate
+{
+    bool hasUpdate;
+    std::vector<unsigned char> bytes;
+    int totalBits;
+};
+
+// Indexed by tick, then client
+using EncodedRun = std::vector<std::vector<EncodedUpdate>>;
+
+static EncodedUpdate ToEncodedUpdate(bool hasUpdate, SLNet::BitStream& stream)
+{
+    auto data = stream.GetData();
+    return { hasUpdate, std::vector<unsigned char>(data, data + stream.GetNumberOfBytesUsed()), (int)stream.GetNumberOfBitsUsed() };
+}
+
+static EncodedRun RunScene(Engine* engine, bool useWorkerPool)
+{
+    engine->StartLoopbackServer("empty-map");
+    auto scene = engine->GetServerGame()->GetScene();
+    auto replicationManager = scene->replicationManager;
+    replicationManager->SetRelevancyFilter(std::make_unique<SpatialRelevancyFilter>(800, 128));
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(0, WorldSize);
+    std::uniform_real_distribution<float> velocity(-4, 4);
+
+    std::vector<EncodingTestEntity*> entities;
+    auto spawnEntity = [&]
+    {
+        auto entity = scene->CreateEntity<EncodingTestEntity>(Vector2(position(random), position(random)));
+        entity->velocity = Vector2(velocity(random), velocity(random));
+        entities.push_back(entity);
+    };
+
+    for (int i = 0; i < InitialEntities; ++i)
+    {
+        spawnEntity();
+    }
+
+    std::vector<Vector2> viewpoints;
+    for (int clientId = 0; clientId < TotalClients; ++clientId)
+    {
+        replicationManager->GetClient(clientId);
+        viewpoints.emplace_back(position(random), position(random));
+    }
+
+    std::vector<SLNet::BitStream> streams(TotalClients);
+    std::vector<ClientWorldUpdate> updates(TotalClients);
+    EncodedRun run;
+
+    for (int tick = 0; tick < TotalTicks; ++tick)
+    {
+        for (auto entity : entities)
+        {
+            entity->SetCenter(entity->Center() + entity->velocity);
+        }
+
+        if (tick % 10 == 0)
+        {
+            spawnEntity();
+        }
+
+        for (int clientId = 0; clientId < TotalClients; ++clientId)
+        {
+            viewpoints[clientId] = viewpoints[clientId] + Vector2(12, 7 - clientId % 5);
+            replicationManager->SetClientViewpoint(clientId, viewpoints[clientId]);
+        }
+
+        scene->deltaTime = 1.0f / 60;
+        scene->relativeTime += scene->deltaTime;
+        replicationManager->TakeSnapshot();
+
+        run.emplace_back();
+        auto& encoded = run.back();
+
+        if (useWorkerPool)
+        {
+            for (int clientId = 0; clientId < TotalClients; ++clientId)
+            {
+                updates[clientId] = ClientWorldUpdate();
+                updates[clientId].clientId = clientId;
+                updates[clientId].stream = &streams[clientId];
+            }
+
+            replicationManager->Server_WriteWorldUpdates(updates);
+
+            for (auto& update : updates)
+            {
+                encoded.push_back(ToEncodedUpdate(update.hasUpdate, *update.stream));
+            }
+        }
+        else
+        {
+            for (int clientId = 0; clientId < TotalClients; ++clientId)
+            {
+                SLNet::BitStream stream;
+                bool hasUpdate = replicationManager->Server_SendWorldUpdate(clientId, stream);
+                encoded.push_back(ToEncodedUpdate(hasUpdate, stream));
+            }
+        }
+
+        for (int clientId = 0; clientId < TotalClients; ++clientId)
+        {
+            // A third acknowledge every tick, a third every few ticks and the rest rarely enough to need full states
+            int ackInterval = clientId % 3 == 0 ? 1 : (clientId % 3 == 1 ? 4 : 2 * ReplicationManager::MaxSnapshotsWithoutAck());
+            if (tick % ackInterval == 0 && encoded[clientId].hasUpdate)
+            {
+                replicationManager->GetClient(clientId).lastReceivedSnapshotId = replicationManager->GetCurrentSnapshotId();
+            }
+        }
+    }
+
+    return run;
+}
+
+int main()
+{
+    HeadlessGame game([](Engine* engine)
+    {
+        CHECK(engine->GetWorkerPool() != nullptr && engine->GetWorkerPool()->TotalThreads() > 1);
+
+        auto serial = RunScene(engine, false);
+        auto parallel = RunScene(engine, true);
+
+        CHECK(serial.size() == parallel.size());
+
+        int mismatches = 0;
+        int totalUpdates = 0;
+        int64_t totalBytes = 0;
+
+        for (int tick = 0; tick < (int)serial.size() && tick < (int)parallel.size(); ++tick)
+        {
+            for (int clientId = 0; clientId < TotalClients; ++clientId)
+            {
+                auto& expected = serial[tick][clientId];
+                auto& actual = parallel[tick][clientId];
+
+                bool isSame = expected.hasUpdate == actual.hasUpdate
+                    && expected.totalBits == actual.totalBits
+                    && expected.bytes.size() == actual.bytes.size()
+                    && memcmp(expected.bytes.data(), actual.bytes.data(), expected.bytes.size()) == 0;
+
+                if (!isSame && mismatches++ == 0)
+                {
+                    printf("  first mismatch on tick %d for client %d: %d bits serially, %d bits on workers\n",
+                        tick,
+                        clientId,
+                        expected.totalBits,
+                        actual.totalBits);
+                }
+
+                totalUpdates += expected.hasUpdate;
+                totalBytes += expected.bytes.size();
+            }
+        }
+
+        CHECK(mismatches == 0);
+        CHECK(totalUpdates > 0);
+
+        printf("  %d updates, %lld bytes compared on %d threads\n",
+            totalUpdates,
+            (long long)totalBytes,
+            engine->GetWorkerPool()->TotalThreads());
+    },
+    [](EngineConfig& config)
+    {
+        // At least a few workers even on small CI machines, so clients are really encoded concurrently
+        config.workerThreadCount = 4;
+    });
+
+    game.Run();
+
+    return TestResult("WorldUpdateEncodingTest");
+}